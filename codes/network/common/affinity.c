@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include "affinity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#define AFFINITY_MAX_NODES 1024
+#define IRQ_HINTS_PER_NIC 4   // 每块网卡最多打印的中断调整建议
+
+int affinity_parse_cpus(const char *spec, int *cpus, int max) {
+    int count = 0;
+    const char *p = spec;
+
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) return -1;
+        long last = first;
+        p = end;
+
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) return -1;
+            p = end;
+        }
+        if (last >= AFFINITY_MAX_CPUS) return -1;
+
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (count >= max) return -1;
+            cpus[count++] = (int)cpu;
+        }
+
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return -1;
+        }
+    }
+    return count;
+}
+
+int affinity_attr_set_cpu(pthread_attr_t *attr, int cpu) {
+    if (cpu < 0) return 0;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_attr_setaffinity_np(attr, sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+int affinity_pin_self(int cpu) {
+    if (cpu < 0) return 0;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+// sysfs中CPU目录下的nodeN链接
+int affinity_cpu_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+    DIR *dir = opendir(path);
+    if (!dir) return -1;
+
+    int node = -1;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, "node", 4) == 0 && isdigit((unsigned char)de->d_name[4])) {
+            node = atoi(de->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+int affinity_node_count(void) {
+    static int cached;
+    if (cached) return cached;
+
+    int count = 0;
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir) {
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL) {
+            if (strncmp(de->d_name, "node", 4) == 0 && isdigit((unsigned char)de->d_name[4])) {
+                count++;
+            }
+        }
+        closedir(dir);
+    }
+    cached = count > 0 ? count : 1;
+    return cached;
+}
+
+int affinity_bind_memory(void *addr, size_t len, int node) {
+    if (!addr || len == 0 || node < 0 || node >= AFFINITY_MAX_NODES || affinity_node_count() <= 1) {
+        return 0;
+    }
+
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(page - 1);
+    uintptr_t end = ((uintptr_t)addr + len + page - 1) & ~(page - 1);
+
+    unsigned long mask[AFFINITY_MAX_NODES / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+
+    // PREFERRED：节点内存不足时仍可从其他节点分配；MF_MOVE迁移已经分配的页
+    if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, mask, AFFINITY_MAX_NODES + 1, MPOL_MF_MOVE) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void *affinity_alloc(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size = (size + page - 1) & ~(page - 1);
+
+    void *p = aligned_alloc(page, size);
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+// 读取一行文本，失败返回-1
+static int read_line(const char *path, char *buf, size_t size) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    int ret = fgets(buf, (int)size, f) ? 0 : -1;
+    fclose(f);
+    buf[strcspn(buf, "\n")] = '\0';
+    return ret;
+}
+
+// 中断实际投递的CPU：优先effective_affinity_list（内核最终选择），没有时用smp_affinity_list
+static int irq_cpus(int irq, int *cpus, int max) {
+    char path[64], line[256];
+
+    snprintf(path, sizeof(path), "/proc/irq/%d/effective_affinity_list", irq);
+    if (read_line(path, line, sizeof(line)) != 0 || line[0] == '\0') {
+        snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", irq);
+        if (read_line(path, line, sizeof(line)) != 0) return -1;
+    }
+    return affinity_parse_cpus(line, cpus, max);
+}
+
+void affinity_report_irqs(const int *cpus, int count) {
+    static bool worker_cpu[AFFINITY_MAX_CPUS];
+    static bool worker_node[AFFINITY_MAX_NODES];
+    static int irq_cpu_list[AFFINITY_MAX_CPUS];
+
+    memset(worker_cpu, 0, sizeof(worker_cpu));
+    memset(worker_node, 0, sizeof(worker_node));
+    for (int i = 0; i < count; i++) {
+        if (cpus[i] < 0 || cpus[i] >= AFFINITY_MAX_CPUS) continue;
+        worker_cpu[cpus[i]] = true;
+        int node = affinity_cpu_node(cpus[i]);
+        if (node >= 0 && node < AFFINITY_MAX_NODES) worker_node[node] = true;
+    }
+
+    DIR *net = opendir("/sys/class/net");
+    if (!net) return;
+
+    struct dirent *de;
+    while ((de = readdir(net)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+
+        // 没有device链接的是虚拟接口（lo、bridge、veth等）
+        char path[512];
+        snprintf(path, sizeof(path), "/sys/class/net/%s/device", de->d_name);
+        if (access(path, F_OK) != 0) continue;
+
+        char line[32];
+        int nic_node = -1;
+        snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", de->d_name);
+        if (read_line(path, line, sizeof(line)) == 0) nic_node = atoi(line);
+
+        int irqs = 0, irqs_on_workers = 0, hints = 0;
+        snprintf(path, sizeof(path), "/sys/class/net/%s/device/msi_irqs", de->d_name);
+        DIR *msi = opendir(path);
+        struct dirent *ie;
+        while (msi && (ie = readdir(msi)) != NULL) {
+            if (!isdigit((unsigned char)ie->d_name[0])) continue;
+            int irq = atoi(ie->d_name);
+            int n = irq_cpus(irq, irq_cpu_list, AFFINITY_MAX_CPUS);
+            if (n <= 0) continue;
+            irqs++;
+
+            bool on_worker = false;
+            for (int i = 0; i < n; i++) {
+                if (worker_cpu[irq_cpu_list[i]]) on_worker = true;
+            }
+            if (on_worker) {
+                irqs_on_workers++;
+            } else if (count > 0 && hints++ < IRQ_HINTS_PER_NIC) {
+                printf("  hint: IRQ %d (%s) is delivered to CPU %d, not a worker CPU; "
+                       "write a worker CPU to /proc/irq/%d/smp_affinity_list\n",
+                       irq, de->d_name, irq_cpu_list[0], irq);
+            }
+        }
+        if (msi) closedir(msi);
+
+        printf("NIC %s: numa_node=%d, msi_irqs=%d, on worker CPUs=%d\n",
+               de->d_name, nic_node, irqs, irqs_on_workers);
+        if (count > 0 && nic_node >= 0 && nic_node < AFFINITY_MAX_NODES && !worker_node[nic_node]) {
+            printf("  hint: %s is attached to node %d but no worker thread runs there\n", de->d_name, nic_node);
+        }
+    }
+    closedir(net);
+}
@@ -0,0 +1,36 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// CPU绑定与NUMA本地内存：直接使用sched/mbind系统调用和sysfs，不依赖libnuma
+// 线程绑核后，它独占的状态应当位于本节点：新分配的内存靠首次访问落在本地，
+// 绑核前已分配的内存用affinity_bind_memory迁移过去
+#define AFFINITY_MAX_CPUS 1024
+
+// 解析CPU列表（如"0-3,8,10-11"），返回CPU个数，格式错误或超出max返回-1
+int affinity_parse_cpus(const char *spec, int *cpus, int max);
+
+// 设置线程属性，新线程从第一条指令起就运行在cpu上；cpu < 0时不做任何事
+int affinity_attr_set_cpu(pthread_attr_t *attr, int cpu);
+// 绑定当前线程
+int affinity_pin_self(int cpu);
+
+// CPU所在的NUMA节点，无法确定时返回-1
+int affinity_cpu_node(int cpu);
+// 系统的NUMA节点数（至少为1）
+int affinity_node_count(void);
+
+// 把[addr, addr+len)覆盖的整页绑定到node：已分配的页迁移过去，之后缺页也在该节点分配
+// node < 0或单节点机器上不做任何事；失败（内核不支持、页被共享等）返回-1，内存仍可正常使用
+int affinity_bind_memory(void *addr, size_t len, int node);
+
+// 按页对齐分配并清零，用free释放；独立成页的对象才能单独迁移到某个节点
+void *affinity_alloc(size_t size);
+
+// 启动时打印网卡中断的分布：中断不在工作CPU上、网卡与工作线程不在同一节点时给出调整建议
+void affinity_report_irqs(const int *cpus, int count);
+
+#endif
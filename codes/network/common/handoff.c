@@ -0,0 +1,192 @@
+#include "handoff.h"
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static int handoff_addr(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int handoff_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (handoff_addr(path, &addr) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    // 上一个进程留下的socket文件；仍在运行的旧进程已持有监听fd，删除文件不影响它
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int handoff_connect(const char *path) {
+    struct sockaddr_un addr;
+    if (handoff_addr(path, &addr) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 非阻塞发送返回EAGAIN后等待socket可写；deadline为-1表示阻塞发送，不会走到这里
+static int wait_writable(int sock, int64_t deadline) {
+    if (deadline < 0) return -1;
+    for (;;) {
+        int64_t left = deadline - monotonic_ms();
+        if (left <= 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        struct pollfd pfd = { .fd = sock, .events = POLLOUT };
+        int n = poll(&pfd, 1, (int)left);
+        if (n > 0) return 0;
+        if (n < 0 && errno != EINTR) return -1;
+    }
+}
+
+// 写完len字节
+static int send_full(int sock, const char *buf, size_t len, int flags, int64_t deadline) {
+    while (len > 0) {
+        ssize_t n = send(sock, buf, len, MSG_NOSIGNAL | flags);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(sock, deadline) == 0) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int handoff_send(int sock, handoff_msg_t *msg, const int *fds, int nfds, const void *payload) {
+    return handoff_send_timeout(sock, msg, fds, nfds, payload, -1);
+}
+
+int handoff_send_timeout(int sock, handoff_msg_t *msg, const int *fds, int nfds, const void *payload,
+                         int timeout_ms) {
+    if (nfds < 0 || nfds > HANDOFF_MAX_FDS) {
+        errno = EINVAL;
+        return -1;
+    }
+    msg->magic = HANDOFF_MAGIC;
+    msg->nfds = (uint16_t)nfds;
+
+    // fd附在消息头的第一个字节上，消息头与payload分开发送，payload再大也只需一次SCM_RIGHTS
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { .iov_base = msg, .iov_len = sizeof(*msg) };
+    struct msghdr mh = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+    if (nfds > 0) {
+        memset(&control, 0, sizeof(control));
+        mh.msg_control = control.buf;
+        mh.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+        memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfds);
+    }
+
+    // timeout_ms为负时阻塞发送，否则每次发送都带MSG_DONTWAIT，由poll等待可写
+    int flags = timeout_ms < 0 ? 0 : MSG_DONTWAIT;
+    int64_t deadline = timeout_ms < 0 ? -1 : monotonic_ms() + timeout_ms;
+    ssize_t n;
+    while ((n = sendmsg(sock, &mh, MSG_NOSIGNAL | flags)) < 0) {
+        if (errno == EINTR) continue;
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(sock, deadline) == 0) continue;
+        return -1;
+    }
+
+    if (send_full(sock, (const char*)msg + n, sizeof(*msg) - (size_t)n, flags, deadline) != 0) return -1;
+    if (msg->payload_len > 0 && send_full(sock, payload, msg->payload_len, flags, deadline) != 0) return -1;
+    return 0;
+}
+
+int handoff_recv_payload(int sock, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(sock, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int handoff_recv(int sock, handoff_msg_t *msg, int *fds, int max_fds) {
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { .iov_base = msg, .iov_len = sizeof(*msg) };
+    struct msghdr mh = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = control.buf, .msg_controllen = sizeof(control.buf),
+    };
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+
+    // 先收下附带的fd，后续出错时也要关闭，不能泄漏
+    int received = 0;
+    int got[HANDOFF_MAX_FDS];
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+            int count = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            for (int i = 0; i < count && received < HANDOFF_MAX_FDS; i++) {
+                memcpy(&got[received++], CMSG_DATA(cm) + i * sizeof(int), sizeof(int));
+            }
+        }
+    }
+
+    int ret = 0;
+    if ((mh.msg_flags & MSG_CTRUNC) ||
+        handoff_recv_payload(sock, (char*)msg + n, sizeof(*msg) - (size_t)n) != 0 ||
+        msg->magic != HANDOFF_MAGIC || msg->nfds != received) {
+        ret = -1;
+    }
+
+    for (int i = 0; i < received; i++) {
+        if (ret == 0 && i < max_fds) {
+            fds[i] = got[i];
+        } else {
+            close(got[i]);
+        }
+    }
+    if (ret == 0 && received > max_fds) msg->nfds = (uint16_t)max_fds;
+    return ret;
+}
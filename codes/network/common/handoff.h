@@ -0,0 +1,48 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 热升级：新旧进程通过Unix socket交接fd（SCM_RIGHTS），fd与进程无关，连接在交接中不会断开
+// 新进程连上旧进程的控制socket发送REQUEST，旧进程依次回复LISTENERS、若干CONNECTION、DONE
+#define HANDOFF_MAGIC 0x48414e44   // "HAND"
+#define HANDOFF_MAX_FDS 64         // 单条消息附带的fd上限
+
+typedef enum {
+    HANDOFF_REQUEST = 1,     // 新进程 -> 旧进程，flags见HANDOFF_WANT_*
+    HANDOFF_LISTENERS,       // 监听socket，arg为各类监听socket的个数（由使用方约定）
+    HANDOFF_CONNECTION,      // 一个已建立的连接，payload为它的缓冲状态
+    HANDOFF_DONE,            // 交接结束，arg[0]为交出的连接数
+} handoff_type_t;
+
+#define HANDOFF_WANT_CONNECTIONS 0x1   // 除监听socket外，连已建立的连接一起接管
+
+typedef struct handoff_msg_s {
+    uint32_t magic;
+    uint16_t type;           // handoff_type_t
+    uint16_t nfds;           // 随消息传递的fd个数
+    uint32_t flags;
+    uint32_t arg[4];         // 按消息类型解释
+    uint64_t payload_len;    // 紧跟在消息后的数据长度
+} handoff_msg_t;
+
+// 旧进程：在path上监听（先删除残留的socket文件），返回监听fd
+int handoff_listen(const char *path);
+// 新进程：连接旧进程的控制socket
+int handoff_connect(const char *path);
+
+// 发送消息、fd和payload（payload_len取自msg）；多个线程共用一个socket时由调用者加锁
+// 对端已断开时返回-1，不产生SIGPIPE
+int handoff_send(int sock, handoff_msg_t *msg, const int *fds, int nfds, const void *payload);
+// 同上，但不阻塞在socket上：整条消息最多等待对端timeout_ms毫秒，超时返回-1且errno为ETIMEDOUT
+// 超时时消息可能只发出一部分，这个socket不能再用于交接
+int handoff_send_timeout(int sock, handoff_msg_t *msg, const int *fds, int nfds, const void *payload,
+                         int timeout_ms);
+
+// 接收消息头和附带的fd（超出max_fds的部分关闭），payload由调用者用handoff_recv_payload读取
+// 对端关闭或消息格式错误返回-1
+int handoff_recv(int sock, handoff_msg_t *msg, int *fds, int max_fds);
+int handoff_recv_payload(int sock, void *buf, size_t len);
+
+#endif
@@ -0,0 +1,273 @@
+#define _GNU_SOURCE
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define LOG_MSG_SIZE (LOG_RECORD_SIZE - 16)
+#define LOG_OUT_BUF_SIZE 65536
+
+_Static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of 2");
+
+typedef struct log_record_s {
+    uint64_t ts;        // CLOCK_MONOTONIC毫秒
+    uint32_t len;
+    uint32_t level;
+    char msg[LOG_MSG_SIZE];
+} log_record_t;
+
+// 线程的日志缓冲：所属线程写head，后台线程写tail
+typedef struct log_ring_s {
+    struct log_ring_s *next;
+    uint32_t id;
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+    atomic_ullong dropped;
+    log_record_t records[LOG_RING_SIZE];
+} log_ring_t;
+
+int log_runtime_level = LOG_LEVEL_TRACE;
+
+static _Atomic(log_ring_t*) log_rings = NULL;
+static atomic_uint log_ring_count = 0;
+static atomic_bool log_running = false;
+static pthread_t log_thread;
+static int log_fd = STDOUT_FILENO;
+static int64_t log_clock_offset = 0;   // CLOCK_REALTIME - CLOCK_MONOTONIC，输出时换算成墙上时间
+
+static __thread log_ring_t *tls_ring = NULL;
+static __thread uint64_t tls_clock = 0;
+
+static const char *log_level_names[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+
+static uint64_t clock_ms(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void log_set_clock(uint64_t now_ms) {
+    tls_clock = now_ms;
+}
+
+void log_tick(void) {
+    tls_clock = clock_ms(CLOCK_MONOTONIC_COARSE);
+}
+
+void log_set_level(int level) {
+    log_runtime_level = level;
+}
+
+int log_get_level(void) {
+    return log_runtime_level;
+}
+
+int log_parse_level(const char *name) {
+    for (int level = LOG_LEVEL_TRACE; level <= LOG_LEVEL_ERROR; level++) {
+        if (strcasecmp(name, log_level_names[level]) == 0) return level;
+    }
+    return strcasecmp(name, "off") == 0 ? LOG_LEVEL_OFF : -1;
+}
+
+// 线程第一次写日志时创建缓冲，无锁挂到全局链表
+static log_ring_t* log_ring_get(void) {
+    if (tls_ring) return tls_ring;
+
+    log_ring_t *ring = aligned_alloc(64, sizeof(log_ring_t));
+    if (!ring) return NULL;
+
+    ring->id = atomic_fetch_add(&log_ring_count, 1);
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+
+    log_ring_t *old = atomic_load(&log_rings);
+    do {
+        ring->next = old;
+    } while (!atomic_compare_exchange_weak(&log_rings, &old, ring));
+
+    tls_ring = ring;
+    return ring;
+}
+
+// 格式化一条记录的输出前缀：时:分:秒.毫秒 T线程 级别:
+// 秒级缓存是线程本地的：后台线程和同步输出路径（log_init之前、log_shutdown之后）可能并发调用
+static size_t log_format_prefix(char *out, uint64_t ts, uint32_t thread, uint32_t level) {
+    static __thread time_t cached_sec = -1;
+    static __thread struct tm cached_tm;
+
+    uint64_t wall = ts + (uint64_t)log_clock_offset;
+    time_t sec = (time_t)(wall / 1000);
+    if (sec != cached_sec) {
+        localtime_r(&sec, &cached_tm);
+        cached_sec = sec;
+    }
+
+    int n = snprintf(out, 64, "%02d:%02d:%02d.%03u T%u %s: ",
+                     cached_tm.tm_hour, cached_tm.tm_min, cached_tm.tm_sec,
+                     (unsigned)(wall % 1000), thread,
+                     level <= LOG_LEVEL_ERROR ? log_level_names[level] : "LOG");
+    return n > 0 ? (size_t)n : 0;
+}
+
+static void log_output(const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(log_fd, buf, len);
+        if (n <= 0) return;
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+// 后台线程：批量取出所有线程的记录，合并成一次write
+static bool log_drain(void) {
+    static char out[LOG_OUT_BUF_SIZE];
+    size_t used = 0;
+    bool drained = false;
+
+    for (log_ring_t *ring = atomic_load(&log_rings); ring; ring = ring->next) {
+        unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        while (tail != head) {
+            log_record_t *rec = &ring->records[tail & (LOG_RING_SIZE - 1)];
+
+            if (used + LOG_RECORD_SIZE + 64 > sizeof(out)) {
+                log_output(out, used);
+                used = 0;
+            }
+            used += log_format_prefix(out + used, rec->ts, ring->id, rec->level);
+            memcpy(out + used, rec->msg, rec->len);
+            used += rec->len;
+            out[used++] = '\n';
+
+            tail++;
+            drained = true;
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+
+    if (used > 0) {
+        log_output(out, used);
+    }
+    return drained;
+}
+
+static void* log_thread_main(void *arg) {
+    (void)arg;
+
+    while (atomic_load(&log_running)) {
+        if (!log_drain()) {
+            usleep(LOG_FLUSH_INTERVAL_US);
+        }
+    }
+    log_drain();
+    return NULL;
+}
+
+int log_init(int fd, int level) {
+    if (atomic_load(&log_running)) return 0;
+
+    log_fd = fd;
+    log_runtime_level = level;
+    log_clock_offset = (int64_t)clock_ms(CLOCK_REALTIME) - (int64_t)clock_ms(CLOCK_MONOTONIC);
+
+    atomic_store(&log_running, true);
+    if (pthread_create(&log_thread, NULL, log_thread_main, NULL) != 0) {
+        atomic_store(&log_running, false);
+        perror("pthread_create log thread");
+        return -1;
+    }
+    return 0;
+}
+
+void log_shutdown(void) {
+    if (!atomic_exchange(&log_running, false)) return;
+    pthread_join(log_thread, NULL);
+
+    unsigned long long dropped = log_dropped();
+    if (dropped > 0) {
+        char msg[96];
+        int n = snprintf(msg, sizeof(msg), "log: %llu messages dropped (ring full)\n", dropped);
+        log_output(msg, (size_t)n);
+    }
+}
+
+unsigned long long log_dropped(void) {
+    unsigned long long total = 0;
+    for (log_ring_t *ring = atomic_load(&log_rings); ring; ring = ring->next) {
+        total += atomic_load(&ring->dropped);
+    }
+    return total;
+}
+
+// 写入一条记录；后台线程未启动时同步输出
+static void log_commit(int level, uint64_t ts, const char *fmt, va_list ap) {
+    if (!atomic_load_explicit(&log_running, memory_order_relaxed)) {
+        char line[LOG_RECORD_SIZE + 64];
+        size_t n = log_format_prefix(line, ts, 0, (uint32_t)level);
+        int len = vsnprintf(line + n, LOG_MSG_SIZE, fmt, ap);
+        if (len < 0) return;
+        n += (size_t)len < LOG_MSG_SIZE ? (size_t)len : LOG_MSG_SIZE - 1;
+        line[n++] = '\n';
+        log_output(line, n);
+        return;
+    }
+
+    log_ring_t *ring = log_ring_get();
+    if (!ring) return;
+
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    // 直接格式化到记录槽位，不经过stdio，也不加锁
+    log_record_t *rec = &ring->records[head & (LOG_RING_SIZE - 1)];
+    int len = vsnprintf(rec->msg, LOG_MSG_SIZE, fmt, ap);
+    if (len < 0) return;
+    rec->len = (size_t)len < LOG_MSG_SIZE ? (uint32_t)len : LOG_MSG_SIZE - 1;
+    rec->ts = ts;
+    rec->level = (uint32_t)level;
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static void log_commit_fmt(int level, uint64_t ts, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    log_commit(level, ts, fmt, ap);
+    va_end(ap);
+}
+
+void log_write(int level, log_site_t *site, const char *fmt, ...) {
+    uint64_t ts = tls_clock ? tls_clock : clock_ms(CLOCK_MONOTONIC_COARSE);
+
+    // 按调用点限速：每秒一个窗口，新窗口开始时补一条被抑制的条数
+    uint64_t window = ts / 1000;
+    if (site->window != window) {
+        if (site->suppressed > 0) {
+            log_commit_fmt(level, ts, "(suppressed %u similar messages)", site->suppressed);
+        }
+        site->window = window;
+        site->count = 0;
+        site->suppressed = 0;
+    }
+    if (site->count >= LOG_RATE_BURST) {
+        site->suppressed++;
+        return;
+    }
+    site->count++;
+
+    va_list ap;
+    va_start(ap, fmt);
+    log_commit(level, ts, fmt, ap);
+    va_end(ap);
+}
@@ -0,0 +1,72 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+// 日志级别
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_WARN  3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF   5
+
+// 编译期级别：低于该级别的日志调用连同参数求值一起被编译器消除
+// 编译时用 -DLOG_COMPILE_LEVEL=LOG_LEVEL_OFF 去掉全部日志
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// 每个线程一个单生产者单消费者环形缓冲，定长记录，满了直接丢弃并计数
+#define LOG_RING_SIZE 4096        // 记录数，必须是2的幂
+#define LOG_RECORD_SIZE 256       // 单条记录大小（含头部），超长消息截断
+#define LOG_FLUSH_INTERVAL_US 1000
+
+// 同一调用点每个线程每秒最多输出LOG_RATE_BURST条，超出的合并为一条"suppressed"提示
+#define LOG_RATE_BURST 100
+
+// 调用点限速状态（线程本地）
+typedef struct log_site_s {
+    uint64_t window;      // 当前统计窗口（秒）
+    uint32_t count;       // 窗口内已输出条数
+    uint32_t suppressed;  // 窗口内被抑制的条数
+} log_site_t;
+
+// 启动后台写线程；fd为输出目标，level为运行期级别（不低于编译期级别才有意义）
+int log_init(int fd, int level);
+// 写出所有缓冲中的日志并停止后台线程
+void log_shutdown(void);
+
+void log_set_level(int level);
+int log_get_level(void);
+// 按名字（trace/debug/info/warn/error/off，不区分大小写）取级别，无法识别返回-1
+int log_parse_level(const char *name);
+
+// 缓存的时钟：事件循环每轮调用一次，日志时间戳直接取缓存值，不再每条日志调用clock_gettime
+void log_set_clock(uint64_t now_ms);   // 传入循环已有的CLOCK_MONOTONIC毫秒数
+void log_tick(void);                   // 没有现成时钟的循环使用，读取粗粒度时钟
+
+// 丢弃的日志条数（缓冲满）
+unsigned long long log_dropped(void);
+
+void log_write(int level, log_site_t *site, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+// 运行期级别检查放在宏里，关闭的级别不会格式化参数
+extern int log_runtime_level;
+
+#define LOG_AT(level, fmt, ...) do { \
+    if ((level) >= LOG_COMPILE_LEVEL && (level) >= log_runtime_level) { \
+        static __thread log_site_t log_site_; \
+        log_write((level), &log_site_, fmt, ##__VA_ARGS__); \
+    } \
+} while (0)
+
+#define LOG_TRACE(fmt, ...) LOG_AT(LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...)  LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...)  LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+#endif
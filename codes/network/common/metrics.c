@@ -0,0 +1,260 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static size_t metrics_size(uint32_t shard_count) {
+    return sizeof(metrics_t) + (size_t)shard_count * METRICS_SHARD_VALUES * sizeof(uint64_t);
+}
+
+// 创建注册表
+metrics_t* metrics_create(const char *shm_name, uint32_t shard_count) {
+    if (shard_count == 0 || shard_count > METRICS_MAX_SHARDS) {
+        return NULL;
+    }
+
+    size_t size = metrics_size(shard_count);
+    void *addr = MAP_FAILED;
+
+    if (shm_name) {
+        int fd = shm_open(shm_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd >= 0) {
+            if (ftruncate(fd, (off_t)size) == 0) {
+                addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            close(fd);
+            if (addr == MAP_FAILED) {
+                shm_unlink(shm_name);
+            }
+        }
+        if (addr == MAP_FAILED) {
+            perror("metrics shm_open");
+        }
+    }
+
+    // 没有共享内存时仍然可以通过文本接口读取
+    if (addr == MAP_FAILED) {
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            perror("metrics mmap");
+            return NULL;
+        }
+    }
+
+    // 新映射的内存已清零
+    metrics_t *m = (metrics_t*)addr;
+    m->version = METRICS_VERSION;
+    m->shard_count = shard_count;
+    m->hist_sub_bits = METRICS_HIST_SUB_BITS;
+    m->size = size;
+    for (uint32_t i = 0; i < shard_count; i++) {
+        snprintf(m->shard_names[i], METRICS_SHARD_NAME_MAX, "%u", i);
+    }
+
+    // 最后写magic，读者据此判断头部已初始化
+    atomic_thread_fence(memory_order_release);
+    m->magic = METRICS_MAGIC;
+    return m;
+}
+
+void metrics_destroy(metrics_t *m, const char *shm_name) {
+    if (!m) return;
+    munmap(m, m->size);
+    if (shm_name) {
+        shm_unlink(shm_name);
+    }
+}
+
+// 只读打开
+metrics_t* metrics_open(const char *shm_name) {
+    int fd = shm_open(shm_name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(metrics_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    metrics_t *m = (metrics_t*)addr;
+    if (m->magic != METRICS_MAGIC || m->version != METRICS_VERSION ||
+        m->size != (uint64_t)st.st_size || m->hist_sub_bits != METRICS_HIST_SUB_BITS) {
+        munmap(addr, (size_t)st.st_size);
+        return NULL;
+    }
+    return m;
+}
+
+void metrics_close(metrics_t *m) {
+    if (m) munmap(m, m->size);
+}
+
+void metrics_set_shard_name(metrics_t *m, uint32_t shard, const char *name) {
+    if (!m || shard >= m->shard_count) return;
+    snprintf(m->shard_names[shard], METRICS_SHARD_NAME_MAX, "%s", name);
+}
+
+// 注册指标
+metric_id_t metrics_register(metrics_t *m, const char *name, const char *help, metric_type_t type) {
+    uint32_t need = type == METRIC_HISTOGRAM ? METRICS_HIST_VALUES : 1;
+
+    if (!m || m->metric_count >= METRICS_MAX || m->values_used + need > METRICS_SHARD_VALUES) {
+        return METRIC_INVALID;
+    }
+
+    metric_id_t id = m->metric_count;
+    metric_desc_t *d = &m->desc[id];
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    snprintf(d->help, sizeof(d->help), "%s", help ? help : "");
+    d->type = type;
+    d->offset = m->values_used;
+
+    m->values_used += need;
+    // 描述写完再公开，读者按metric_count遍历
+    atomic_thread_fence(memory_order_release);
+    m->metric_count = id + 1;
+    return id;
+}
+
+static inline uint64_t load_value(const metrics_t *m, uint32_t shard, uint32_t slot) {
+    return atomic_load_explicit(&((metrics_t*)m)->values[(size_t)shard * METRICS_SHARD_VALUES + slot],
+                                memory_order_relaxed);
+}
+
+metric_id_t metrics_find(const metrics_t *m, const char *name) {
+    uint32_t count = m->metric_count;
+    atomic_thread_fence(memory_order_acquire);
+
+    for (metric_id_t id = 0; id < count; id++) {
+        if (strcmp(m->desc[id].name, name) == 0) return id;
+    }
+    return METRIC_INVALID;
+}
+
+uint64_t metrics_sum(const metrics_t *m, metric_id_t id) {
+    uint64_t sum = 0;
+    for (uint32_t s = 0; s < m->shard_count; s++) {
+        sum += load_value(m, s, m->desc[id].offset);
+    }
+    return sum;
+}
+
+// 桶内最大值（与HDR直方图一样按桶上界报告）
+static uint64_t hist_bucket_upper(uint32_t idx) {
+    if (idx < METRICS_HIST_SUB) {
+        return idx;
+    }
+    uint32_t shift = idx / METRICS_HIST_SUB - 1;
+    uint64_t lower = (uint64_t)(METRICS_HIST_SUB + idx % METRICS_HIST_SUB) << shift;
+    return lower + (((uint64_t)1 << shift) - 1);
+}
+
+// 直方图分位数
+uint64_t metrics_hist_quantile(const metrics_t *m, uint32_t shard, metric_id_t id, double q) {
+    const metric_desc_t *d = &m->desc[id];
+    uint32_t first = shard == METRICS_ALL_SHARDS ? 0 : shard;
+    uint32_t last = shard == METRICS_ALL_SHARDS ? m->shard_count : shard + 1;
+    uint64_t total = 0;
+
+    // 各桶计数与count不是原子快照，分位数按桶求和计算
+    for (uint32_t s = first; s < last; s++) {
+        for (uint32_t b = 0; b < METRICS_HIST_BUCKETS; b++) {
+            total += load_value(m, s, d->offset + b);
+        }
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(q * (double)total);
+    if (rank >= total) rank = total - 1;
+
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < METRICS_HIST_BUCKETS; b++) {
+        for (uint32_t s = first; s < last; s++) {
+            seen += load_value(m, s, d->offset + b);
+        }
+        if (seen > rank) {
+            return hist_bucket_upper(b);
+        }
+    }
+    return hist_bucket_upper(METRICS_HIST_BUCKETS - 1);
+}
+
+// 追加格式化文本，空间不足时截断
+static size_t append(char *buf, size_t size, size_t used, const char *fmt, ...) {
+    if (used >= size) return used;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + used, size - used, fmt, ap);
+    va_end(ap);
+
+    if (n < 0) return used;
+    return used + (size_t)n < size ? used + (size_t)n : size;
+}
+
+static void render_hist(const metrics_t *m, metric_id_t id, uint32_t shard, const char *label,
+                        char *buf, size_t size, size_t *used) {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    const metric_desc_t *d = &m->desc[id];
+    uint64_t count = 0, sum = 0;
+    uint32_t first = shard == METRICS_ALL_SHARDS ? 0 : shard;
+    uint32_t last = shard == METRICS_ALL_SHARDS ? m->shard_count : shard + 1;
+
+    for (uint32_t s = first; s < last; s++) {
+        count += load_value(m, s, d->offset + METRICS_HIST_BUCKETS);
+        sum += load_value(m, s, d->offset + METRICS_HIST_BUCKETS + 1);
+    }
+
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        *used = append(buf, size, *used, "%s{thread=\"%s\",quantile=\"%g\"} %llu\n", d->name, label, quantiles[i],
+                       (unsigned long long)metrics_hist_quantile(m, shard, id, quantiles[i]));
+    }
+    *used = append(buf, size, *used, "%s_sum{thread=\"%s\"} %llu\n", d->name, label, (unsigned long long)sum);
+    *used = append(buf, size, *used, "%s_count{thread=\"%s\"} %llu\n", d->name, label, (unsigned long long)count);
+}
+
+// 渲染为纯文本
+size_t metrics_render(const metrics_t *m, char *buf, size_t size) {
+    size_t used = 0;
+    uint32_t count = m->metric_count;
+
+    atomic_thread_fence(memory_order_acquire);
+
+    for (metric_id_t id = 0; id < count; id++) {
+        const metric_desc_t *d = &m->desc[id];
+        const char *type = d->type == METRIC_COUNTER ? "counter" :
+                           d->type == METRIC_GAUGE ? "gauge" : "summary";
+
+        used = append(buf, size, used, "# HELP %s %s\n# TYPE %s %s\n", d->name, d->help, d->name, type);
+
+        if (d->type == METRIC_HISTOGRAM) {
+            for (uint32_t s = 0; s < m->shard_count; s++) {
+                render_hist(m, id, s, m->shard_names[s], buf, size, &used);
+            }
+            if (m->shard_count > 1) {
+                render_hist(m, id, METRICS_ALL_SHARDS, "all", buf, size, &used);
+            }
+        } else {
+            for (uint32_t s = 0; s < m->shard_count; s++) {
+                used = append(buf, size, used, "%s{thread=\"%s\"} %llu\n", d->name, m->shard_names[s],
+                              (unsigned long long)load_value(m, s, d->offset));
+            }
+        }
+    }
+
+    return used;
+}
@@ -0,0 +1,115 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// 指标注册表：描述信息和每个分片（线程）的数值放在同一块共享内存中，
+// 外部进程只读映射即可查看。每个分片只有一个写者，更新是普通的load/store，没有lock前缀
+#define METRICS_MAGIC 0x4d455452u        // "METR"
+#define METRICS_VERSION 1
+#define METRICS_MAX 64                   // 指标数上限
+#define METRICS_MAX_SHARDS 32            // 分片数上限
+#define METRICS_SHARD_VALUES 8192        // 每个分片的数值槽位（uint64）
+#define METRICS_NAME_MAX 48
+#define METRICS_HELP_MAX 80
+#define METRICS_SHARD_NAME_MAX 16
+
+// 对数线性直方图：每个2的幂区间再等分为2^METRICS_HIST_SUB_BITS个桶，相对误差不超过1/16
+#define METRICS_HIST_SUB_BITS 4
+#define METRICS_HIST_SUB (1 << METRICS_HIST_SUB_BITS)
+#define METRICS_HIST_BUCKETS ((64 - METRICS_HIST_SUB_BITS + 1) * METRICS_HIST_SUB)
+#define METRICS_HIST_VALUES (METRICS_HIST_BUCKETS + 2)   // 桶 + count + sum
+
+typedef enum {
+    METRIC_COUNTER = 1,
+    METRIC_GAUGE = 2,
+    METRIC_HISTOGRAM = 3,
+} metric_type_t;
+
+typedef uint32_t metric_id_t;
+
+typedef struct metric_desc_s {
+    char name[METRICS_NAME_MAX];
+    char help[METRICS_HELP_MAX];
+    uint32_t type;
+    uint32_t offset;    // 在分片数值区中的起始槽位
+} metric_desc_t;
+
+// 共享内存布局（头部 + 分片数值区）
+typedef struct metrics_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t metric_count;
+    uint32_t shard_count;
+    uint32_t values_used;       // 已分配的槽位数
+    uint32_t hist_sub_bits;
+    uint64_t size;              // 整个映射的大小
+
+    metric_desc_t desc[METRICS_MAX];
+    char shard_names[METRICS_MAX_SHARDS][METRICS_SHARD_NAME_MAX];
+
+    _Alignas(64) _Atomic uint64_t values[];   // shard_count * METRICS_SHARD_VALUES
+} metrics_t;
+
+// 创建注册表；shm_name非NULL时创建POSIX共享内存（/dev/shm下），失败退回匿名内存
+metrics_t* metrics_create(const char *shm_name, uint32_t shard_count);
+void metrics_destroy(metrics_t *m, const char *shm_name);
+// 只读打开另一个进程的注册表
+metrics_t* metrics_open(const char *shm_name);
+void metrics_close(metrics_t *m);
+
+void metrics_set_shard_name(metrics_t *m, uint32_t shard, const char *name);
+// 注册指标，只能在分片开始更新之前调用；失败返回METRIC_INVALID
+#define METRIC_INVALID ((metric_id_t)-1)
+metric_id_t metrics_register(metrics_t *m, const char *name, const char *help, metric_type_t type);
+
+// 按名字查找指标，找不到返回METRIC_INVALID
+metric_id_t metrics_find(const metrics_t *m, const char *name);
+// 计数器/仪表在所有分片上的合计
+uint64_t metrics_sum(const metrics_t *m, metric_id_t id);
+
+// 渲染为纯文本（Prometheus exposition格式），返回写入的字节数（截断时为size）
+size_t metrics_render(const metrics_t *m, char *buf, size_t size);
+
+// 直方图分位数（所有分片合并时shard传METRICS_ALL_SHARDS）
+#define METRICS_ALL_SHARDS UINT32_MAX
+uint64_t metrics_hist_quantile(const metrics_t *m, uint32_t shard, metric_id_t id, double q);
+
+static inline _Atomic uint64_t* metrics_slot(metrics_t *m, uint32_t shard, metric_id_t id) {
+    return &m->values[(size_t)shard * METRICS_SHARD_VALUES + m->desc[id].offset];
+}
+
+// 单写者更新：只能由分片所属线程调用
+static inline void metrics_add(metrics_t *m, uint32_t shard, metric_id_t id, uint64_t n) {
+    _Atomic uint64_t *v = metrics_slot(m, shard, id);
+    atomic_store_explicit(v, atomic_load_explicit(v, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline void metrics_set(metrics_t *m, uint32_t shard, metric_id_t id, uint64_t value) {
+    atomic_store_explicit(metrics_slot(m, shard, id), value, memory_order_relaxed);
+}
+
+static inline uint32_t metrics_hist_bucket(uint64_t value) {
+    if (value < METRICS_HIST_SUB) {
+        return (uint32_t)value;
+    }
+    uint32_t msb = 63 - (uint32_t)__builtin_clzll(value);
+    uint32_t shift = msb - METRICS_HIST_SUB_BITS;
+    return (shift + 1) * METRICS_HIST_SUB + (uint32_t)((value >> shift) & (METRICS_HIST_SUB - 1));
+}
+
+static inline void metrics_record(metrics_t *m, uint32_t shard, metric_id_t id, uint64_t value) {
+    _Atomic uint64_t *base = metrics_slot(m, shard, id);
+    _Atomic uint64_t *bucket = base + metrics_hist_bucket(value);
+    _Atomic uint64_t *count = base + METRICS_HIST_BUCKETS;
+    _Atomic uint64_t *sum = count + 1;
+
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(sum, atomic_load_explicit(sum, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+#endif
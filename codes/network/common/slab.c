@@ -0,0 +1,149 @@
+#include "slab.h"
+#include "affinity.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 单写者计数：普通的load/store，不产生lock前缀指令
+#define SLAB_STAT_ADD(counter, n) \
+    atomic_store_explicit(&(counter), atomic_load_explicit(&(counter), memory_order_relaxed) + (n), \
+                          memory_order_relaxed)
+
+static inline slab_obj_t *obj_header(void *ptr) {
+    return (slab_obj_t*)((char*)ptr - SLAB_HDR_SIZE);
+}
+
+static inline void *obj_payload(slab_obj_t *obj) {
+    return (char*)obj + SLAB_HDR_SIZE;
+}
+
+// 初始化slab
+int slab_cache_init(slab_cache_t *cache, const char *name, size_t obj_size, uint32_t objs_per_chunk) {
+    if (!cache || obj_size == 0 || objs_per_chunk == 0) return -1;
+
+    memset(cache, 0, sizeof(*cache));
+    cache->name = name;
+    cache->obj_size = obj_size;
+    cache->stride = SLAB_HDR_SIZE + ((obj_size + SLAB_CACHE_LINE - 1) & ~(size_t)(SLAB_CACHE_LINE - 1));
+    cache->objs_per_chunk = objs_per_chunk;
+    cache->numa_node = -1;
+    atomic_init(&cache->remote_free, NULL);
+    return 0;
+}
+
+void slab_cache_set_node(slab_cache_t *cache, int node) {
+    cache->numa_node = node;
+}
+
+// 释放slab
+void slab_cache_destroy(slab_cache_t *cache) {
+    if (!cache) return;
+
+    slab_chunk_t *chunk = cache->chunks;
+    while (chunk) {
+        slab_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    cache->chunks = NULL;
+    cache->free_list = NULL;
+    atomic_store(&cache->remote_free, NULL);
+}
+
+// 申请一个新chunk并切分到空闲链表
+static int slab_grow(slab_cache_t *cache) {
+    // chunk头部占一个缓存行，后面紧跟对象
+    size_t size = SLAB_CACHE_LINE + cache->stride * cache->objs_per_chunk;
+    slab_chunk_t *chunk;
+    if (cache->numa_node >= 0) {
+        // 按页对齐申请后绑定，已清零的页迁到目标节点，之后只在该节点上访问
+        chunk = affinity_alloc(size);
+        if (chunk) affinity_bind_memory(chunk, size, cache->numa_node);
+    } else {
+        chunk = aligned_alloc(SLAB_CACHE_LINE, size);
+    }
+    if (!chunk) return -1;
+
+    chunk->next = cache->chunks;
+    cache->chunks = chunk;
+
+    char *base = (char*)chunk + SLAB_CACHE_LINE;
+    for (uint32_t i = cache->objs_per_chunk; i > 0; i--) {
+        slab_obj_t *obj = (slab_obj_t*)(base + (size_t)(i - 1) * cache->stride);
+        obj->owner = cache;
+        obj->next = cache->free_list;
+        cache->free_list = obj;
+    }
+
+    SLAB_STAT_ADD(cache->chunk_count, 1);
+    return 0;
+}
+
+// 分配对象
+void *slab_alloc(slab_cache_t *cache) {
+    if (!cache->owner_bound) {
+        cache->owner_thread = pthread_self();
+        cache->owner_bound = true;
+    }
+
+    slab_obj_t *obj = cache->free_list;
+    if (!obj) {
+        // 一次性摘回其他线程释放的对象，只用exchange，不存在ABA问题
+        cache->free_list = atomic_exchange_explicit(&cache->remote_free, NULL, memory_order_acquire);
+        obj = cache->free_list;
+    }
+
+    if (obj) {
+        SLAB_STAT_ADD(cache->hits, 1);
+    } else {
+        if (slab_grow(cache) != 0) return NULL;
+        obj = cache->free_list;
+        SLAB_STAT_ADD(cache->misses, 1);
+    }
+
+    cache->free_list = obj->next;
+    obj->next = NULL;
+
+    SLAB_STAT_ADD(cache->allocs, 1);
+    unsigned long long in_use = atomic_load_explicit(&cache->allocs, memory_order_relaxed)
+        - atomic_load_explicit(&cache->local_frees, memory_order_relaxed)
+        - atomic_load_explicit(&cache->remote_frees, memory_order_relaxed);
+    if (in_use > atomic_load_explicit(&cache->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&cache->high_water, in_use, memory_order_relaxed);
+    }
+
+    return obj_payload(obj);
+}
+
+// 释放对象
+void slab_free(void *ptr) {
+    if (!ptr) return;
+
+    slab_obj_t *obj = obj_header(ptr);
+    slab_cache_t *cache = obj->owner;
+
+    if (cache->owner_bound && pthread_equal(cache->owner_thread, pthread_self())) {
+        obj->next = cache->free_list;
+        cache->free_list = obj;
+        SLAB_STAT_ADD(cache->local_frees, 1);
+        return;
+    }
+
+    // 远程释放：压入无锁栈
+    slab_obj_t *head = atomic_load_explicit(&cache->remote_free, memory_order_relaxed);
+    do {
+        obj->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&cache->remote_free, &head, obj,
+                                                    memory_order_release, memory_order_relaxed));
+    atomic_fetch_add_explicit(&cache->remote_frees, 1, memory_order_relaxed);
+}
+
+// 统计信息
+void slab_cache_stats(slab_cache_t *cache, slab_stats_t *stats) {
+    stats->hits = atomic_load(&cache->hits);
+    stats->misses = atomic_load(&cache->misses);
+    stats->high_water = atomic_load(&cache->high_water);
+    stats->remote_frees = atomic_load(&cache->remote_frees);
+    stats->chunks = atomic_load(&cache->chunk_count);
+    stats->in_use = atomic_load(&cache->allocs) - atomic_load(&cache->local_frees) - stats->remote_frees;
+}
@@ -0,0 +1,77 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// 每个对象前有一个缓存行大小的头部，对象本身按缓存行对齐
+#define SLAB_CACHE_LINE 64
+#define SLAB_HDR_SIZE SLAB_CACHE_LINE
+
+typedef struct slab_cache_s slab_cache_t;
+
+typedef struct slab_obj_s {
+    slab_cache_t *owner;        // 所属slab，释放时据此判断本地/远程
+    struct slab_obj_s *next;    // 空闲链表
+} slab_obj_t;
+
+typedef struct slab_chunk_s {
+    struct slab_chunk_s *next;
+} slab_chunk_t;
+
+// 每线程一个slab：分配和本地释放只由所属线程操作，无锁无原子指令
+// 其他线程释放的对象压入remote_free无锁栈，所属线程在本地空闲链表用尽时整体摘回
+struct slab_cache_s {
+    const char *name;
+    size_t obj_size;
+    size_t stride;              // 头部 + 按缓存行向上取整的对象大小
+    uint32_t objs_per_chunk;
+
+    pthread_t owner_thread;     // 第一次分配时绑定
+    bool owner_bound;
+    int numa_node;              // chunk所在的NUMA节点，-1表示按分配线程首次访问
+
+    slab_obj_t *free_list;
+    slab_chunk_t *chunks;
+
+    // 统计（所属线程写，其他线程可读）
+    atomic_ullong hits;         // 从空闲链表分配
+    atomic_ullong misses;       // 需要新申请chunk
+    atomic_ullong allocs;
+    atomic_ullong local_frees;
+    atomic_ullong high_water;   // 同时在用对象数的峰值
+    atomic_ullong chunk_count;
+
+    // 远程释放（多生产者、单消费者），独占缓存行
+    _Alignas(SLAB_CACHE_LINE) _Atomic(slab_obj_t*) remote_free;
+    atomic_ullong remote_frees;
+};
+
+typedef struct slab_stats_s {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long in_use;
+    unsigned long long high_water;
+    unsigned long long remote_frees;
+    unsigned long long chunks;
+} slab_stats_t;
+
+// API
+int slab_cache_init(slab_cache_t *cache, const char *name, size_t obj_size, uint32_t objs_per_chunk);
+// 释放所有chunk，调用前所有线程都不能再访问其中的对象
+void slab_cache_destroy(slab_cache_t *cache);
+
+// 之后申请的chunk按页对齐并绑定到node（对象由其他节点上的线程分配、本节点线程使用时）
+void slab_cache_set_node(slab_cache_t *cache, int node);
+
+// 只能由所属线程调用；返回的内存未清零
+void *slab_alloc(slab_cache_t *cache);
+// 任意线程都可调用
+void slab_free(void *ptr);
+
+void slab_cache_stats(slab_cache_t *cache, slab_stats_t *stats);
+
+#endif
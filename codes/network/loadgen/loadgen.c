@@ -0,0 +1,643 @@
+// loadgen.c - 多线程压测客户端，可用于reactor_server、proactor_server和混合proactor
+// 请求为定长、以换行结尾的消息；三个服务端都逐字节回显（proactor系在每次读到的数据前加"Echo: "），
+// 所以按收到的换行数匹配响应，不依赖回显长度。欢迎语等开场白用-W跳过
+//
+// 模式：
+//   echo      闭环，每个连接一个在途请求，收到响应后立即发下一个
+//   pipeline  闭环，每个连接-D个在途请求
+//   rate      开环，所有连接合计按-r的固定速率发送，不等响应；延迟从计划发送时间算起，
+//             服务端卡顿期间本该发出的请求也计入，不存在协调遗漏（coordinated omission）
+//   idle      开环，每个连接每-H秒发一次心跳（即rate模式，速率为连接数/H），模拟大量空闲长连接
+// -P指定服务进程pid时，报告建连前后服务端RSS的增量折算到每个连接（rss_per_conn，字节）
+// 闭环模式的延迟从实际发送时间算起，服务端卡顿时客户端也停止发送，慢请求被少计；
+// 输出同时给出按HdrHistogram方法修正后的分位数（期望间隔默认取中位延迟，-i指定）
+//
+// 连接数超过单个源地址的临时端口范围时，对127.x目标自动轮流绑定127.0.0.2开始的多个源地址
+// （-S指定个数，只适用于回环目标）
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define MAX_THREADS 64
+#define MAX_EVENTS 1024
+#define MAX_MESSAGE 65536
+#define TEMPLATE_REQUESTS 64          // 发送模板中的请求数，一次write最多写出这么多个
+#define RECV_BUF_SIZE (256 * 1024)
+#define PORTS_PER_SOURCE 20000        // 单个源地址计划使用的端口数，低于默认临时端口范围(28232)
+
+// 对数线性直方图：纳秒，每个2的幂区间分64档，相对误差<1.6%
+#define HIST_SUB_BITS 6
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+typedef enum {
+    MODE_ECHO,
+    MODE_PIPELINE,
+    MODE_RATE,
+    MODE_IDLE,
+} load_mode_t;
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} hist_t;
+
+// 在途请求的发送时间（开环为计划时间），FIFO，满时倍增
+typedef struct {
+    uint64_t *ts;
+    uint32_t head;
+    uint32_t count;
+    uint32_t cap;
+} ts_fifo_t;
+
+typedef struct {
+    int fd;
+    bool up;               // connect已完成
+    bool want_out;         // 已注册EPOLLOUT
+    uint32_t banner_left;  // 还要跳过的开场白行数
+    size_t wr_left;        // 已发出但未写入socket的字节
+    size_t wr_pos;         // 下一个字节在单个请求中的偏移
+    ts_fifo_t inflight;
+} lg_conn_t;
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    int epfd;
+    lg_conn_t *conns;
+    int nconns;
+    int first;             // 本线程第一个连接的全局序号，用于选择源地址
+    int connected;
+    double rate;           // 开环模式下本线程的速率（请求/秒）
+    uint64_t issued;       // 开环模式下已按计划发出的请求数
+    uint32_t next_conn;
+
+    // 测量窗口内的统计
+    uint64_t sent;
+    uint64_t received;
+    uint64_t errors;
+    uint64_t bytes_in;
+    hist_t hist;
+} lg_worker_t;
+
+static const char *g_host = "127.0.0.1";
+static int g_port = 8080;
+static load_mode_t g_mode = MODE_ECHO;
+static int g_depth = 1;
+static size_t g_size = 64;
+static uint32_t g_banner = 0;
+static int g_sources = 0;
+static char *g_template;
+static size_t g_template_len;
+static struct sockaddr_in g_addr;
+
+static atomic_int g_ready;
+static atomic_bool g_running;
+static atomic_bool g_measuring;
+static _Atomic uint64_t g_measure_start;   // 测量窗口起点，之前发出的请求不计入延迟
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* ---------------- 直方图 ---------------- */
+
+static uint32_t hist_index(uint64_t v) {
+    if (v < HIST_SUB * 2) return (uint32_t)v;
+    int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return (uint32_t)((shift + 1) * HIST_SUB + ((v >> shift) - HIST_SUB));
+}
+
+// 桶的中点
+static uint64_t hist_value(uint32_t idx) {
+    if (idx < HIST_SUB * 2) return idx;
+    int shift = (int)(idx / HIST_SUB) - 1;
+    uint64_t low = (uint64_t)(idx % HIST_SUB + HIST_SUB) << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+static void hist_record_n(hist_t *h, uint64_t v, uint64_t n) {
+    uint32_t idx = hist_index(v);
+    if (idx >= HIST_BUCKETS) idx = HIST_BUCKETS - 1;
+    h->counts[idx] += n;
+    h->total += n;
+    if (v > h->max) h->max = v;
+}
+
+static void hist_merge(hist_t *dst, const hist_t *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+static uint64_t hist_quantile(const hist_t *h, double q) {
+    if (h->total == 0) return 0;
+    uint64_t target = (uint64_t)(q * (double)h->total);
+    if (target >= h->total) target = h->total - 1;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > target) return hist_value(i) < h->max ? hist_value(i) : h->max;
+    }
+    return h->max;
+}
+
+// HdrHistogram的copyCorrectedForCoordinatedOmission：超过期望间隔的样本，
+// 补上卡顿期间本该发出的请求，延迟依次递减一个间隔
+static void hist_correct(hist_t *dst, const hist_t *src, uint64_t interval) {
+    memset(dst, 0, sizeof(*dst));
+    for (uint32_t i = 0; i < HIST_BUCKETS; i++) {
+        uint64_t n = src->counts[i];
+        if (n == 0) continue;
+        uint64_t v = hist_value(i);
+        hist_record_n(dst, v, n);
+        if (interval == 0) continue;
+        for (uint64_t missing = v > interval ? v - interval : 0; missing >= interval; missing -= interval) {
+            hist_record_n(dst, missing, n);
+        }
+    }
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+/* ---------------- 在途请求队列 ---------------- */
+
+static int fifo_push(ts_fifo_t *f, uint64_t ts) {
+    if (f->count == f->cap) {
+        uint32_t cap = f->cap ? f->cap * 2 : 4;
+        uint64_t *nts = malloc((size_t)cap * sizeof(uint64_t));
+        if (!nts) return -1;
+        for (uint32_t i = 0; i < f->count; i++) {
+            nts[i] = f->ts[(f->head + i) % f->cap];
+        }
+        free(f->ts);
+        f->ts = nts;
+        f->head = 0;
+        f->cap = cap;
+    }
+    f->ts[(f->head + f->count) % f->cap] = ts;
+    f->count++;
+    return 0;
+}
+
+static uint64_t fifo_pop(ts_fifo_t *f) {
+    uint64_t ts = f->ts[f->head];
+    f->head = (f->head + 1) % f->cap;
+    f->count--;
+    return ts;
+}
+
+/* ---------------- 连接 ---------------- */
+
+static void conn_set_out(lg_worker_t *w, lg_conn_t *c, bool out) {
+    if (c->want_out == out) return;
+    struct epoll_event ev = { .events = EPOLLIN | (out ? EPOLLOUT : 0), .data.ptr = c };
+    epoll_ctl(w->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_out = out;
+}
+
+static void conn_close(lg_worker_t *w, lg_conn_t *c) {
+    if (c->fd < 0) return;
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    w->connected--;
+    if (atomic_load_explicit(&g_measuring, memory_order_relaxed)) w->errors++;
+}
+
+// 尽量写出待发送字节，写不完时注册EPOLLOUT
+static void conn_flush(lg_worker_t *w, lg_conn_t *c) {
+    while (c->wr_left > 0) {
+        size_t len = g_template_len - c->wr_pos;
+        if (len > c->wr_left) len = c->wr_left;
+        ssize_t n = write(c->fd, g_template + c->wr_pos, len);
+        if (n > 0) {
+            c->wr_left -= (size_t)n;
+            c->wr_pos = (c->wr_pos + (size_t)n) % g_size;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            conn_set_out(w, c, true);
+            return;
+        } else {
+            conn_close(w, c);
+            return;
+        }
+    }
+    conn_set_out(w, c, false);
+}
+
+static void conn_issue(lg_worker_t *w, lg_conn_t *c, uint64_t ts) {
+    if (fifo_push(&c->inflight, ts) != 0) {
+        w->errors++;
+        return;
+    }
+    c->wr_left += g_size;
+    if (ts >= atomic_load_explicit(&g_measure_start, memory_order_relaxed) &&
+        atomic_load_explicit(&g_measuring, memory_order_relaxed)) {
+        w->sent++;
+    }
+}
+
+// 读出响应，每个换行对应最早的一个在途请求；闭环模式下补发相同数量的请求
+static void conn_read(lg_worker_t *w, lg_conn_t *c, char *buf) {
+    for (;;) {
+        ssize_t n = read(c->fd, buf, RECV_BUF_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            conn_close(w, c);
+            return;
+        }
+
+        uint64_t now = now_ns();
+        bool measuring = atomic_load_explicit(&g_measuring, memory_order_relaxed);
+        uint64_t measure_start = atomic_load_explicit(&g_measure_start, memory_order_relaxed);
+        uint32_t done = 0;
+        if (measuring) w->bytes_in += (uint64_t)n;
+        for (char *p = buf, *end = buf + n; (p = memchr(p, '\n', (size_t)(end - p))) != NULL; p++) {
+            if (c->banner_left > 0) {
+                c->banner_left--;
+                continue;
+            }
+            if (c->inflight.count == 0) {
+                // 多出来的行：服务端不是逐字节回显
+                if (measuring) w->errors++;
+                continue;
+            }
+            uint64_t ts = fifo_pop(&c->inflight);
+            done++;
+            if (measuring && ts >= measure_start) {
+                hist_record_n(&w->hist, now > ts ? now - ts : 0, 1);
+                w->received++;
+            }
+        }
+
+        if ((g_mode == MODE_ECHO || g_mode == MODE_PIPELINE) &&
+            atomic_load_explicit(&g_running, memory_order_relaxed)) {
+            for (uint32_t i = 0; i < done; i++) conn_issue(w, c, now);
+        }
+    }
+    if (c->wr_left > 0 && !c->want_out) conn_flush(w, c);
+}
+
+// 非阻塞建连，按源地址轮流绑定；返回-1表示socket创建失败
+static int conn_open(lg_worker_t *w, lg_conn_t *c, int index) {
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (c->fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (g_sources > 0) {
+        // 端口推迟到connect时按四元组分配，不同源地址可以复用同一端口
+        setsockopt(c->fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+        struct sockaddr_in src = { .sin_family = AF_INET };
+        src.sin_addr.s_addr = htonl(0x7f000002u + (uint32_t)(index % g_sources));
+        if (bind(c->fd, (struct sockaddr*)&src, sizeof(src)) != 0) {
+            close(c->fd);
+            c->fd = -1;
+            return 0;
+        }
+    }
+    if (connect(c->fd, (struct sockaddr*)&g_addr, sizeof(g_addr)) != 0 && errno != EINPROGRESS) {
+        close(c->fd);
+        c->fd = -1;
+        return 0;
+    }
+
+    struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = c };
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    return 0;
+}
+
+// 建立本线程的全部连接，等待connect完成；失败或超时的连接丢弃
+static void worker_connect(lg_worker_t *w) {
+    int pending = 0;
+    for (int i = 0; i < w->nconns; i++) {
+        if (conn_open(w, &w->conns[i], w->first + i) == 0 && w->conns[i].fd >= 0) {
+            pending++;
+        } else {
+            w->conns[i].fd = -1;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t deadline = now_ns() + 10000000000ull;
+    while (pending > 0 && now_ns() < deadline) {
+        int n = epoll_wait(w->epfd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < n; i++) {
+            lg_conn_t *c = events[i].data.ptr;
+            // 已建立的连接在等待其它连接期间可能收到开场白，留给主循环读取
+            if (c->up) continue;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            pending--;
+            if (err != 0) {
+                epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                close(c->fd);
+                c->fd = -1;
+                continue;
+            }
+            struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+            epoll_ctl(w->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+            c->up = true;
+            c->banner_left = g_banner;
+            w->connected++;
+        }
+    }
+
+    for (int i = 0; i < w->nconns; i++) {
+        lg_conn_t *c = &w->conns[i];
+        if (c->fd >= 0 && !c->up) {
+            epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+            close(c->fd);
+            c->fd = -1;
+        }
+    }
+}
+
+// 开环：按计划时间发出到期的请求，连接轮流选取；返回距下一个计划时间的纳秒数
+static uint64_t worker_issue_due(lg_worker_t *w, uint64_t start, uint64_t now) {
+    if (w->connected == 0) return 100000000ull;
+    double interval = 1e9 / w->rate;
+    uint64_t due = (uint64_t)((double)(now - start) / interval) + 1;
+    while (w->issued < due) {
+        lg_conn_t *c;
+        do {
+            c = &w->conns[w->next_conn++ % (uint32_t)w->nconns];
+        } while (c->fd < 0);
+        conn_issue(w, c, start + (uint64_t)((double)w->issued * interval));
+        w->issued++;
+        if (!c->want_out) conn_flush(w, c);
+    }
+    uint64_t next = start + (uint64_t)((double)w->issued * interval);
+    return next > now ? next - now : 0;
+}
+
+static void *worker_main(void *arg) {
+    lg_worker_t *w = (lg_worker_t*)arg;
+    char *buf = malloc(RECV_BUF_SIZE);
+    struct epoll_event events[MAX_EVENTS];
+
+    worker_connect(w);
+    atomic_fetch_add(&g_ready, 1);
+    while (!atomic_load(&g_running)) {
+        usleep(1000);
+    }
+
+    // 闭环模式：每个连接先发出depth个请求
+    uint64_t start = now_ns();
+    if (g_mode == MODE_ECHO || g_mode == MODE_PIPELINE) {
+        for (int i = 0; i < w->nconns; i++) {
+            lg_conn_t *c = &w->conns[i];
+            if (c->fd < 0) continue;
+            for (int d = 0; d < g_depth; d++) conn_issue(w, c, start);
+            conn_flush(w, c);
+        }
+    }
+
+    while (atomic_load_explicit(&g_running, memory_order_relaxed) && buf) {
+        struct timespec timeout = { 0, 100000000 };
+        if (g_mode == MODE_RATE || g_mode == MODE_IDLE) {
+            uint64_t wait = worker_issue_due(w, start, now_ns());
+            timeout.tv_sec = (time_t)(wait / 1000000000ull);
+            timeout.tv_nsec = (long)(wait % 1000000000ull);
+        }
+        int n = epoll_pwait2(w->epfd, events, MAX_EVENTS, &timeout, NULL);
+        for (int i = 0; i < n; i++) {
+            lg_conn_t *c = events[i].data.ptr;
+            if (c->fd < 0) continue;
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) conn_read(w, c, buf);
+            if (c->fd >= 0 && (events[i].events & EPOLLOUT)) conn_flush(w, c);
+        }
+    }
+
+    for (int i = 0; i < w->nconns; i++) {
+        if (w->conns[i].fd >= 0) close(w->conns[i].fd);
+        free(w->conns[i].inflight.ts);
+    }
+    free(buf);
+    return NULL;
+}
+
+// 服务进程的VmRSS（KB），读取失败返回0
+static unsigned long server_rss_kb(int pid) {
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    unsigned long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %lu kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-h host] [-p port] [-m echo|pipeline|rate|idle] [-c conns] [-t threads] [-s message_bytes]\n"
+            "       [-D pipeline_depth] [-r total_requests_per_sec] [-H heartbeat_seconds] [-d seconds]\n"
+            "       [-w warmup_seconds] [-W banner_lines] [-S source_addrs] [-i expected_interval_us]\n"
+            "       [-P server_pid] [-f kv|json] [-l label]\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    int conns = 100;
+    int threads = 2;
+    double rate = 10000;
+    int seconds = 5;
+    int warmup = 1;
+    double interval_us = 0;
+    double heartbeat = 30;
+    int server_pid = 0;
+    bool json = false;
+    const char *label = "loadgen";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:m:c:t:s:D:r:H:d:w:W:S:i:P:f:l:")) != -1) {
+        switch (opt) {
+            case 'h': g_host = optarg; break;
+            case 'p': g_port = atoi(optarg); break;
+            case 'm':
+                if (strcmp(optarg, "echo") == 0) g_mode = MODE_ECHO;
+                else if (strcmp(optarg, "pipeline") == 0) g_mode = MODE_PIPELINE;
+                else if (strcmp(optarg, "rate") == 0) g_mode = MODE_RATE;
+                else if (strcmp(optarg, "idle") == 0) g_mode = MODE_IDLE;
+                else { usage(argv[0]); return 1; }
+                break;
+            case 'c': conns = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 's': g_size = strtoul(optarg, NULL, 10); break;
+            case 'D': g_depth = atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'H': heartbeat = atof(optarg); break;
+            case 'd': seconds = atoi(optarg); break;
+            case 'w': warmup = atoi(optarg); break;
+            case 'W': g_banner = (uint32_t)atoi(optarg); break;
+            case 'S': g_sources = atoi(optarg); break;
+            case 'i': interval_us = atof(optarg); break;
+            case 'P': server_pid = atoi(optarg); break;
+            case 'f': json = strcmp(optarg, "json") == 0; break;
+            case 'l': label = optarg; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (threads <= 0) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if (conns < threads) conns = threads;
+    if (g_size == 0) g_size = 1;
+    if (g_size > MAX_MESSAGE) g_size = MAX_MESSAGE;
+    if (g_mode == MODE_ECHO || g_depth <= 0) g_depth = 1;
+    if (g_mode == MODE_IDLE) rate = heartbeat > 0 ? conns / heartbeat : conns;
+    if (rate <= 0) rate = 1;
+    if (seconds <= 0) seconds = 1;
+    if (warmup < 0) warmup = 0;
+
+    g_addr.sin_family = AF_INET;
+    g_addr.sin_port = htons((uint16_t)g_port);
+    if (inet_pton(AF_INET, g_host, &g_addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid host %s\n", g_host);
+        return 1;
+    }
+    // 回环目标默认按连接数分配源地址
+    if (g_sources == 0 && (ntohl(g_addr.sin_addr.s_addr) >> 24) == 127 && conns > PORTS_PER_SOURCE) {
+        g_sources = (conns + PORTS_PER_SOURCE - 1) / PORTS_PER_SOURCE;
+    }
+
+    // 软限制提到硬限制；仍不够时照常运行，建连失败的连接计入connected之外
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        if (rl.rlim_cur < (rlim_t)conns + 64) {
+            fprintf(stderr, "RLIMIT_NOFILE is %llu, not enough for %d connections\n",
+                    (unsigned long long)rl.rlim_cur, conns);
+        }
+    }
+
+    // 发送模板：TEMPLATE_REQUESTS个请求首尾相接，每个以换行结尾
+    g_template_len = g_size * TEMPLATE_REQUESTS;
+    g_template = malloc(g_template_len);
+    lg_worker_t *workers = calloc(threads, sizeof(lg_worker_t));
+    if (!g_template || !workers) return 1;
+    memset(g_template, 'q', g_template_len);
+    for (int i = 1; i <= TEMPLATE_REQUESTS; i++) {
+        g_template[i * g_size - 1] = '\n';
+    }
+
+    unsigned long rss_base = server_pid > 0 ? server_rss_kb(server_pid) : 0;
+    atomic_store(&g_ready, 0);
+    for (int i = 0, first = 0; i < threads; i++) {
+        lg_worker_t *w = &workers[i];
+        w->id = i;
+        w->nconns = conns / threads + (i < conns % threads);
+        w->first = first;
+        first += w->nconns;
+        w->rate = rate / threads;
+        w->conns = calloc(w->nconns, sizeof(lg_conn_t));
+        w->epfd = epoll_create1(0);
+        if (!w->conns || w->epfd < 0) return 1;
+        pthread_create(&w->thread, NULL, worker_main, w);
+    }
+    while (atomic_load(&g_ready) < threads) {
+        usleep(1000);
+    }
+    int connected = 0;
+    for (int i = 0; i < threads; i++) connected += workers[i].connected;
+    if (connected == 0) {
+        fprintf(stderr, "No connection to %s:%d could be established\n", g_host, g_port);
+        return 1;
+    }
+
+    // 预热期间的请求不计入；测量窗口内收到的响应才计入延迟和吞吐
+    atomic_store(&g_running, true);
+    sleep((unsigned)warmup);
+    uint64_t start = now_ns();
+    atomic_store(&g_measure_start, start);
+    atomic_store(&g_measuring, true);
+    sleep((unsigned)seconds);
+    atomic_store(&g_measuring, false);
+    double elapsed = (double)(now_ns() - start) / 1e9;
+    unsigned long rss_end = server_pid > 0 ? server_rss_kb(server_pid) : 0;
+    atomic_store(&g_running, false);
+
+    static hist_t hist, corrected;
+    uint64_t sent = 0, received = 0, errors = 0, bytes_in = 0;
+    int alive = 0;
+    for (int i = 0; i < threads; i++) {
+        lg_worker_t *w = &workers[i];
+        pthread_join(w->thread, NULL);
+        sent += w->sent;
+        received += w->received;
+        errors += w->errors;
+        bytes_in += w->bytes_in;
+        alive += w->connected;
+        hist_merge(&hist, &w->hist);
+        close(w->epfd);
+        free(w->conns);
+    }
+
+    // 开环延迟已从计划时间算起，不再修正；闭环的期望间隔默认取中位延迟
+    uint64_t interval_ns = 0;
+    if (g_mode == MODE_ECHO || g_mode == MODE_PIPELINE) {
+        interval_ns = interval_us > 0 ? (uint64_t)(interval_us * 1000) : hist_quantile(&hist, 0.50);
+    }
+    hist_correct(&corrected, &hist, interval_ns);
+
+    static const char *mode_names[] = { "echo", "pipeline", "rate", "idle" };
+    double rss_per_conn = rss_end > rss_base && alive > 0 ? (double)(rss_end - rss_base) * 1024 / alive : 0;
+    const double q[] = { 0.50, 0.90, 0.99, 0.999 };
+    const char *qn[] = { "p50", "p90", "p99", "p999" };
+    if (json) {
+        printf("{\"label\":\"%s\",\"mode\":\"%s\",\"conns\":%d,\"connected\":%d,\"alive\":%d,\"threads\":%d,"
+               "\"size\":%zu,\"depth\":%d,\"target_rate\":%.0f,\"seconds\":%.3f,\"sent\":%llu,\"received\":%llu,"
+               "\"errors\":%llu,\"rate\":%.0f,\"mbps\":%.2f",
+               label, mode_names[g_mode], conns, connected, alive, threads, g_size, g_depth,
+               g_mode >= MODE_RATE ? rate : 0.0, elapsed, (unsigned long long)sent,
+               (unsigned long long)received, (unsigned long long)errors, received / elapsed,
+               bytes_in * 8 / elapsed / 1e6);
+        if (server_pid > 0) printf(",\"server_rss_kb\":%lu,\"rss_per_conn\":%.0f", rss_end, rss_per_conn);
+        for (int i = 0; i < 4; i++) printf(",\"%s_us\":%.1f", qn[i], hist_quantile(&hist, q[i]) / 1e3);
+        printf(",\"max_us\":%.1f", hist.max / 1e3);
+        for (int i = 0; i < 4; i++) printf(",\"c_%s_us\":%.1f", qn[i], hist_quantile(&corrected, q[i]) / 1e3);
+        printf("}\n");
+    } else {
+        printf("label=%s mode=%s conns=%d connected=%d alive=%d threads=%d size=%zu depth=%d target_rate=%.0f "
+               "seconds=%.3f sent=%llu received=%llu errors=%llu rate=%.0f mbps=%.2f",
+               label, mode_names[g_mode], conns, connected, alive, threads, g_size, g_depth,
+               g_mode >= MODE_RATE ? rate : 0.0, elapsed, (unsigned long long)sent,
+               (unsigned long long)received, (unsigned long long)errors, received / elapsed,
+               bytes_in * 8 / elapsed / 1e6);
+        if (server_pid > 0) printf(" server_rss_kb=%lu rss_per_conn=%.0f", rss_end, rss_per_conn);
+        for (int i = 0; i < 4; i++) printf(" %s_us=%.1f", qn[i], hist_quantile(&hist, q[i]) / 1e3);
+        printf(" max_us=%.1f", hist.max / 1e3);
+        for (int i = 0; i < 4; i++) printf(" c_%s_us=%.1f", qn[i], hist_quantile(&corrected, q[i]) / 1e3);
+        printf("\n");
+    }
+
+    free(workers);
+    free(g_template);
+    return 0;
+}
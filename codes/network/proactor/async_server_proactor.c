@@ -9,16 +9,41 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <signal.h>
+#include <time.h>
+#include <sys/resource.h>
 
 #include "proactor.h"
+#include "log.h"
 
 #define PORT 8080
-#define BUFFER_SIZE 4096
+#define BUFFER_SIZE CONN_BUFFER_SIZE
+#define ECHO_PREFIX "Echo: "
+#define ECHO_PREFIX_LEN (sizeof(ECHO_PREFIX) - 1)
 
+// 等待连接可读：不占用缓冲，空闲连接只有上下文头部常驻
+static void submit_poll_operation(proactor_t *proactor, connection_ctx_t *ctx) {
+    async_operation_t *poll_op = malloc(sizeof(async_operation_t));
+    if (!poll_op) {
+        LOG_ERROR("Failed to allocate poll operation for fd=%d", ctx->fd);
+        proactor_remove_connection(proactor, ctx->fd);
+        return;
+    }
+    
+    memset(poll_op, 0, sizeof(async_operation_t));
+    poll_op->type = OP_POLL;
+    poll_op->fd = ctx->fd;
+    poll_op->handler = ctx->handler;
+    poll_op->data = ctx;
+    ctx->polling = 1;
+    
+    proactor_submit_operation(proactor, poll_op);
+}
+
+// 可读后才提交读，调用前必须已挂上缓冲
 void submit_next_read_operation(proactor_t *proactor, connection_ctx_t *ctx) {
     async_operation_t *read_op = malloc(sizeof(async_operation_t));
     if (!read_op) {
-        printf("Failed to allocate read operation for fd=%d\n", ctx->fd);
+        LOG_ERROR("Failed to allocate read operation for fd=%d", ctx->fd);
         return;
     }
     
@@ -26,38 +51,61 @@ void submit_next_read_operation(proactor_t *proactor, connection_ctx_t *ctx) {
     read_op->type = OP_READ;
     read_op->fd = ctx->fd;
     read_op->handler = ctx->handler;
-    read_op->buffer = ctx->read_buf;
-    read_op->size = BUFFER_SIZE - 1; // 留出空间给null终止符
+    read_op->data = ctx;
+    // 读到前缀之后，回显时就地补上前缀，读和写共用一块缓冲；留出null终止符的空间
+    read_op->buffer = ctx->buf->data + ECHO_PREFIX_LEN;
+    read_op->size = BUFFER_SIZE - 1 - ECHO_PREFIX_LEN;
     read_op->offset = 0;
     
     proactor_submit_operation(proactor, read_op);
     // printf("Submitted read operation for fd=%d\n", ctx->fd);
 }
 
+// 提交write_buf中尚未写出的部分
+static void submit_pending_write(proactor_t *proactor, connection_ctx_t *ctx) {
+    async_operation_t *write_op = malloc(sizeof(async_operation_t));
+    if (!write_op) {
+        LOG_ERROR("Failed to allocate write operation for fd=%d", ctx->fd);
+        proactor_remove_connection(proactor, ctx->fd);
+        return;
+    }
+    
+    memset(write_op, 0, sizeof(async_operation_t));
+    write_op->type = OP_WRITE;
+    write_op->fd = ctx->fd;
+    write_op->handler = ctx->handler;
+    write_op->data = ctx;
+    write_op->buffer = ctx->buf->data + ctx->write_off;
+    write_op->size = ctx->write_len - ctx->write_off;
+    write_op->offset = 0;
+    
+    proactor_submit_operation(proactor, write_op);
+}
+
 // 完成处理器实现
 void handle_read_completion(completion_handler_t *handler, int fd, 
                            void *data, ssize_t bytes) {
     connection_ctx_t *ctx = (connection_ctx_t *)data;
     if (!ctx) {
-        printf("Context is NULL in read completion for fd=%d\n", fd);
+        LOG_DEBUG("Context is NULL in read completion for fd=%d", fd);
         return;
     }
     
     proactor_t *proactor = (proactor_t *)ctx->proactor;
     if (!proactor) {
-        printf("Proactor is NULL in read completion for fd=%d\n", fd);
+        LOG_DEBUG("Proactor is NULL in read completion for fd=%d", fd);
         return;
     }
     
     // 检查连接是否仍然有效
     if (fd < 0 || fd >= proactor->max_connections || proactor->connections[fd] != ctx) {
-        printf("Connection invalid in read completion for fd=%d\n", fd);
+        LOG_DEBUG("Connection invalid in read completion for fd=%d", fd);
         return;
     }
     
     if (bytes == 0) {
         // 对端正常关闭连接
-        printf("Client fd=%d closed connection gracefully\n", fd);
+        LOG_DEBUG("Client fd=%d closed connection gracefully", fd);
         proactor_remove_connection(proactor, fd);
         return;
     } else if (bytes < 0) {
@@ -73,62 +121,46 @@ void handle_read_completion(completion_handler_t *handler, int fd,
         //     return;
         // } else {
             // 其他错误，关闭连接
-            printf("Read error for fd=%d: %s\n", fd, strerror(error_code));
+            LOG_DEBUG("Read error for fd=%d: %s", fd, strerror(error_code));
             proactor_remove_connection(proactor, fd);
             return;
         // }
     }
     
     // 确保字符串以null结尾
-    size_t safe_bytes = bytes < BUFFER_SIZE ? bytes : BUFFER_SIZE - 1;
-    ctx->read_buf[safe_bytes] = '\0';
+    size_t safe_bytes = (size_t)bytes < BUFFER_SIZE - 1 - ECHO_PREFIX_LEN ? (size_t)bytes : BUFFER_SIZE - 1 - ECHO_PREFIX_LEN;
+    char *data_start = ctx->buf->data + ECHO_PREFIX_LEN;
+    data_start[safe_bytes] = '\0';
+    ctx->last_active = time(NULL);
     
-    printf("Received from fd=%d: %.*s", fd, (int)safe_bytes, ctx->read_buf);
+    LOG_DEBUG("Received from fd=%d: %.*s", fd, (int)safe_bytes, data_start);
     
-    // 回显数据
-    const char *echo_prefix = "Echo: ";
-    size_t prefix_len = strlen(echo_prefix);
-    size_t total_len = prefix_len + safe_bytes;
+    // 回显数据：数据读在前缀之后，只需补上前缀
+    memcpy(ctx->buf->data, ECHO_PREFIX, ECHO_PREFIX_LEN);
+    ctx->write_len = ECHO_PREFIX_LEN + safe_bytes;
+    ctx->write_off = 0;
     
-    if (total_len < BUFFER_SIZE) {
-        memcpy(ctx->write_buf, echo_prefix, prefix_len);
-        memcpy(ctx->write_buf + prefix_len, ctx->read_buf, safe_bytes);
-        
-        // 提交写操作
-        async_operation_t *write_op = malloc(sizeof(async_operation_t));
-        if (write_op) {
-            write_op->type = OP_WRITE;
-            write_op->fd = fd;
-            write_op->handler = ctx->handler;
-            write_op->buffer = ctx->write_buf;
-            write_op->size = total_len;
-            write_op->offset = 0;
-            
-            proactor_submit_operation(proactor, write_op);
-        }
-    } else {
-        // 如果缓冲区不够，放弃回写，直接继续读取下一条
-        submit_next_read_operation(proactor, ctx);
-    }
+    // 写完之前不再读：对端不收时读取随之暂停，数据留在内核的接收缓冲中
+    submit_pending_write(proactor, ctx);
 }
 
 void handle_write_completion(completion_handler_t *handler, int fd, 
                             void *data, ssize_t bytes) {
     connection_ctx_t *ctx = (connection_ctx_t *)data;
     if (!ctx) {
-        printf("Context is NULL in write completion for fd=%d\n", fd);
+        LOG_DEBUG("Context is NULL in write completion for fd=%d", fd);
         return;
     }
     
     proactor_t *proactor = (proactor_t *)ctx->proactor;
     if (!proactor) {
-        printf("Proactor is NULL in write completion for fd=%d\n", fd);
+        LOG_DEBUG("Proactor is NULL in write completion for fd=%d", fd);
         return;
     }
     
     // 检查连接是否仍然有效
     if (fd < 0 || fd >= proactor->max_connections || proactor->connections[fd] != ctx) {
-        printf("Connection invalid in write completion for fd=%d\n", fd);
+        LOG_DEBUG("Connection invalid in write completion for fd=%d", fd);
         return;
     }
     
@@ -153,15 +185,51 @@ void handle_write_completion(completion_handler_t *handler, int fd,
         //     }
         //     return;
         // } else {
-            printf("Write failed for fd=%d: %s\n", fd, strerror(error_code));
+            LOG_ERROR("Write failed for fd=%d: %s", fd, strerror(error_code));
             proactor_remove_connection(proactor, fd);
             return;
         // }
     }
 
-    printf("Sent %zd bytes to fd=%d\n", bytes, fd);
+    LOG_DEBUG("Sent %zd bytes to fd=%d", bytes, fd);
+    
+    // 部分写出：继续写剩余部分，写完才恢复读取
+    ctx->write_off += (uint32_t)bytes;
+    if (ctx->write_off < ctx->write_len) {
+        submit_pending_write(proactor, ctx);
+        return;
+    }
+    
+    // 等下一个请求：缓冲先留着，连续的请求不用反复挂上，空闲超时后由分发线程归还
+    submit_poll_operation(proactor, ctx);
+}
+
+void handle_poll_completion(completion_handler_t *handler, int fd,
+                            void *data, int revents) {
+    connection_ctx_t *ctx = (connection_ctx_t *)data;
+    if (!ctx) {
+        LOG_DEBUG("Context is NULL in poll completion for fd=%d", fd);
+        return;
+    }
     
-    // 继续读取
+    proactor_t *proactor = (proactor_t *)ctx->proactor;
+    if (!proactor) {
+        LOG_DEBUG("Proactor is NULL in poll completion for fd=%d", fd);
+        return;
+    }
+    
+    // 检查连接是否仍然有效
+    if (fd < 0 || fd >= proactor->max_connections || proactor->connections[fd] != ctx) {
+        LOG_DEBUG("Connection invalid in poll completion for fd=%d", fd);
+        return;
+    }
+    
+    // 可读、对端关闭或出错都交给读：读到0或错误码时关闭连接
+    LOG_DEBUG("fd=%d ready, revents=0x%x", fd, revents);
+    if (proactor_attach_buffer(proactor, ctx) < 0) {
+        proactor_remove_connection(proactor, fd);
+        return;
+    }
     submit_next_read_operation(proactor, ctx);
 }
 
@@ -169,17 +237,17 @@ void handle_error_completion(completion_handler_t *handler, int fd,
                             void *data, int error) {
     connection_ctx_t *ctx = (connection_ctx_t *)data;
     if (!ctx) {
-        printf("Context is NULL in error completion for fd=%d\n", fd);
+        LOG_DEBUG("Context is NULL in error completion for fd=%d", fd);
         return;
     }
     
     proactor_t *proactor = (proactor_t *)ctx->proactor;
     if (!proactor) {
-        printf("Proactor is NULL in error completion for fd=%d\n", fd);
+        LOG_DEBUG("Proactor is NULL in error completion for fd=%d", fd);
         return;
     }
     
-    printf("Error on fd=%d: %s\n", fd, strerror(error));
+    LOG_DEBUG("Error on fd=%d: %s", fd, strerror(error));
     proactor_remove_connection(proactor, fd);
 }
 
@@ -264,41 +332,34 @@ void submit_welcome_message(proactor_t *proactor, connection_ctx_t *ctx) {
     // } else {
     //     // 欢迎消息太长，延迟后开始读取
     //     usleep(100000); // 延迟100ms
-        submit_next_read_operation(proactor, ctx);
+        submit_poll_operation(proactor, ctx);
     // }
 }
 // 设置新连接（只在async_server_proactor.c中定义）
 void setup_new_connection(proactor_t *proactor, int fd, struct sockaddr_in *addr) {
     // 首先添加到连接管理
     if (proactor_add_connection(proactor, fd, addr) < 0) {
-        fprintf(stderr, "Failed to add connection for fd=%d\n", fd);
+        LOG_ERROR("Failed to add connection for fd=%d", fd);
         close(fd);
         return;
     }
     
     connection_ctx_t *ctx = proactor->connections[fd];
     if (!ctx) {
-        fprintf(stderr, "Connection context not found for fd=%d\n", fd);
+        LOG_ERROR("Connection context not found for fd=%d", fd);
         return;
     }
     
-    // 创建完成处理器
-    completion_handler_t *handler = malloc(sizeof(completion_handler_t));
-    if (!handler) {
-        fprintf(stderr, "Failed to allocate handler for fd=%d\n", fd);
-        proactor_remove_connection(proactor, fd);
-        return;
-    }
-
-    memset(handler, 0, sizeof(completion_handler_t));
-    handler->handle_read = handle_read_completion;
-    handler->handle_write = handle_write_completion;
-    handler->handle_error = handle_error_completion;
-    handler->user_data = ctx;
-    
-    ctx->handler = handler;
+    // 所有连接共用一个完成处理器，连接上下文由操作的data传回
+    static completion_handler_t conn_handler = {
+        .handle_read = handle_read_completion,
+        .handle_write = handle_write_completion,
+        .handle_error = handle_error_completion,
+        .handle_poll = handle_poll_completion,
+    };
+    ctx->handler = &conn_handler;
     
-    printf("Connection setup complete for fd=%d\n", fd);
+    LOG_DEBUG("Connection setup complete for fd=%d", fd);
 
     // 只发送欢迎消息，不立即开始读取
     submit_welcome_message(proactor, ctx);
@@ -312,18 +373,49 @@ void signal_handler(int sig) {
     g_proactor.running = 0;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    static int cpus[AFFINITY_MAX_CPUS];
+    int cpu_count = 0;
+    
+    // --cpus LIST：分发线程和工作者线程依次绑定到这些CPU
+    // --log-level NAME：运行期日志级别，默认INFO
+    int log_level = LOG_LEVEL_INFO;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            cpu_count = affinity_parse_cpus(argv[++i], cpus, AFFINITY_MAX_CPUS);
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            log_level = log_parse_level(argv[++i]);
+        } else {
+            cpu_count = -1;
+        }
+        if (cpu_count < 0 || log_level < 0) {
+            fprintf(stderr, "Usage: %s [--cpus LIST] [--log-level trace|debug|info|warn|error|off]\n", argv[0]);
+            return 1;
+        }
+    }
+    
     // 信号处理
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
+    // 日志由后台线程批量写出
+    log_init(STDOUT_FILENO, log_level);
+    
     printf("Initializing Proactor server...\n");
     
+    // 连接表按fd索引，上限取打开文件数的软限制
+    struct rlimit rl;
+    int max_conn = 10000;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur > (rlim_t)max_conn) {
+        max_conn = (int)rl.rlim_cur;
+    }
+    
     // 初始化Proactor
-    if (proactor_init(&g_proactor, 4, 10000) < 0) {
+    if (proactor_init(&g_proactor, 4, max_conn) < 0) {
         fprintf(stderr, "Proactor initialization failed\n");
         return -1;
     }
+    proactor_set_affinity(&g_proactor, cpus, cpu_count);
     
     // 创建服务器socket
     g_proactor.listen_fd = create_server_socket(PORT);
@@ -350,6 +442,7 @@ int main() {
     
     printf("Shutting down server...\n");
     proactor_stop(&g_proactor);
+    log_shutdown();
         
     printf("Server shutdown complete.\n");
     return 0;
@@ -12,8 +12,10 @@
 #include <sys/epoll.h>
 #include <pthread.h>
 #include <sys/eventfd.h>
+#include <poll.h>
 
 #include "proactor.h"
+#include "log.h"
 
 // 设置文件描述符为非阻塞
 static int set_nonblock(int fd) {
@@ -26,9 +28,15 @@ static int set_nonblock(int fd) {
 int proactor_init(proactor_t *proactor, int thread_count, int max_conn) {
     memset(proactor, 0, sizeof(proactor_t));
     
-    // 初始化 AIO 上下文
-    if (io_setup(10000, &proactor->aio_ctx) < 0) {
-        perror("io_setup failed");
+    // 初始化 AIO 上下文：每个连接都有一个在途操作（空闲时是OP_POLL），容量按最大连接数申请，
+    // 超过系统上限fs.aio-max-nr时退回10000
+    int ret = io_setup(max_conn, &proactor->aio_ctx);
+    if (ret == -EAGAIN && max_conn > 10000) {
+        printf("WARNING: io_setup(%d) exceeds fs.aio-max-nr, falling back to 10000 in-flight operations\n", max_conn);
+        ret = io_setup(10000, &proactor->aio_ctx);
+    }
+    if (ret < 0) {
+        fprintf(stderr, "io_setup failed: %s\n", strerror(-ret));
         return -1;
     }
     
@@ -51,7 +59,8 @@ int proactor_init(proactor_t *proactor, int thread_count, int max_conn) {
     
     // 初始化连接管理
     proactor->max_connections = max_conn;
-    proactor->connections = calloc(max_conn, sizeof(connection_ctx_t*));
+    // 按页对齐分配，绑核后可以迁到分发线程所在节点
+    proactor->connections = affinity_alloc(max_conn * sizeof(connection_ctx_t*));
     if (!proactor->connections) {
         perror("calloc failed");
         close(proactor->epoll_fd);
@@ -60,6 +69,9 @@ int proactor_init(proactor_t *proactor, int thread_count, int max_conn) {
         return -1;
     }
     
+    slab_cache_init(&proactor->conn_slab, "connection_ctx", sizeof(connection_ctx_t), 64);
+    slab_cache_init(&proactor->buf_slab, "conn_buf", sizeof(conn_buf_t), 64);
+    
     // 初始化队列和互斥锁
     pthread_mutex_init(&proactor->queue_mutex, NULL);
     pthread_cond_init(&proactor->queue_cond, NULL);
@@ -116,6 +128,7 @@ static void *worker_thread_func(void *arg) {
         if(!op) {
             continue;
         }
+        log_tick();
         // 执行异步操作
         struct iocb *iocbs[1] = { &op->iocb };
         int ret;
@@ -127,12 +140,12 @@ static void *worker_thread_func(void *arg) {
                 ret = io_submit(proactor->aio_ctx, 1, iocbs);
                 if (ret != 1) {
                     if (ret == -EAGAIN) {
-                        printf("io_submit read EAGAIN for fd=%d, retrying...\n", op->fd);
+                        LOG_DEBUG("io_submit read EAGAIN for fd=%d, retrying...", op->fd);
                         // 重新提交操作
                         usleep(10000);
                         proactor_submit_operation(proactor, op);
                     } else {
-                        fprintf(stderr, "io_submit read failed: %d\n", ret);
+                        LOG_ERROR("io_submit read failed: %d", ret);
                         free(op);
                     }
                 } else {
@@ -146,21 +159,37 @@ static void *worker_thread_func(void *arg) {
                 ret = io_submit(proactor->aio_ctx, 1, iocbs);
                 if (ret != 1) {
                     if (ret == -EAGAIN) {
-                        printf("io_submit write EAGAIN for fd=%d, retrying...\n", op->fd);
+                        LOG_DEBUG("io_submit write EAGAIN for fd=%d, retrying...", op->fd);
                         // 重新提交操作
                         usleep(10000);
                         proactor_submit_operation(proactor, op);
                     } else {
-                        fprintf(stderr, "io_submit write failed: %d\n", ret);
+                        LOG_ERROR("io_submit write failed: %d", ret);
                         free(op);
                     }
                 } else {
-                    printf("Write operation submitted successfully for fd=%d\n", op->fd);
+                    LOG_DEBUG("Write operation submitted successfully for fd=%d", op->fd);
+                }
+                break;
+                
+            case OP_POLL:
+                io_prep_poll(&op->iocb, op->fd, POLLIN);
+                op->iocb.data = op;
+                ret = io_submit(proactor->aio_ctx, 1, iocbs);
+                if (ret != 1) {
+                    if (ret == -EAGAIN) {
+                        LOG_DEBUG("io_submit poll EAGAIN for fd=%d, retrying...", op->fd);
+                        usleep(10000);
+                        proactor_submit_operation(proactor, op);
+                    } else {
+                        LOG_ERROR("io_submit poll failed: %d", ret);
+                        free(op);
+                    }
                 }
                 break;
                 
             default:
-                fprintf(stderr, "Unknown operation type: %d\n", op->type);
+                LOG_ERROR("Unknown operation type: %d", op->type);
                 free(op);
                 break;
         }
@@ -172,7 +201,7 @@ static void *worker_thread_func(void *arg) {
 // 处理连接事件
 static void handle_connection_event(proactor_t *proactor, int fd, uint32_t events) {
     if (events & (EPOLLERR | EPOLLHUP)) {
-        printf("Connection error or hangup on fd=%d\n", fd);
+        LOG_DEBUG("Connection error or hangup on fd=%d", fd);
         proactor_remove_connection(proactor, fd);
         return;
     }
@@ -199,7 +228,7 @@ static void handle_new_connection(proactor_t *proactor) {
         return;
     }
     
-    printf("New connection from %s:%d, fd=%d\n", 
+    LOG_DEBUG("New connection from %s:%d, fd=%d", 
            inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port), client_fd);
     
     // 设置新连接（在async_server_proactor.c中实现）
@@ -214,12 +243,33 @@ static void handle_new_connection(proactor_t *proactor) {
     }
 }
 
+// 等待可读超过CONN_BUF_IDLE_SECONDS的连接归还缓冲，下次可读时再挂上
+static void release_idle_buffers(proactor_t *proactor, time_t now) {
+    for (int fd = 0; fd < proactor->max_connections; fd++) {
+        connection_ctx_t *ctx = proactor->connections[fd];
+        if (ctx && ctx->buf && ctx->polling && now - ctx->last_active >= CONN_BUF_IDLE_SECONDS) {
+            slab_free(ctx->buf);
+            ctx->buf = NULL;
+            proactor->buf_releases++;
+        }
+    }
+}
+
 // 分发线程函数
 static void *dispatcher_thread_func(void *arg) {
     proactor_t *proactor = (proactor_t *)arg;
     struct io_event events[64];
     struct timespec timeout = { 0, 10000000 }; // 10ms
     
+    // 连接表只由分发线程访问，迁到它所在的节点；连接slab由本线程首次分配，本来就在本地
+    if (proactor->cpu_count > 0) {
+        int node = affinity_cpu_node(proactor->cpus[0]);
+        int ret = affinity_bind_memory(proactor->connections,
+                                       proactor->max_connections * sizeof(connection_ctx_t*), node);
+        LOG_INFO("Dispatcher pinned to CPU %d, NUMA node %d%s", proactor->cpus[0], node,
+                 ret ? " (connection table migration failed)" : "");
+    }
+    
     // 添加退出事件到epoll
     struct epoll_event ev;
     ev.events = EPOLLIN;
@@ -239,12 +289,13 @@ static void *dispatcher_thread_func(void *arg) {
         // 处理epoll事件
         struct epoll_event epoll_events[64];
         int nfds = epoll_wait(proactor->epoll_fd, epoll_events, 64, 10); // 10ms超时
+        log_tick();
         
         for (int i = 0; i < nfds; i++) {
             int fd = epoll_events[i].data.fd;
             
             if (fd == proactor->exit_event_fd) {
-                printf("Exit event received\n");
+                LOG_DEBUG("Exit event received");
                 proactor->running = 0;
                 break;
             } else if (fd == proactor->listen_fd) {
@@ -273,14 +324,14 @@ static void *dispatcher_thread_func(void *arg) {
 
             int fd = op->fd;
             if (fd < 0 || fd >= proactor->max_connections) {
-                printf("Invalid fd in completion event: %d\n", fd);
+                LOG_DEBUG("Invalid fd in completion event: %d", fd);
                 free(op);
                 continue;
             }
 
             connection_ctx_t *ctx = proactor->connections[fd];
             if (!ctx) {
-                printf("Connection already closed for fd=%d, skipping completion\n", fd);
+                LOG_DEBUG("Connection already closed for fd=%d, skipping completion", fd);
                 free(op);
                 continue;
             }
@@ -291,70 +342,116 @@ static void *dispatcher_thread_func(void *arg) {
                 continue;
             }
 
-            // 验证handler是否与连接上下文匹配
-            if (handler->user_data != ctx) {
-                printf("Handler mismatch for fd=%d\n", fd);
+            // 验证操作是否属于当前连接（fd关闭后被新连接复用时丢弃旧操作的完成事件）
+            if (op->data != ctx) {
+                LOG_DEBUG("Context mismatch for fd=%d", fd);
                 free(op);
                 continue;
             }
 
-            if (events[i].res < 0) {
+            // libaio的res是无符号的，按有符号解释才能区分负的错误码
+            long res = (long)events[i].res;
+            if (res == -EAGAIN || res == -EWOULDBLOCK) {
+                usleep(10000);
+                proactor_submit_operation(proactor, op);
+                continue;
+            }
+            if (op->type == OP_POLL) {
+                ctx->polling = 0;
+            }
+            if (res < 0) {
                 // 错误处理
                 if (handler->handle_error) {
-                    handler->handle_error(handler, op->fd, handler->user_data, -events[i].res);
+                    handler->handle_error(handler, op->fd, ctx, (int)-res);
                 }
             } else {
-                int error_code = -events[i].res;
-                if(error_code == EAGAIN || error_code == EWOULDBLOCK) {
-                    usleep(10000);
-                    proactor_submit_operation(proactor, op);
-                    continue;
-                }
                 // 成功处理
                 switch (op->type) {
                     case OP_READ:
                         if (handler->handle_read) {
-                            handler->handle_read(handler, op->fd, handler->user_data, events[i].res);
+                            handler->handle_read(handler, op->fd, ctx, res);
                         }
                         break;
                         
                     case OP_WRITE:
                         if (handler->handle_write) {
-                            handler->handle_write(handler, op->fd, handler->user_data, events[i].res);
+                            handler->handle_write(handler, op->fd, ctx, res);
+                        }
+                        break;
+                        
+                    case OP_POLL:
+                        if (handler->handle_poll) {
+                            handler->handle_poll(handler, op->fd, ctx, (int)res);
                         }
                         break;
                         
                     default:
-                        printf("Unknown operation type in completion: %d\n", op->type);
+                        LOG_DEBUG("Unknown operation type in completion: %d", op->type);
                         break;
                 }
             }
             
             free(op);
         }
+        
+        time_t now = time(NULL);
+        if (now != proactor->last_sweep) {
+            proactor->last_sweep = now;
+            release_idle_buffers(proactor, now);
+        }
     }
     
     return NULL;
 }
 
+// 设置绑核
+int proactor_set_affinity(proactor_t *proactor, const int *cpus, int count) {
+    if (count < 0 || count > AFFINITY_MAX_CPUS || (count > 0 && !cpus)) {
+        return -1;
+    }
+    memcpy(proactor->cpus, cpus, count * sizeof(int));
+    proactor->cpu_count = count;
+    return 0;
+}
+
+// 第index个线程（0为分发线程）的CPU，未绑核返回-1
+static int proactor_thread_cpu(proactor_t *proactor, int index) {
+    return proactor->cpu_count > 0 ? proactor->cpus[index % proactor->cpu_count] : -1;
+}
+
+// 按线程属性绑核后创建线程，绑核失败时不绑定继续运行
+static int proactor_create_thread(proactor_t *proactor, pthread_t *thread, int index,
+                                  void *(*func)(void *)) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    int cpu = proactor_thread_cpu(proactor, index);
+    if (affinity_attr_set_cpu(&attr, cpu) != 0) {
+        printf("WARNING: failed to pin thread %d to CPU %d\n", index, cpu);
+    }
+    int ret = pthread_create(thread, &attr, func, proactor);
+    pthread_attr_destroy(&attr);
+    return ret;
+}
+
 // 启动Proactor
 int proactor_start(proactor_t *proactor) {
     // 启动工作者线程
     for (int i = 0; i < proactor->thread_count; i++) {
-        if (pthread_create(&proactor->worker_threads[i], NULL, 
-                          worker_thread_func, proactor) != 0) {
+        if (proactor_create_thread(proactor, &proactor->worker_threads[i], i + 1,
+                                   worker_thread_func) != 0) {
             perror("pthread_create worker failed");
             return -1;
         }
     }
     
     // 启动分发线程
-    if (pthread_create(&proactor->dispatcher_thread, NULL, 
-                      dispatcher_thread_func, proactor) != 0) {
+    if (proactor_create_thread(proactor, &proactor->dispatcher_thread, 0,
+                               dispatcher_thread_func) != 0) {
         perror("pthread_create dispatcher failed");
         return -1;
     }
     
+    affinity_report_irqs(proactor->cpus, proactor->cpu_count);
     printf("Proactor started\n");
     return 0;
 }
@@ -388,10 +485,10 @@ static void cleanup_proactor_resources(proactor_t *proactor) {
         for (int i = 0; i < proactor->max_connections; i++) {
             if (proactor->connections[i]) {
                 close(i);
-                if (proactor->connections[i]->handler) {
-                    free(proactor->connections[i]->handler);
+                if (proactor->connections[i]->buf) {
+                    slab_free(proactor->connections[i]->buf);
                 }
-                free(proactor->connections[i]);
+                slab_free(proactor->connections[i]);
                 proactor->connections[i] = NULL;
             }
         }
@@ -399,6 +496,17 @@ static void cleanup_proactor_resources(proactor_t *proactor) {
         proactor->connections = NULL;
     }
     
+    slab_stats_t slab;
+    slab_cache_stats(&proactor->conn_slab, &slab);
+    printf("conn_slab: hits=%llu, misses=%llu, in_use=%llu, high_water=%llu, remote_frees=%llu\n",
+           slab.hits, slab.misses, slab.in_use, slab.high_water, slab.remote_frees);
+    slab_cache_destroy(&proactor->conn_slab);
+    
+    slab_cache_stats(&proactor->buf_slab, &slab);
+    printf("buf_slab: attaches=%lu, releases=%lu, in_use=%llu, high_water=%llu\n",
+           proactor->buf_attaches, proactor->buf_releases, slab.in_use, slab.high_water);
+    slab_cache_destroy(&proactor->buf_slab);
+    
     // 清理线程数组
     if (proactor->worker_threads) {
         free(proactor->worker_threads);
@@ -508,26 +616,26 @@ int proactor_submit_operation(proactor_t *proactor, async_operation_t *op) {
 // 添加连接（只在proactor.c中定义）
 int proactor_add_connection(proactor_t *proactor, int fd, struct sockaddr_in *addr) {
     if (fd < 0 || fd >= proactor->max_connections) {
-        fprintf(stderr, "Invalid file descriptor: %d\n", fd);
+        LOG_ERROR("Invalid file descriptor: %d", fd);
         return -1;
     }
     
     if (proactor->connections[fd] != NULL) {
-        fprintf(stderr, "Connection already exists for fd: %d\n", fd);
+        LOG_ERROR("Connection already exists for fd: %d", fd);
         return -1;
     }
     
-    connection_ctx_t *ctx = malloc(sizeof(connection_ctx_t));
+    connection_ctx_t *ctx = slab_alloc(&proactor->conn_slab);
     if (!ctx) {
-        fprintf(stderr, "Failed to allocate connection context\n");
+        LOG_ERROR("Failed to allocate connection context");
         return -1;
     }
     
+    // 地址只在accept时记日志，不保存在常驻的上下文中
+    (void)addr;
     memset(ctx, 0, sizeof(connection_ctx_t));
     ctx->fd = fd;
-    if (addr) {
-        ctx->client_addr = *addr;
-    }
+    ctx->last_active = time(NULL);
     ctx->proactor = proactor;
     
     proactor->connections[fd] = ctx;
@@ -538,17 +646,17 @@ int proactor_add_connection(proactor_t *proactor, int fd, struct sockaddr_in *ad
 // 移除连接
 void proactor_remove_connection(proactor_t *proactor, int fd) {
     if (fd < 0 || fd >= proactor->max_connections) {
-        printf("Invalid fd in remove_connection: %d\n", fd);
+        LOG_DEBUG("Invalid fd in remove_connection: %d", fd);
         return;
     }
     
     connection_ctx_t *ctx = proactor->connections[fd];
     if (!ctx) {
-        printf("Connection already removed for fd=%d\n", fd);
+        LOG_DEBUG("Connection already removed for fd=%d", fd);
         return;
     }
     
-    printf("Removing connection fd=%d\n", fd);
+    LOG_DEBUG("Removing connection fd=%d", fd);
     
     // 先从epoll中移除
     if (proactor->epoll_fd >= 0) {
@@ -558,15 +666,26 @@ void proactor_remove_connection(proactor_t *proactor, int fd) {
     // 关闭文件描述符
     close(fd);
     
-    // 清理handler
-    if (ctx->handler) {
-        free(ctx->handler);
-        ctx->handler = NULL;
-    }
-    
     // 从连接数组中移除
     proactor->connections[fd] = NULL;
     
-    // 最后释放上下文
-    free(ctx);
+    // 最后释放缓冲和上下文
+    if (ctx->buf) {
+        slab_free(ctx->buf);
+    }
+    slab_free(ctx);
+}
+
+// 挂上连接缓冲
+int proactor_attach_buffer(proactor_t *proactor, connection_ctx_t *ctx) {
+    if (ctx->buf) {
+        return 0;
+    }
+    ctx->buf = slab_alloc(&proactor->buf_slab);
+    if (!ctx->buf) {
+        LOG_ERROR("Failed to allocate buffer for fd=%d", ctx->fd);
+        return -1;
+    }
+    proactor->buf_attaches++;
+    return 0;
 }
\ No newline at end of file
@@ -9,12 +9,17 @@
 #include <netinet/in.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <time.h>
+
+#include "slab.h"
+#include "affinity.h"
 
 // 异步操作类型
 typedef enum {
     OP_ACCEPT,
     OP_READ,
     OP_WRITE,
+    OP_POLL,     // 等待可读（IOCB_CMD_POLL），不占用缓冲，空闲连接在途的只有它
     OP_CLOSE
 } operation_type_t;
 
@@ -24,6 +29,7 @@ struct completion_handler {
     void (*handle_read)(completion_handler_t *handler, int fd, void *data, ssize_t bytes);
     void (*handle_write)(completion_handler_t *handler, int fd, void *data, ssize_t bytes);
     void (*handle_error)(completion_handler_t *handler, int fd, void *data, int error);
+    void (*handle_poll)(completion_handler_t *handler, int fd, void *data, int revents);
     void *user_data;
 };
 
@@ -33,6 +39,7 @@ struct async_operation {
     operation_type_t type;
     int fd;
     completion_handler_t *handler;
+    void *data;          // 提交时的连接上下文，完成时原样传给handler；与连接表不一致说明fd已被复用
     void *buffer;
     size_t size;
     off_t offset;
@@ -40,14 +47,24 @@ struct async_operation {
     async_operation_t *next;
 };
 
-// 连接上下文
+#define CONN_BUFFER_SIZE 4096
+#define CONN_BUF_IDLE_SECONDS 2    // 等待可读超过该时间的连接归还缓冲（按秒检查，实际持有2~3秒）
+
+// 连接缓冲：只在有数据在途（读、回显、写）时挂在连接上，读和回显共用
+typedef struct conn_buf {
+    char data[CONN_BUFFER_SIZE];
+} conn_buf_t;
+
+// 连接上下文：常驻部分只有这个头部，空闲连接不持有缓冲
 typedef struct connection_context {
     int fd;
-    struct sockaddr_in client_addr;
-    char read_buf[4096];
-    char write_buf[4096];
-    // size_t write_len;
-    completion_handler_t *handler;
+    // 一条回显分多次写完时的进度；写完之前不提交读，发送缓冲就是这条连接的高水位
+    uint32_t write_len;
+    uint32_t write_off;
+    int polling;                    // 在途的是OP_POLL，缓冲没有被任何操作引用
+    time_t last_active;             // 最近一次读到数据的时间
+    conn_buf_t *buf;                // 按需挂上，空闲超过CONN_BUF_IDLE_SECONDS后由分发线程归还
+    completion_handler_t *handler;  // 所有连接共用同一个处理器
     void *proactor;
 } connection_ctx_t;
 
@@ -72,16 +89,29 @@ typedef struct proactor {
     // 连接管理
     connection_ctx_t **connections;
     int max_connections;
+    slab_cache_t conn_slab;   // 连接上下文对象池，由分发线程分配
+    slab_cache_t buf_slab;    // 连接缓冲对象池，挂上和归还都在分发线程
+    time_t last_sweep;        // 上次检查空闲缓冲的时间
+    unsigned long buf_attaches;
+    unsigned long buf_releases;
+    
+    // 绑核：分发线程用cpus[0]，工作者线程依次用后面的CPU（循环使用），cpu_count为0表示不绑定
+    int cpus[AFFINITY_MAX_CPUS];
+    int cpu_count;
     
 } proactor_t;
 
 // 函数声明 - 只在proactor.c中实现
 int proactor_init(proactor_t *proactor, int thread_count, int max_conn);
 int proactor_start(proactor_t *proactor);
+// 设置绑核，只能在proactor_start之前调用；分发线程启动后把连接表迁到自己的NUMA节点
+int proactor_set_affinity(proactor_t *proactor, const int *cpus, int count);
 int proactor_stop(proactor_t *proactor);
 int proactor_submit_operation(proactor_t *proactor, async_operation_t *op);
 int proactor_add_connection(proactor_t *proactor, int fd, struct sockaddr_in *addr);
 void proactor_remove_connection(proactor_t *proactor, int fd);
+// 给连接挂上缓冲（已有则直接返回），只能在分发线程（完成处理器）中调用；失败返回-1
+int proactor_attach_buffer(proactor_t *proactor, connection_ctx_t *ctx);
 
 // 服务器特定函数声明 - 在async_server_proactor.c中实现
 int create_server_socket(int port);
@@ -3,11 +3,18 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
 
 #include "hybrid_proactor.h"
+#include "handoff.h"
+#include "log.h"
+
+#define UPGRADE_DRAIN_SECONDS 30   // 热升级后旧进程等待剩余连接关闭的上限
 
 mt_proactor_t g_proactor;
 extern sig_atomic_t graceful_shutdown;
+static int g_upgrade_fd = -1;   // 等待新进程连接的控制socket
 
 void signal_handler(int sig) {
     if (graceful_shutdown) {
@@ -26,16 +33,79 @@ void signal_handler(int sig) {
     }
 }
 
+// 热升级控制线程：交出监听socket，等剩余连接关闭后按信号退出的路径停止服务
+void *upgrade_thread_func(void *arg) {
+    (void)arg;
+    
+    while (g_proactor.running && !graceful_shutdown) {
+        int sock = accept(g_upgrade_fd, NULL, NULL);
+        if (sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;   // 退出时shutdown控制socket
+        }
+        
+        handoff_msg_t msg;
+        if (handoff_recv(sock, &msg, NULL, 0) != 0 || msg.type != HANDOFF_REQUEST ||
+            mt_proactor_upgrade_send(&g_proactor, sock) != 0) {
+            close(sock);
+            continue;
+        }
+        close(sock);
+        
+        for (int i = 0; i < UPGRADE_DRAIN_SECONDS * 10 && !graceful_shutdown; i++) {
+            if (atomic_load(&g_proactor.connection_count) == 0) break;
+            usleep(100000);
+        }
+        printf("Upgrade complete, %d connections left\n", atomic_load(&g_proactor.connection_count));
+        
+        graceful_shutdown = 1;
+        g_proactor.running = 0;
+        uint64_t value = 1;
+        if (write(g_proactor.exit_event_fd, &value, sizeof(value)) < 0) {
+            perror("write exit_event_fd");
+        }
+        break;
+    }
+    return NULL;
+}
+
 int main(int argc, char *argv[]) {
     int num_workers = 4;
     int port = DEFAULT_PORT;
+    const char *upgrade_sock = NULL;
+    const char *upgrade_from = NULL;
+    
+    // 热升级选项可出现在任意位置，其余为位置参数
+    char *args[4] = { argv[0] };
+    int nargs = 1;
+    int log_level = LOG_LEVEL_INFO;   // 运行期日志级别，--log-level修改
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--upgrade-sock") == 0 && i + 1 < argc) {
+            upgrade_sock = argv[++i];
+        } else if (strcmp(argv[i], "--upgrade-from") == 0 && i + 1 < argc) {
+            upgrade_from = argv[++i];
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            log_level = log_parse_level(argv[++i]);
+        } else if (nargs < 4 && strncmp(argv[i], "--", 2) != 0) {
+            args[nargs++] = argv[i];
+        } else {
+            log_level = -1;
+        }
+        if (log_level < 0) {
+            fprintf(stderr, "Usage: %s [workers] [port] [cpus] [--upgrade-sock PATH] [--upgrade-from PATH] "
+                    "[--log-level trace|debug|info|warn|error|off]\n", argv[0]);
+            return 1;
+        }
+    }
+    argc = nargs;
+    argv = args;
     
     // 解析命令行参数
     if (argc > 1) {
         num_workers = atoi(argv[1]);
         if (num_workers <= 0 || num_workers > MAX_WORKER_THREADS) {
             fprintf(stderr, "Invalid number of workers: %d\n", num_workers);
-            fprintf(stderr, "Usage: %s [workers=%d] [port=%d]\n", argv[0], num_workers, port);
+            fprintf(stderr, "Usage: %s [workers=%d] [port=%d] [cpus]\n", argv[0], num_workers, port);
             return 1;
         }
     }
@@ -48,6 +118,20 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    // 第三个参数为CPU列表（如0-3），工作线程和accept线程依次绑定
+    static int cpus[AFFINITY_MAX_CPUS];
+    int cpu_count = 0;
+    if (argc > 3) {
+        cpu_count = affinity_parse_cpus(argv[3], cpus, AFFINITY_MAX_CPUS);
+        if (cpu_count <= 0) {
+            fprintf(stderr, "Invalid CPU list: %s\n", argv[3]);
+            return 1;
+        }
+    }
+    
+    // 日志由后台线程批量写出
+    log_init(STDOUT_FILENO, log_level);
+    
     printf("Starting multi-threaded hybrid proactor server\n");
     printf("Workers: %d, Port: %d\n", num_workers, port);
     
@@ -61,9 +145,22 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Proactor initialization failed\n");
         return 1;
     }
+    mt_proactor_set_affinity(&g_proactor, cpus, cpu_count);
     
-    // 创建服务器socket
-    g_proactor.listen_fd = create_server_socket(port);
+    // 创建服务器socket；热升级时接管旧进程的监听socket，监听队列中的连接不会丢失
+    if (upgrade_from) {
+        int sock = handoff_connect(upgrade_from);
+        handoff_msg_t req = { .type = HANDOFF_REQUEST };
+        if (sock < 0 || handoff_send(sock, &req, NULL, 0, NULL) != 0) {
+            fprintf(stderr, "Failed to reach the old process at %s: %s\n", upgrade_from, strerror(errno));
+            g_proactor.listen_fd = -1;
+        } else {
+            g_proactor.listen_fd = mt_proactor_upgrade_recv(sock);
+        }
+        if (sock >= 0) close(sock);
+    } else {
+        g_proactor.listen_fd = create_server_socket(port);
+    }
     if (g_proactor.listen_fd < 0) {
         fprintf(stderr, "Server socket creation failed\n");
         mt_proactor_stop(&g_proactor);
@@ -81,6 +178,17 @@ int main(int argc, char *argv[]) {
     printf("Multi-threaded server running on port %d\n", port);
     printf("Press Ctrl+C to stop the server\n");
     
+    pthread_t upgrade_thread = 0;
+    if (upgrade_sock) {
+        g_upgrade_fd = handoff_listen(upgrade_sock);
+        if (g_upgrade_fd < 0 || pthread_create(&upgrade_thread, NULL, upgrade_thread_func, NULL) != 0) {
+            fprintf(stderr, "Failed to listen for upgrades on %s: %s\n", upgrade_sock, strerror(errno));
+            upgrade_thread = 0;
+        } else {
+            printf("Waiting for upgrade requests on %s\n", upgrade_sock);
+        }
+    }
+    
     // 等待所有线程结束
     pthread_join(g_proactor.accept_thread, NULL);
     
@@ -90,8 +198,15 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    if (upgrade_thread) {
+        shutdown(g_upgrade_fd, SHUT_RDWR);
+        pthread_join(upgrade_thread, NULL);
+    }
+    if (g_upgrade_fd >= 0) close(g_upgrade_fd);
+    
     // 清理资源
     mt_proactor_stop(&g_proactor);
+    log_shutdown();
     
     printf("Server shutdown complete\n");
     return 0;
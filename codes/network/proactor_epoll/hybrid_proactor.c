@@ -15,11 +15,17 @@
 #include <signal.h>
 
 #include "hybrid_proactor.h"
+#include "handoff.h"
+#include "log.h"
 
 // 全局变量，用于优雅关闭
 volatile sig_atomic_t graceful_shutdown = 0;
 
+#define ECHO_PREFIX "Echo: "
+#define ECHO_PREFIX_LEN (sizeof(ECHO_PREFIX) - 1)
+
 void mt_send_welcome_message(worker_context_t *worker, mt_connection_t *conn);
+static void mt_flush_dirty(worker_context_t *worker);
 
 // // 信号处理
 // void signal_handler(int sig) {
@@ -80,6 +86,55 @@ int create_server_socket(int port) {
     return fd;
 }
 
+// 消息格式与reactor一致：监听socket作为应用的监听（arg[2]）发送，不交接连接
+int mt_proactor_upgrade_send(mt_proactor_t *proactor, int sock) {
+    handoff_msg_t msg = { .type = HANDOFF_LISTENERS, .arg = { 0, 0, 1 } };
+    if (handoff_send(sock, &msg, &proactor->listen_fd, 1, NULL) != 0) {
+        perror("handoff_send listeners");
+        return -1;
+    }
+    
+    // 新连接由新进程accept；listen_fd在mt_proactor_stop中关闭
+    proactor->accepting = 0;
+    
+    handoff_msg_t done = { .type = HANDOFF_DONE };
+    if (handoff_send(sock, &done, NULL, 0, NULL) != 0) {
+        perror("handoff_send done");
+        return -1;
+    }
+    printf("Upgrade: handed the listening socket to the new process, %d connections stay until closed\n",
+           atomic_load(&proactor->connection_count));
+    return 0;
+}
+
+int mt_proactor_upgrade_recv(int sock) {
+    int fds[HANDOFF_MAX_FDS];
+    handoff_msg_t msg;
+    if (handoff_recv(sock, &msg, fds, HANDOFF_MAX_FDS) != 0 || msg.type != HANDOFF_LISTENERS) {
+        fprintf(stderr, "Failed to receive listening socket from the old process\n");
+        return -1;
+    }
+    
+    // 只需要一个监听socket：取应用的监听，没有时取第一个，其余关闭
+    int index = msg.arg[2] > 0 && msg.arg[0] + msg.arg[1] < msg.nfds ? (int)(msg.arg[0] + msg.arg[1]) : 0;
+    int listen_fd = msg.nfds > 0 ? fds[index] : -1;
+    for (int i = 0; i < msg.nfds; i++) {
+        if (i != index) close(fds[i]);
+    }
+    
+    // 请求中没有HANDOFF_WANT_CONNECTIONS，旧进程随后只发送DONE
+    if (handoff_recv(sock, &msg, NULL, 0) != 0 || msg.type != HANDOFF_DONE) {
+        fprintf(stderr, "Unexpected handoff message from the old process\n");
+    }
+    
+    if (listen_fd < 0 || set_nonblock(listen_fd) < 0) {
+        if (listen_fd >= 0) close(listen_fd);
+        return -1;
+    }
+    printf("Upgrade: took over the listening socket from the old process\n");
+    return listen_fd;
+}
+
 // 初始化多线程Proactor
 int mt_proactor_init(mt_proactor_t *proactor, int num_workers) {
     if (num_workers <= 0 || num_workers > MAX_WORKER_THREADS) {
@@ -90,7 +145,9 @@ int mt_proactor_init(mt_proactor_t *proactor, int num_workers) {
     memset(proactor, 0, sizeof(mt_proactor_t));
     proactor->num_workers = num_workers;
     proactor->running = 1;
+    proactor->accepting = 1;
     proactor->next_worker = 0;
+    atomic_init(&proactor->connection_count, 0);
     
     // 创建工作线程数组
     proactor->workers = calloc(num_workers, sizeof(worker_context_t));
@@ -99,6 +156,15 @@ int mt_proactor_init(mt_proactor_t *proactor, int num_workers) {
         return -1;
     }
     
+    // 连接对象池：由accept线程分配，工作线程通过无锁远程释放归还
+    for (int i = 0; i < num_workers; i++) {
+        slab_cache_init(&proactor->workers[i].conn_slab, "mt_connection", sizeof(mt_connection_t), 64);
+        slab_cache_init(&proactor->workers[i].buf_slab, "mt_conn_buf", sizeof(mt_conn_buf_t), 16);
+        slab_cache_init(&proactor->workers[i].aio_slab, "mt_aio_read", sizeof(mt_aio_read_t), 16);
+        proactor->workers[i].cpu = -1;
+        proactor->workers[i].numa_node = -1;
+    }
+    
     // 初始化同步原语
     pthread_mutex_init(&proactor->accept_lock, NULL);
     pthread_cond_init(&proactor->accept_cond, NULL);
@@ -115,6 +181,36 @@ int mt_proactor_init(mt_proactor_t *proactor, int num_workers) {
     return 0;
 }
 
+// 设置绑核
+int mt_proactor_set_affinity(mt_proactor_t *proactor, const int *cpus, int count) {
+    if (count < 0 || count > AFFINITY_MAX_CPUS || (count > 0 && !cpus)) {
+        return -1;
+    }
+    memcpy(proactor->cpus, cpus, count * sizeof(int));
+    proactor->cpu_count = count;
+    
+    for (int i = 0; i < proactor->num_workers; i++) {
+        worker_context_t *worker = &proactor->workers[i];
+        worker->cpu = count > 0 ? cpus[i % count] : -1;
+        worker->numa_node = worker->cpu >= 0 ? affinity_cpu_node(worker->cpu) : -1;
+        // 连接缓冲由工作线程读写，多节点时放到工作线程所在节点，而不是分配它的accept线程所在节点
+        slab_cache_set_node(&worker->conn_slab, affinity_node_count() > 1 ? worker->numa_node : -1);
+    }
+    return 0;
+}
+
+// 按线程属性绑核后创建线程，绑核失败时不绑定继续运行
+static int mt_create_thread(pthread_t *thread, int cpu, void *(*func)(void *), void *arg) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (affinity_attr_set_cpu(&attr, cpu) != 0) {
+        printf("WARNING: failed to pin thread to CPU %d\n", cpu);
+    }
+    int ret = pthread_create(thread, &attr, func, arg);
+    pthread_attr_destroy(&attr);
+    return ret;
+}
+
 // 启动工作线程
 int mt_proactor_start(mt_proactor_t *proactor) {
     // 初始化工作线程
@@ -143,22 +239,29 @@ int mt_proactor_start(mt_proactor_t *proactor) {
         pthread_mutex_init(&worker->conn_list_lock, NULL);
         
         // 启动工作线程
-        if (pthread_create(&worker->thread, NULL, worker_thread_func, worker) != 0) {
+        if (mt_create_thread(&worker->thread, worker->cpu, worker_thread_func, worker) != 0) {
             perror("pthread_create worker failed");
             close(worker->epoll_fd);
             io_destroy(worker->aio_ctx);
             goto cleanup;
         }
         
-        printf("Worker thread %d started\n", i);
+        if (worker->cpu >= 0) {
+            printf("Worker thread %d started on CPU %d, NUMA node %d\n", i, worker->cpu, worker->numa_node);
+        } else {
+            printf("Worker thread %d started\n", i);
+        }
     }
     
     // 启动接受连接线程
-    if (pthread_create(&proactor->accept_thread, NULL, accept_thread_func, proactor) != 0) {
+    int accept_cpu = proactor->cpu_count > 0 ? proactor->cpus[proactor->num_workers % proactor->cpu_count] : -1;
+    if (mt_create_thread(&proactor->accept_thread, accept_cpu, accept_thread_func, proactor) != 0) {
         perror("pthread_create accept thread failed");
         goto cleanup;
     }
     
+    affinity_report_irqs(proactor->cpus, proactor->cpu_count);
+    
     printf("All threads started successfully\n");
     return 0;
 
@@ -231,7 +334,10 @@ int mt_proactor_stop(mt_proactor_t *proactor) {
             if (conn->fd >= 0) {
                 close(conn->fd);
             }
-            free(conn);
+            if (conn->buf) {
+                slab_free(conn->buf);
+            }
+            slab_free(conn);
             conn = next;
         }
         worker->connections = NULL;
@@ -251,7 +357,23 @@ int mt_proactor_stop(mt_proactor_t *proactor) {
         proactor->listen_fd = -1;
     }
     
+    // 连接都已释放，最后销毁各工作线程的对象池
     if (proactor->workers) {
+        for (int i = 0; i < proactor->num_workers; i++) {
+            slab_stats_t slab;
+            slab_cache_stats(&proactor->workers[i].conn_slab, &slab);
+            printf("Worker %d conn_slab: hits=%llu, misses=%llu, in_use=%llu, high_water=%llu, remote_frees=%llu\n",
+                   i, slab.hits, slab.misses, slab.in_use, slab.high_water, slab.remote_frees);
+            slab_cache_destroy(&proactor->workers[i].conn_slab);
+            
+            slab_cache_stats(&proactor->workers[i].buf_slab, &slab);
+            printf("Worker %d buf_slab: attaches=%lu, releases=%lu, in_use=%llu, high_water=%llu\n",
+                   i, proactor->workers[i].buf_attaches, proactor->workers[i].buf_releases,
+                   slab.in_use, slab.high_water);
+            slab_cache_destroy(&proactor->workers[i].buf_slab);
+            // 停止时丢弃的AIO完成事件没有归还读缓冲，随对象池一起释放
+            slab_cache_destroy(&proactor->workers[i].aio_slab);
+        }
         free(proactor->workers);
         proactor->workers = NULL;
     }
@@ -267,14 +389,15 @@ int mt_proactor_stop(mt_proactor_t *proactor) {
 void *accept_thread_func(void *arg) {
     mt_proactor_t *proactor = (mt_proactor_t *)arg;
     
-    printf("Accept thread started\n");
+    LOG_DEBUG("Accept thread started");
     
-    while (proactor->running && !graceful_shutdown) {
+    while (proactor->running && proactor->accepting && !graceful_shutdown) {
         struct sockaddr_in client_addr;
         socklen_t addr_len = sizeof(client_addr);
         
         int client_fd = accept(proactor->listen_fd, 
                               (struct sockaddr*)&client_addr, &addr_len);
+        log_tick();
         
         if (client_fd < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -299,7 +422,7 @@ void *accept_thread_func(void *arg) {
             continue;
         }
         
-        printf("New connection from %s:%d, fd=%d\n", 
+        LOG_DEBUG("New connection from %s:%d, fd=%d", 
                inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port), client_fd);
         
         // 选择工作线程（轮询策略）
@@ -309,37 +432,37 @@ void *accept_thread_func(void *arg) {
         worker_context_t *worker = &proactor->workers[worker_id];
         
         // 创建工作线程的连接
-        mt_connection_t *conn = mt_create_connection(client_fd, &client_addr, worker_id);
+        mt_connection_t *conn = mt_create_connection(proactor, client_fd, &client_addr, worker_id);
         if (!conn) {
             close(client_fd);
             continue;
         }
         
+        // 欢迎消息由工作线程发送：连接缓冲归工作线程所有，加入epoll后连接也只由它访问
+        conn->welcome = 1;
+        
         // 添加到工作线程
         mt_add_connection_to_worker(worker, conn);
         
         proactor->total_connections++;
-        
-        // 发送欢迎消息
-        mt_send_welcome_message(worker, conn);
     }
     
-    printf("Accept thread exiting\n");
+    LOG_DEBUG("Accept thread exiting");
     return NULL;
 }
 
 // 创建工作线程连接
-mt_connection_t *mt_create_connection(int fd, struct sockaddr_in *addr, int worker_id) {
-    mt_connection_t *conn = malloc(sizeof(mt_connection_t));
+mt_connection_t *mt_create_connection(mt_proactor_t *proactor, int fd, struct sockaddr_in *addr, int worker_id) {
+    // 在accept线程中调用，各工作线程的slab都归accept线程所有
+    mt_connection_t *conn = slab_alloc(&proactor->workers[worker_id].conn_slab);
     if (!conn) {
         return NULL;
     }
     
+    // 地址只在accept时记日志，不保存在常驻的连接结构中
+    (void)addr;
     memset(conn, 0, sizeof(mt_connection_t));
     conn->fd = fd;
-    if (addr) {
-        conn->client_addr = *addr;
-    }
     conn->worker_id = worker_id;
     conn->readable = 1;
     conn->writable = 1;
@@ -348,14 +471,14 @@ mt_connection_t *mt_create_connection(int fd, struct sockaddr_in *addr, int work
     
     // 初始化线程安全字段
     atomic_init(&conn->is_removing, 0);
-    atomic_init(&conn->ref_count, 1);
-    pthread_mutex_init(&conn->lock, NULL);
     
     return conn;
 }
 
 // 添加连接到工作线程
 void mt_add_connection_to_worker(worker_context_t *worker, mt_connection_t *conn) {
+    // 失败时由mt_remove_connection_safe减回
+    atomic_fetch_add(&worker->proactor->connection_count, 1);
     pthread_mutex_lock(&worker->conn_list_lock);
     
     // 添加到连接列表头部
@@ -378,18 +501,59 @@ void mt_add_connection_to_worker(worker_context_t *worker, mt_connection_t *conn
     
     pthread_mutex_unlock(&worker->conn_list_lock);
     
-    printf("Connection fd=%d added to worker %d\n", conn->fd, worker->id);
+    LOG_DEBUG("Connection fd=%d added to worker %d", conn->fd, worker->id);
+}
+
+// 挂上连接缓冲（已有则直接返回），只在工作线程中调用；失败返回-1
+static int mt_attach_buffer(worker_context_t *worker, mt_connection_t *conn) {
+    if (conn->buf) return 0;
+    conn->buf = slab_alloc(&worker->buf_slab);
+    if (!conn->buf) {
+        LOG_ERROR("Worker %d: failed to allocate buffer for fd=%d", worker->id, conn->fd);
+        return -1;
+    }
+    worker->buf_attaches++;
+    return 0;
+}
+
+// 归还空闲连接的缓冲：没有待发送数据、且空闲超过BUF_IDLE_SECONDS，下次有数据时再挂上
+static void mt_release_idle_buffers(worker_context_t *worker, time_t now) {
+    pthread_mutex_lock(&worker->conn_list_lock);
+    for (mt_connection_t *conn = worker->connections; conn; conn = conn->next) {
+        if (conn->buf && conn->write_pending == 0 && !conn->dirty &&
+            now - conn->last_activity >= BUF_IDLE_SECONDS) {
+            slab_free(conn->buf);
+            conn->buf = NULL;
+            worker->buf_releases++;
+        }
+    }
+    pthread_mutex_unlock(&worker->conn_list_lock);
 }
 
-// 发送欢迎消息
+// 发送欢迎消息（工作线程收到连接的第一个事件时调用）
 void mt_send_welcome_message(worker_context_t *worker, mt_connection_t *conn) {
     const char *welcome = "Welcome to Multi-threaded Hybrid Proactor Server!\r\n"
                          "Type something and press enter to echo.\r\n";
     size_t welcome_len = strlen(welcome);
     
-    if (welcome_len < BUFFER_SIZE) {
-        memcpy(conn->write_buf, welcome, welcome_len);
-        conn->write_pending = welcome_len;
+    // 新连接的发送缓冲是空的，通常一次就能写完，不必为它挂上连接缓冲（否则建连高峰时每个连接都占一块）
+    size_t sent = 0;
+    if (conn->write_pending == 0) {
+        ssize_t n = write(conn->fd, welcome, welcome_len);
+        if (n > 0) {
+            sent = (size_t)n;
+        } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            // 连接已出错，留给随后的读写处理关闭
+            return;
+        }
+    }
+    if (sent == welcome_len) return;
+    
+    // 没写完的部分放进write_buf
+    size_t left = welcome_len - sent;
+    if (conn->write_pending + left <= BUFFER_SIZE && mt_attach_buffer(worker, conn) == 0) {
+        memcpy(conn->buf->write_buf + conn->write_pending, welcome + sent, left);
+        conn->write_pending += left;
         
         // 尝试立即发送
         mt_try_write(worker, conn);
@@ -400,7 +564,7 @@ void *worker_thread_func(void *arg) {
     worker_context_t *worker = (worker_context_t *)arg;
     mt_proactor_t *proactor = worker->proactor;
     
-    printf("Worker thread %d starting\n", worker->id);
+    LOG_DEBUG("Worker thread %d starting", worker->id);
     
     struct epoll_event events[MAX_EVENTS];
     struct io_event aio_events[MAX_EVENTS];
@@ -420,6 +584,7 @@ void *worker_thread_func(void *arg) {
     while (worker->running && !graceful_shutdown) {
         // 处理epoll事件
         int nfds = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, 10);
+        log_tick();
         
         if (nfds < 0) {
             if (errno == EINTR) {
@@ -455,7 +620,7 @@ void *worker_thread_func(void *arg) {
                 if (!worker->running || graceful_shutdown) break;
                 continue;
             } else if (errno == EINVAL) {
-                printf("Worker %d: AIO context invalid\n", worker->id);
+                LOG_DEBUG("Worker %d: AIO context invalid", worker->id);
                 break;
             } else {
                 perror("io_getevents failed");
@@ -468,17 +633,28 @@ void *worker_thread_func(void *arg) {
             mt_handle_aio_completion(worker, &aio_events[i]);
         }
         
+        // 同步读和AIO读完成产生的回显在这里一起发出
+        mt_flush_dirty(worker);
+        
         if (!worker->running || graceful_shutdown) {
             break;
         }
         
+        // 每秒检查一次空闲连接的缓冲
+        time_t now = time(NULL);
+        if (now != worker->last_sweep) {
+            worker->last_sweep = now;
+            mt_release_idle_buffers(worker, now);
+        }
+        
         // 性能监控（每5秒一次）
         static time_t last_report = 0;
-        time_t now = time(NULL);
         if (now - last_report >= 5) {
-            printf("Worker %d: total_ops=%lu, eagain=%lu, success=%lu\n",
+            LOG_DEBUG("Worker %d: total_ops=%lu, eagain=%lu, success=%lu, backpressure=%lu, flushes=%lu, coalesced=%lu, "
+                   "buf_attaches=%lu, buf_releases=%lu",
                    worker->id, worker->total_operations, 
-                   worker->eagain_errors, worker->successful_ops);
+                   worker->eagain_errors, worker->successful_ops, worker->backpressure_pauses,
+                   worker->flushes, worker->coalesced, worker->buf_attaches, worker->buf_releases);
             last_report = now;
         }
         
@@ -488,18 +664,24 @@ void *worker_thread_func(void *arg) {
         }
     }
     
-    printf("Worker thread %d exiting\n", worker->id);
+    LOG_DEBUG("Worker thread %d exiting", worker->id);
     return NULL;
 }
 
 // 处理连接事件
 void mt_handle_connection_event(worker_context_t *worker, mt_connection_t *conn, uint32_t events) {
     if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
-        printf("Worker %d: Connection error on fd=%d\n", worker->id, conn->fd);
+        LOG_DEBUG("Worker %d: Connection error on fd=%d", worker->id, conn->fd);
         mt_remove_connection_safe(worker, conn);
         return;
     }
     
+    // 加入epoll时注册了EPOLLOUT，第一个事件总是在连接建立后立即到达
+    if (conn->welcome) {
+        conn->welcome = 0;
+        mt_send_welcome_message(worker, conn);
+    }
+    
     if (events & EPOLLIN) {
         conn->readable = 1;
         mt_try_read(worker, conn);
@@ -511,25 +693,44 @@ void mt_handle_connection_event(worker_context_t *worker, mt_connection_t *conn,
     }
 }
 
+// 一次最多读取的字节数：回显（加前缀）后必须放得进发送缓冲
+static size_t mt_read_limit(const mt_connection_t *conn) {
+    size_t space = BUFFER_SIZE - conn->write_pending;
+    size_t limit = space > ECHO_PREFIX_LEN ? space - ECHO_PREFIX_LEN : 0;
+    return limit < BUFFER_SIZE - 1 ? limit : BUFFER_SIZE - 1;
+}
+
+// 恢复读取：边缘触发下暂停期间到达的数据不会再产生事件，重新MOD让epoll按当前状态上报
+static void mt_resume_read(worker_context_t *worker, mt_connection_t *conn) {
+    conn->state = CONN_ACTIVE;
+    
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+    ev.data.ptr = conn;
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+    LOG_DEBUG("Worker %d: write backlog of fd=%d below low watermark, resuming reads", worker->id, conn->fd);
+}
+
 // 尝试读取
 void mt_try_read(worker_context_t *worker, mt_connection_t *conn) {
-    if (!conn->readable) return;
+    if (!conn->readable || conn->state == CONN_SUSPENDED) return;
     
-    ssize_t n = read(conn->fd, conn->read_buf, BUFFER_SIZE - 1);
+    // 读到线程共用的临时缓冲，mt_process_data立即把它追加到连接的write_buf
+    ssize_t n = read(conn->fd, worker->read_scratch, mt_read_limit(conn));
     
     if (n > 0) {
         // 同步读取成功
-        conn->read_buf[n] = '\0';
-        printf("Worker %d: Sync read %zd bytes from fd=%d\n", worker->id, n, conn->fd);
+        worker->read_scratch[n] = '\0';
+        LOG_DEBUG("Worker %d: Sync read %zd bytes from fd=%d", worker->id, n, conn->fd);
         
-        mt_process_data(worker, conn, conn->read_buf, n);
+        mt_process_data(worker, conn, worker->read_scratch, n);
         worker->successful_ops++;
         worker->total_operations++;
         conn->last_activity = time(NULL);
         
     } else if (n == 0) {
         // 连接关闭
-        printf("Worker %d: Connection fd=%d closed by peer\n", worker->id, conn->fd);
+        LOG_DEBUG("Worker %d: Connection fd=%d closed by peer", worker->id, conn->fd);
         mt_remove_connection_safe(worker, conn);
         
     } else if (n == -1) {
@@ -551,29 +752,31 @@ void mt_try_read(worker_context_t *worker, mt_connection_t *conn) {
 void mt_try_write(worker_context_t *worker, mt_connection_t *conn) {
     if (!conn->writable || conn->write_pending == 0) return;
     
-    ssize_t n = write(conn->fd, conn->write_buf, conn->write_pending);
+    ssize_t n = write(conn->fd, conn->buf->write_buf, conn->write_pending);
     
     if (n > 0) {
         // 同步写入成功
-        printf("Worker %d: Sync wrote %zd bytes to fd=%d\n", worker->id, n, conn->fd);
+        LOG_DEBUG("Worker %d: Sync wrote %zd bytes to fd=%d", worker->id, n, conn->fd);
         
         // 移动剩余数据
         if (n < conn->write_pending) {
-            memmove(conn->write_buf, conn->write_buf + n, conn->write_pending - n);
+            memmove(conn->buf->write_buf, conn->buf->write_buf + n, conn->write_pending - n);
         }
         conn->write_pending -= n;
         worker->successful_ops++;
         worker->total_operations++;
         conn->last_activity = time(NULL);
         
+        if (conn->state == CONN_SUSPENDED && conn->write_pending <= WRITE_LOW_WATERMARK) {
+            mt_resume_read(worker, conn);
+        }
+        
     } else if (n == -1) {
         if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            // 暂时不可写
+            // 暂时不可写，等EPOLLOUT（已注册）再写；剩余数据留在write_buf中，
+            // 不再提交AIO写：它的完成事件不消费write_pending，数据会重复发送
             conn->writable = 0;
             worker->eagain_errors++;
-            
-            // 使用异步写入
-            mt_submit_async_write(worker, conn);
         } else {
             perror("write failed");
             mt_remove_connection_safe(worker, conn);
@@ -581,45 +784,87 @@ void mt_try_write(worker_context_t *worker, mt_connection_t *conn) {
     }
 }
 
+// 标记待发送，已在dirty链中时只是合并到同一次write
+static void mt_mark_dirty(worker_context_t *worker, mt_connection_t *conn) {
+    if (conn->dirty) {
+        worker->coalesced++;
+        return;
+    }
+    conn->dirty = 1;
+    conn->dirty_next = worker->dirty_head;
+    worker->dirty_head = conn;
+}
+
+// 本轮末尾统一发送：write_buf是连续的，每个连接一次write就能发出本轮全部回显
+static void mt_flush_dirty(worker_context_t *worker) {
+    while (worker->dirty_head) {
+        mt_connection_t *conn = worker->dirty_head;
+        worker->dirty_head = conn->dirty_next;
+        conn->dirty = 0;
+        conn->dirty_next = NULL;
+        worker->flushes++;
+        mt_try_write(worker, conn);
+    }
+}
+
 // 处理数据
 void mt_process_data(worker_context_t *worker, mt_connection_t *conn, const char *data, size_t len) {
     // 简单回显处理
-    printf("Worker %d: Processing data from fd=%d: %.*s\n", 
+    LOG_DEBUG("Worker %d: Processing data from fd=%d: %.*s", 
            worker->id, conn->fd, (int)len, data);
     
-    // 准备回显数据
-    const char *echo_prefix = "Echo: ";
-    size_t prefix_len = strlen(echo_prefix);
-    size_t total_len = prefix_len + len;
+    // 追加到待发送数据之后（覆盖会丢掉上次未写完的回显）
+    size_t total_len = ECHO_PREFIX_LEN + len;
+    if (conn->write_pending + total_len > BUFFER_SIZE) {
+        // 读取长度按剩余空间限制，只有同步读和AIO读同时完成时才会发生
+        LOG_ERROR("Worker %d: write buffer full on fd=%d, dropping %zu bytes", worker->id, conn->fd, len);
+        return;
+    }
+    if (mt_attach_buffer(worker, conn) < 0) {
+        LOG_ERROR("Worker %d: no buffer for fd=%d, dropping %zu bytes", worker->id, conn->fd, len);
+        return;
+    }
+    memcpy(conn->buf->write_buf + conn->write_pending, ECHO_PREFIX, ECHO_PREFIX_LEN);
+    memcpy(conn->buf->write_buf + conn->write_pending + ECHO_PREFIX_LEN, data, len);
+    conn->write_pending += total_len;
     
-    if (total_len < BUFFER_SIZE) {
-        memcpy(conn->write_buf, echo_prefix, prefix_len);
-        memcpy(conn->write_buf + prefix_len, data, len);
-        conn->write_pending = total_len;
-        
-        // 尝试立即写入
-        mt_try_write(worker, conn);
+    // 超过高水位暂停读取，对端不收数据时不再从它读入新的请求
+    if (conn->state != CONN_SUSPENDED && conn->write_pending >= WRITE_HIGH_WATERMARK) {
+        conn->state = CONN_SUSPENDED;
+        worker->backpressure_pauses++;
+        LOG_DEBUG("Worker %d: write backlog of fd=%d above high watermark, pausing reads", worker->id, conn->fd);
     }
+    
+    // 不立即写：同一轮处理的多个请求合并成一次write，在本轮末尾由mt_flush_dirty发出
+    mt_mark_dirty(worker, conn);
 }
 
 // 提交异步读取
 void mt_submit_async_read(worker_context_t *worker, mt_connection_t *conn) {
+    // 分配不到读缓冲时不提交，新数据到达时epoll仍会通知
+    mt_aio_read_t *rd = slab_alloc(&worker->aio_slab);
+    if (!rd) return;
+    rd->conn = conn;
+    
     struct iocb iocb;
     struct iocb *iocbs[1] = { &iocb };
     
-    io_prep_pread(&iocb, conn->fd, conn->read_buf, BUFFER_SIZE - 1, 0);
-    iocb.data = conn;
+    io_prep_pread(&iocb, conn->fd, rd->data, mt_read_limit(conn), 0);
+    iocb.data = rd;
     
     int ret = io_submit(worker->aio_ctx, 1, iocbs);
     if (ret == 1) {
+        conn->aio_reads++;
         worker->total_operations++;
-        printf("Worker %d: Submitted async read for fd=%d\n", worker->id, conn->fd);
+        LOG_DEBUG("Worker %d: Submitted async read for fd=%d", worker->id, conn->fd);
+        return;
     } else if (ret == -EAGAIN) {
-        printf("Worker %d: AIO queue full for fd=%d\n", worker->id, conn->fd);
+        LOG_DEBUG("Worker %d: AIO queue full for fd=%d", worker->id, conn->fd);
         worker->eagain_errors++;
     } else {
-        printf("Worker %d: AIO submit failed for fd=%d: %d\n", worker->id, conn->fd, ret);
+        LOG_ERROR("Worker %d: AIO submit failed for fd=%d: %d", worker->id, conn->fd, ret);
     }
+    slab_free(rd);
 }
 
 // 提交异步写入
@@ -627,47 +872,64 @@ void mt_submit_async_write(worker_context_t *worker, mt_connection_t *conn) {
     struct iocb iocb;
     struct iocb *iocbs[1] = { &iocb };
     
-    io_prep_pwrite(&iocb, conn->fd, conn->write_buf, conn->write_pending, 0);
+    if (conn->write_pending == 0) return;
+    
+    io_prep_pwrite(&iocb, conn->fd, conn->buf->write_buf, conn->write_pending, 0);
     iocb.data = conn;
     
     int ret = io_submit(worker->aio_ctx, 1, iocbs);
     if (ret == 1) {
         worker->total_operations++;
-        printf("Worker %d: Submitted async write for fd=%d\n", worker->id, conn->fd);
+        LOG_DEBUG("Worker %d: Submitted async write for fd=%d", worker->id, conn->fd);
     } else if (ret == -EAGAIN) {
-        printf("Worker %d: AIO queue full for fd=%d\n", worker->id, conn->fd);
+        LOG_DEBUG("Worker %d: AIO queue full for fd=%d", worker->id, conn->fd);
         worker->eagain_errors++;
     } else {
-        printf("Worker %d: AIO submit failed for fd=%d: %d\n", worker->id, conn->fd, ret);
+        LOG_ERROR("Worker %d: AIO submit failed for fd=%d: %d", worker->id, conn->fd, ret);
     }
 }
 
 // 处理AIO完成事件
 void mt_handle_aio_completion(worker_context_t *worker, struct io_event *event) {
-    mt_connection_t *conn = (mt_connection_t *)event->data;
-    if (!conn) return;
+    // 只提交AIO读（mt_submit_async_write未使用），data是随读操作分配的mt_aio_read_t
+    mt_aio_read_t *rd = (mt_aio_read_t *)event->data;
+    if (!rd) return;
+    mt_connection_t *conn = rd->conn;
+    conn->aio_reads--;
+    
+    // 连接已移除：丢弃读到的数据，最后一个在途读完成时释放连接
+    if (atomic_load(&conn->is_removing)) {
+        if (conn->aio_reads == 0) {
+            slab_free(conn);
+        }
+        slab_free(rd);
+        return;
+    }
     
-    if (event->res > 0) {
+    // libaio的res是无符号的，按有符号解释才能区分负的错误码，否则-EAGAIN会被当成读到的字节数
+    long res = (long)event->res;
+    if (res > 0) {
         // AIO操作成功
-        printf("Worker %d: AIO completed: %lld bytes for fd=%d\n", 
-               worker->id, (long long)event->res, conn->fd);
+        LOG_DEBUG("Worker %d: AIO completed: %ld bytes for fd=%d", 
+               worker->id, res, conn->fd);
         
         if (event->res2 == 0) { // 读操作
-            conn->read_buf[event->res] = '\0';
-            mt_process_data(worker, conn, conn->read_buf, event->res);
+            rd->data[res] = '\0';
+            mt_process_data(worker, conn, rd->data, res);
         } else { // 写操作
-            printf("Worker %d: Async write completed for fd=%d\n", worker->id, conn->fd);
+            LOG_DEBUG("Worker %d: Async write completed for fd=%d", worker->id, conn->fd);
         }
         
         worker->successful_ops++;
         conn->last_activity = time(NULL);
         
-    } else if (event->res == -EAGAIN) {
-        printf("Worker %d: AIO EAGAIN for fd=%d\n", worker->id, conn->fd);
+    } else if (res == -EAGAIN) {
+        LOG_DEBUG("Worker %d: AIO EAGAIN for fd=%d", worker->id, conn->fd);
         worker->eagain_errors++;
     } else {
-        printf("Worker %d: AIO error for fd=%d: %lld\n", worker->id, conn->fd, (long long)event->res);
+        LOG_DEBUG("Worker %d: AIO error for fd=%d: %ld", worker->id, conn->fd, res);
     }
+    slab_free(rd);
 }
 
 // 安全移除连接
@@ -680,7 +942,17 @@ void mt_remove_connection_safe(worker_context_t *worker, mt_connection_t *conn)
         return; // 已经在移除过程中
     }
     
-    printf("Worker %d: Safely removing connection fd=%d\n", worker->id, conn->fd);
+    LOG_DEBUG("Worker %d: Safely removing connection fd=%d", worker->id, conn->fd);
+    
+    // 还在dirty链中时先摘除，本轮末尾不能再访问它
+    if (conn->dirty) {
+        mt_connection_t **link = &worker->dirty_head;
+        while (*link && *link != conn) {
+            link = &(*link)->dirty_next;
+        }
+        if (*link) *link = conn->dirty_next;
+        conn->dirty = 0;
+    }
     
     // 从epoll移除
     if (worker->epoll_fd >= 0 && conn->fd >= 0) {
@@ -706,7 +978,14 @@ void mt_remove_connection_safe(worker_context_t *worker, mt_connection_t *conn)
     }
     pthread_mutex_unlock(&worker->conn_list_lock);
     
-    // 释放连接资源
-    pthread_mutex_destroy(&conn->lock);
-    free(conn);
+    // 释放连接资源（工作线程中调用，连接走slab的远程释放路径，缓冲是本线程的本地释放）
+    if (conn->buf) {
+        slab_free(conn->buf);
+        conn->buf = NULL;
+    }
+    // 还有在途的AIO读时不能归还：槽位被新连接复用后，过期的完成事件会把数据回显给另一个客户端
+    if (conn->aio_reads == 0) {
+        slab_free(conn);
+    }
+    atomic_fetch_sub(&worker->proactor->connection_count, 1);
 }
\ No newline at end of file
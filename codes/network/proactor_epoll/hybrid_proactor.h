@@ -11,11 +11,18 @@
 #include <unistd.h>
 #include <time.h>
 #include <stdatomic.h>
+#include <stdint.h>
+
+#include "slab.h"
+#include "affinity.h"
 
 #define MAX_EVENTS 64
 #define BUFFER_SIZE 4096
 #define DEFAULT_PORT 8080
 #define MAX_WORKER_THREADS 16
+#define WRITE_HIGH_WATERMARK (BUFFER_SIZE * 3 / 4)   // 待发送数据超过该值时暂停读取（CONN_SUSPENDED）
+#define WRITE_LOW_WATERMARK (BUFFER_SIZE / 4)        // 回落到该值以下时恢复读取
+#define BUF_IDLE_SECONDS 2                           // 没有数据在途且空闲超过该时间的连接归还缓冲
 
 // 连接状态
 typedef enum {
@@ -25,29 +32,39 @@ typedef enum {
     CONN_SUSPENDED
 } conn_state_t;
 
-// 连接结构
+// 连接缓冲：只在有待发送数据时挂在连接上，从工作线程的buf_slab分配；
+// 同步读用工作线程的read_scratch，AIO读用随操作分配的mt_aio_read_t，读到的数据都立即追加到write_buf
+typedef struct mt_conn_buf {
+    char write_buf[BUFFER_SIZE];
+} mt_conn_buf_t;
+
+// 连接结构：常驻部分只有这一个缓存行，空闲连接不持有缓冲
 typedef struct mt_connection {
     int fd;
-    struct sockaddr_in client_addr;
     conn_state_t state;
-    int readable;
-    int writable;
-    char read_buf[BUFFER_SIZE];
-    char write_buf[BUFFER_SIZE];
-    size_t write_pending;
-    time_t last_activity;
-    
-    // 线程安全字段
+    int worker_id;                 // 所属工作线程
     atomic_int is_removing;
-    atomic_int ref_count;
-    pthread_mutex_t lock;
-    
-    // 所属工作线程
-    int worker_id;
-    
+    uint8_t readable;
+    uint8_t writable;
+    // 延迟发送：回显追加到write_buf后挂到工作线程的dirty链，本轮事件处理完后统一写一次
+    uint8_t dirty;
+    uint8_t welcome;               // 欢迎消息待发送：accept线程置位，工作线程收到第一个事件时发出
+    uint16_t aio_reads;            // 在途的AIO读；移除时不为0则推迟到最后一个完成事件再释放连接
+    size_t write_pending;          // 不为0时buf一定已挂上
+    time_t last_activity;
+    mt_conn_buf_t *buf;            // 按需挂上，没有待发送数据且空闲超过BUF_IDLE_SECONDS后归还
+    struct mt_connection *dirty_next;
     struct mt_connection *next;
 } mt_connection_t;
 
+_Static_assert(sizeof(mt_connection_t) <= 64, "mt_connection_t must fit in one cache line");
+
+// AIO读：目标缓冲要在完成前一直有效，随操作从工作线程的aio_slab分配，完成时归还
+typedef struct mt_aio_read {
+    mt_connection_t *conn;
+    char data[BUFFER_SIZE];
+} mt_aio_read_t;
+
 // 工作线程上下文
 typedef struct {
     int id;
@@ -64,10 +81,28 @@ typedef struct {
     mt_connection_t *connections;
     pthread_mutex_t conn_list_lock;
     
+    // 本线程连接的对象池：由accept线程分配，绑核时chunk绑定到本线程所在的NUMA节点
+    slab_cache_t conn_slab;
+    // 连接缓冲和AIO读缓冲的对象池：分配和归还都在本线程
+    slab_cache_t buf_slab;
+    slab_cache_t aio_slab;
+    char read_scratch[BUFFER_SIZE];   // 同步读的临时缓冲，读到的数据立即追加到连接的write_buf
+    time_t last_sweep;                // 上次检查空闲缓冲的时间
+    int cpu;         // 绑定的CPU，-1表示不绑定
+    int numa_node;
+    
     // 统计信息
     unsigned long total_operations;
     unsigned long eagain_errors;
     unsigned long successful_ops;
+    unsigned long backpressure_pauses;   // 因待发送数据超过高水位暂停读取的次数
+    unsigned long flushes;               // 延迟发送的write次数
+    unsigned long coalesced;             // 合并进已有待发送数据、没有单独write的回显数
+    unsigned long buf_attaches;          // 挂上连接缓冲的次数
+    unsigned long buf_releases;          // 空闲后归还连接缓冲的次数
+    
+    // 本轮有待发送数据的连接（仅本线程访问）
+    mt_connection_t *dirty_head;
     
     // 指向主proactor的指针
     struct mt_proactor *proactor;
@@ -89,9 +124,17 @@ typedef struct mt_proactor {
     // 连接分配策略
     int next_worker; // 轮询分配
     
+    // 绑核：工作线程i用cpus[i % cpu_count]，accept线程用下一个；cpu_count为0表示不绑定
+    int cpus[AFFINITY_MAX_CPUS];
+    int cpu_count;
+    
     // 全局统计
     unsigned long total_connections;
     unsigned long total_operations;
+    atomic_int connection_count;   // 当前连接数，热升级后据此判断是否已排空
+    
+    // 热升级：监听socket交给新进程后清零，accept线程退出，已有连接留在本进程直到关闭
+    volatile int accepting;
     
     // 同步原语
     pthread_mutex_t accept_lock;
@@ -102,17 +145,25 @@ typedef struct mt_proactor {
 // 初始化
 int mt_proactor_init(mt_proactor_t *proactor, int num_workers);
 int mt_proactor_start(mt_proactor_t *proactor);
+// 设置绑核，只能在mt_proactor_start之前调用
+int mt_proactor_set_affinity(mt_proactor_t *proactor, const int *cpus, int count);
 int mt_proactor_stop(mt_proactor_t *proactor);
 
 // 网络
 int create_server_socket(int port);
 
+// 热升级（协议见common/handoff.h）：只交接监听socket，连接有进行中的AIO，留在旧进程
+// 旧进程：收到新进程的请求后调用，交出listen_fd并停止accept
+int mt_proactor_upgrade_send(mt_proactor_t *proactor, int sock);
+// 新进程：在mt_proactor_start之前调用，接管旧进程的监听socket，返回其fd，失败返回-1
+int mt_proactor_upgrade_recv(int sock);
+
 // 工作线程
 void *worker_thread_func(void *arg);
 void *accept_thread_func(void *arg);
 
 // 连接管理
-mt_connection_t *mt_create_connection(int fd, struct sockaddr_in *addr, int worker_id);
+mt_connection_t *mt_create_connection(mt_proactor_t *proactor, int fd, struct sockaddr_in *addr, int worker_id);
 void mt_remove_connection_safe(worker_context_t *worker, mt_connection_t *conn);
 void mt_add_connection_to_worker(worker_context_t *worker, mt_connection_t *conn);
 
@@ -0,0 +1,140 @@
+// accept_bench.c - 连接建立速率压测：connect -> 发1字节 -> 等回显 -> RST关闭
+// 用于对比单accept线程与SO_REUSEPORT每线程监听两种模式
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define LAT_BUCKETS 100000   // 10us一档，最长1s
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    unsigned long conns;
+    unsigned long errors;
+    unsigned long lat_hist[LAT_BUCKETS];
+} bench_worker_t;
+
+static const char *g_host = "127.0.0.1";
+static int g_port = 8080;
+static atomic_bool g_running;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 建立一次连接并完成一次1字节往返
+static int one_connection(const struct sockaddr_in *addr) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    // RST关闭，客户端不留TIME_WAIT，避免耗尽本地端口
+    struct linger lg = { .l_onoff = 1, .l_linger = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct timeval tv = { .tv_sec = 2, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int ret = -1;
+    char c = 'x';
+    if (connect(fd, (const struct sockaddr*)addr, sizeof(*addr)) == 0 &&
+        write(fd, &c, 1) == 1 && read(fd, &c, 1) == 1) {
+        ret = 0;
+    }
+
+    close(fd);
+    return ret;
+}
+
+static void *worker_main(void *arg) {
+    bench_worker_t *w = (bench_worker_t*)arg;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(g_port) };
+    inet_pton(AF_INET, g_host, &addr.sin_addr);
+
+    while (atomic_load(&g_running)) {
+        uint64_t start = now_us();
+        if (one_connection(&addr) != 0) {
+            w->errors++;
+            continue;
+        }
+        uint64_t bucket = (now_us() - start) / 10;
+        w->lat_hist[bucket < LAT_BUCKETS ? bucket : LAT_BUCKETS - 1]++;
+        w->conns++;
+    }
+    return NULL;
+}
+
+// 合并后的直方图求百分位(us)
+static double percentile(const unsigned long *hist, unsigned long total, double p) {
+    unsigned long target = (unsigned long)(total * p);
+    unsigned long seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen > target) return i * 10.0;
+    }
+    return LAT_BUCKETS * 10.0;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = 4;
+    int seconds = 5;
+    const char *label = "reactor";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:t:d:l:")) != -1) {
+        switch (opt) {
+            case 'h': g_host = optarg; break;
+            case 'p': g_port = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'd': seconds = atoi(optarg); break;
+            case 'l': label = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-h host] [-p port] [-t threads] [-d seconds] [-l label]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (threads <= 0) threads = 1;
+
+    bench_worker_t *workers = calloc(threads, sizeof(bench_worker_t));
+    if (!workers) return 1;
+
+    atomic_store(&g_running, true);
+    uint64_t start = now_us();
+    for (int i = 0; i < threads; i++) {
+        workers[i].id = i;
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    sleep(seconds);
+    atomic_store(&g_running, false);
+
+    static unsigned long hist[LAT_BUCKETS];
+    unsigned long conns = 0, errors = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        conns += workers[i].conns;
+        errors += workers[i].errors;
+        for (int j = 0; j < LAT_BUCKETS; j++) hist[j] += workers[i].lat_hist[j];
+    }
+    double elapsed = (now_us() - start) / 1e6;
+
+    printf("mode=%s threads=%d conns=%lu errors=%lu rate=%.0f/s p50=%.0fus p99=%.0fus p999=%.0fus\n",
+           label, threads, conns, errors, conns / elapsed,
+           percentile(hist, conns, 0.50), percentile(hist, conns, 0.99), percentile(hist, conns, 0.999));
+
+    free(workers);
+    return 0;
+}
@@ -0,0 +1,275 @@
+// broadcast_bench.c - 组广播压测：进程内启动Reactor，所有连接在on_connect中加入同一个组，
+// 主线程按固定频率调用reactor_broadcast；客户端连接放在fork出的子进程中（两端各占一个fd，
+// 万级成员时单进程会超出fd上限），子进程统计收到的消息数和从广播到收到的延迟
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../reactor.h"
+#include "log.h"
+
+#define LAT_BUCKETS 100000   // 10us一档，最长1s
+#define MAX_MESSAGE 1024
+#define BENCH_GROUP 1
+
+// 子进程的统计结果，经管道交给父进程
+typedef struct {
+    int connected;
+    unsigned long received;
+    double p50_us;
+    double p99_us;
+    double max_us;
+} client_result_t;
+
+typedef struct {
+    int fd;
+    size_t have;
+    char partial[MAX_MESSAGE];
+} client_conn_t;
+
+static int g_port = 9091;
+static size_t g_size = 64;
+static reactor_t *g_reactor;
+static atomic_int g_joined;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void on_connect(connection_t *conn) {
+    if (reactor_group_join(g_reactor, conn, BENCH_GROUP) == 0) {
+        atomic_fetch_add(&g_joined, 1);
+    }
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static double percentile(const unsigned long *hist, unsigned long total, double p) {
+    unsigned long target = (unsigned long)(total * p);
+    unsigned long seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen > target) return i * 10.0;
+    }
+    return LAT_BUCKETS * 10.0;
+}
+
+// 子进程：收到'g'后建立members个连接并回报，之后一直接收，收到期望总数（由父进程写入ctl）后回报结果
+static int client_main(int ctl, int res, int members) {
+    static unsigned long hist[LAT_BUCKETS];
+    client_result_t result = { 0 };
+    char go;
+    if (read_full(ctl, &go, 1) != 0) return 1;
+
+    client_conn_t *clients = calloc(members, sizeof(client_conn_t));
+    int ep = epoll_create1(0);
+    if (!clients || ep < 0) return 1;
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(g_port) };
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    for (int i = 0; i < members; i++) {
+        clients[i].fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (clients[i].fd < 0 || connect(clients[i].fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "client %d: connect failed: %s\n", i, strerror(errno));
+            if (clients[i].fd >= 0) close(clients[i].fd);
+            break;
+        }
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &clients[i] };
+        epoll_ctl(ep, EPOLL_CTL_ADD, clients[i].fd, &ev);
+        result.connected++;
+    }
+    if (write(res, &result.connected, sizeof(result.connected)) != sizeof(result.connected)) return 1;
+
+    struct epoll_event cev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(ep, EPOLL_CTL_ADD, ctl, &cev);
+
+    static char buf[64 * 1024];
+    struct epoll_event events[512];
+    unsigned long expected = 0;
+    bool stopped = false;
+    uint64_t deadline = 0;
+    uint64_t max_ns = 0;
+    while (!stopped || (result.received < expected && now_ns() < deadline)) {
+        int n = epoll_wait(ep, events, 512, 100);
+        for (int i = 0; i < n; i++) {
+            client_conn_t *c = events[i].data.ptr;
+            if (!c) {
+                // 父进程停止广播，写入期望收到的总数；最多再等2秒
+                if (read_full(ctl, &expected, sizeof(expected)) != 0) expected = result.received;
+                epoll_ctl(ep, EPOLL_CTL_DEL, ctl, NULL);
+                stopped = true;
+                deadline = now_ns() + 2000000000ull;
+                continue;
+            }
+
+            ssize_t len = read(c->fd, buf, sizeof(buf));
+            if (len <= 0) continue;
+            uint64_t now = now_ns();
+            for (ssize_t off = 0; off < len; ) {
+                size_t take = g_size - c->have;
+                if ((size_t)(len - off) < take) take = (size_t)(len - off);
+                memcpy(c->partial + c->have, buf + off, take);
+                c->have += take;
+                off += (ssize_t)take;
+                if (c->have < g_size) break;
+
+                uint64_t t;
+                memcpy(&t, c->partial, sizeof(t));
+                uint64_t lat = now - t;
+                if (lat > max_ns) max_ns = lat;
+                uint64_t bucket = lat / 10000;
+                hist[bucket < LAT_BUCKETS ? bucket : LAT_BUCKETS - 1]++;
+                c->have = 0;
+                result.received++;
+            }
+        }
+    }
+
+    result.p50_us = percentile(hist, result.received, 0.50);
+    result.p99_us = percentile(hist, result.received, 0.99);
+    result.max_us = max_ns / 1000.0;
+    if (write(res, &result, sizeof(result)) != sizeof(result)) return 1;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = 2;
+    int members = 10000;
+    int hz = 100;
+    int seconds = 5;
+    reactor_backend_t backend = REACTOR_BACKEND_EPOLL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:t:c:r:s:d:b:")) != -1) {
+        switch (opt) {
+            case 'p': g_port = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'c': members = atoi(optarg); break;
+            case 'r': hz = atoi(optarg); break;
+            case 's': g_size = strtoul(optarg, NULL, 10); break;
+            case 'd': seconds = atoi(optarg); break;
+            case 'b': backend = strcmp(optarg, "uring") == 0 ? REACTOR_BACKEND_URING : REACTOR_BACKEND_EPOLL; break;
+            default:
+                fprintf(stderr, "Usage: %s [-p port] [-t reactor_threads] [-c members] [-r broadcasts_per_sec] "
+                        "[-s message_bytes] [-d seconds] [-b epoll|uring]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (threads <= 0) threads = 1;
+    if (threads > MAX_REACTOR_THREADS) threads = MAX_REACTOR_THREADS;
+    if (members <= 0) members = 1;
+    if (hz <= 0) hz = 1;
+    if (g_size < sizeof(uint64_t)) g_size = sizeof(uint64_t);
+    if (g_size > MAX_MESSAGE) g_size = MAX_MESSAGE;
+
+    // 先fork再创建Reactor线程，子进程中没有其他线程
+    int ctl[2], res[2];
+    if (pipe(ctl) != 0 || pipe(res) != 0) return 1;
+    pid_t child = fork();
+    if (child < 0) return 1;
+    if (child == 0) {
+        close(ctl[1]);
+        close(res[0]);
+        _exit(client_main(ctl[0], res[1], members));
+    }
+    close(ctl[0]);
+    close(res[1]);
+
+    log_init(STDERR_FILENO, LOG_LEVEL_ERROR);
+    g_reactor = reactor_create_backend(threads, backend);
+    if (!g_reactor) {
+        kill(child, SIGKILL);
+        return 1;
+    }
+    g_reactor->on_connect = on_connect;
+    if (reactor_listen_reuseport(g_reactor, g_port, false) != 0 || reactor_run(g_reactor) != 0) {
+        fprintf(stderr, "Failed to start reactor on port %d\n", g_port);
+        kill(child, SIGKILL);
+        return 1;
+    }
+
+    int connected = 0;
+    if (write(ctl[1], "g", 1) != 1 || read_full(res[0], &connected, sizeof(connected)) != 0) {
+        kill(child, SIGKILL);
+        return 1;
+    }
+    for (int waited = 0; atomic_load(&g_joined) < connected && waited < 5000; waited++) {
+        usleep(1000);
+    }
+    int joined = atomic_load(&g_joined);
+
+    // 按绝对时间节拍广播，单次广播的耗时不累积到周期上
+    char msg[MAX_MESSAGE];
+    memset(msg, 'b', g_size);
+    uint64_t period = 1000000000ull / hz;
+    uint64_t start = now_ns();
+    uint64_t next = start;
+    unsigned long broadcasts = 0, failed = 0;
+    uint64_t call_ns = 0;
+    while (now_ns() - start < (uint64_t)seconds * 1000000000ull) {
+        uint64_t t = now_ns();
+        if (t < next) {
+            struct timespec ts = { (time_t)((next - t) / 1000000000ull), (long)((next - t) % 1000000000ull) };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+        next += period;
+
+        t = now_ns();
+        memcpy(msg, &t, sizeof(t));
+        if (reactor_broadcast(g_reactor, BENCH_GROUP, msg, g_size) == 0) {
+            broadcasts++;
+        } else {
+            failed++;
+        }
+        call_ns += now_ns() - t;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    unsigned long expected = broadcasts * (unsigned long)joined;
+    client_result_t result = { 0 };
+    if (write(ctl[1], &expected, sizeof(expected)) != sizeof(expected) ||
+        read_full(res[0], &result, sizeof(result)) != 0) {
+        fprintf(stderr, "Failed to collect client results\n");
+    }
+    waitpid(child, NULL, 0);
+
+    metrics_t *m = g_reactor->metrics;
+    const reactor_metric_ids_t *mid = &g_reactor->mid;
+    printf("backend=%s threads=%d members=%d/%d size=%zu rate=%.1f/s failed=%lu call=%.1fus "
+           "fanout_p50=%lluus fanout_p99=%lluus delay_p99=%lluus delivered=%lu/%lu "
+           "recv_p50=%.0fus recv_p99=%.0fus recv_max=%.0fus\n",
+           g_reactor->backend == REACTOR_BACKEND_URING ? "uring" : "epoll", threads, joined, members, g_size,
+           broadcasts / elapsed, failed, broadcasts ? call_ns / 1000.0 / broadcasts : 0.0,
+           (unsigned long long)metrics_hist_quantile(m, METRICS_ALL_SHARDS, mid->broadcast_fanout_us, 0.50),
+           (unsigned long long)metrics_hist_quantile(m, METRICS_ALL_SHARDS, mid->broadcast_fanout_us, 0.99),
+           (unsigned long long)metrics_hist_quantile(m, METRICS_ALL_SHARDS, mid->broadcast_delay_us, 0.99),
+           result.received, expected, result.p50_us, result.p99_us, result.max_us);
+
+    reactor_stop(g_reactor);
+    reactor_destroy(g_reactor);
+    return result.received == expected ? 0 : 1;
+}
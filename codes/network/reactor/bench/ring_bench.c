@@ -0,0 +1,315 @@
+// ring_bench.c - 环形队列族的压力校验与吞吐/延迟测试
+// 每个配置：P个生产者各写入N个元素（生产者号+序号），C个消费者取出并校验
+// - 同一消费者看到的每个生产者的序号严格递增（单消费者时必须连续）
+// - 全部消费者合计不丢不重：每个生产者的计数为N、序号和为N(N-1)/2
+// 每LAT_SAMPLE个元素带一个时间戳，统计入队到出队的延迟
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "../ring_queue.h"
+
+#define MAX_THREADS 8
+#define MAX_BATCH 64
+#define MAX_PAYLOAD 256
+#define LAT_SAMPLE 1024
+
+// 元素头部，payload其余部分填充
+typedef struct bench_item_s {
+    uint32_t producer;
+    uint32_t seq;
+    uint64_t stamp_ns;   // 非采样元素为0
+} bench_item_t;
+
+typedef struct ring_ops_s {
+    const char *name;
+    size_t size;   // 队列结构大小
+    int (*init)(void *q, size_t capacity, size_t elem_size);
+    void (*destroy)(void *q);
+    uint32_t (*push_batch)(void *q, const void *items, uint32_t count);
+    uint32_t (*pop_batch)(void *q, void *items, uint32_t count);
+} ring_ops_t;
+
+#define RING_OPS(kind) \
+    static int kind##_init(void *q, size_t c, size_t e) { return kind##_ring_init(q, c, e); } \
+    static void kind##_destroy(void *q) { kind##_ring_destroy(q); } \
+    static uint32_t kind##_push(void *q, const void *i, uint32_t n) { return kind##_ring_push_batch(q, i, n); } \
+    static uint32_t kind##_pop(void *q, void *i, uint32_t n) { return kind##_ring_pop_batch(q, i, n); } \
+    static const ring_ops_t kind##_ops = { #kind, sizeof(kind##_ring_t), kind##_init, kind##_destroy, \
+                                           kind##_push, kind##_pop };
+
+RING_OPS(spsc)
+RING_OPS(mpsc)
+RING_OPS(mpmc)
+
+typedef struct bench_config_s {
+    const ring_ops_t *ops;
+    int producers;
+    int consumers;
+    uint32_t batch;
+} bench_config_t;
+
+typedef struct bench_ctx_s {
+    const bench_config_t *cfg;
+    void *queue;
+    size_t elem_size;
+    uint32_t per_producer;
+    atomic_ullong consumed;
+    atomic_int ready;
+    atomic_bool go;
+} bench_ctx_t;
+
+typedef struct bench_worker_s {
+    bench_ctx_t *ctx;
+    int id;
+    pthread_t thread;
+
+    // 消费者统计
+    uint64_t count[MAX_THREADS];
+    uint64_t sum[MAX_THREADS];
+    int64_t last[MAX_THREADS];
+    uint64_t order_errors;
+    uint64_t *lat;
+    size_t lat_count;
+    size_t lat_cap;
+} bench_worker_t;
+
+static uint32_t g_count = 1000000;
+static size_t g_payload = 16;
+static size_t g_capacity = 4096;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void wait_start(bench_ctx_t *ctx) {
+    atomic_fetch_add(&ctx->ready, 1);
+    while (!atomic_load(&ctx->go)) {
+        sched_yield();
+    }
+}
+
+static void *producer_main(void *arg) {
+    bench_worker_t *w = (bench_worker_t*)arg;
+    bench_ctx_t *ctx = w->ctx;
+    const ring_ops_t *ops = ctx->cfg->ops;
+    char items[MAX_BATCH * MAX_PAYLOAD];
+
+    memset(items, 0, sizeof(items));
+    wait_start(ctx);
+
+    uint32_t seq = 0;
+    while (seq < ctx->per_producer) {
+        uint32_t n = ctx->per_producer - seq;
+        if (n > ctx->cfg->batch) n = ctx->cfg->batch;
+
+        for (uint32_t i = 0; i < n; i++) {
+            bench_item_t *item = (bench_item_t*)(items + i * ctx->elem_size);
+            item->producer = (uint32_t)w->id;
+            item->seq = seq + i;
+            item->stamp_ns = (seq + i) % LAT_SAMPLE == 0 ? now_ns() : 0;
+        }
+
+        // 队列满时只推进已入队的部分
+        uint32_t pushed = 0;
+        while (pushed < n) {
+            uint32_t k = ops->push_batch(ctx->queue, items + pushed * ctx->elem_size, n - pushed);
+            if (k == 0) sched_yield();
+            pushed += k;
+        }
+        seq += n;
+    }
+    return NULL;
+}
+
+static void *consumer_main(void *arg) {
+    bench_worker_t *w = (bench_worker_t*)arg;
+    bench_ctx_t *ctx = w->ctx;
+    const ring_ops_t *ops = ctx->cfg->ops;
+    uint64_t total = (uint64_t)ctx->per_producer * ctx->cfg->producers;
+    bool single = ctx->cfg->consumers == 1;
+    char items[MAX_BATCH * MAX_PAYLOAD];
+
+    for (int p = 0; p < MAX_THREADS; p++) {
+        w->last[p] = -1;
+    }
+    wait_start(ctx);
+
+    while (atomic_load_explicit(&ctx->consumed, memory_order_relaxed) < total) {
+        uint32_t n = ops->pop_batch(ctx->queue, items, ctx->cfg->batch);
+        if (n == 0) {
+            sched_yield();
+            continue;
+        }
+
+        uint64_t now = now_ns();
+        for (uint32_t i = 0; i < n; i++) {
+            const bench_item_t *item = (const bench_item_t*)(items + i * ctx->elem_size);
+            uint32_t p = item->producer;
+            if (p >= (uint32_t)ctx->cfg->producers) {
+                w->order_errors++;
+                continue;
+            }
+
+            if (single ? item->seq != w->last[p] + 1 : (int64_t)item->seq <= w->last[p]) {
+                w->order_errors++;
+            }
+            w->last[p] = item->seq;
+            w->count[p]++;
+            w->sum[p] += item->seq;
+
+            if (item->stamp_ns && w->lat_count < w->lat_cap) {
+                w->lat[w->lat_count++] = now - item->stamp_ns;
+            }
+        }
+        atomic_fetch_add_explicit(&ctx->consumed, n, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// 运行一个配置，返回校验是否通过
+static bool run_config(const bench_config_t *cfg) {
+    bench_ctx_t ctx = { .cfg = cfg, .per_producer = g_count };
+    ctx.elem_size = g_payload;
+    atomic_init(&ctx.consumed, 0);
+    atomic_init(&ctx.ready, 0);
+    atomic_init(&ctx.go, false);
+
+    ctx.queue = aligned_alloc(RING_CACHE_LINE, (cfg->ops->size + RING_CACHE_LINE - 1) & ~(size_t)(RING_CACHE_LINE - 1));
+    if (!ctx.queue || cfg->ops->init(ctx.queue, g_capacity, ctx.elem_size) != 0) {
+        fprintf(stderr, "Failed to create %s ring\n", cfg->ops->name);
+        free(ctx.queue);
+        return false;
+    }
+
+    int threads = cfg->producers + cfg->consumers;
+    bench_worker_t *workers = calloc(threads, sizeof(bench_worker_t));
+    size_t lat_cap = (size_t)g_count * cfg->producers / LAT_SAMPLE + 1;
+
+    for (int i = 0; i < threads; i++) {
+        bench_worker_t *w = &workers[i];
+        w->ctx = &ctx;
+        if (i < cfg->producers) {
+            w->id = i;
+            pthread_create(&w->thread, NULL, producer_main, w);
+        } else {
+            w->id = i - cfg->producers;
+            w->lat = malloc(lat_cap * sizeof(uint64_t));
+            w->lat_cap = w->lat ? lat_cap : 0;
+            pthread_create(&w->thread, NULL, consumer_main, w);
+        }
+    }
+
+    while (atomic_load(&ctx.ready) < threads) {
+        sched_yield();
+    }
+    uint64_t start = now_ns();
+    atomic_store(&ctx.go, true);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    // 合并消费者统计并校验
+    bool ok = true;
+    uint64_t expect_sum = (uint64_t)g_count * (g_count - 1) / 2;
+    uint64_t order_errors = 0;
+    size_t lat_count = 0;
+    uint64_t *lat = malloc(lat_cap * cfg->consumers * sizeof(uint64_t));
+
+    for (int p = 0; p < cfg->producers; p++) {
+        uint64_t count = 0, sum = 0;
+        for (int i = cfg->producers; i < threads; i++) {
+            count += workers[i].count[p];
+            sum += workers[i].sum[p];
+        }
+        if (count != g_count || sum != expect_sum) {
+            ok = false;
+        }
+    }
+    for (int i = cfg->producers; i < threads; i++) {
+        order_errors += workers[i].order_errors;
+        if (lat) {
+            memcpy(lat + lat_count, workers[i].lat, workers[i].lat_count * sizeof(uint64_t));
+            lat_count += workers[i].lat_count;
+        }
+        free(workers[i].lat);
+    }
+    if (order_errors) ok = false;
+
+    uint64_t p50 = 0, p99 = 0;
+    if (lat && lat_count) {
+        qsort(lat, lat_count, sizeof(uint64_t), cmp_u64);
+        p50 = lat[lat_count / 2];
+        p99 = lat[lat_count * 99 / 100];
+    }
+
+    double ops = (double)g_count * cfg->producers;
+    printf("%-5s %dp%dc batch=%-3u size=%-3zu %8.2f Mops/s  lat p50=%lluns p99=%lluns  %s",
+           cfg->ops->name, cfg->producers, cfg->consumers, cfg->batch, g_payload,
+           ops / elapsed / 1e6, (unsigned long long)p50, (unsigned long long)p99, ok ? "ok" : "FAILED");
+    if (order_errors) {
+        printf(" (order_errors=%llu)", (unsigned long long)order_errors);
+    }
+    printf("\n");
+
+    free(lat);
+    free(workers);
+    cfg->ops->destroy(ctx.queue);
+    free(ctx.queue);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    static const bench_config_t configs[] = {
+        { &spsc_ops, 1, 1, 1 },
+        { &spsc_ops, 1, 1, 32 },
+        { &mpsc_ops, 1, 1, 1 },
+        { &mpsc_ops, 2, 1, 1 },
+        { &mpsc_ops, 4, 1, 1 },
+        { &mpsc_ops, 4, 1, 32 },
+        { &mpmc_ops, 2, 2, 1 },
+        { &mpmc_ops, 4, 4, 1 },
+        { &mpmc_ops, 4, 4, 32 },
+    };
+    const char *only = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:q:k:")) != -1) {
+        switch (opt) {
+            case 'n': g_count = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 's': g_payload = strtoul(optarg, NULL, 10); break;
+            case 'q': g_capacity = strtoul(optarg, NULL, 10); break;
+            case 'k': only = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n items_per_producer] [-s payload_bytes] [-q capacity] "
+                        "[-k spsc|mpsc|mpmc]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (g_count == 0) g_count = 1;
+    if (g_payload < sizeof(bench_item_t)) g_payload = sizeof(bench_item_t);
+    if (g_payload > MAX_PAYLOAD) g_payload = MAX_PAYLOAD;
+    g_payload = (g_payload + 7) & ~(size_t)7;   // 元素头部按8字节对齐访问
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        if (only && strcmp(only, configs[i].ops->name) != 0) continue;
+        if (!run_config(&configs[i])) failed++;
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,337 @@
+// rr_bench.c - 长连接请求/响应压测：每个连接发一个请求，等完整回显后再发下一个
+// 用于对比epoll与io_uring后端；-m指定服务进程pid时从指标共享内存读取系统调用数，折算到每个请求
+// -B指定大流量连接数时，另起线程在这些连接上不停地发送并丢弃回显，观察交互连接的延迟是否受影响
+// -m为pid时同时读取服务进程所有线程的CPU时间（schedstat，纳秒），折算为每个请求的CPU时间
+// -P指定流水线深度时，每个连接一次写入多个请求（以换行结尾，服务端可用--codec line逐条回显），再收齐全部回显
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+#include "metrics.h"
+
+#define LAT_BUCKETS 100000   // 10us一档，最长1s
+#define MAX_REQUEST 65536
+#define BULK_CHUNK (64 * 1024)
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    int conns;
+    unsigned long requests;
+    unsigned long errors;
+    unsigned long lat_hist[LAT_BUCKETS];
+} bench_worker_t;
+
+static const char *g_host = "127.0.0.1";
+static int g_port = 8080;
+static size_t g_size = 64;
+static int g_depth = 1;
+static atomic_bool g_running;
+static atomic_int g_ready;
+static atomic_ullong g_bulk_bytes;   // 大流量连接收到的回显字节数
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int connect_one(const struct sockaddr_in *addr) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval tv = { .tv_sec = 2, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if (connect(fd, (const struct sockaddr*)addr, sizeof(*addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int read_full(int fd, char *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, buf + got, len - got);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        got += (size_t)n;
+    }
+    return 0;
+}
+
+// 每轮向本线程所有连接各发一个请求，再依次收齐回显，服务端同时有conns个请求在处理
+static void *worker_main(void *arg) {
+    bench_worker_t *w = (bench_worker_t*)arg;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(g_port) };
+    inet_pton(AF_INET, g_host, &addr.sin_addr);
+
+    int *fds = calloc(w->conns, sizeof(int));
+    uint64_t *sent_at = calloc(w->conns, sizeof(uint64_t));
+    size_t batch = g_size * (size_t)g_depth;
+    char *req = malloc(batch);
+    char *resp = malloc(batch);
+    if (!fds || !sent_at || !req || !resp) {
+        atomic_fetch_add(&g_ready, 1);
+        goto out;
+    }
+    memset(req, 'r', batch);
+    for (int d = 1; d <= g_depth; d++) {
+        req[d * g_size - 1] = '\n';
+    }
+
+    int opened = 0;
+    for (; opened < w->conns; opened++) {
+        fds[opened] = connect_one(&addr);
+        if (fds[opened] < 0) {
+            w->errors++;
+            break;
+        }
+    }
+    atomic_fetch_add(&g_ready, 1);
+
+    while (atomic_load(&g_running) && opened > 0) {
+        for (int i = 0; i < opened; i++) {
+            sent_at[i] = now_us();
+            if (write(fds[i], req, batch) != (ssize_t)batch) w->errors++;
+        }
+        for (int i = 0; i < opened; i++) {
+            if (read_full(fds[i], resp, batch) != 0) {
+                w->errors++;
+                continue;
+            }
+            uint64_t bucket = (now_us() - sent_at[i]) / 10;
+            w->lat_hist[bucket < LAT_BUCKETS ? bucket : LAT_BUCKETS - 1] += (unsigned long)g_depth;
+            w->requests += (unsigned long)g_depth;
+        }
+    }
+
+    for (int i = 0; i < opened; i++) {
+        close(fds[i]);
+    }
+out:
+    free(fds);
+    free(sent_at);
+    free(req);
+    free(resp);
+    return NULL;
+}
+
+// 大流量连接：非阻塞，可写时整块发送，可读时读出回显丢弃
+static void *bulk_main(void *arg) {
+    (void)arg;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(g_port) };
+    inet_pton(AF_INET, g_host, &addr.sin_addr);
+
+    int fd = connect_one(&addr);
+    char *chunk = malloc(BULK_CHUNK);
+    if (fd < 0 || !chunk) {
+        if (fd >= 0) close(fd);
+        free(chunk);
+        return NULL;
+    }
+    memset(chunk, 'B', BULK_CHUNK);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    while (atomic_load(&g_running)) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN | POLLOUT };
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        if (pfd.revents & (POLLERR | POLLHUP)) break;
+        if (pfd.revents & POLLIN) {
+            ssize_t n;
+            while ((n = read(fd, chunk, BULK_CHUNK)) > 0) {
+                atomic_fetch_add_explicit(&g_bulk_bytes, (unsigned long long)n, memory_order_relaxed);
+            }
+            if (n == 0) break;
+            memset(chunk, 'B', BULK_CHUNK);
+        }
+        if (pfd.revents & POLLOUT) {
+            while (write(fd, chunk, BULK_CHUNK) > 0) {}
+        }
+    }
+
+    close(fd);
+    free(chunk);
+    return NULL;
+}
+
+// 合并后的直方图求百分位(us)
+static double percentile(const unsigned long *hist, unsigned long total, double p) {
+    unsigned long target = (unsigned long)(total * p);
+    unsigned long seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen > target) return i * 10.0;
+    }
+    return LAT_BUCKETS * 10.0;
+}
+
+// 服务端所有线程的系统调用合计，读取失败返回0
+static uint64_t server_syscalls(metrics_t *m) {
+    if (!m) return 0;
+    metric_id_t id = metrics_find(m, "reactor_syscalls_total");
+    return id == METRIC_INVALID ? 0 : metrics_sum(m, id);
+}
+
+// 服务进程所有线程的运行时间(ns)之和，读取失败返回0
+static uint64_t server_cpu_ns(const char *pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%s/task", pid);
+    DIR *dir = opendir(path);
+    if (!dir) return 0;
+
+    uint64_t total = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        char stat_path[300];
+        snprintf(stat_path, sizeof(stat_path), "/proc/%s/task/%s/schedstat", pid, de->d_name);
+        FILE *f = fopen(stat_path, "r");
+        if (!f) continue;
+        unsigned long long ns;
+        if (fscanf(f, "%llu", &ns) == 1) total += ns;
+        fclose(f);
+    }
+    closedir(dir);
+    return total;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = 4;
+    int conns = 64;
+    int seconds = 5;
+    const char *label = "reactor";
+    const char *server = NULL;
+    int bulk = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:t:c:s:d:l:m:B:P:")) != -1) {
+        switch (opt) {
+            case 'h': g_host = optarg; break;
+            case 'p': g_port = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'c': conns = atoi(optarg); break;
+            case 's': g_size = strtoul(optarg, NULL, 10); break;
+            case 'd': seconds = atoi(optarg); break;
+            case 'l': label = optarg; break;
+            case 'm': server = optarg; break;
+            case 'B': bulk = atoi(optarg); break;
+            case 'P': g_depth = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-h host] [-p port] [-t threads] [-c conns] [-s request_bytes] "
+                        "[-d seconds] [-l label] [-m server_pid|/shm-name] [-B bulk_conns] [-P pipeline_depth]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (threads <= 0) threads = 1;
+    if (conns < threads) conns = threads;
+    if (g_size == 0) g_size = 1;
+    if (g_size > MAX_REQUEST) g_size = MAX_REQUEST;
+    if (g_depth <= 0) g_depth = 1;
+    if ((size_t)g_depth * g_size > MAX_REQUEST) g_depth = (int)(MAX_REQUEST / g_size);
+
+    // 纯数字参数视为服务进程的pid
+    metrics_t *m = NULL;
+    const char *pid = NULL;
+    if (server) {
+        char shm_name[64];
+        if (isdigit((unsigned char)server[0])) {
+            snprintf(shm_name, sizeof(shm_name), "/reactor-%s", server);
+            pid = server;
+        } else {
+            snprintf(shm_name, sizeof(shm_name), "%s", server);
+        }
+        m = metrics_open(shm_name);
+        if (!m) fprintf(stderr, "Failed to open metrics %s, syscalls not reported\n", shm_name);
+    }
+
+    bench_worker_t *workers = calloc(threads, sizeof(bench_worker_t));
+    if (!workers) return 1;
+
+    atomic_store(&g_running, true);
+    atomic_store(&g_ready, 0);
+    for (int i = 0; i < threads; i++) {
+        workers[i].id = i;
+        workers[i].conns = conns / threads + (i < conns % threads);
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    // 连接全部建立后才开始计时和计数，建连的系统调用不计入
+    while (atomic_load(&g_ready) < threads) {
+        usleep(1000);
+    }
+    pthread_t *bulk_threads = bulk > 0 ? calloc(bulk, sizeof(pthread_t)) : NULL;
+    for (int i = 0; bulk_threads && i < bulk; i++) {
+        pthread_create(&bulk_threads[i], NULL, bulk_main, NULL);
+    }
+    // 大流量连接先跑一会儿，填满服务端的读写缓冲
+    if (bulk > 0) usleep(200000);
+    unsigned long long bulk_start = atomic_load(&g_bulk_bytes);
+    uint64_t syscalls_start = server_syscalls(m);
+    uint64_t cpu_start = pid ? server_cpu_ns(pid) : 0;
+    uint64_t start = now_us();
+    unsigned long requests_start = 0;
+    for (int i = 0; i < threads; i++) requests_start += workers[i].requests;
+
+    sleep(seconds);
+    // 先取服务端计数再停止，关闭连接的系统调用不计入
+    uint64_t syscalls = server_syscalls(m) - syscalls_start;
+    uint64_t cpu_ns = pid ? server_cpu_ns(pid) - cpu_start : 0;
+    unsigned long long bulk_bytes = atomic_load(&g_bulk_bytes) - bulk_start;
+    atomic_store(&g_running, false);
+    for (int i = 0; bulk_threads && i < bulk; i++) {
+        pthread_join(bulk_threads[i], NULL);
+    }
+    free(bulk_threads);
+
+    static unsigned long hist[LAT_BUCKETS];
+    unsigned long requests = 0, errors = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        requests += workers[i].requests;
+        errors += workers[i].errors;
+        for (int j = 0; j < LAT_BUCKETS; j++) hist[j] += workers[i].lat_hist[j];
+    }
+    double elapsed = (now_us() - start) / 1e6;
+    requests -= requests_start;
+
+    printf("mode=%s conns=%d size=%zu requests=%lu errors=%lu rate=%.0f/s p50=%.0fus p99=%.0fus",
+           label, conns, g_size, requests, errors, requests / elapsed,
+           percentile(hist, requests, 0.50), percentile(hist, requests, 0.99));
+    if (g_depth > 1) {
+        printf(" depth=%d", g_depth);
+    }
+    if (bulk > 0) {
+        printf(" bulk=%d bulk_rate=%.1fMB/s", bulk, bulk_bytes / elapsed / 1e6);
+    }
+    if (m) {
+        printf(" syscalls/req=%.2f", requests ? (double)syscalls / requests : 0.0);
+        metrics_close(m);
+    }
+    if (pid && cpu_ns > 0) {
+        printf(" cpu_ns/req=%.0f", requests ? (double)cpu_ns / requests : 0.0);
+    }
+    printf("\n");
+
+    free(workers);
+    return 0;
+}
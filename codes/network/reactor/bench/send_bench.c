@@ -0,0 +1,274 @@
+// send_bench.c - 跨线程发送压测：进程内启动Reactor，外部生产者线程按目标速率调用reactor_send
+// 推送定长消息，接收线程从客户端连接读取，统计投递速率、入队失败（队列满）和推送到收到的延迟
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../reactor.h"
+#include "log.h"
+
+#define LAT_BUCKETS 100000   // 10us一档，最长1s
+#define MAX_CONNS 4096
+#define MAX_PRODUCERS 64
+#define MAX_MESSAGE 4096
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    unsigned long rate;         // 本线程的目标速率（条/秒）
+    unsigned long sent;
+    unsigned long queue_full;   // reactor_send返回EAGAIN后重试的次数
+} producer_t;
+
+// 客户端连接的接收状态：消息可能跨多次read，不完整的部分留在partial中
+typedef struct {
+    int fd;
+    size_t have;
+    char partial[MAX_MESSAGE];
+} client_conn_t;
+
+static reactor_t *g_reactor;
+static int g_port = 9090;
+static size_t g_size = 64;
+static atomic_bool g_running;
+static atomic_bool g_receiving;
+
+// on_connect在Reactor线程执行，句柄供生产者线程使用
+static conn_handle_t g_handles[MAX_CONNS];
+static atomic_int g_connected;
+
+static atomic_ullong g_received;
+static unsigned long g_lat_hist[LAT_BUCKETS];   // 仅接收线程写
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void on_connect(connection_t *conn) {
+    int i = atomic_fetch_add(&g_connected, 1);
+    if (i < MAX_CONNS) g_handles[i] = conn->handle;
+}
+
+// 按1ms节拍发送，落后时补发；每条消息开头为发送时间，连接轮流选取
+static void *producer_main(void *arg) {
+    producer_t *p = (producer_t*)arg;
+    int conns = atomic_load(&g_connected);
+    char msg[MAX_MESSAGE];
+    memset(msg, 'm', g_size);
+
+    uint64_t start = now_ns();
+    unsigned long next = (unsigned long)p->id;
+    while (atomic_load(&g_running)) {
+        uint64_t elapsed = now_ns() - start;
+        unsigned long due = (unsigned long)(elapsed / 1000000 + 1) * p->rate / 1000;
+        if (p->sent >= due) {
+            struct timespec ts = { 0, 100000 };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        while (p->sent < due && atomic_load(&g_running)) {
+            uint64_t t = now_ns();
+            memcpy(msg, &t, sizeof(t));
+            if (reactor_send(g_reactor, g_handles[next % conns], msg, g_size) != 0) {
+                p->queue_full++;
+                sched_yield();
+                continue;
+            }
+            next++;
+            p->sent++;
+        }
+    }
+    return NULL;
+}
+
+static void *receiver_main(void *arg) {
+    client_conn_t *clients = (client_conn_t*)arg;
+    int conns = atomic_load(&g_connected);
+    int ep = epoll_create1(0);
+    for (int i = 0; i < conns; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &clients[i] };
+        epoll_ctl(ep, EPOLL_CTL_ADD, clients[i].fd, &ev);
+    }
+
+    static char buf[256 * 1024];
+    struct epoll_event events[256];
+    while (atomic_load(&g_receiving)) {
+        int n = epoll_wait(ep, events, 256, 100);
+        for (int i = 0; i < n; i++) {
+            client_conn_t *c = events[i].data.ptr;
+            ssize_t len = read(c->fd, buf, sizeof(buf));
+            if (len <= 0) continue;
+
+            uint64_t now = now_ns();
+            unsigned long count = 0;
+            for (ssize_t off = 0; off < len; ) {
+                size_t take = g_size - c->have;
+                if ((size_t)(len - off) < take) take = (size_t)(len - off);
+                memcpy(c->partial + c->have, buf + off, take);
+                c->have += take;
+                off += (ssize_t)take;
+                if (c->have < g_size) break;
+
+                uint64_t t;
+                memcpy(&t, c->partial, sizeof(t));
+                uint64_t bucket = (now - t) / 10000;
+                g_lat_hist[bucket < LAT_BUCKETS ? bucket : LAT_BUCKETS - 1]++;
+                c->have = 0;
+                count++;
+            }
+            atomic_fetch_add(&g_received, count);
+        }
+    }
+    close(ep);
+    return NULL;
+}
+
+static double percentile(const unsigned long *hist, unsigned long total, double p) {
+    unsigned long target = (unsigned long)(total * p);
+    unsigned long seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen > target) return i * 10.0;
+    }
+    return LAT_BUCKETS * 10.0;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = 2;
+    int producers = 4;
+    int conns = 64;
+    unsigned long rate = 1000000;
+    int seconds = 5;
+    reactor_backend_t backend = REACTOR_BACKEND_EPOLL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:t:P:c:r:s:d:b:")) != -1) {
+        switch (opt) {
+            case 'p': g_port = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'P': producers = atoi(optarg); break;
+            case 'c': conns = atoi(optarg); break;
+            case 'r': rate = strtoul(optarg, NULL, 10); break;
+            case 's': g_size = strtoul(optarg, NULL, 10); break;
+            case 'd': seconds = atoi(optarg); break;
+            case 'b': backend = strcmp(optarg, "uring") == 0 ? REACTOR_BACKEND_URING : REACTOR_BACKEND_EPOLL; break;
+            default:
+                fprintf(stderr, "Usage: %s [-p port] [-t reactor_threads] [-P producers] [-c conns] "
+                        "[-r total_msgs_per_sec] [-s message_bytes] [-d seconds] [-b epoll|uring]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (threads <= 0) threads = 1;
+    if (threads > MAX_REACTOR_THREADS) threads = MAX_REACTOR_THREADS;
+    if (producers <= 0) producers = 1;
+    if (producers > MAX_PRODUCERS) producers = MAX_PRODUCERS;
+    if (conns <= 0) conns = 1;
+    if (conns > MAX_CONNS) conns = MAX_CONNS;
+    if (g_size < sizeof(uint64_t)) g_size = sizeof(uint64_t);
+    if (g_size > MAX_MESSAGE) g_size = MAX_MESSAGE;
+
+    log_init(STDERR_FILENO, LOG_LEVEL_ERROR);
+
+    g_reactor = reactor_create_backend(threads, backend);
+    if (!g_reactor) {
+        fprintf(stderr, "Failed to create reactor\n");
+        return 1;
+    }
+    g_reactor->on_connect = on_connect;
+    if (reactor_listen_reuseport(g_reactor, g_port, false) != 0 || reactor_run(g_reactor) != 0) {
+        fprintf(stderr, "Failed to start reactor on port %d\n", g_port);
+        reactor_destroy(g_reactor);
+        return 1;
+    }
+
+    client_conn_t *clients = calloc(conns, sizeof(client_conn_t));
+    if (!clients) return 1;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(g_port) };
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    for (int i = 0; i < conns; i++) {
+        clients[i].fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (clients[i].fd < 0 || connect(clients[i].fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "Failed to connect client %d: %s\n", i, strerror(errno));
+            return 1;
+        }
+    }
+    for (int waited = 0; atomic_load(&g_connected) < conns && waited < 2000; waited++) {
+        usleep(1000);
+    }
+    if (atomic_load(&g_connected) < conns) {
+        fprintf(stderr, "Only %d of %d connections registered\n", atomic_load(&g_connected), conns);
+        return 1;
+    }
+
+    unsigned long long wakeups_start = 0;
+    for (int i = 0; i < g_reactor->thread_count; i++) {
+        wakeups_start += atomic_load(&g_reactor->threads[i]->wakeups_sent);
+    }
+
+    pthread_t receiver;
+    atomic_store(&g_receiving, true);
+    pthread_create(&receiver, NULL, receiver_main, clients);
+
+    producer_t *prods = calloc(producers, sizeof(producer_t));
+    atomic_store(&g_running, true);
+    uint64_t start = now_ns();
+    for (int i = 0; i < producers; i++) {
+        prods[i].id = i;
+        prods[i].rate = rate / producers + ((unsigned long)i < rate % producers);
+        pthread_create(&prods[i].thread, NULL, producer_main, &prods[i]);
+    }
+
+    sleep(seconds);
+    atomic_store(&g_running, false);
+    unsigned long sent = 0, queue_full = 0;
+    for (int i = 0; i < producers; i++) {
+        pthread_join(prods[i].thread, NULL);
+        sent += prods[i].sent;
+        queue_full += prods[i].queue_full;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    // 等在途消息收完（最多2秒）
+    for (int waited = 0; atomic_load(&g_received) < sent && waited < 2000; waited++) {
+        usleep(1000);
+    }
+    atomic_store(&g_receiving, false);
+    pthread_join(receiver, NULL);
+
+    unsigned long long wakeups = 0;
+    for (int i = 0; i < g_reactor->thread_count; i++) {
+        wakeups += atomic_load(&g_reactor->threads[i]->wakeups_sent);
+    }
+    wakeups -= wakeups_start;
+    unsigned long received = (unsigned long)atomic_load(&g_received);
+
+    printf("backend=%s threads=%d producers=%d conns=%d size=%zu target=%lu/s sent=%.0f/s received=%lu/%lu "
+           "queue_full=%lu wakeups/msg=%.4f p50=%.0fus p99=%.0fus\n",
+           g_reactor->backend == REACTOR_BACKEND_URING ? "uring" : "epoll", threads, producers, conns, g_size,
+           rate, sent / elapsed, received, sent, queue_full, sent ? (double)wakeups / sent : 0.0,
+           percentile(g_lat_hist, received, 0.50), percentile(g_lat_hist, received, 0.99));
+
+    for (int i = 0; i < conns; i++) {
+        close(clients[i].fd);
+    }
+    reactor_stop(g_reactor);
+    reactor_destroy(g_reactor);
+    free(clients);
+    free(prods);
+    return received == sent ? 0 : 1;
+}
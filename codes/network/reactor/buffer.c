@@ -0,0 +1,505 @@
+#include "buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 初始化段池
+void buf_pool_init(buf_pool_t *pool, uint32_t max_free) {
+    pool->free_list = NULL;
+    pool->free_count = 0;
+    pool->max_free = max_free;
+    pool->in_use = 0;
+    pool->allocated = 0;
+    pool->slice_free = NULL;
+    pool->slice_free_count = 0;
+    pool->slices_in_use = 0;
+    pool->copied_bytes = 0;
+    pool->zero_copy_bytes = 0;
+}
+
+// 释放池中所有空闲段（借出的段由使用者负责归还）
+void buf_pool_destroy(buf_pool_t *pool) {
+    while (pool->free_list) {
+        buf_segment_t *seg = pool->free_list;
+        pool->free_list = seg->next;
+        free(seg);
+    }
+    pool->free_count = 0;
+    
+    while (pool->slice_free) {
+        buf_slice_t *slice = pool->slice_free;
+        pool->slice_free = slice->next;
+        free(slice);
+    }
+    pool->slice_free_count = 0;
+}
+
+// 借出一个段
+buf_segment_t* buf_pool_get(buf_pool_t *pool) {
+    buf_segment_t *seg = pool->free_list;
+
+    if (seg) {
+        pool->free_list = seg->next;
+        pool->free_count--;
+    } else {
+        seg = malloc(BUF_SEGMENT_SIZE);
+        if (!seg) return NULL;
+        pool->allocated++;
+    }
+
+    seg->next = NULL;
+    seg->start = 0;
+    seg->end = 0;
+    seg->refs = 1;
+    pool->in_use++;
+    return seg;
+}
+
+// 释放一个引用，最后一个引用释放时归还段
+void buf_pool_put(buf_pool_t *pool, buf_segment_t *seg) {
+    if (--seg->refs > 0) return;
+    
+    pool->in_use--;
+
+    if (pool->free_count >= pool->max_free) {
+        free(seg);
+        return;
+    }
+
+    seg->next = pool->free_list;
+    pool->free_list = seg;
+    pool->free_count++;
+}
+
+// 把段挂到链尾
+static inline void chain_link_tail(buf_chain_t *c, buf_segment_t *seg) {
+    seg->next = NULL;
+    if (c->tail) {
+        c->tail->next = seg;
+    } else {
+        c->head = seg;
+    }
+    c->tail = seg;
+}
+
+// 预留可写空间
+int buf_chain_reserve(buf_chain_t *c, buf_pool_t *pool, struct iovec *iov, int max_iov) {
+    int n = 0;
+
+    if (c->tail && c->tail->end < BUF_SEGMENT_DATA_SIZE && n < max_iov) {
+        iov[n].iov_base = c->tail->data + c->tail->end;
+        iov[n].iov_len = BUF_SEGMENT_DATA_SIZE - c->tail->end;
+        n++;
+    }
+
+    // 预留段按顺序挂在spare上，commit时按实际写入量接入链尾
+    buf_segment_t **link = &c->spare;
+    while (*link) link = &(*link)->next;
+
+    while (n < max_iov) {
+        buf_segment_t *seg = buf_pool_get(pool);
+        if (!seg) break;
+        *link = seg;
+        link = &seg->next;
+        iov[n].iov_base = seg->data;
+        iov[n].iov_len = BUF_SEGMENT_DATA_SIZE;
+        n++;
+    }
+
+    return n;
+}
+
+// 提交readv写入的数据
+void buf_chain_commit(buf_chain_t *c, buf_pool_t *pool, size_t n) {
+    c->len += n;
+
+    if (c->tail && c->tail->end < BUF_SEGMENT_DATA_SIZE) {
+        size_t take = BUF_SEGMENT_DATA_SIZE - c->tail->end;
+        if (take > n) take = n;
+        c->tail->end += take;
+        n -= take;
+    }
+
+    while (n > 0 && c->spare) {
+        buf_segment_t *seg = c->spare;
+        c->spare = seg->next;
+
+        size_t take = n < BUF_SEGMENT_DATA_SIZE ? n : BUF_SEGMENT_DATA_SIZE;
+        seg->end = take;
+        n -= take;
+        chain_link_tail(c, seg);
+    }
+
+    // 未用到的预留段立即归还
+    while (c->spare) {
+        buf_segment_t *seg = c->spare;
+        c->spare = seg->next;
+        buf_pool_put(pool, seg);
+    }
+}
+
+// 挂接内核已写入的段
+void buf_chain_append_segment(buf_chain_t *c, buf_segment_t *seg, size_t len) {
+    seg->start = 0;
+    seg->end = (uint32_t)len;
+    chain_link_tail(c, seg);
+    c->len += len;
+}
+
+// 追加数据
+size_t buf_chain_append(buf_chain_t *c, buf_pool_t *pool, const void *data, size_t len) {
+    const char *src = (const char*)data;
+    size_t copied = 0;
+
+    while (copied < len) {
+        if (!c->tail || c->tail->end == BUF_SEGMENT_DATA_SIZE) {
+            buf_segment_t *seg = buf_pool_get(pool);
+            if (!seg) break;
+            chain_link_tail(c, seg);
+        }
+
+        size_t space = BUF_SEGMENT_DATA_SIZE - c->tail->end;
+        size_t take = len - copied < space ? len - copied : space;
+        memcpy(c->tail->data + c->tail->end, src + copied, take);
+        c->tail->end += take;
+        copied += take;
+    }
+
+    c->len += copied;
+    return copied;
+}
+
+// 取可读数据的iovec
+int buf_chain_iov(const buf_chain_t *c, struct iovec *iov, int max_iov) {
+    int n = 0;
+
+    for (buf_segment_t *seg = c->head; seg && n < max_iov; seg = seg->next) {
+        if (seg->end == seg->start) continue;
+        iov[n].iov_base = seg->data + seg->start;
+        iov[n].iov_len = seg->end - seg->start;
+        n++;
+    }
+
+    return n;
+}
+
+// 消费n字节
+void buf_chain_consume(buf_chain_t *c, buf_pool_t *pool, size_t n) {
+    if (n > c->len) n = c->len;
+    c->len -= n;
+
+    while (c->head) {
+        buf_segment_t *seg = c->head;
+        size_t avail = seg->end - seg->start;
+
+        if (n < avail) {
+            seg->start += n;
+            break;
+        }
+
+        // 读空的段立即归还，包括未写满的tail
+        n -= avail;
+        c->head = seg->next;
+        if (!c->head) c->tail = NULL;
+        buf_pool_put(pool, seg);
+    }
+}
+
+// 丢弃全部数据
+void buf_chain_clear(buf_chain_t *c, buf_pool_t *pool) {
+    buf_chain_consume(c, pool, c->len);
+    buf_chain_commit(c, pool, 0);
+}
+
+// 定位偏移off所在的段，off改为段内偏移
+static buf_segment_t* chain_seek(const buf_chain_t *c, size_t *off) {
+    buf_segment_t *seg = c->head;
+    
+    while (seg) {
+        size_t avail = seg->end - seg->start;
+        if (*off < avail) break;
+        *off -= avail;
+        seg = seg->next;
+    }
+    return seg;
+}
+
+// 拷贝数据（不消费）
+size_t buf_chain_peek(const buf_chain_t *c, size_t off, void *dst, size_t len) {
+    char *out = (char*)dst;
+    size_t copied = 0;
+    
+    for (buf_segment_t *seg = chain_seek(c, &off); seg && copied < len; seg = seg->next) {
+        size_t avail = seg->end - seg->start - off;
+        size_t take = len - copied < avail ? len - copied : avail;
+        memcpy(out + copied, seg->data + seg->start + off, take);
+        copied += take;
+        off = 0;
+    }
+    
+    return copied;
+}
+
+// 查找字节
+ssize_t buf_chain_find(const buf_chain_t *c, size_t off, char ch) {
+    size_t base = off;
+    
+    for (buf_segment_t *seg = chain_seek(c, &off); seg; seg = seg->next) {
+        const char *p = seg->data + seg->start + off;
+        size_t avail = seg->end - seg->start - off;
+        const char *hit = memchr(p, ch, avail);
+        if (hit) {
+            return (ssize_t)(base + (size_t)(hit - p));
+        }
+        base += avail;
+        off = 0;
+    }
+    
+    return -1;
+}
+
+// 取连续视图
+const char* buf_chain_linearize(const buf_chain_t *c, size_t off, size_t len, char *scratch) {
+    size_t seg_off = off;
+    buf_segment_t *seg = chain_seek(c, &seg_off);
+    
+    if (seg && seg->end - seg->start - seg_off >= len) {
+        return seg->data + seg->start + seg_off;
+    }
+    
+    buf_chain_peek(c, off, scratch, len);
+    return scratch;
+}
+
+// 借出一个片段节点
+static buf_slice_t* slice_get(buf_pool_t *pool) {
+    buf_slice_t *slice = pool->slice_free;
+    
+    if (slice) {
+        pool->slice_free = slice->next;
+        pool->slice_free_count--;
+    } else {
+        slice = malloc(sizeof(buf_slice_t));
+        if (!slice) return NULL;
+    }
+    
+    slice->next = NULL;
+    slice->seg = NULL;
+    slice->free_fn = NULL;
+    slice->free_arg = NULL;
+    pool->slices_in_use++;
+    return slice;
+}
+
+// 释放片段：段引用计数减一，外部内存回调释放函数
+static void slice_put(buf_pool_t *pool, buf_slice_t *slice) {
+    if (slice->seg) {
+        buf_pool_put(pool, slice->seg);
+    } else if (slice->free_fn) {
+        slice->free_fn(slice->free_arg);
+    }
+    
+    pool->slices_in_use--;
+    if (pool->slice_free_count >= pool->max_free) {
+        free(slice);
+        return;
+    }
+    slice->next = pool->slice_free;
+    pool->slice_free = slice;
+    pool->slice_free_count++;
+}
+
+// 片段挂到队尾
+static inline void outq_link_tail(buf_outq_t *q, buf_slice_t *slice) {
+    if (q->tail) {
+        q->tail->next = slice;
+    } else {
+        q->head = slice;
+    }
+    q->tail = slice;
+    q->len += slice->len;
+}
+
+// 拷贝入队
+size_t buf_outq_copy(buf_outq_t *q, buf_pool_t *pool, const void *data, size_t len) {
+    const char *src = (const char*)data;
+    size_t copied = 0;
+    
+    while (copied < len) {
+        buf_slice_t *tail = q->tail;
+        buf_segment_t *seg = tail ? tail->seg : NULL;
+        
+        // 队尾片段独占其段且位于段末尾时，直接追加到段的剩余空间
+        if (seg && seg->refs == 1 && tail->data + tail->len == seg->data + seg->end &&
+            seg->end < BUF_SEGMENT_DATA_SIZE) {
+            size_t space = BUF_SEGMENT_DATA_SIZE - seg->end;
+            size_t take = len - copied < space ? len - copied : space;
+            memcpy(seg->data + seg->end, src + copied, take);
+            seg->end += take;
+            tail->len += take;
+            q->len += take;
+            copied += take;
+            continue;
+        }
+        
+        seg = buf_pool_get(pool);
+        if (!seg) break;
+        buf_slice_t *slice = slice_get(pool);
+        if (!slice) {
+            buf_pool_put(pool, seg);
+            break;
+        }
+        
+        slice->seg = seg;
+        slice->data = seg->data;
+        slice->len = 0;
+        outq_link_tail(q, slice);
+    }
+    
+    pool->copied_bytes += copied;
+    return copied;
+}
+
+// 零拷贝入队外部内存
+int buf_outq_ref(buf_outq_t *q, buf_pool_t *pool, const void *data, size_t len,
+                 buf_free_fn free_fn, void *arg) {
+    if (len == 0) {
+        if (free_fn) free_fn(arg);
+        return 0;
+    }
+    
+    buf_slice_t *slice = slice_get(pool);
+    if (!slice) return -1;
+    
+    slice->data = (const char*)data;
+    slice->len = len;
+    slice->free_fn = free_fn;
+    slice->free_arg = arg;
+    outq_link_tail(q, slice);
+    
+    pool->zero_copy_bytes += len;
+    return 0;
+}
+
+// 零拷贝转移段链中的数据
+size_t buf_outq_splice(buf_outq_t *q, buf_pool_t *pool, buf_chain_t *src, size_t len) {
+    size_t moved = 0;
+    
+    if (len > src->len) len = src->len;
+    
+    for (buf_segment_t *seg = src->head; seg && moved < len; seg = seg->next) {
+        size_t avail = seg->end - seg->start;
+        if (avail == 0) continue;
+        
+        buf_slice_t *slice = slice_get(pool);
+        if (!slice) break;
+        
+        size_t take = len - moved < avail ? len - moved : avail;
+        buf_segment_ref(seg);
+        slice->seg = seg;
+        slice->data = seg->data + seg->start;
+        slice->len = take;
+        outq_link_tail(q, slice);
+        moved += take;
+    }
+    
+    // 段链释放自己的引用，段由片段继续持有
+    buf_chain_consume(src, pool, moved);
+    
+    pool->zero_copy_bytes += moved;
+    return moved;
+}
+
+// 取待发送数据的iovec
+int buf_outq_iov(const buf_outq_t *q, struct iovec *iov, int max_iov) {
+    int n = 0;
+    
+    for (buf_slice_t *slice = q->head; slice && n < max_iov; slice = slice->next) {
+        if (slice->len == 0) continue;
+        iov[n].iov_base = (void*)slice->data;
+        iov[n].iov_len = slice->len;
+        n++;
+    }
+    
+    return n;
+}
+
+// 拷贝待发送数据（不消费）
+size_t buf_outq_peek(const buf_outq_t *q, void *dst, size_t len) {
+    char *out = (char*)dst;
+    size_t copied = 0;
+    
+    for (buf_slice_t *slice = q->head; slice && copied < len; slice = slice->next) {
+        size_t take = len - copied < slice->len ? len - copied : slice->len;
+        memcpy(out + copied, slice->data, take);
+        copied += take;
+    }
+    
+    return copied;
+}
+
+// 消费n字节
+void buf_outq_consume(buf_outq_t *q, buf_pool_t *pool, size_t n) {
+    if (n > q->len) n = q->len;
+    q->len -= n;
+    
+    while (q->head) {
+        buf_slice_t *slice = q->head;
+        
+        if (n < slice->len) {
+            slice->data += n;
+            slice->len -= n;
+            break;
+        }
+        
+        n -= slice->len;
+        q->head = slice->next;
+        if (!q->head) q->tail = NULL;
+        slice_put(pool, slice);
+    }
+}
+
+// 丢弃全部数据
+void buf_outq_clear(buf_outq_t *q, buf_pool_t *pool) {
+    buf_outq_consume(q, pool, q->len);
+}
+
+// 撤销队尾的数据
+void buf_outq_truncate(buf_outq_t *q, buf_pool_t *pool, size_t len) {
+    if (len >= q->len) return;
+    
+    buf_slice_t *keep = NULL;
+    buf_slice_t *slice = q->head;
+    size_t pos = 0;
+    while (slice && pos + slice->len <= len) {
+        pos += slice->len;
+        keep = slice;
+        slice = slice->next;
+    }
+    
+    // 跨过len的片段截短；拷贝合并进段末尾的数据同时退回段的写入位置
+    if (slice && len > pos) {
+        size_t cut = slice->len - (len - pos);
+        buf_segment_t *seg = slice->seg;
+        if (seg && seg->refs == 1 && slice->data + slice->len == seg->data + seg->end) {
+            seg->end -= (uint32_t)cut;
+        }
+        slice->len -= cut;
+        keep = slice;
+        slice = slice->next;
+    }
+    
+    if (keep) {
+        keep->next = NULL;
+    } else {
+        q->head = NULL;
+    }
+    q->tail = keep;
+    q->len = len;
+    
+    while (slice) {
+        buf_slice_t *next = slice->next;
+        slice->free_fn = NULL;
+        slice_put(pool, slice);
+        slice = next;
+    }
+}
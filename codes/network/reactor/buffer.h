@@ -0,0 +1,148 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+
+// 固定大小的缓冲段，从线程本地池中按需借出，数据读空后立即归还
+// 空闲连接的读写链都为空，不占用任何数据内存
+#define BUF_SEGMENT_SIZE 4096
+#define BUF_RESERVE_MAX 4      // 单次readv最多预留的段数（含tail剩余空间）
+#define BUF_IOV_MAX 64         // 单次writev最多提交的段数
+#define BUF_COPY_MAX 256       // 小于该长度的数据拷贝进段，不单独挂外部内存片段
+
+// 段带引用计数：输入链和发送队列的片段可以同时引用同一个段，计数归零才归还池
+typedef struct buf_segment_s {
+    struct buf_segment_s *next;
+    uint32_t start;   // 已消费位置
+    uint32_t end;     // 已写入位置
+    uint32_t refs;    // 引用计数（仅所属线程访问，不需要原子操作）
+    char data[];
+} buf_segment_t;
+
+#define BUF_SEGMENT_DATA_SIZE (BUF_SEGMENT_SIZE - sizeof(buf_segment_t))
+
+typedef void (*buf_free_fn)(void *arg);
+
+// 发送队列的片段：引用段中的一段数据，或引用外部内存（发送完后回调free_fn）
+typedef struct buf_slice_s {
+    struct buf_slice_s *next;
+    const char *data;
+    size_t len;
+    buf_segment_t *seg;     // 引用的段，外部内存为NULL
+    buf_free_fn free_fn;
+    void *free_arg;
+} buf_slice_t;
+
+// 段池：仅由所属线程访问，同时缓存片段节点
+typedef struct buf_pool_s {
+    buf_segment_t *free_list;
+    uint32_t free_count;
+    uint32_t max_free;      // 空闲段上限，超出部分归还系统
+    uint64_t in_use;        // 当前借出的段数
+    uint64_t allocated;     // 向系统申请过的段总数
+    
+    buf_slice_t *slice_free;
+    uint32_t slice_free_count;
+    uint64_t slices_in_use;
+    
+    // 发送队列统计：拷贝入队与零拷贝入队的字节数
+    uint64_t copied_bytes;
+    uint64_t zero_copy_bytes;
+} buf_pool_t;
+
+// 段链：head读、tail写
+typedef struct buf_chain_s {
+    buf_segment_t *head;
+    buf_segment_t *tail;
+    buf_segment_t *spare;   // reserve预留、尚未写入数据的新段
+    size_t len;             // 可读字节数
+} buf_chain_t;
+
+// 发送队列：片段链，writev直接由片段生成iovec
+typedef struct buf_outq_s {
+    buf_slice_t *head;
+    buf_slice_t *tail;
+    size_t len;             // 待发送字节数
+} buf_outq_t;
+
+// 段池API
+void buf_pool_init(buf_pool_t *pool, uint32_t max_free);
+void buf_pool_destroy(buf_pool_t *pool);
+buf_segment_t* buf_pool_get(buf_pool_t *pool);
+// 释放一个引用，计数归零时段归还池
+void buf_pool_put(buf_pool_t *pool, buf_segment_t *seg);
+
+static inline void buf_segment_ref(buf_segment_t *seg) {
+    seg->refs++;
+}
+
+// 段链API
+static inline void buf_chain_init(buf_chain_t *c) {
+    c->head = c->tail = c->spare = NULL;
+    c->len = 0;
+}
+
+static inline bool buf_chain_empty(const buf_chain_t *c) {
+    return c->len == 0;
+}
+
+// 预留可写空间（tail剩余空间+新段），返回iovec个数，用于readv
+int buf_chain_reserve(buf_chain_t *c, buf_pool_t *pool, struct iovec *iov, int max_iov);
+// 提交readv实际写入的n字节，未用到的预留段归还池
+void buf_chain_commit(buf_chain_t *c, buf_pool_t *pool, size_t n);
+
+// 把已写入len字节的段挂到链尾（段的引用转移给链），用于内核直接写入的缓冲
+void buf_chain_append_segment(buf_chain_t *c, buf_segment_t *seg, size_t len);
+
+// 追加数据（拷贝），内存不足时返回实际追加的字节数
+size_t buf_chain_append(buf_chain_t *c, buf_pool_t *pool, const void *data, size_t len);
+
+// 取可读数据的iovec，用于writev
+int buf_chain_iov(const buf_chain_t *c, struct iovec *iov, int max_iov);
+// 消费n字节，读空的段归还池
+void buf_chain_consume(buf_chain_t *c, buf_pool_t *pool, size_t n);
+// 丢弃全部数据
+void buf_chain_clear(buf_chain_t *c, buf_pool_t *pool);
+
+// 拷贝从off开始的最多len字节到dst（不消费），返回实际拷贝的字节数
+size_t buf_chain_peek(const buf_chain_t *c, size_t off, void *dst, size_t len);
+// 从off开始查找字节ch，返回相对链头的偏移，找不到返回-1
+ssize_t buf_chain_find(const buf_chain_t *c, size_t off, char ch);
+// 取[off, off+len)的连续视图：位于同一段时直接返回段内指针，跨段时拷贝到scratch
+const char* buf_chain_linearize(const buf_chain_t *c, size_t off, size_t len, char *scratch);
+
+// 发送队列API
+static inline void buf_outq_init(buf_outq_t *q) {
+    q->head = q->tail = NULL;
+    q->len = 0;
+}
+
+static inline bool buf_outq_empty(const buf_outq_t *q) {
+    return q->len == 0;
+}
+
+// 拷贝入队（协议头等小块数据），尽量合并到队尾段的剩余空间，返回实际入队的字节数
+size_t buf_outq_copy(buf_outq_t *q, buf_pool_t *pool, const void *data, size_t len);
+// 零拷贝入队外部内存，发送完或丢弃时调用free_fn(arg)（free_fn可为NULL）；失败返回-1，不调用free_fn
+int buf_outq_ref(buf_outq_t *q, buf_pool_t *pool, const void *data, size_t len,
+                 buf_free_fn free_fn, void *arg);
+// 零拷贝转移段链头部的len字节：片段引用原段，段链消费这部分数据，返回实际转移的字节数
+size_t buf_outq_splice(buf_outq_t *q, buf_pool_t *pool, buf_chain_t *src, size_t len);
+
+// 取待发送数据的iovec，用于writev
+int buf_outq_iov(const buf_outq_t *q, struct iovec *iov, int max_iov);
+// 拷贝最多len字节待发送数据到dst（不消费），返回实际拷贝的字节数
+size_t buf_outq_peek(const buf_outq_t *q, void *dst, size_t len);
+// 消费n字节，发送完的片段释放引用
+void buf_outq_consume(buf_outq_t *q, buf_pool_t *pool, size_t n);
+// 丢弃全部数据
+void buf_outq_clear(buf_outq_t *q, buf_pool_t *pool);
+// 撤销len之后入队的数据（多段入队中途失败时回退到入队前的长度），
+// 被撤销的外部内存片段不回调free_fn，释放责任仍在调用者
+void buf_outq_truncate(buf_outq_t *q, buf_pool_t *pool, size_t len);
+
+#endif
@@ -0,0 +1,475 @@
+#define _GNU_SOURCE
+#include "codec.h"
+#include "log.h"
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <ctype.h>
+
+// ---------------- 长度前缀 ----------------
+
+static ssize_t length_prefix_decode(reactor_t *reactor, connection_t *conn, char *scratch, codec_frame_t *frame) {
+    (void)reactor;
+    uint8_t hdr[4];
+
+    if (buf_chain_peek(&conn->input, 0, hdr, sizeof(hdr)) < sizeof(hdr)) {
+        return 0;
+    }
+
+    uint32_t len = ((uint32_t)hdr[0] << 24) | ((uint32_t)hdr[1] << 16) | ((uint32_t)hdr[2] << 8) | hdr[3];
+    if (len > CODEC_MAX_FRAME) {
+        return -1;
+    }
+    if (conn->input.len < sizeof(hdr) + len) {
+        return 0;
+    }
+
+    frame->data = buf_chain_linearize(&conn->input, sizeof(hdr), len, scratch);
+    frame->len = len;
+    frame->type = CODEC_FRAME_BINARY;
+    frame->fin = true;
+    return (ssize_t)(sizeof(hdr) + len);
+}
+
+static int length_prefix_encode(connection_t *conn, const codec_frame_t *frame,
+                                char *hdr, size_t *hdr_len, char *trl, size_t *trl_len) {
+    (void)conn;
+    (void)trl;
+
+    if (frame->len > 0xFFFFFFFFu) {
+        return -1;
+    }
+
+    uint32_t len = (uint32_t)frame->len;
+    hdr[0] = (char)(len >> 24);
+    hdr[1] = (char)(len >> 16);
+    hdr[2] = (char)(len >> 8);
+    hdr[3] = (char)len;
+    *hdr_len = 4;
+    *trl_len = 0;
+    return 0;
+}
+
+const codec_t codec_length_prefix = {
+    .name = "length",
+    .decode = length_prefix_decode,
+    .encode = length_prefix_encode,
+};
+
+// ---------------- 按行 ----------------
+
+// codec_state记录已扫描过的字节数，半行数据到达时不重复扫描
+static ssize_t line_decode(reactor_t *reactor, connection_t *conn, char *scratch, codec_frame_t *frame) {
+    (void)reactor;
+
+    ssize_t pos = buf_chain_find(&conn->input, conn->codec_state, '\n');
+    if (pos < 0) {
+        if (conn->input.len > CODEC_MAX_FRAME) {
+            return -1;
+        }
+        conn->codec_state = (uint32_t)conn->input.len;
+        return 0;
+    }
+    if ((size_t)pos > CODEC_MAX_FRAME) {
+        return -1;
+    }
+
+    conn->codec_state = 0;
+
+    size_t len = (size_t)pos;
+    frame->data = buf_chain_linearize(&conn->input, 0, len, scratch);
+    if (len > 0 && frame->data[len - 1] == '\r') {
+        len--;
+    }
+    frame->len = len;
+    frame->type = CODEC_FRAME_TEXT;
+    frame->fin = true;
+    return pos + 1;
+}
+
+static int line_encode(connection_t *conn, const codec_frame_t *frame,
+                       char *hdr, size_t *hdr_len, char *trl, size_t *trl_len) {
+    (void)conn;
+    (void)frame;
+    (void)hdr;
+
+    *hdr_len = 0;
+    trl[0] = '\n';
+    *trl_len = 1;
+    return 0;
+}
+
+const codec_t codec_line = {
+    .name = "line",
+    .decode = line_decode,
+    .encode = line_encode,
+};
+
+// ---------------- WebSocket ----------------
+
+#define WS_STATE_HANDSHAKE 0
+#define WS_STATE_OPEN      1
+#define WS_STATE_CLOSING   2
+#define WS_STATE_MASK      0xFF
+// 收到fin=0的数据帧后置位，直到fin=1的续帧结束该消息；控制帧可穿插其间
+#define WS_FRAGMENTED      0x100
+
+#define WS_STATE(conn) ((conn)->codec_state & WS_STATE_MASK)
+
+#define WS_HANDSHAKE_MAX 8192
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+// SHA-1（仅用于计算Sec-WebSocket-Accept）
+typedef struct sha1_ctx_s {
+    uint32_t h[5];
+    uint64_t len;
+    uint8_t block[64];
+    uint32_t used;
+} sha1_ctx_t;
+
+#define SHA1_ROL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+static void sha1_transform(sha1_ctx_t *ctx, const uint8_t *block) {
+    uint32_t w[80];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = SHA1_ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = ctx->h[0], b = ctx->h[1], c = ctx->h[2], d = ctx->h[3], e = ctx->h[4];
+
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = SHA1_ROL(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = SHA1_ROL(b, 30);
+        b = a;
+        a = t;
+    }
+
+    ctx->h[0] += a;
+    ctx->h[1] += b;
+    ctx->h[2] += c;
+    ctx->h[3] += d;
+    ctx->h[4] += e;
+}
+
+static void sha1_init(sha1_ctx_t *ctx) {
+    ctx->h[0] = 0x67452301;
+    ctx->h[1] = 0xEFCDAB89;
+    ctx->h[2] = 0x98BADCFE;
+    ctx->h[3] = 0x10325476;
+    ctx->h[4] = 0xC3D2E1F0;
+    ctx->len = 0;
+    ctx->used = 0;
+}
+
+static void sha1_update(sha1_ctx_t *ctx, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t*)data;
+
+    ctx->len += len;
+    while (len > 0) {
+        uint32_t take = 64 - ctx->used;
+        if (take > len) take = (uint32_t)len;
+        memcpy(ctx->block + ctx->used, p, take);
+        ctx->used += take;
+        p += take;
+        len -= take;
+        if (ctx->used == 64) {
+            sha1_transform(ctx, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
+
+static void sha1_final(sha1_ctx_t *ctx, uint8_t digest[20]) {
+    uint64_t bits = ctx->len * 8;
+    uint8_t pad = 0x80;
+
+    sha1_update(ctx, &pad, 1);
+    pad = 0;
+    while (ctx->used != 56) {
+        sha1_update(ctx, &pad, 1);
+    }
+
+    uint8_t tail[8];
+    for (int i = 0; i < 8; i++) {
+        tail[i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+    sha1_update(ctx, tail, 8);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (uint8_t)(ctx->h[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->h[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->h[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)ctx->h[i];
+    }
+}
+
+// base64编码，out至少 4*((len+2)/3)+1 字节
+static void base64_encode(const uint8_t *in, size_t len, char *out) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i = 0;
+
+    for (; i + 2 < len; i += 3) {
+        uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        *out++ = table[(v >> 18) & 63];
+        *out++ = table[(v >> 12) & 63];
+        *out++ = table[(v >> 6) & 63];
+        *out++ = table[v & 63];
+    }
+    if (i < len) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        *out++ = table[(v >> 18) & 63];
+        *out++ = table[(v >> 12) & 63];
+        *out++ = i + 1 < len ? table[(v >> 6) & 63] : '=';
+        *out++ = '=';
+    }
+    *out = '\0';
+}
+
+// 在握手请求中查找Sec-WebSocket-Key（头名不区分大小写）
+static bool ws_find_key(const char *req, size_t len, const char **key, size_t *key_len) {
+    static const char name[] = "Sec-WebSocket-Key:";
+    const size_t name_len = sizeof(name) - 1;
+    const char *end = req + len;
+
+    for (const char *line = req; line < end; ) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) eol = end;
+
+        if ((size_t)(eol - line) > name_len && strncasecmp(line, name, name_len) == 0) {
+            const char *v = line + name_len;
+            const char *ve = eol;
+            while (v < ve && isspace((unsigned char)*v)) v++;
+            while (ve > v && isspace((unsigned char)ve[-1])) ve--;
+            if (ve == v) return false;
+            *key = v;
+            *key_len = (size_t)(ve - v);
+            return true;
+        }
+        line = eol + 1;
+    }
+
+    return false;
+}
+
+// 握手：等到完整的请求头，回复101
+static ssize_t ws_handshake(reactor_t *reactor, connection_t *conn, char *scratch) {
+    size_t scan = conn->input.len < WS_HANDSHAKE_MAX ? conn->input.len : WS_HANDSHAKE_MAX;
+    const char *req = buf_chain_linearize(&conn->input, 0, scan, scratch);
+    const char *end = memmem(req, scan, "\r\n\r\n", 4);
+
+    if (!end) {
+        return conn->input.len >= WS_HANDSHAKE_MAX ? -1 : 0;
+    }
+    size_t req_len = (size_t)(end - req) + 4;
+
+    const char *key;
+    size_t key_len;
+    if (!ws_find_key(req, req_len, &key, &key_len)) {
+        LOG_DEBUG("WebSocket handshake without Sec-WebSocket-Key on fd=%d", conn->fd);
+        return -1;
+    }
+
+    uint8_t digest[20];
+    sha1_ctx_t sha;
+    sha1_init(&sha);
+    sha1_update(&sha, key, key_len);
+    sha1_update(&sha, WS_GUID, sizeof(WS_GUID) - 1);
+    sha1_final(&sha, digest);
+
+    char accept[32];
+    base64_encode(digest, sizeof(digest), accept);
+
+    char resp[256];
+    int n = snprintf(resp, sizeof(resp),
+                     "HTTP/1.1 101 Switching Protocols\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+    if (reactor_write(reactor, conn, resp, (size_t)n) != (size_t)n) {
+        return -1;
+    }
+
+    conn->codec_state = WS_STATE_OPEN;
+    return (ssize_t)req_len;
+}
+
+// 写一个完整的控制帧（pong/close）
+static int ws_write_control(reactor_t *reactor, connection_t *conn, uint32_t opcode, const char *data, size_t len) {
+    char hdr[2] = { (char)(0x80 | opcode), (char)len };
+
+    if (reactor_write(reactor, conn, hdr, sizeof(hdr)) != sizeof(hdr) ||
+        reactor_write(reactor, conn, data, len) != len) {
+        return -1;
+    }
+    return 0;
+}
+
+static ssize_t ws_decode(reactor_t *reactor, connection_t *conn, char *scratch, codec_frame_t *frame) {
+    if (WS_STATE(conn) == WS_STATE_HANDSHAKE) {
+        ssize_t n = ws_handshake(reactor, conn, scratch);
+        if (n > 0) frame->type = CODEC_FRAME_NONE;
+        return n;
+    }
+
+    uint8_t hdr[14];
+    size_t have = buf_chain_peek(&conn->input, 0, hdr, sizeof(hdr));
+    if (have < 2) {
+        return 0;
+    }
+
+    bool fin = (hdr[0] & 0x80) != 0;
+    uint32_t opcode = hdr[0] & 0x0F;
+    bool masked = (hdr[1] & 0x80) != 0;
+    uint64_t len = hdr[1] & 0x7F;
+    size_t hdr_len = 2;
+
+    // 客户端发来的帧必须带掩码，不支持扩展（RSV位）
+    if (!masked || (hdr[0] & 0x70)) {
+        return -1;
+    }
+
+    if (len == 126) {
+        hdr_len += 2;
+    } else if (len == 127) {
+        hdr_len += 8;
+    }
+    if (have < hdr_len + 4) {
+        return 0;
+    }
+    if (len == 126) {
+        len = ((uint64_t)hdr[2] << 8) | hdr[3];
+    } else if (len == 127) {
+        len = 0;
+        for (int i = 0; i < 8; i++) {
+            len = (len << 8) | hdr[2 + i];
+        }
+    }
+
+    const uint8_t *mask = hdr + hdr_len;
+    hdr_len += 4;
+
+    // 控制帧不能分片，负载不超过125字节
+    if (opcode >= 0x8 && (!fin || len > 125)) {
+        return -1;
+    }
+    if (len > CODEC_MAX_FRAME) {
+        return -1;
+    }
+    if (conn->input.len < hdr_len + len) {
+        return 0;
+    }
+
+    // 去掩码需要改写数据，负载总是拷贝到拼接缓冲
+    buf_chain_peek(&conn->input, hdr_len, scratch, (size_t)len);
+    for (uint64_t i = 0; i < len; i++) {
+        scratch[i] ^= (char)mask[i & 3];
+    }
+
+    frame->data = scratch;
+    frame->len = (size_t)len;
+    frame->type = opcode;
+    frame->fin = fin;
+
+    switch (opcode) {
+    case CODEC_FRAME_CONTINUATION:
+    case CODEC_FRAME_TEXT:
+    case CODEC_FRAME_BINARY:
+        // 续帧必须跟在未结束的消息之后，新消息不能打断未结束的消息
+        if ((opcode == CODEC_FRAME_CONTINUATION) != ((conn->codec_state & WS_FRAGMENTED) != 0)) {
+            return -1;
+        }
+        if (fin) {
+            conn->codec_state &= ~WS_FRAGMENTED;
+        } else {
+            conn->codec_state |= WS_FRAGMENTED;
+        }
+        if (WS_STATE(conn) == WS_STATE_CLOSING) {
+            frame->type = CODEC_FRAME_NONE;
+        }
+        break;
+    case CODEC_FRAME_PING:
+        if (ws_write_control(reactor, conn, CODEC_FRAME_PONG, scratch, (size_t)len) != 0) {
+            return -1;
+        }
+        frame->type = CODEC_FRAME_NONE;
+        break;
+    case CODEC_FRAME_PONG:
+        frame->type = CODEC_FRAME_NONE;
+        break;
+    case CODEC_FRAME_CLOSE:
+        // 原样回复状态码，交给应用后等待对端关闭TCP连接
+        if (WS_STATE(conn) == WS_STATE_OPEN) {
+            conn->codec_state = WS_STATE_CLOSING;
+            if (ws_write_control(reactor, conn, CODEC_FRAME_CLOSE, scratch, len >= 2 ? 2 : 0) != 0) {
+                return -1;
+            }
+        } else {
+            frame->type = CODEC_FRAME_NONE;
+        }
+        break;
+    default:
+        return -1;
+    }
+
+    return (ssize_t)(hdr_len + len);
+}
+
+// 服务端发出的帧不带掩码
+static int ws_encode(connection_t *conn, const codec_frame_t *frame,
+                     char *hdr, size_t *hdr_len, char *trl, size_t *trl_len) {
+    (void)trl;
+
+    if (WS_STATE(conn) != WS_STATE_OPEN) {
+        return -1;
+    }
+
+    uint32_t opcode = frame->type == CODEC_FRAME_NONE ? CODEC_FRAME_BINARY : frame->type;
+    uint64_t len = frame->len;
+
+    hdr[0] = (char)((frame->fin ? 0x80 : 0) | (opcode & 0x0F));
+    if (len < 126) {
+        hdr[1] = (char)len;
+        *hdr_len = 2;
+    } else if (len <= 0xFFFF) {
+        hdr[1] = 126;
+        hdr[2] = (char)(len >> 8);
+        hdr[3] = (char)len;
+        *hdr_len = 4;
+    } else {
+        hdr[1] = 127;
+        for (int i = 0; i < 8; i++) {
+            hdr[2 + i] = (char)(len >> (56 - i * 8));
+        }
+        *hdr_len = 10;
+    }
+    *trl_len = 0;
+    return 0;
+}
+
+const codec_t codec_websocket = {
+    .name = "websocket",
+    .decode = ws_decode,
+    .encode = ws_encode,
+};
@@ -0,0 +1,46 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include "reactor.h"
+#include <sys/types.h>
+
+// 编解码层：在Reactor线程内直接从输入段链解帧，不再把原始字节交给其他线程解析
+#define CODEC_MAX_FRAME 65536   // 单帧负载上限，超出视为协议错误；也是每线程拼接缓冲的大小
+#define CODEC_HDR_MAX 16        // 帧头/帧尾的最大长度
+
+// 帧类型：WebSocket直接使用opcode，其他编解码器只产生TEXT/BINARY
+#define CODEC_FRAME_CONTINUATION 0x0
+#define CODEC_FRAME_TEXT         0x1
+#define CODEC_FRAME_BINARY       0x2
+#define CODEC_FRAME_CLOSE        0x8
+#define CODEC_FRAME_PING         0x9
+#define CODEC_FRAME_PONG         0xA
+#define CODEC_FRAME_NONE         0xFF   // 协议内部消息（握手、心跳），不交给应用
+
+struct codec_frame_s {
+    const char *data;   // 负载：位于单个段内时直接指向段，跨段或需改写时指向线程的拼接缓冲
+    size_t len;
+    uint32_t type;
+    bool fin;           // WebSocket分片的最后一片，其他编解码器恒为true
+};
+
+struct codec_s {
+    const char *name;
+
+    // 从conn->input头部解出一帧（不消费）：返回帧的总长度，需要更多数据返回0，协议错误返回-1
+    // 握手应答、pong等协议内部回复由decode直接写入发送队列
+    ssize_t (*decode)(reactor_t *reactor, connection_t *conn, char *scratch, codec_frame_t *frame);
+
+    // 生成帧头和帧尾（各不超过CODEC_HDR_MAX），负载由调用者单独入队；失败返回-1
+    int (*encode)(connection_t *conn, const codec_frame_t *frame,
+                  char *hdr, size_t *hdr_len, char *trl, size_t *trl_len);
+};
+
+// 4字节大端长度前缀
+extern const codec_t codec_length_prefix;
+// 按'\n'分行，去掉行尾的"\r\n"或"\n"
+extern const codec_t codec_line;
+// WebSocket（RFC 6455）服务端：HTTP Upgrade握手，自动应答ping和close
+extern const codec_t codec_websocket;
+
+#endif
@@ -0,0 +1,201 @@
+#include "group.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define GROUP_MIN_MEMBERS 8
+
+static inline uint32_t group_hash(uint64_t gid) {
+    uint64_t h = gid * 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(h >> 32);
+}
+
+// 初始化组表，容量向上取整为2的幂
+int group_table_init(group_table_t *t, uint32_t capacity) {
+    if (!t) return -1;
+
+    uint32_t cap = 16;
+    while (cap < capacity) cap <<= 1;
+
+    t->buckets = calloc(cap, sizeof(conn_group_t*));
+    if (!t->buckets) return -1;
+    t->mask = cap - 1;
+    t->count = 0;
+    return 0;
+}
+
+static void group_free(conn_group_t *g) {
+    free(g->members);
+    free(g->index);
+    free(g);
+}
+
+void group_table_destroy(group_table_t *t) {
+    if (!t || !t->buckets) return;
+
+    for (uint32_t i = 0; i <= t->mask; i++) {
+        if (t->buckets[i]) group_free(t->buckets[i]);
+    }
+    free(t->buckets);
+    t->buckets = NULL;
+    t->count = 0;
+}
+
+conn_group_t *group_table_find(const group_table_t *t, uint64_t gid) {
+    for (uint32_t i = group_hash(gid) & t->mask; t->buckets[i]; i = (i + 1) & t->mask) {
+        if (t->buckets[i]->gid == gid) return t->buckets[i];
+    }
+    return NULL;
+}
+
+// 负载超过一半时扩容一倍，重新插入所有组
+static int group_table_grow(group_table_t *t) {
+    uint32_t old_cap = t->mask + 1;
+    conn_group_t **old = t->buckets;
+
+    t->buckets = calloc((size_t)old_cap * 2, sizeof(conn_group_t*));
+    if (!t->buckets) {
+        t->buckets = old;
+        return -1;
+    }
+    t->mask = old_cap * 2 - 1;
+
+    for (uint32_t i = 0; i < old_cap; i++) {
+        if (!old[i]) continue;
+        uint32_t j = group_hash(old[i]->gid) & t->mask;
+        while (t->buckets[j]) j = (j + 1) & t->mask;
+        t->buckets[j] = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+conn_group_t *group_table_get(group_table_t *t, uint64_t gid) {
+    conn_group_t *g = group_table_find(t, gid);
+    if (g) return g;
+
+    if ((t->count + 1) * 2 > t->mask + 1 && group_table_grow(t) != 0) {
+        return NULL;
+    }
+
+    g = calloc(1, sizeof(conn_group_t));
+    if (!g) return NULL;
+    g->gid = gid;
+
+    uint32_t i = group_hash(gid) & t->mask;
+    while (t->buckets[i]) i = (i + 1) & t->mask;
+    t->buckets[i] = g;
+    t->count++;
+    return g;
+}
+
+// 删除后把同一探测链上后面的组前移，查找不会在空位处提前结束
+void group_table_remove(group_table_t *t, conn_group_t *g) {
+    uint32_t i = group_hash(g->gid) & t->mask;
+    while (t->buckets[i] != g) {
+        if (!t->buckets[i]) return;
+        i = (i + 1) & t->mask;
+    }
+
+    t->buckets[i] = NULL;
+    t->count--;
+    for (uint32_t j = (i + 1) & t->mask; t->buckets[j]; j = (j + 1) & t->mask) {
+        uint32_t home = group_hash(t->buckets[j]->gid) & t->mask;
+        // home不在(i, j]区间内时，该组可以前移到空位i
+        if (((j - home) & t->mask) >= ((j - i) & t->mask)) {
+            t->buckets[i] = t->buckets[j];
+            t->buckets[j] = NULL;
+            i = j;
+        }
+    }
+    group_free(g);
+}
+
+static inline uint32_t index_mask(const conn_group_t *g) {
+    return g->capacity * 2 - 1;
+}
+
+// 查找句柄在索引中的位置，不存在时返回可插入的空位；调用前capacity必须不为0
+static uint32_t index_probe(const conn_group_t *g, uint64_t handle) {
+    uint32_t mask = index_mask(g);
+    uint32_t i = group_hash(handle) & mask;
+    while (g->index[i] && g->members[g->index[i] - 1] != handle) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// 从索引中删除位置i，后移填补的方式与group_table_remove相同
+static void index_remove(conn_group_t *g, uint32_t i) {
+    uint32_t mask = index_mask(g);
+    g->index[i] = 0;
+    for (uint32_t j = (i + 1) & mask; g->index[j]; j = (j + 1) & mask) {
+        uint32_t home = group_hash(g->members[g->index[j] - 1]) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            g->index[i] = g->index[j];
+            g->index[j] = 0;
+            i = j;
+        }
+    }
+}
+
+// 成员数组和索引扩容一倍，重建索引
+static int group_grow(conn_group_t *g) {
+    uint32_t cap = g->capacity ? g->capacity * 2 : GROUP_MIN_MEMBERS;
+    uint64_t *members = realloc(g->members, (size_t)cap * sizeof(uint64_t));
+    if (!members) return -1;
+    g->members = members;
+
+    // 索引分配失败时容量不变，已扩大的成员数组照常使用
+    uint32_t *index = calloc((size_t)cap * 2, sizeof(uint32_t));
+    if (!index) return -1;
+    free(g->index);
+    g->index = index;
+    g->capacity = cap;
+
+    for (uint32_t i = 0; i < g->count; i++) {
+        g->index[index_probe(g, g->members[i])] = i + 1;
+    }
+    return 0;
+}
+
+int group_add_member(conn_group_t *g, uint64_t handle, group_alive_fn alive, void *arg) {
+    if (g->capacity && g->index[index_probe(g, handle)]) return 1;
+
+    if (g->count == g->capacity) {
+        // 清理一遍的代价由之后至少capacity/2次加入分摊
+        if (alive) {
+            for (uint32_t i = 0; i < g->count; ) {
+                if (alive(g->members[i], arg)) {
+                    i++;
+                } else {
+                    group_del_at(g, i);
+                }
+            }
+        }
+        if ((g->capacity == 0 || g->count > g->capacity / 2) && group_grow(g) != 0 &&
+            g->count == g->capacity) {
+            return -1;
+        }
+    }
+
+    g->index[index_probe(g, handle)] = g->count + 1;
+    g->members[g->count++] = handle;
+    return 0;
+}
+
+void group_del_at(conn_group_t *g, uint32_t i) {
+    index_remove(g, index_probe(g, g->members[i]));
+    uint32_t last = --g->count;
+    if (i != last) {
+        g->members[i] = g->members[last];
+        g->index[index_probe(g, g->members[i])] = i + 1;
+    }
+}
+
+bool group_del_member(conn_group_t *g, uint64_t handle) {
+    if (!g->capacity) return false;
+    uint32_t slot = index_probe(g, handle);
+    if (!g->index[slot]) return false;
+    group_del_at(g, g->index[slot] - 1);
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 广播组成员表：gid -> 成员句柄数组，每个Reactor线程一张，只记录本线程的连接
+// 仅由所属线程访问，不需要原子操作；开放寻址（线性探测），删除时后移填补，不留墓碑
+typedef struct conn_group_s {
+    uint64_t gid;
+    uint64_t *members;    // 连接句柄（conn_handle_t），无序，删除时与末尾交换
+    uint32_t *index;      // 句柄 -> members下标+1（0为空），开放寻址，容量为capacity的2倍
+    uint32_t count;
+    uint32_t capacity;
+} conn_group_t;
+
+// 成员是否仍然有效（连接未关闭、未迁出）
+typedef bool (*group_alive_fn)(uint64_t handle, void *arg);
+
+typedef struct group_table_s {
+    conn_group_t **buckets;
+    uint32_t mask;
+    uint32_t count;
+} group_table_t;
+
+int group_table_init(group_table_t *t, uint32_t capacity);
+// 释放表和其中所有组
+void group_table_destroy(group_table_t *t);
+
+// 查找组，不存在返回NULL
+conn_group_t *group_table_find(const group_table_t *t, uint64_t gid);
+// 查找组，不存在时创建；内存不足返回NULL
+conn_group_t *group_table_get(group_table_t *t, uint64_t gid);
+// 从表中删除并释放组
+void group_table_remove(group_table_t *t, conn_group_t *g);
+
+// 加入成员：返回0，已是成员返回1，内存不足返回-1；均摊O(1)
+// 成员数组满时先按alive清理失效成员，有效成员仍超过一半才扩容，没有广播的组也不会无限增长
+int group_add_member(conn_group_t *g, uint64_t handle, group_alive_fn alive, void *arg);
+// 删除成员，不是成员返回false；O(1)
+bool group_del_member(conn_group_t *g, uint64_t handle);
+// 删除下标i的成员（与末尾交换）
+void group_del_at(conn_group_t *g, uint32_t i);
+
+#endif
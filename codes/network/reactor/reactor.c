@@ -1,12 +1,49 @@
+#define _GNU_SOURCE
 #include "reactor.h"
+#include "codec.h"
+#include "log.h"
+#include "affinity.h"
+#include "handoff.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/filter.h>
+#include <sys/eventfd.h>
 #include <fcntl.h>
 #include <time.h>
+#include <stddef.h>
+
+// 由定时器节点反查所属对象
+#define container_of(ptr, type, member) ((type*)((char*)(ptr) - offsetof(type, member)))
+
+// 用户定时器
+struct reactor_timer_s {
+    timer_node_t node;
+    reactor_thread_t *thread;
+    reactor_timer_cb_t cb;
+    void *arg;
+    bool firing;      // 回调执行中
+    bool cancelled;   // 回调中被取消，回调返回后释放
+};
+
+// 广播负载：一次分配，每个线程持有一个引用，最后一个线程释放
+struct broadcast_payload_s {
+    atomic_uint refs;
+    uint32_t len;
+    char data[];
+};
+
+// 负载在一个线程内的引用：同线程的成员共享，计数不需要原子操作
+typedef struct broadcast_ref_s {
+    broadcast_payload_t *payload;
+    uint32_t refs;
+} broadcast_ref_t;
+
+static void thread_load_sample(timer_node_t *node, void *arg);
 
 // 设置非阻塞
 static int set_nonblocking(int fd) {
@@ -21,47 +58,335 @@ static uint64_t get_current_time_ms(void) {
     return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
+static uint64_t get_current_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 单写者统计：只有所属线程修改，用普通的读改写而不是带lock前缀的原子加，其他线程读到完整的旧值或新值
+static inline void thread_stat_add(atomic_ullong *stat, uint64_t n) {
+    atomic_store_explicit(stat, atomic_load_explicit(stat, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// 连接数增减，connection_count与active_connections总是同时变化
+static inline void thread_conns_add(reactor_thread_t *thread, int delta) {
+    uint32_t count = atomic_load_explicit(&thread->connection_count, memory_order_relaxed);
+    atomic_store_explicit(&thread->connection_count, count + (uint32_t)delta, memory_order_relaxed);
+    thread_stat_add(&thread->active_connections, (uint64_t)(int64_t)delta);
+}
+
 // 创建连接
-static connection_t* connection_create(int fd, int thread_id) {
-    connection_t *conn = calloc(1, sizeof(connection_t));
+static connection_t* connection_create(reactor_thread_t *thread, int fd) {
+    // 从本线程的slab分配，缓存行对齐，不经过malloc
+    connection_t *conn = slab_alloc(&thread->conn_slab);
     if (!conn) return NULL;
     
+    memset(conn, 0, sizeof(connection_t));
     conn->fd = fd;
-    conn->thread_id = thread_id;
-    atomic_store(&conn->state, 0);
-    atomic_store(&conn->read_len, 0);
-    atomic_store(&conn->write_len, 0);
-    atomic_store(&conn->write_sent, 0);
+    conn->thread_id = thread->id;
+    buf_chain_init(&conn->input);
+    buf_outq_init(&conn->output);
     conn->last_active_time = get_current_time_ms();
     
     return conn;
 }
 
+// 空闲超时回调：期间有活动则按最后活动时间顺延，O(1)
+static void connection_idle_timeout(timer_node_t *node, void *arg) {
+    reactor_thread_t *thread = (reactor_thread_t*)arg;
+    connection_t *conn = container_of(node, connection_t, idle_timer);
+    
+    if (thread->now_ms - conn->last_active_time >= CONN_IDLE_TIMEOUT_MS) {
+        LOG_DEBUG("Thread %d - connection timeout on fd=%d, closing", thread->id, conn->fd);
+        handle_close_event(thread, conn);
+        return;
+    }
+    
+    timer_wheel_add(&thread->timers, node, conn->last_active_time + CONN_IDLE_TIMEOUT_MS, 0);
+}
+
+// 线程内按句柄查找连接
+static inline connection_t* thread_lookup_connection(reactor_thread_t *thread, conn_handle_t handle) {
+    if (CONN_HANDLE_THREAD(handle) != (uint32_t)thread->id) return NULL;
+    return slot_table_get(&thread->connections, CONN_HANDLE_SLOT(handle), CONN_HANDLE_GEN(handle));
+}
+
+// 读取是否暂停（发送队列超过高水位或应用暂停）
+static inline bool connection_read_paused(const connection_t *conn) {
+    return conn->flags & (CONN_FLAG_OUTQ_HIGH | CONN_FLAG_READ_PAUSED);
+}
+
+/* ---------------- io_uring后端：请求与连接生命周期 ---------------- */
+
+// user_data：连接指针（slab对象按缓存行对齐，低位为0）或0，低3位为请求类型
+#define URING_OP_RECV           1
+#define URING_OP_SEND           2
+#define URING_OP_ACCEPT         3
+#define URING_OP_ACCEPT_METRICS 4
+#define URING_OP_WAKEUP         5
+#define URING_OP_CANCEL         6   // 取消多发accept（热升级交出监听socket），完成事件忽略
+#define URING_OP_MASK           7
+#define URING_PBUF_GROUP        0
+#define URING_CQE_BATCH         (MAX_EVENTS * 4)   // 每轮最多处理的完成事件数，避免饿死定时器
+#define URING_DRAIN_MS          1000               // 线程退出时等待进行中请求完成的上限
+#define URING_ACCEPT_RETRY_MS   100                // fd耗尽后暂停accept的时间
+
+// 一次sendmsg的参数，请求完成前必须保持有效
+typedef struct uring_send_s {
+    struct uring_send_s *next;
+    struct msghdr msg;
+    struct iovec iov[BUF_IOV_MAX];
+} uring_send_t;
+
+static inline bool thread_is_uring(const reactor_thread_t *thread) {
+    return thread->reactor->backend == REACTOR_BACKEND_URING;
+}
+
+// 缓冲原样放回提供缓冲环
+static inline void uring_pbuf_recycle(reactor_thread_t *thread, uint16_t bid) {
+    uring_buf_ring_add(&thread->pbuf, thread->pbuf_segs[bid]->data, BUF_SEGMENT_DATA_SIZE, bid);
+}
+
+// 多发recv：有数据就产生一个完成事件，缓冲由内核从提供缓冲环中选取，直到出错或对端关闭
+static int uring_arm_recv(reactor_thread_t *thread, connection_t *conn) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&thread->uring);
+    if (!sqe) return -1;
+    
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_PBUF_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | URING_OP_RECV;
+    conn->uring_inflight++;
+    conn->flags |= CONN_FLAG_URING_RECV;
+    return 0;
+}
+
+// 按user_data取消进行中的请求
+static int uring_cancel(reactor_thread_t *thread, uint64_t user_data) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&thread->uring);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->user_data = URING_OP_CANCEL;
+    return 0;
+}
+
+// 已关闭的连接在没有进行中的请求后释放
+static void uring_release(reactor_thread_t *thread, connection_t *conn) {
+    if (!(conn->flags & CONN_FLAG_CLOSED) || conn->uring_inflight > 0 ||
+        (conn->flags & CONN_FLAG_SEND_QUEUED)) {
+        return;
+    }
+    buf_outq_clear(&conn->output, &thread->buf_pool);
+    thread->zombies--;
+    slab_free(conn);
+}
+
+// 关闭：shutdown让进行中的recv/send尽快完成，fd可以立即关闭（请求持有文件引用）
+// 发送队列可能正被sendmsg引用，随连接一起在请求完成后释放
+static void uring_close_connection(reactor_thread_t *thread, connection_t *conn) {
+    shutdown(conn->fd, SHUT_RDWR);
+    close(conn->fd);
+    thread->syscalls += 2;
+    
+    buf_chain_clear(&conn->input, &thread->buf_pool);
+    conn->flags |= CONN_FLAG_CLOSED;
+    thread->zombies++;
+    uring_release(thread, conn);
+}
+
+// 发送队列有数据：加入本轮的待发送链，循环末尾统一提交，同一连接在一轮内的多次写合并为一个sendmsg
+static void uring_queue_send(reactor_thread_t *thread, connection_t *conn) {
+    if ((conn->flags & CONN_FLAG_SEND_QUEUED) || conn->uring_send) return;
+    conn->flags |= CONN_FLAG_SEND_QUEUED;
+    conn->send_next = thread->send_head;
+    thread->send_head = conn;
+}
+
 // 处理连接关闭
 void handle_close_event(reactor_thread_t *thread, connection_t *conn) {
     if (!thread || !conn) return;
     
+    // 释放槽位，代数递增使旧句柄失效；重复关闭时直接返回
+    if (!slot_table_free(&thread->connections, CONN_HANDLE_SLOT(conn->handle), CONN_HANDLE_GEN(conn->handle))) {
+        return;
+    }
+    thread_conns_add(thread, -1);
+    
+    // 槽位已释放，回调中再次关闭或按旧句柄查找都会失败
+    if (thread->reactor->on_close && !(conn->flags & CONN_FLAG_METRICS)) {
+        thread->reactor->on_close(conn);
+    }
+    
+    timer_wheel_del(&thread->timers, &conn->idle_timer);
+    
+    if (thread_is_uring(thread)) {
+        uring_close_connection(thread, conn);
+        return;
+    }
+    
     // 从epoll中移除
     epoll_ctl(thread->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
     
     // 关闭socket
     close(conn->fd);
+    thread->syscalls += 2;
     
-    // 从连接数组中移除
-    for (int i = 0; i < MAX_CONNECTIONS; i++) {
-        if (thread->connections[i] == conn) {
-            thread->connections[i] = NULL;
-            atomic_fetch_sub(&thread->connection_count, 1);
-            atomic_fetch_sub(&thread->active_connections, 1);
-            break;
+    // 缓冲段归还线程池
+    buf_chain_clear(&conn->input, &thread->buf_pool);
+    buf_outq_clear(&conn->output, &thread->buf_pool);
+    
+    slab_free(conn);
+}
+
+// 创建指标注册表，每个Reactor线程一个分片
+static int reactor_metrics_init(reactor_t *reactor) {
+    snprintf(reactor->metrics_shm, sizeof(reactor->metrics_shm), "/reactor-%d", (int)getpid());
+    reactor->metrics = metrics_create(reactor->metrics_shm, (uint32_t)reactor->thread_count);
+    if (!reactor->metrics) {
+        printf("ERROR: Failed to create metrics registry\n");
+        return -1;
+    }
+    
+    metrics_t *m = reactor->metrics;
+    reactor_metric_ids_t *mid = &reactor->mid;
+    mid->loop_time_us = metrics_register(m, "reactor_loop_time_us",
+        "Event loop iteration time excluding epoll_wait (us)", METRIC_HISTOGRAM);
+    mid->events_per_wakeup = metrics_register(m, "reactor_events_per_wakeup",
+        "Events returned by each epoll_wait", METRIC_HISTOGRAM);
+    mid->bytes_in = metrics_register(m, "reactor_bytes_in_total", "Bytes read from sockets", METRIC_COUNTER);
+    mid->bytes_out = metrics_register(m, "reactor_bytes_out_total", "Bytes written to sockets", METRIC_COUNTER);
+    mid->write_backlog = metrics_register(m, "reactor_conn_write_backlog_bytes",
+        "Bytes left in a connection output queue after each flush", METRIC_HISTOGRAM);
+    mid->accept_queue_depth = metrics_register(m, "reactor_accept_queue_depth",
+        "Connections waiting in the accept queue", METRIC_GAUGE);
+    mid->accept_queue_fails = metrics_register(m, "reactor_accept_queue_fails_total",
+        "Connections rejected because the accept queue was full", METRIC_COUNTER);
+    mid->accept_rejected = metrics_register(m, "reactor_accept_rejected_total",
+        "Connections accepted and closed at once because file descriptors ran out", METRIC_COUNTER);
+    mid->connections = metrics_register(m, "reactor_connections", "Open connections", METRIC_GAUGE);
+    mid->accepted = metrics_register(m, "reactor_accepted_total",
+        "Connections accepted on per-thread listeners", METRIC_COUNTER);
+    mid->buf_segments = metrics_register(m, "reactor_buf_segments", "Buffer segments in use", METRIC_GAUGE);
+    mid->event_rate = metrics_register(m, "reactor_event_rate", "Smoothed events per second", METRIC_GAUGE);
+    mid->migrated_in = metrics_register(m, "reactor_migrated_in_total",
+        "Connections migrated in from other threads", METRIC_COUNTER);
+    mid->migrated_out = metrics_register(m, "reactor_migrated_out_total",
+        "Connections migrated out to other threads", METRIC_COUNTER);
+    mid->syscalls = metrics_register(m, "reactor_syscalls_total",
+        "System calls issued by the reactor thread", METRIC_COUNTER);
+    mid->spin_time_us = metrics_register(m, "reactor_spin_time_us_total",
+        "Time spent busy-polling with a zero timeout (us)", METRIC_COUNTER);
+    mid->sleep_time_us = metrics_register(m, "reactor_sleep_time_us_total",
+        "Time spent blocked waiting for events (us)", METRIC_COUNTER);
+    mid->backpressure = metrics_register(m, "reactor_backpressure_total",
+        "Times a connection output queue crossed the high watermark", METRIC_COUNTER);
+    mid->read_deferred = metrics_register(m, "reactor_read_deferred_total",
+        "Reads cut short by the read budget and resumed next iteration", METRIC_COUNTER);
+    mid->remote_sends = metrics_register(m, "reactor_remote_sends_total",
+        "Messages queued by reactor_send from any thread", METRIC_COUNTER);
+    mid->remote_dropped = metrics_register(m, "reactor_remote_dropped_total",
+        "reactor_send messages dropped because the connection had closed", METRIC_COUNTER);
+    mid->send_queue_fails = metrics_register(m, "reactor_send_queue_fails_total",
+        "reactor_send calls rejected because the command queue was full", METRIC_COUNTER);
+    mid->broadcast_fanout_us = metrics_register(m, "reactor_broadcast_fanout_us",
+        "Time one thread spends queueing a broadcast to its group members (us)", METRIC_HISTOGRAM);
+    mid->broadcast_delay_us = metrics_register(m, "reactor_broadcast_delay_us",
+        "Time from reactor_broadcast to a thread finishing its fan-out (us)", METRIC_HISTOGRAM);
+    mid->broadcast_members = metrics_register(m, "reactor_broadcast_members_total",
+        "Group members a broadcast was queued to", METRIC_COUNTER);
+    
+    return 0;
+}
+
+// 释放线程的io_uring资源：提供缓冲中的段归还线程池
+static void thread_uring_destroy(reactor_thread_t *thread) {
+    uring_buf_ring_destroy(&thread->uring, &thread->pbuf);
+    if (thread->pbuf_segs) {
+        for (uint32_t i = 0; i < URING_PBUF_ENTRIES; i++) {
+            if (thread->pbuf_segs[i]) buf_pool_put(&thread->buf_pool, thread->pbuf_segs[i]);
         }
+        free(thread->pbuf_segs);
+        thread->pbuf_segs = NULL;
     }
+    while (thread->send_free) {
+        uring_send_t *s = thread->send_free;
+        thread->send_free = s->next;
+        free(s);
+    }
+    if (thread->uring.sq_ring) {
+        uring_exit(&thread->uring);
+    }
+}
+
+// 创建线程的ring和提供缓冲环；缓冲由线程启动后uring_pbuf_fill放入
+static int thread_uring_init(reactor_thread_t *thread) {
+    if (uring_init(&thread->uring, URING_ENTRIES, URING_CQ_ENTRIES) != 0) {
+        return -1;
+    }
+    
+    thread->pbuf_segs = calloc(URING_PBUF_ENTRIES, sizeof(buf_segment_t*));
+    if (!thread->pbuf_segs ||
+        uring_buf_ring_init(&thread->uring, &thread->pbuf, URING_PBUF_ENTRIES, URING_PBUF_GROUP) != 0) {
+        thread_uring_destroy(thread);
+        return -1;
+    }
+    return 0;
+}
+
+// 在事件线程中从本线程buf_pool取段放入提供缓冲环，段内存按首次访问落在线程所在节点
+static int uring_pbuf_fill(reactor_thread_t *thread) {
+    for (uint16_t bid = 0; bid < URING_PBUF_ENTRIES; bid++) {
+        thread->pbuf_segs[bid] = buf_pool_get(&thread->buf_pool);
+        if (!thread->pbuf_segs[bid]) return -1;
+        uring_pbuf_recycle(thread, bid);
+    }
+    uring_buf_ring_publish(&thread->pbuf);
+    return 0;
+}
+
+// 线程已在目标CPU上运行：把创建时由主线程分配的状态迁到本节点
+// 之后本线程分配的内存（缓冲段、连接slab、提供缓冲）按首次访问本来就在本地
+static void thread_localize(reactor_thread_t *thread) {
+    if (thread->cpu < 0) return;
     
-    free(conn);
+    thread->numa_node = affinity_cpu_node(thread->cpu);
+    int node = thread->numa_node;
+    slot_table_t *t = &thread->connections;
+    int ret = affinity_bind_memory(thread, sizeof(*thread), node);
+    ret |= affinity_bind_memory(t->values, t->capacity * sizeof(void*), node);
+    ret |= affinity_bind_memory(t->generations, t->capacity * sizeof(uint32_t), node);
+    ret |= affinity_bind_memory(t->next_free, t->capacity * sizeof(uint32_t), node);
+    ret |= affinity_bind_memory(thread->accept_queue.buffer,
+                                (thread->accept_queue.mask + 1) * thread->accept_queue.elem_size, node);
+    if (thread->codec_scratch) {
+        ret |= affinity_bind_memory(thread->codec_scratch, CODEC_MAX_FRAME, node);
+    }
+    
+    LOG_INFO("Thread %d pinned to CPU %d, NUMA node %d%s", thread->id, thread->cpu, node,
+             ret ? " (memory migration failed, state stays where it was allocated)" : "");
+}
+
+// 释放前count个线程结构和Reactor本身（各线程的资源已由调用者释放）
+static void reactor_free_threads(reactor_t *reactor, int count) {
+    for (int i = 0; i < count; i++) {
+        free(reactor->threads[i]);
+    }
+    metrics_destroy(reactor->metrics, reactor->metrics_shm);
+    pthread_mutex_destroy(&reactor->upgrade_lock);
+    free(reactor);
 }
 
 // 创建Reactor
 reactor_t* reactor_create(int thread_count) {
+    return reactor_create_backend(thread_count, REACTOR_BACKEND_EPOLL);
+}
+
+reactor_t* reactor_create_backend(int thread_count, reactor_backend_t backend) {
     if (thread_count <= 0 || thread_count > MAX_REACTOR_THREADS) {
         return NULL;
     }
@@ -70,25 +395,100 @@ reactor_t* reactor_create(int thread_count) {
     if (!reactor) return NULL;
     
     reactor->thread_count = thread_count;
+    reactor->metrics_fd = -1;
+    reactor->upgrade_sock = -1;
+    reactor->outq_high = OUTQ_HIGH_WATERMARK;
+    reactor->outq_low = OUTQ_LOW_WATERMARK;
+    reactor->deferred_flush = true;
+    reactor->read_budget_conn = READ_BUDGET_CONN;
+    reactor->read_budget_loop = READ_BUDGET_LOOP;
+    pthread_mutex_init(&reactor->upgrade_lock, NULL);
     atomic_store(&reactor->running, false);
     atomic_store(&reactor->next_thread, 0);
+    atomic_store(&reactor->placement, PLACEMENT_ROUND_ROBIN);
+    atomic_store(&reactor->rebalance, false);
+    
+    if (reactor_metrics_init(reactor) != 0) {
+        free(reactor);
+        return NULL;
+    }
     
     for (int i = 0; i < thread_count; i++) {
-        reactor_thread_t *thread = &reactor->threads[i];
+        // 每个线程的状态独占整页，绑核后可以单独迁到线程所在的NUMA节点
+        reactor_thread_t *thread = affinity_alloc(sizeof(reactor_thread_t));
+        if (!thread) {
+            reactor_free_threads(reactor, i);
+            return NULL;
+        }
+        reactor->threads[i] = thread;
+        thread->reactor = reactor;
         thread->id = i;
+        thread->cpu = -1;
+        thread->numa_node = -1;
+        thread->listen_fd = -1;
         atomic_store(&thread->running, false);
         atomic_store(&thread->connection_count, 0);
         
-        // 初始化环形队列
-        ring_queue_init(&thread->accept_queue);
+        thread->now_ms = get_current_time_ms();
+        timer_wheel_init(&thread->timers, thread->now_ms);
+        
+        // 负载采样定时器，周期执行
+        atomic_store(&thread->migrate_in, NULL);
+        atomic_store(&thread->handoff_in, NULL);
+        atomic_store(&thread->upgrade_request, 0);
+        atomic_store(&thread->event_rate, 0);
+        thread->load_last_events = 0;
+        timer_node_init(&thread->load_timer, thread_load_sample, thread);
+        timer_wheel_add(&thread->timers, &thread->load_timer,
+                        thread->now_ms + REACTOR_LOAD_SAMPLE_MS, REACTOR_LOAD_SAMPLE_MS);
+        buf_pool_init(&thread->buf_pool, BUF_POOL_MAX_FREE);
+        slab_cache_init(&thread->conn_slab, "connection", sizeof(connection_t), CONN_SLAB_CHUNK);
+        slab_cache_init(&thread->bcast_slab, "broadcast", sizeof(broadcast_ref_t), BCAST_SLAB_CHUNK);
         
         thread->epoll_fd = epoll_create1(0);
-        if (thread->epoll_fd == -1) {
+        thread->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        thread->reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        atomic_store(&thread->wakeup_pending, true);
+        
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = REACTOR_TOKEN_WAKEUP;
+        
+        if (thread->epoll_fd == -1 || thread->wakeup_fd == -1 ||
+            epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, thread->wakeup_fd, &ev) == -1 ||
+            slot_table_init(&thread->connections, MAX_CONNECTIONS) != 0 ||
+            !(thread->conn_events = calloc(MAX_CONNECTIONS, sizeof(uint32_t))) ||
+            spsc_ring_init(&thread->accept_queue, ACCEPT_QUEUE_SIZE, sizeof(int)) != 0 ||
+            mpsc_ring_init(&thread->send_queue, SEND_QUEUE_SIZE, sizeof(reactor_send_cmd_t)) != 0 ||
+            group_table_init(&thread->groups, GROUP_TABLE_SIZE) != 0 ||
+            !(thread->ready = calloc(MAX_CONNECTIONS, sizeof(conn_handle_t))) ||
+            !(thread->ready_work = calloc(MAX_CONNECTIONS, sizeof(conn_handle_t))) ||
+            !(thread->dirty = calloc(MAX_CONNECTIONS, sizeof(conn_handle_t)))) {
             // 清理已创建的资源
+            if (thread->epoll_fd != -1) close(thread->epoll_fd);
+            if (thread->wakeup_fd != -1) close(thread->wakeup_fd);
+            if (thread->reserve_fd != -1) close(thread->reserve_fd);
+            slot_table_destroy(&thread->connections);
+            free(thread->conn_events);
+            spsc_ring_destroy(&thread->accept_queue);
+            mpsc_ring_destroy(&thread->send_queue);
+            group_table_destroy(&thread->groups);
+            free(thread->ready);
+            free(thread->ready_work);
             for (int j = 0; j < i; j++) {
-                close(reactor->threads[j].epoll_fd);
+                close(reactor->threads[j]->epoll_fd);
+                close(reactor->threads[j]->wakeup_fd);
+                if (reactor->threads[j]->reserve_fd != -1) close(reactor->threads[j]->reserve_fd);
+                slot_table_destroy(&reactor->threads[j]->connections);
+                free(reactor->threads[j]->conn_events);
+                spsc_ring_destroy(&reactor->threads[j]->accept_queue);
+                mpsc_ring_destroy(&reactor->threads[j]->send_queue);
+                group_table_destroy(&reactor->threads[j]->groups);
+                free(reactor->threads[j]->ready);
+                free(reactor->threads[j]->ready_work);
+                free(reactor->threads[j]->dirty);
             }
-            free(reactor);
+            reactor_free_threads(reactor, i + 1);
             return NULL;
         }
         
@@ -97,294 +497,2130 @@ reactor_t* reactor_create(int thread_count) {
         atomic_store(&thread->active_connections, 0);
         atomic_store(&thread->processed_events, 0);
         atomic_store(&thread->batch_processed, 0);
-        
-        // 初始化连接数组
-        for (int j = 0; j < MAX_CONNECTIONS; j++) {
-            thread->connections[j] = NULL;
+        atomic_store(&thread->accepted_connections, 0);
+        atomic_store(&thread->wakeups_sent, 0);
+        atomic_store(&thread->migrated_in, 0);
+        atomic_store(&thread->migrated_out, 0);
+        atomic_store(&thread->busy_poll_us, 0);
+    }
+    
+    // io_uring不可用（内核过旧、被seccomp禁止等）时整体退回epoll
+    if (backend == REACTOR_BACKEND_URING) {
+        reactor->backend = REACTOR_BACKEND_URING;
+        for (int i = 0; i < thread_count; i++) {
+            if (thread_uring_init(reactor->threads[i]) != 0) {
+                printf("WARNING: io_uring unavailable (%s), falling back to epoll\n", strerror(errno));
+                for (int j = 0; j < i; j++) {
+                    thread_uring_destroy(reactor->threads[j]);
+                }
+                reactor->backend = REACTOR_BACKEND_EPOLL;
+                break;
+            }
         }
     }
     
     return reactor;
 }
 
-// 线程本地的连接添加
-static int thread_add_connection(reactor_thread_t *thread, int fd) {
-    // 查找空闲槽位
-    for (int i = 0; i < MAX_CONNECTIONS; i++) {
-        if (!thread->connections[i]) {
-            connection_t *conn = connection_create(fd, thread->id);
-            if (!conn) return -1;
-            
-            if (set_nonblocking(fd) == -1) {
-                free(conn);
-                return -1;
-            }
-            
-            // 添加到epoll（边缘触发）
-            struct epoll_event ev;
-            ev.events = EPOLLIN | EPOLLET;
-            ev.data.ptr = conn;
-            
-            if (epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
-                free(conn);
-                return -1;
-            }
-            
-            thread->connections[i] = conn;
-            atomic_fetch_add(&thread->connection_count, 1);
-            atomic_fetch_add(&thread->total_connections, 1);
-            atomic_fetch_add(&thread->active_connections, 1);
-            
-            return 0;
-        }
+// 套接字级忙轮询：内核收包时直接轮询网卡队列，非特权进程通常会被拒绝，失败不影响连接
+static void thread_socket_busy_poll(reactor_thread_t *thread, int fd, uint32_t busy_poll_us) {
+    int value = (int)busy_poll_us;
+    setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value));
+    thread->syscalls++;
+#ifdef SO_PREFER_BUSY_POLL
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one));
+    thread->syscalls++;
+#endif
+}
+
+// 本轮等待的超时：最近一次有事件后的忙轮询预算内返回0（不睡眠），*spinning为true
+static inline int thread_wait_timeout(reactor_thread_t *thread, uint64_t now_us, bool *spinning) {
+    int timeout = timer_wheel_next_timeout(&thread->timers, thread->now_ms);
+    uint32_t budget = atomic_load_explicit(&thread->busy_poll_us, memory_order_relaxed);
+    
+    *spinning = false;
+    if (timeout != 0 && budget && now_us - thread->last_event_us < budget) {
+        *spinning = true;
+        return 0;
     }
-    return -1;
+    return timeout;
+}
+
+// 记录本轮等待花费的时间，有事件时刷新忙轮询的起点
+static inline void thread_account_wait(reactor_thread_t *thread, bool spinning, int timeout,
+                                       uint64_t wait_start_us, uint64_t now_us, bool got_events) {
+    if (spinning) {
+        thread->spin_time_us += now_us - wait_start_us;
+    } else if (timeout != 0) {
+        thread->sleep_time_us += now_us - wait_start_us;
+    }
+    if (got_events) {
+        thread->last_event_us = now_us;
+    }
+}
+
+// 线程本地的连接添加（fd需已设置为非阻塞）
+// 注册新连接，失败返回NULL（fd由调用者关闭）
+static connection_t* thread_add_connection(reactor_thread_t *thread, int fd, uint32_t flags) {
+    connection_t *conn = connection_create(thread, fd);
+    if (!conn) return NULL;
+    conn->flags = flags;
+    
+    // 从空闲链表取槽位，O(1)
+    uint32_t gen;
+    uint32_t slot = slot_table_alloc(&thread->connections, conn, &gen);
+    if (slot == SLOT_NIL) {
+        slab_free(conn);
+        return NULL;
+    }
+    conn->handle = CONN_HANDLE_MAKE(gen, thread->id, slot);
+    thread->conn_events[slot] = 0;
+    
+    uint32_t busy_poll_us = atomic_load_explicit(&thread->busy_poll_us, memory_order_relaxed);
+    if (busy_poll_us) {
+        thread_socket_busy_poll(thread, fd, busy_poll_us);
+    }
+    
+    // io_uring后端提交多发recv；epoll后端边缘触发同时注册读写，事件中携带句柄
+    int ret;
+    if (thread_is_uring(thread)) {
+        ret = uring_arm_recv(thread, conn);
+    } else {
+        struct epoll_event ev;
+        ev.events = CONN_EPOLL_EVENTS;
+        ev.data.u64 = conn->handle;
+        ret = epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        thread->syscalls++;
+    }
+    
+    if (ret == -1) {
+        slot_table_free(&thread->connections, slot, gen);
+        slab_free(conn);
+        return NULL;
+    }
+    
+    conn->last_active_time = thread->now_ms;
+    timer_node_init(&conn->idle_timer, connection_idle_timeout, thread);
+    timer_wheel_add(&thread->timers, &conn->idle_timer, thread->now_ms + CONN_IDLE_TIMEOUT_MS, 0);
+    
+    thread_conns_add(thread, 1);
+    thread_stat_add(&thread->total_connections, 1);
+    
+    // 接管的连接先恢复缓冲状态，由调用者回调on_connect
+    if (thread->reactor->on_connect && !(flags & (CONN_FLAG_METRICS | CONN_FLAG_ADOPTED))) {
+        thread->reactor->on_connect(conn);
+    }
+    
+    return conn;
 }
 
 // 批量处理新连接
 static uint32_t process_new_connections_batch(reactor_thread_t *thread) {
     int fds[BATCH_SIZE];
-    uint32_t count = ring_queue_pop_batch(&thread->accept_queue, fds, BATCH_SIZE);
+    uint32_t count = spsc_ring_pop_batch(&thread->accept_queue, fds, BATCH_SIZE);
     
     
     if (count == 0) {
         return 0;
     }
     // 添加调试信息
-    printf("DEBUG: Thread %d - ring_queue_pop_batch returned count=%u\n", thread->id, count);
+    LOG_DEBUG("Thread %d - spsc_ring_pop_batch returned count=%u", thread->id, count);
     
     uint32_t success_count = 0;
-    printf("DEBUG: Thread %d - Processing %u new connections\n", thread->id, count);
+    LOG_DEBUG("Thread %d - Processing %u new connections", thread->id, count);
     
     for (uint32_t i = 0; i < count; i++) {
-        if (thread_add_connection(thread, fds[i]) == 0) {
+        thread->syscalls += 2;
+        if (set_nonblocking(fds[i]) == 0 && thread_add_connection(thread, fds[i], 0)) {
             success_count++;
-            printf("DEBUG: Thread %d - Successfully added fd=%d\n", thread->id, fds[i]);
+            LOG_DEBUG("Thread %d - Successfully added fd=%d", thread->id, fds[i]);
         } else {
             close(fds[i]);
-            printf("DEBUG: Thread %d - Failed to add fd=%d, closed\n", thread->id, fds[i]);
+            LOG_DEBUG("Thread %d - Failed to add fd=%d, closed", thread->id, fds[i]);
         }
     }
     
     if (count > 1) {
-        atomic_fetch_add(&thread->batch_processed, 1);
+        thread_stat_add(&thread->batch_processed, 1);
     }
     
-    printf("DEBUG: Thread %d - Successfully processed %u/%u connections\n", 
+    LOG_DEBUG("Thread %d - Successfully processed %u/%u connections", 
            thread->id, success_count, count);
     return success_count;
 }
 
-static void handle_add_write(reactor_thread_t *thread, connection_t *conn)
-{
-    uint32_t write_sent = atomic_load(&conn->write_sent);
-    uint32_t read_len = atomic_load(&conn->read_len);
-    if(conn->write_len == 0 && write_sent + read_len < BUFFER_SIZE) {
-        memcpy(conn->write_buf + write_sent, conn->read_buf, read_len);
-        atomic_store(&conn->read_len, 0);
-        atomic_fetch_add(&conn->write_len, read_len);
+// 唤醒阻塞在epoll_wait中的线程；线程醒着时不发系统调用
+static void thread_wakeup(reactor_thread_t *thread) {
+    if (!atomic_exchange(&thread->wakeup_pending, true)) {
+        uint64_t one = 1;
+        if (write(thread->wakeup_fd, &one, sizeof(one)) == sizeof(one)) {
+            atomic_fetch_add(&thread->wakeups_sent, 1);
+        }
     }
-    struct epoll_event ev;
-    ev.events = EPOLLOUT | EPOLLET;
-    ev.data.ptr = conn;
-    epoll_ctl(thread->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
-
 }
 
-// 处理读事件（边缘触发，批量读取）
-static void handle_read_event(reactor_thread_t *thread, connection_t *conn) {
-    while (1) {
-        uint32_t read_len = atomic_load(&conn->read_len);
-        size_t remaining = BUFFER_SIZE - read_len;
-        
-        if (remaining == 0) {
-            // 缓冲区满，需要处理数据
-            printf("DEBUG: Thread %d - Buffer full for fd=%d\n", thread->id, conn->fd);
-            break;
-        }
-        
-        ssize_t n = read(conn->fd, conn->read_buf + read_len, remaining);
-        
-        if (n > 0) {
-            atomic_fetch_add(&conn->read_len, n);
-            printf("DEBUG: Thread %d - Read %zd bytes from fd=%d\n", thread->id, n, conn->fd);
-            handle_add_write(thread, conn);
-        } else if (n == 0) {
-            // 连接关闭
-            printf("DEBUG: Thread %d - Connection closed by peer, fd=%d\n", thread->id, conn->fd);
-            handle_close_event(thread, conn);
-            break;
-        } else {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // 数据已读完
-                break;
-            } else {
-                printf("DEBUG: Thread %d - Read error on fd=%d: %s\n", thread->id, conn->fd, strerror(errno));
-                handle_close_event(thread, conn);
-                break;
-            }
-        }
-    }
+// 迁出连接：从本线程注销（旧句柄失效）后压入目标线程的迁入栈，调用前读写缓冲必须为空
+// 缓冲段的引用计数不是原子的，且可能被其他连接的发送队列共享（reactor_forward），所以不随连接跨线程
+static void thread_migrate_out(reactor_thread_t *thread, connection_t *conn) {
+    reactor_thread_t *target = thread->reactor->threads[conn->migrate_to];
+    
+    slot_table_free(&thread->connections, CONN_HANDLE_SLOT(conn->handle), CONN_HANDLE_GEN(conn->handle));
+    thread_conns_add(thread, -1);
+    timer_wheel_del(&thread->timers, &conn->idle_timer);
+    epoll_ctl(thread->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    thread->syscalls++;
+    conn->flags &= ~(CONN_FLAG_MIGRATE | CONN_FLAG_DIRTY | CONN_FLAG_WANT_OUT | CONN_FLAG_READ_READY);
+    
+    LOG_DEBUG("Thread %d - migrating fd=%d to thread %d", thread->id, conn->fd, target->id);
+    thread_stat_add(&thread->migrated_out, 1);
+    metrics_add(thread->reactor->metrics, thread->id, thread->reactor->mid.migrated_out, 1);
+    
+    // 与slab的remote_free相同：生产者CAS压栈，消费者一次摘走整条链，不存在ABA
+    connection_t *head = atomic_load_explicit(&target->migrate_in, memory_order_relaxed);
+    do {
+        conn->migrate_next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&target->migrate_in, &head, conn,
+                                                    memory_order_release, memory_order_relaxed));
+    thread_wakeup(target);
 }
 
-static void handle_add_read_event(reactor_thread_t *thread, connection_t *conn)
-{
-    if (atomic_load(&conn->write_sent) >= atomic_load(&conn->write_len)) {
-        // 发送完成，改为监听读
-        struct epoll_event ev;
-        ev.events = EPOLLIN | EPOLLET;
-        ev.data.ptr = conn;
-        epoll_ctl(thread->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
-        
-        atomic_store(&conn->write_len, 0);
-        atomic_store(&conn->write_sent, 0);
-        printf("DEBUG: Thread %d - All data sent to fd=%d, switching to read mode\n", thread->id, conn->fd);
+// 执行推迟的迁移；返回true表示连接已迁出，调用方不能再访问conn
+static bool connection_try_migrate(reactor_thread_t *thread, connection_t *conn) {
+    if (!(conn->flags & CONN_FLAG_MIGRATE) ||
+        !buf_chain_empty(&conn->input) || !buf_outq_empty(&conn->output)) {
+        return false;
     }
-
+    thread_migrate_out(thread, conn);
+    return true;
 }
 
-// 批量处理写事件
-static void handle_write_events(reactor_thread_t *thread, connection_t **conns, uint32_t count) {
-    for (uint32_t i = 0; i < count; i++) {
-        connection_t *conn = conns[i];
-        if (!conn) continue;
-        
-        uint32_t write_len = atomic_load(&conn->write_len);
-        uint32_t write_sent = atomic_load(&conn->write_sent);
+// 接管迁入的连接，失败时按关闭处理
+static void thread_adopt_connection(reactor_thread_t *thread, connection_t *conn) {
+    reactor_t *reactor = thread->reactor;
+    conn_handle_t old_handle = conn->handle;
+    
+    conn->thread_id = thread->id;
+    conn->migrate_next = NULL;
+    
+    uint32_t gen;
+    uint32_t slot = slot_table_alloc(&thread->connections, conn, &gen);
+    if (slot != SLOT_NIL) {
+        conn->handle = CONN_HANDLE_MAKE(gen, thread->id, slot);
+        thread->conn_events[slot] = 0;
         
-        if (write_sent < write_len) {
-            ssize_t n = write(conn->fd, 
-                            conn->write_buf + write_sent,
-                            write_len - write_sent);
+        // 迁移途中到达的数据：ADD时内核检查就绪状态，边缘触发也会立即上报；
+        // 读取暂停的连接此时的EPOLLIN被忽略，恢复时经ready列表补读
+        struct epoll_event ev;
+        ev.events = CONN_EPOLL_EVENTS;
+        ev.data.u64 = conn->handle;
+        thread->syscalls++;
+        if (epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, conn->fd, &ev) == 0) {
+            timer_node_init(&conn->idle_timer, connection_idle_timeout, thread);
+            timer_wheel_add(&thread->timers, &conn->idle_timer, thread->now_ms + CONN_IDLE_TIMEOUT_MS, 0);
             
-            if (n > 0) {
-                atomic_fetch_add(&conn->write_sent, n);
-                printf("DEBUG: Thread %d - Wrote %zd bytes to fd=%d\n", thread->id, n, conn->fd);
-                handle_add_read_event(thread, conn);
-            } else if (n == -1) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    // 写缓冲区满，下次再试
-                    continue;
-                } else {
-                    printf("DEBUG: Thread %d - Write error on fd=%d: %s\n", thread->id, conn->fd, strerror(errno));
-                    handle_close_event(thread, conn);
-                }
+            thread_conns_add(thread, 1);
+            thread_stat_add(&thread->migrated_in, 1);
+            metrics_add(reactor->metrics, thread->id, reactor->mid.migrated_in, 1);
+            
+            if (reactor->on_migrate) {
+                reactor->on_migrate(conn, old_handle);
             }
+            return;
         }
+        slot_table_free(&thread->connections, slot, gen);
+    }
+    
+    LOG_ERROR("Thread %d - failed to adopt migrated fd=%d, closing", thread->id, conn->fd);
+    if (reactor->on_close) {
+        reactor->on_close(conn);
     }
+    close(conn->fd);
+    slab_free(conn);
 }
 
-// Reactor线程主循环
-static void* reactor_thread_main(void *arg) {
-    reactor_thread_t *thread = (reactor_thread_t*)arg;
-    struct epoll_event events[MAX_EVENTS];
+// 处理其他线程迁入的连接
+static void process_migrated_connections(reactor_thread_t *thread) {
+    connection_t *conn = atomic_exchange_explicit(&thread->migrate_in, NULL, memory_order_acquire);
     
-    atomic_store(&thread->running, true);
-    printf("DEBUG: Reactor thread %d started\n", thread->id);
-    
-    uint32_t loop_count = 0;
+    while (conn) {
+        connection_t *next = conn->migrate_next;
+        thread_adopt_connection(thread, conn);
+        conn = next;
+    }
+}
+
+// 过载时把本周期事件最多的连接迁往事件速率最低的线程，迁出量约为速率差的一半
+static void thread_rebalance(reactor_thread_t *thread, uint32_t rate) {
+    reactor_t *reactor = thread->reactor;
+    int target = -1;
+    uint32_t target_rate = UINT32_MAX;
     
-    while (atomic_load(&thread->running)) {
-        loop_count++;
-        
-        // 1. 批量处理新连接（每次循环都处理）
-        uint32_t new_conns = process_new_connections_batch(thread);
-        if (new_conns > 0) {
-            printf("DEBUG: Thread %d processed %u new connections\n", thread->id, new_conns);
-        }
-        
-        // 2. 等待事件（短超时，及时响应新连接）
-        int nfds = epoll_wait(thread->epoll_fd, events, MAX_EVENTS, 10); // 10ms超时
-        if (nfds == -1) {
-            if (errno == EINTR) continue;
-            perror("epoll_wait");
-            break;
-        }
-        
-        if (nfds > 0) {
-            atomic_fetch_add(&thread->processed_events, nfds);
-            printf("DEBUG: Thread %d got %d events\n", thread->id, nfds);
+    for (int i = 0; i < reactor->thread_count; i++) {
+        uint32_t r = atomic_load_explicit(&reactor->threads[i]->event_rate, memory_order_relaxed);
+        if (i != thread->id && r < target_rate) {
+            target = i;
+            target_rate = r;
         }
-        
-        // 3. 预处理：分类事件
-        connection_t *read_conns[MAX_EVENTS];
-        connection_t *write_conns[MAX_EVENTS];
-        uint32_t read_count = 0, write_count = 0;
-        
-        for (int i = 0; i < nfds; i++) {
-            connection_t *conn = (connection_t*)events[i].data.ptr;
-            if (!conn) continue;
-            
-            conn->last_active_time = get_current_time_ms();
-            
-            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
-                printf("DEBUG: Thread %d - connection error/hup on fd=%d, closing\n", thread->id, conn->fd);
-                handle_close_event(thread, conn);
-                continue;
-            }
-            
-            if (events[i].events & EPOLLIN) {
-                read_conns[read_count++] = conn;
-            }
-            
-            if (events[i].events & EPOLLOUT) {
-                write_conns[write_count++] = conn;
-            }
+    }
+    
+    // 明显高于最空闲的线程才迁移，避免连接来回搬动
+    bool overloaded = target >= 0 && rate >= REBALANCE_MIN_RATE && rate > target_rate + target_rate / 2;
+    
+    // 每个周期都要清零连接的事件数：计数按槽位连续存放，未过载时整段清零，
+    // 过载时顺序扫描，只有计数够进前REBALANCE_MAX_MOVES名的槽位才访问连接本身
+    uint32_t *counts = thread->conn_events;
+    uint32_t cursor = thread->connections.cursor;
+    if (!overloaded) {
+        memset(counts, 0, cursor * sizeof(uint32_t));
+        return;
+    }
+    
+    connection_t *hot[REBALANCE_MAX_MOVES];
+    uint32_t hot_events[REBALANCE_MAX_MOVES];
+    uint32_t hot_count = 0;
+    
+    for (uint32_t j = 0; j < cursor; j++) {
+        uint32_t events = counts[j];
+        if (events == 0) continue;
+        counts[j] = 0;
+        if (hot_count == REBALANCE_MAX_MOVES && events <= hot_events[hot_count - 1]) {
+            continue;
         }
         
-        // 4. 处理读事件
-        for (uint32_t i = 0; i < read_count; i++) {
-            handle_read_event(thread, read_conns[i]);
+        connection_t *conn = thread->connections.values[j];
+        if (!conn || (conn->flags & (CONN_FLAG_METRICS | CONN_FLAG_CLOSE_ON_FLUSH | CONN_FLAG_MIGRATE))) {
+            continue;
         }
         
-        // 5. 处理写事件
-        if (write_count > 0) {
-            handle_write_events(thread, write_conns, write_count);
+        uint32_t k = hot_count < REBALANCE_MAX_MOVES ? hot_count++ : hot_count - 1;
+        while (k > 0 && hot_events[k - 1] < events) {
+            hot[k] = hot[k - 1];
+            hot_events[k] = hot_events[k - 1];
+            k--;
         }
+        hot[k] = conn;
+        hot_events[k] = events;
+    }
+    
+    uint64_t gap = rate - target_rate;
+    uint64_t moved = 0;
+    for (uint32_t i = 0; i < hot_count && moved < gap / 2; i++) {
+        uint64_t conn_rate = (uint64_t)hot_events[i] * 1000 / REACTOR_LOAD_SAMPLE_MS;
+        // 单个连接超过速率差时迁过去只是把热点换了个线程
+        if (conn_rate >= gap) continue;
         
-        // 6. 定时器检查（每100次循环检查一次）
-        if (loop_count % 100 == 0) {
-            uint64_t current_time = get_current_time_ms();
-            for (int i = 0; i < MAX_CONNECTIONS; i++) {
-                connection_t *conn = thread->connections[i];
-                if (conn && current_time - conn->last_active_time > 30000) {
-                    printf("DEBUG: Thread %d - connection timeout on fd=%d, closing\n", thread->id, conn->fd);
-                    handle_close_event(thread, conn);
-                }
-            }
+        if (reactor_migrate(reactor, hot[i], target) == 0) {
+            moved += conn_rate;
         }
     }
-    
-    printf("DEBUG: Reactor thread %d stopped\n", thread->id);
-    return NULL;
 }
 
-// 添加连接
-int reactor_add_connection(reactor_t *reactor, int fd) {
-    if (!reactor || fd < 0) {
-        printf("ERROR: Invalid parameters to reactor_add_connection\n");
-        return -1;
-    }
-    
-    if (!atomic_load(&reactor->running)) {
-        printf("ERROR: Reactor not running when adding connection\n");
-        return -1;
-    }
+// 负载采样：更新本线程的事件速率，开启迁移时检查是否过载
+static void thread_load_sample(timer_node_t *node, void *arg) {
+    reactor_thread_t *thread = (reactor_thread_t*)arg;
+    (void)node;
     
-    // 负载均衡：简单的轮询
-    uint32_t thread_index = atomic_fetch_add(&reactor->next_thread, 1) % reactor->thread_count;
-    reactor_thread_t *thread = &reactor->threads[thread_index];
+    uint64_t events = atomic_load(&thread->processed_events);
+    uint32_t rate = (uint32_t)((events - thread->load_last_events) * 1000 / REACTOR_LOAD_SAMPLE_MS);
+    thread->load_last_events = events;
     
-    printf("DEBUG: Adding fd=%d to thread %d\n", fd, thread_index);
+    // 与上一周期平均，平滑突发
+    rate = (atomic_load_explicit(&thread->event_rate, memory_order_relaxed) + rate) / 2;
+    atomic_store_explicit(&thread->event_rate, rate, memory_order_relaxed);
+    metrics_set(thread->reactor->metrics, thread->id, thread->reactor->mid.event_rate, rate);
     
-    // 使用无锁队列
-    if (ring_queue_push(&thread->accept_queue, fd)) {
-        printf("DEBUG: Successfully queued fd=%d to thread %d\n", fd, thread_index);
-        return 0;
+    if (atomic_load_explicit(&thread->reactor->rebalance, memory_order_relaxed)) {
+        thread_rebalance(thread, rate);
     }
+}
+
+// fd耗尽（EMFILE/ENFILE）时连接留在监听队列里，水平触发会立即再次上报，线程空转。
+// 临时关闭预留的fd腾出一个位置，取出一个连接直接关闭，再重新预留；返回false表示监听队列已空
+static bool thread_reject_connection(reactor_thread_t *thread, int listen_fd) {
+    if (thread->reserve_fd != -1) {
+        close(thread->reserve_fd);
+    }
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd != -1) {
+        close(fd);
+        metrics_add(thread->reactor->metrics, thread->id, thread->reactor->mid.accept_rejected, 1);
+    }
+    thread->reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    thread->syscalls += 4;
+    return fd != -1;
+}
+
+// 处理本线程的监听socket：accept4直接得到非阻塞fd，循环取到EAGAIN或达到上限
+static void handle_listen_event(reactor_thread_t *thread) {
+    for (int i = 0; i < MAX_ACCEPT_PER_WAKEUP; i++) {
+        int fd = accept4(thread->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        thread->syscalls++;
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                LOG_ERROR("Thread %d - accept4 failed: %s, closing the pending connection",
+                          thread->id, strerror(errno));
+                if (thread_reject_connection(thread, thread->listen_fd)) continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("Thread %d - accept4 failed: %s", thread->id, strerror(errno));
+            }
+            break;
+        }
+        
+        if (!thread_add_connection(thread, fd, 0)) {
+            close(fd);
+            continue;
+        }
+        thread_stat_add(&thread->accepted_connections, 1);
+        metrics_add(thread->reactor->metrics, thread->id, thread->reactor->mid.accepted, 1);
+    }
+}
+
+// 指标抓取端口的新连接，按普通连接处理，请求到齐后回复并在发送完后关闭
+static void handle_metrics_accept(reactor_thread_t *thread) {
+    for (int i = 0; i < MAX_ACCEPT_PER_WAKEUP; i++) {
+        int fd = accept4(thread->reactor->metrics_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        thread->syscalls++;
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if ((errno == EMFILE || errno == ENFILE) &&
+                thread_reject_connection(thread, thread->reactor->metrics_fd)) continue;
+            break;
+        }
+        if (!thread_add_connection(thread, fd, CONN_FLAG_METRICS)) {
+            close(fd);
+        }
+    }
+}
+
+static void metrics_buffer_free(void *arg) {
+    free(arg);
+}
+
+// 收到完整的HTTP请求头后返回文本指标，请求内容不做解析
+static bool handle_metrics_request(reactor_thread_t *thread, connection_t *conn) {
+    reactor_t *reactor = thread->reactor;
+    char req[4096];
+    size_t len = buf_chain_peek(&conn->input, 0, req, sizeof(req));
+    
+    if (!memmem(req, len, "\r\n\r\n", 4) && !memmem(req, len, "\n\n", 2)) {
+        if (len < sizeof(req)) return true;
+    }
+    buf_chain_clear(&conn->input, &thread->buf_pool);
+    if (conn->flags & CONN_FLAG_CLOSE_ON_FLUSH) return true;
+    
+    char *body = malloc(METRICS_RESPONSE_MAX);
+    if (!body) {
+        handle_close_event(thread, conn);
+        return false;
+    }
+    size_t body_len = metrics_render(reactor->metrics, body, METRICS_RESPONSE_MAX);
+    
+    char hdr[160];
+    int hdr_len = snprintf(hdr, sizeof(hdr),
+                           "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: %zu\r\n"
+                           "Connection: close\r\n\r\n", body_len);
+    
+    // 响应头拷贝入队，正文零拷贝，发送完后释放
+    conn->flags |= CONN_FLAG_CLOSE_ON_FLUSH;
+    if (reactor_write(reactor, conn, hdr, (size_t)hdr_len) != (size_t)hdr_len ||
+        reactor_write_ref(reactor, conn, body, body_len, metrics_buffer_free, body) != 0) {
+        free(body);
+        handle_close_event(thread, conn);
+        return false;
+    }
+    return true;
+}
+
+// 发送遇到EAGAIN，等可写后由handle_write_events继续发送：连接注册时已带EPOLLOUT|EPOLLET，
+// 内核发送缓冲腾出空间时会上报新的边缘，这里只记录写意向，不需要系统调用；期间照常读取
+static void connection_watch_write(connection_t *conn) {
+    conn->flags |= CONN_FLAG_WANT_OUT;
+}
+
+// 不先尝试发送、直接等EPOLLOUT（--flush epollout或dirty列表已满）：socket一直可写时不会有新的边缘，
+// 用相同的事件集MOD一次让内核按当前状态重新上报，可写时立即得到EPOLLOUT
+static void connection_rearm_write(reactor_thread_t *thread, connection_t *conn) {
+    if (conn->flags & CONN_FLAG_WANT_OUT) return;
+    
+    struct epoll_event ev;
+    ev.events = CONN_EPOLL_EVENTS;
+    ev.data.u64 = conn->handle;
+    epoll_ctl(thread->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+    thread->syscalls++;
+    conn->flags |= CONN_FLAG_WANT_OUT;
+}
+
+static void connection_want_write(reactor_thread_t *thread, connection_t *conn)
+{
+    if (thread_is_uring(thread)) {
+        uring_queue_send(thread, conn);
+        return;
+    }
+    
+    // 延迟发送：记入dirty列表，本轮末尾直接sendmsg，只有遇到EAGAIN才依赖EPOLLOUT边缘；
+    // 已在等待EPOLLOUT的连接由可写事件发送。列表满时（本轮关闭的连接留下的失效句柄过多）退回EPOLLOUT
+    if (thread->reactor->deferred_flush && thread->dirty_count < MAX_CONNECTIONS) {
+        if (!(conn->flags & (CONN_FLAG_DIRTY | CONN_FLAG_WANT_OUT))) {
+            conn->flags |= CONN_FLAG_DIRTY;
+            thread->dirty[thread->dirty_count++] = conn->handle;
+        }
+        return;
+    }
+    connection_rearm_write(thread, conn);
+}
+
+// 读取暂停状态改变后更新：io_uring后端取消或重新提交多发recv；
+// epoll后端不改注册，暂停期间的EPOLLIN由handle_read_event忽略，恢复时放入ready列表，
+// 下一轮直接读到EAGAIN（暂停期间到达的数据不会再有新的边缘）
+static void connection_update_read(reactor_thread_t *thread, connection_t *conn) {
+    if (thread_is_uring(thread)) {
+        if (connection_read_paused(conn)) {
+            if (conn->flags & CONN_FLAG_URING_RECV) {
+                uring_cancel(thread, (uint64_t)(uintptr_t)conn | URING_OP_RECV);
+            }
+        } else if (!(conn->flags & CONN_FLAG_URING_RECV) && uring_arm_recv(thread, conn) != 0) {
+            LOG_ERROR("Thread %d - failed to resume recv on fd=%d", thread->id, conn->fd);
+        }
+        return;
+    }
+    
+    if (!connection_read_paused(conn) && !(conn->flags & CONN_FLAG_READ_READY) &&
+        thread->ready_count < MAX_CONNECTIONS) {
+        conn->flags |= CONN_FLAG_READ_READY;
+        thread->ready[thread->ready_count++] = conn->handle;
+    }
+}
+
+// 数据入队后检查高水位：越过时暂停本连接的读取并通知应用
+static void connection_check_high(reactor_thread_t *thread, connection_t *conn) {
+    reactor_t *reactor = thread->reactor;
+    if ((conn->flags & CONN_FLAG_OUTQ_HIGH) || conn->output.len < reactor->outq_high) return;
+    
+    conn->flags |= CONN_FLAG_OUTQ_HIGH;
+    connection_update_read(thread, conn);
+    metrics_add(reactor->metrics, thread->id, reactor->mid.backpressure, 1);
+    LOG_DEBUG("Thread %d - output of fd=%d above high watermark (%zu bytes), pausing reads",
+              thread->id, conn->fd, conn->output.len);
+    
+    if (reactor->on_backpressure && !(conn->flags & CONN_FLAG_METRICS)) {
+        reactor->on_backpressure(conn, true);
+    }
+}
+
+// 发送后检查低水位：回落时恢复读取并通知应用；返回false表示连接已在回调中关闭
+static bool connection_check_low(reactor_thread_t *thread, connection_t *conn) {
+    reactor_t *reactor = thread->reactor;
+    if (!(conn->flags & CONN_FLAG_OUTQ_HIGH) || conn->output.len > reactor->outq_low) return true;
+    
+    conn->flags &= ~CONN_FLAG_OUTQ_HIGH;
+    connection_update_read(thread, conn);
+    LOG_DEBUG("Thread %d - output of fd=%d below low watermark, resuming reads", thread->id, conn->fd);
+    
+    if (reactor->on_backpressure && !(conn->flags & CONN_FLAG_METRICS)) {
+        conn_handle_t handle = conn->handle;
+        reactor->on_backpressure(conn, false);
+        return thread_lookup_connection(thread, handle) != NULL;
+    }
+    return true;
+}
+
+static void handle_add_write(reactor_thread_t *thread, connection_t *conn)
+{
+    // 回显：输入链的段直接挂到发送队列，不拷贝数据
+    buf_outq_splice(&conn->output, &thread->buf_pool, &conn->input, conn->input.len);
+    
+    connection_want_write(thread, conn);
+    connection_check_high(thread, conn);
+}
+
+// 按编解码器解帧，逐帧回调；返回false表示连接已关闭
+static bool connection_decode_frames(reactor_thread_t *thread, connection_t *conn) {
+    reactor_t *reactor = thread->reactor;
+    conn_handle_t handle = conn->handle;
+    
+    while (!buf_chain_empty(&conn->input)) {
+        codec_frame_t frame = { .type = CODEC_FRAME_NONE, .fin = true };
+        ssize_t n = reactor->codec->decode(reactor, conn, thread->codec_scratch, &frame);
+        
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            LOG_DEBUG("Thread %d - %s protocol error on fd=%d, closing",
+                   thread->id, reactor->codec->name, conn->fd);
+            handle_close_event(thread, conn);
+            return false;
+        }
+        
+        if (frame.type != CODEC_FRAME_NONE) {
+            if (reactor->on_frame) {
+                reactor->on_frame(conn, &frame);
+                // 回调中可能关闭了连接
+                if (!thread_lookup_connection(thread, handle)) {
+                    return false;
+                }
+            } else if (frame.type <= CODEC_FRAME_BINARY) {
+                // 默认原样回送数据帧，保留分片的opcode和fin位
+                reactor_send_codec_frame(reactor, conn, &frame);
+            }
+        }
+        
+        buf_chain_consume(&conn->input, &thread->buf_pool, (size_t)n);
+    }
+    
+    return true;
+}
+
+// 收到数据后交给编解码器或应用；返回false表示连接已关闭
+static bool connection_on_input(reactor_thread_t *thread, connection_t *conn) {
+    reactor_t *reactor = thread->reactor;
+    
+    if (conn->flags & CONN_FLAG_METRICS) {
+        return handle_metrics_request(thread, conn);
+    }
+    
+    if (reactor->codec) {
+        return connection_decode_frames(thread, conn);
+    }
+    
+    if (reactor->on_data) {
+        conn_handle_t handle = conn->handle;
+        reactor->on_data(conn);
+        return thread_lookup_connection(thread, handle) != NULL;
+    }
+    
+    // 默认回显
+    handle_add_write(thread, conn);
+    return true;
+}
+
+// 处理读事件（边缘触发，readv直接读入段链）
+// 读预算用完：放入ready列表，下一轮继续读（边缘触发不会再次上报已有的数据）
+static void connection_defer_read(reactor_thread_t *thread, connection_t *conn) {
+    conn->flags |= CONN_FLAG_READ_READY;
+    thread->ready[thread->ready_count++] = conn->handle;
+    thread->read_deferred++;
+    metrics_add(thread->reactor->metrics, thread->id, thread->reactor->mid.read_deferred, 1);
+}
+
+static void handle_read_event(reactor_thread_t *thread, connection_t *conn) {
+    if (connection_read_paused(conn)) return;
+    
+    size_t conn_left = thread->reactor->read_budget_conn;
+    while (1) {
+        if (conn_left == 0 || thread->loop_read_left == 0) {
+            connection_defer_read(thread, conn);
+            break;
+        }
+        
+        struct iovec iov[BUF_RESERVE_MAX];
+        int iovcnt = buf_chain_reserve(&conn->input, &thread->buf_pool, iov, BUF_RESERVE_MAX);
+        
+        if (iovcnt == 0) {
+            // 段池无法分配内存
+            LOG_DEBUG("Thread %d - Out of buffer memory for fd=%d", thread->id, conn->fd);
+            handle_close_event(thread, conn);
+            break;
+        }
+        
+        ssize_t n = readv(conn->fd, iov, iovcnt);
+        thread->syscalls++;
+        
+        // 未写入数据的预留段立即归还
+        buf_chain_commit(&conn->input, &thread->buf_pool, n > 0 ? (size_t)n : 0);
+        
+        if (n > 0) {
+            metrics_add(thread->reactor->metrics, thread->id, thread->reactor->mid.bytes_in, (uint64_t)n);
+            LOG_DEBUG("Thread %d - Read %zd bytes from fd=%d", thread->id, n, conn->fd);
+            conn_left = (size_t)n < conn_left ? conn_left - (size_t)n : 0;
+            thread->loop_read_left = (size_t)n < thread->loop_read_left ? thread->loop_read_left - (size_t)n : 0;
+            if (!connection_on_input(thread, conn)) {
+                break;
+            }
+            // 暂停后剩余数据留在内核接收缓冲，恢复时经ready列表继续读
+            if (connection_read_paused(conn)) {
+                break;
+            }
+        } else if (n == 0) {
+            // 连接关闭
+            LOG_DEBUG("Thread %d - Connection closed by peer, fd=%d", thread->id, conn->fd);
+            handle_close_event(thread, conn);
+            break;
+        } else {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 数据已读完，应用已消费全部输入时执行推迟的迁移
+                connection_try_migrate(thread, conn);
+                break;
+            } else {
+                LOG_DEBUG("Thread %d - Read error on fd=%d: %s", thread->id, conn->fd, strerror(errno));
+                handle_close_event(thread, conn);
+                break;
+            }
+        }
+    }
+}
+
+// 发送队列清空后清除写意向；返回false表示连接已关闭
+static bool handle_add_read_event(reactor_thread_t *thread, connection_t *conn)
+{
+    if (buf_outq_empty(&conn->output)) {
+        if (conn->flags & CONN_FLAG_CLOSE_ON_FLUSH) {
+            handle_close_event(thread, conn);
+            return false;
+        }
+        
+        // 发送完成，之后的EPOLLOUT边缘不再处理；注册的事件集不变，读取一直有效
+        conn->flags &= ~CONN_FLAG_WANT_OUT;
+        
+        LOG_DEBUG("Thread %d - All data sent to fd=%d", thread->id, conn->fd);
+        
+        if (thread->reactor->on_write) {
+            conn_handle_t handle = conn->handle;
+            thread->reactor->on_write(conn);
+            if (!thread_lookup_connection(thread, handle)) {
+                return false;
+            }
+        }
+        
+        return !connection_try_migrate(thread, conn);
+    }
+    
+    return true;
+}
+
+// 发送队列写到空或EAGAIN（边缘触发下不写到EAGAIN不会再有EPOLLOUT）
+// 一次sendmsg提交不完整个队列时带MSG_MORE，内核不会把批次中间的小块单独发成一个段
+static void connection_flush(reactor_thread_t *thread, connection_t *conn) {
+    while (!buf_outq_empty(&conn->output)) {
+        struct iovec iov[BUF_IOV_MAX];
+        int iovcnt = buf_outq_iov(&conn->output, iov, BUF_IOV_MAX);
+        size_t batch = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            batch += iov[i].iov_len;
+        }
+        
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = (size_t)iovcnt };
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | (batch < conn->output.len ? MSG_MORE : 0));
+        thread->syscalls++;
+        
+        if (n > 0) {
+            buf_outq_consume(&conn->output, &thread->buf_pool, n);
+            metrics_add(thread->reactor->metrics, thread->id, thread->reactor->mid.bytes_out, (uint64_t)n);
+            LOG_DEBUG("Thread %d - Wrote %zd bytes to fd=%d", thread->id, n, conn->fd);
+            if (!connection_check_low(thread, conn)) {
+                return;
+            }
+            if (buf_outq_empty(&conn->output)) {
+                metrics_record(thread->reactor->metrics, thread->id, thread->reactor->mid.write_backlog, 0);
+                handle_add_read_event(thread, conn);
+                return;
+            }
+        } else if (n == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 写缓冲区满，等可写后再试
+                metrics_record(thread->reactor->metrics, thread->id, thread->reactor->mid.write_backlog,
+                               conn->output.len);
+                connection_watch_write(conn);
+                return;
+            } else if (errno != EINTR) {
+                LOG_DEBUG("Thread %d - Write error on fd=%d: %s", thread->id, conn->fd, strerror(errno));
+                handle_close_event(thread, conn);
+                return;
+            }
+        }
+    }
+}
+
+// 批量处理写事件
+static void handle_write_events(reactor_thread_t *thread, conn_handle_t *handles, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        // 读阶段可能已关闭该连接，重新按句柄校验
+        connection_t *conn = thread_lookup_connection(thread, handles[i]);
+        if (conn) connection_flush(thread, conn);
+    }
+}
+
+// 循环末尾发送本轮写入过数据的连接；发送完成回调（on_write）中新写入的连接留到下一轮
+static void thread_flush_dirty(reactor_thread_t *thread) {
+    uint32_t count = thread->dirty_count;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        connection_t *conn = thread_lookup_connection(thread, thread->dirty[i]);
+        if (!conn || !(conn->flags & CONN_FLAG_DIRTY)) continue;
+        conn->flags &= ~CONN_FLAG_DIRTY;
+        thread->flushes++;
+        connection_flush(thread, conn);
+    }
+    
+    thread->dirty_count -= count;
+    memmove(thread->dirty, thread->dirty + count, thread->dirty_count * sizeof(conn_handle_t));
+}
+
+/* ---------------- io_uring后端：完成事件与主循环 ---------------- */
+
+static int uring_arm_accept(reactor_thread_t *thread, int fd, uint64_t op) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&thread->uring);
+    if (!sqe) return -1;
+    
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = op;
+    return 0;
+}
+
+// eventfd读请求：完成即表示被唤醒，新连接在下一轮循环开头处理
+static int uring_arm_wakeup(reactor_thread_t *thread) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&thread->uring);
+    if (!sqe) return -1;
+    
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = thread->wakeup_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&thread->wakeup_value;
+    sqe->len = sizeof(thread->wakeup_value);
+    sqe->user_data = URING_OP_WAKEUP;
+    return 0;
+}
+
+// 接收到的数据交给输入链：小块数据拷进尾段剩余空间、缓冲原样放回，
+// 否则整段挂到输入链（零拷贝），换一个新段补进缓冲环
+static int uring_recv_input(reactor_thread_t *thread, connection_t *conn, uint16_t bid, size_t len) {
+    buf_segment_t *seg = thread->pbuf_segs[bid];
+    buf_chain_t *in = &conn->input;
+    
+    if (len < BUF_COPY_MAX && in->tail && BUF_SEGMENT_DATA_SIZE - in->tail->end >= len) {
+        buf_chain_append(in, &thread->buf_pool, seg->data, len);
+        uring_pbuf_recycle(thread, bid);
+        return 0;
+    }
+    
+    buf_segment_t *fresh = buf_pool_get(&thread->buf_pool);
+    if (!fresh) {
+        uring_pbuf_recycle(thread, bid);
+        return -1;
+    }
+    thread->pbuf_segs[bid] = fresh;
+    uring_pbuf_recycle(thread, bid);
+    buf_chain_append_segment(in, seg, len);
+    return 0;
+}
+
+static void uring_handle_recv(reactor_thread_t *thread, connection_t *conn, const struct io_uring_cqe *cqe) {
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+    bool has_buf = cqe->flags & IORING_CQE_F_BUFFER;
+    uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    
+    if (!more) {
+        conn->uring_inflight--;
+        conn->flags &= ~CONN_FLAG_URING_RECV;
+    }
+    
+    // 关闭后到达的完成事件只归还缓冲
+    if (conn->flags & CONN_FLAG_CLOSED) {
+        if (has_buf) uring_pbuf_recycle(thread, bid);
+        uring_release(thread, conn);
+        return;
+    }
+    
+    conn->last_active_time = thread->now_ms;
+    thread->conn_events[CONN_HANDLE_SLOT(conn->handle)]++;
+    
+    if (cqe->res > 0 && has_buf) {
+        if (uring_recv_input(thread, conn, bid, (size_t)cqe->res) != 0) {
+            LOG_DEBUG("Thread %d - Out of buffer memory for fd=%d", thread->id, conn->fd);
+            handle_close_event(thread, conn);
+            return;
+        }
+        metrics_add(thread->reactor->metrics, thread->id, thread->reactor->mid.bytes_in, (uint64_t)cqe->res);
+        LOG_DEBUG("Thread %d - Received %d bytes from fd=%d", thread->id, cqe->res, conn->fd);
+        if (!connection_on_input(thread, conn)) {
+            return;
+        }
+        if (!more && !connection_read_paused(conn) && uring_arm_recv(thread, conn) != 0) {
+            handle_close_event(thread, conn);
+        }
+        return;
+    }
+    
+    if (has_buf) uring_pbuf_recycle(thread, bid);
+    
+    // 提供缓冲暂时用完：本轮处理完的缓冲会放回，重新提交即可；暂停读取时被取消，恢复时重新提交
+    if (cqe->res == -ENOBUFS || cqe->res == -ECANCELED) {
+        if (!more && !connection_read_paused(conn) && uring_arm_recv(thread, conn) != 0) {
+            handle_close_event(thread, conn);
+        }
+        return;
+    }
+    
+    if (cqe->res == 0) {
+        LOG_DEBUG("Thread %d - Connection closed by peer, fd=%d", thread->id, conn->fd);
+    } else {
+        LOG_DEBUG("Thread %d - Read error on fd=%d: %s", thread->id, conn->fd, strerror(-cqe->res));
+    }
+    handle_close_event(thread, conn);
+}
+
+// 发送队列的片段直接组成iovec，一个sendmsg提交
+static int uring_prep_send(reactor_thread_t *thread, connection_t *conn) {
+    uring_send_t *s = thread->send_free;
+    if (s) {
+        thread->send_free = s->next;
+    } else if (!(s = malloc(sizeof(uring_send_t)))) {
+        return -1;
+    }
+    
+    struct io_uring_sqe *sqe = uring_get_sqe(&thread->uring);
+    if (!sqe) {
+        s->next = thread->send_free;
+        thread->send_free = s;
+        return -1;
+    }
+    
+    memset(&s->msg, 0, sizeof(s->msg));
+    s->msg.msg_iov = s->iov;
+    s->msg.msg_iovlen = (size_t)buf_outq_iov(&conn->output, s->iov, BUF_IOV_MAX);
+    
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&s->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | URING_OP_SEND;
+    conn->uring_send = s;
+    conn->uring_inflight++;
+    return 0;
+}
+
+// 提交本轮所有待发送连接的sendmsg
+static void uring_flush_sends(reactor_thread_t *thread) {
+    connection_t *conn = thread->send_head;
+    thread->send_head = NULL;
+    
+    while (conn) {
+        connection_t *next = conn->send_next;
+        conn->flags &= ~CONN_FLAG_SEND_QUEUED;
+        
+        if (conn->flags & CONN_FLAG_CLOSED) {
+            uring_release(thread, conn);
+        } else if (!buf_outq_empty(&conn->output) && !conn->uring_send &&
+                   uring_prep_send(thread, conn) != 0) {
+            LOG_ERROR("Thread %d - failed to submit send on fd=%d, closing", thread->id, conn->fd);
+            handle_close_event(thread, conn);
+        }
+        conn = next;
+    }
+}
+
+static void uring_handle_send(reactor_thread_t *thread, connection_t *conn, const struct io_uring_cqe *cqe) {
+    uring_send_t *s = conn->uring_send;
+    conn->uring_send = NULL;
+    conn->uring_inflight--;
+    s->next = thread->send_free;
+    thread->send_free = s;
+    
+    if (conn->flags & CONN_FLAG_CLOSED) {
+        uring_release(thread, conn);
+        return;
+    }
+    
+    if (cqe->res < 0) {
+        LOG_DEBUG("Thread %d - Write error on fd=%d: %s", thread->id, conn->fd, strerror(-cqe->res));
+        handle_close_event(thread, conn);
+        return;
+    }
+    
+    buf_outq_consume(&conn->output, &thread->buf_pool, (size_t)cqe->res);
+    metrics_add(thread->reactor->metrics, thread->id, thread->reactor->mid.bytes_out, (uint64_t)cqe->res);
+    LOG_DEBUG("Thread %d - Wrote %d bytes to fd=%d", thread->id, cqe->res, conn->fd);
+    if (!connection_check_low(thread, conn)) {
+        return;
+    }
+    
+    if (buf_outq_empty(&conn->output)) {
+        metrics_record(thread->reactor->metrics, thread->id, thread->reactor->mid.write_backlog, 0);
+        handle_add_read_event(thread, conn);
+    } else {
+        // 部分发送或发送期间又有新数据，本轮末尾继续
+        metrics_record(thread->reactor->metrics, thread->id, thread->reactor->mid.write_backlog, conn->output.len);
+        uring_queue_send(thread, conn);
+    }
+}
+
+// fd耗尽后暂停的accept到期重新提交
+static void uring_accept_retry(timer_node_t *node, void *arg) {
+    reactor_thread_t *thread = (reactor_thread_t*)arg;
+    (void)node;
+    
+    if (!atomic_load(&thread->running)) return;
+    if ((thread->accept_paused & (1u << URING_OP_ACCEPT)) && thread->listen_fd != -1) {
+        uring_arm_accept(thread, thread->listen_fd, URING_OP_ACCEPT);
+    }
+    if ((thread->accept_paused & (1u << URING_OP_ACCEPT_METRICS)) && thread->reactor->metrics_fd != -1) {
+        uring_arm_accept(thread, thread->reactor->metrics_fd, URING_OP_ACCEPT_METRICS);
+    }
+    thread->accept_paused = 0;
+}
+
+static void uring_handle_accept(reactor_thread_t *thread, const struct io_uring_cqe *cqe, uint64_t op) {
+    reactor_t *reactor = thread->reactor;
+    bool metrics_port = op == URING_OP_ACCEPT_METRICS;
+    
+    if (cqe->res >= 0) {
+        int fd = cqe->res;
+        if (!atomic_load(&thread->running) ||
+            !thread_add_connection(thread, fd, metrics_port ? CONN_FLAG_METRICS : 0)) {
+            close(fd);
+            thread->syscalls++;
+        } else if (!metrics_port) {
+            thread_stat_add(&thread->accepted_connections, 1);
+            metrics_add(reactor->metrics, thread->id, reactor->mid.accepted, 1);
+        }
+    } else if (cqe->res != -ECONNABORTED && cqe->res != -EINTR && cqe->res != -ECANCELED) {
+        LOG_ERROR("Thread %d - accept failed: %s", thread->id, strerror(-cqe->res));
+    }
+    
+    // 多发accept出错后终止，重新提交；监听socket已交给新进程时不再提交
+    // fd耗尽时io_uring先分配fd再取连接，监听队列为空也立即失败：取出并关闭一个等待的连接，
+    // 隔URING_ACCEPT_RETRY_MS再重新提交，否则线程空转
+    int listen_fd = metrics_port ? reactor->metrics_fd : thread->listen_fd;
+    if ((cqe->res == -EMFILE || cqe->res == -ENFILE) && listen_fd != -1 && !(cqe->flags & IORING_CQE_F_MORE)) {
+        thread_reject_connection(thread, listen_fd);
+        thread->accept_paused |= 1u << op;
+        if (!timer_node_pending(&thread->accept_timer)) {
+            timer_wheel_add(&thread->timers, &thread->accept_timer, thread->now_ms + URING_ACCEPT_RETRY_MS, 0);
+        }
+        return;
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE) && listen_fd != -1 && atomic_load(&thread->running)) {
+        uring_arm_accept(thread, listen_fd, op);
+    }
+}
+
+// 分发一个完成事件
+static void uring_dispatch(reactor_thread_t *thread, const struct io_uring_cqe *cqe) {
+    uint64_t op = cqe->user_data & URING_OP_MASK;
+    connection_t *conn = (connection_t*)(uintptr_t)(cqe->user_data & ~(uint64_t)URING_OP_MASK);
+    
+    switch (op) {
+        case URING_OP_RECV:
+            uring_handle_recv(thread, conn, cqe);
+            break;
+        case URING_OP_SEND:
+            uring_handle_send(thread, conn, cqe);
+            break;
+        case URING_OP_ACCEPT:
+        case URING_OP_ACCEPT_METRICS:
+            uring_handle_accept(thread, cqe, op);
+            break;
+        case URING_OP_WAKEUP:
+            if (atomic_load(&thread->running)) uring_arm_wakeup(thread);
+            break;
+    }
+}
+
+// 处理已到达的完成事件，返回处理的个数；处理中可能提交新请求，逐个推进CQ头
+static uint32_t uring_process_completions(reactor_thread_t *thread) {
+    uint32_t count = 0;
+    struct io_uring_cqe *cqe;
+    
+    while (count < URING_CQE_BATCH && (cqe = uring_peek_cqe(&thread->uring, 0)) != NULL) {
+        struct io_uring_cqe local = *cqe;
+        uring_cqe_advance(&thread->uring, 1);
+        uring_dispatch(thread, &local);
+        count++;
+    }
+    
+    // 本轮放回的缓冲一次发布
+    uring_buf_ring_publish(&thread->pbuf);
+    return count;
+}
+
+// 线程退出：关闭剩余连接（不回调），等进行中的请求完成后释放
+static void uring_thread_drain(reactor_thread_t *thread) {
+    for (uint32_t j = 0; j < thread->connections.cursor; j++) {
+        connection_t *conn = thread->connections.values[j];
+        if (!conn) continue;
+        
+        slot_table_free(&thread->connections, CONN_HANDLE_SLOT(conn->handle), CONN_HANDLE_GEN(conn->handle));
+        thread_conns_add(thread, -1);
+        timer_wheel_del(&thread->timers, &conn->idle_timer);
+        uring_close_connection(thread, conn);
+    }
+    uring_flush_sends(thread);
+    
+    uint64_t deadline = get_current_time_ms() + URING_DRAIN_MS;
+    while (thread->zombies > 0 && get_current_time_ms() < deadline) {
+        uring_submit_and_wait(&thread->uring, 1, 100);
+        uring_process_completions(thread);
+        uring_flush_sends(thread);
+    }
+    if (thread->zombies > 0) {
+        LOG_ERROR("Thread %d - %u connections still have pending io_uring requests", thread->id, thread->zombies);
+    }
+}
+
+/* ---------------- 热升级：监听socket与连接的交接 ---------------- */
+
+// 交接请求，由upgrade_request传给各线程
+#define UPGRADE_DETACH_LISTENERS      0x1   // 停止accept并关闭本进程的监听socket
+#define UPGRADE_HANDOFF_CONNECTIONS   0x2   // 交出本线程的连接
+
+// 交出一个连接时等待新进程读取的上限，Reactor线程持upgrade_lock发送，不能无限期阻塞
+#define UPGRADE_SEND_TIMEOUT_MS 1000
+
+// 新进程收到的连接，由接收线程压入目标线程的handoff_in栈
+typedef struct handoff_conn_s {
+    struct handoff_conn_s *next;
+    int fd;
+    uint32_t codec_state;
+    uint32_t input_len;
+    uint32_t output_len;
+    char data[];   // 未处理的输入在前，未发送的输出在后
+} handoff_conn_t;
+
+// 关闭本线程持有的监听socket；新进程持有同一个socket的副本，监听队列中的连接不会丢失
+static void thread_detach_listeners(reactor_thread_t *thread) {
+    reactor_t *reactor = thread->reactor;
+    int *fds[2] = { &thread->listen_fd, thread->id == 0 ? &reactor->metrics_fd : NULL };
+    uint64_t ops[2] = { URING_OP_ACCEPT, URING_OP_ACCEPT_METRICS };
+    
+    for (int i = 0; i < 2; i++) {
+        if (!fds[i] || *fds[i] == -1) continue;
+        // io_uring的多发accept持有socket的引用，只关闭fd不会停止accept
+        if (thread_is_uring(thread)) {
+            uring_cancel(thread, ops[i]);
+        } else {
+            epoll_ctl(thread->epoll_fd, EPOLL_CTL_DEL, *fds[i], NULL);
+        }
+        close(*fds[i]);
+        *fds[i] = -1;
+        thread->syscalls += 2;
+    }
+}
+
+// 摘除已交给新进程的连接：释放槽位、定时器、缓冲和epoll注册，只关闭本进程的fd副本
+// 连接仍在新进程中服务，不回调on_close；epoll注册跟随打开的文件而非fd，必须先DEL再close
+static void thread_detach_connection(reactor_thread_t *thread, connection_t *conn) {
+    slot_table_free(&thread->connections, CONN_HANDLE_SLOT(conn->handle), CONN_HANDLE_GEN(conn->handle));
+    thread_conns_add(thread, -1);
+    timer_wheel_del(&thread->timers, &conn->idle_timer);
+    epoll_ctl(thread->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    thread->syscalls += 2;
+    
+    buf_chain_clear(&conn->input, &thread->buf_pool);
+    buf_outq_clear(&conn->output, &thread->buf_pool);
+    slab_free(conn);
+}
+
+// 把本线程的连接连同缓冲状态发给新进程，发送成功的连接从本进程摘除，对端无感知
+static void thread_handoff_connections(reactor_thread_t *thread) {
+    reactor_t *reactor = thread->reactor;
+    uint32_t sent = 0;
+    
+    for (uint32_t j = 0; j < thread->connections.cursor; j++) {
+        connection_t *conn = thread->connections.values[j];
+        if (!conn || (conn->flags & (CONN_FLAG_METRICS | CONN_FLAG_CLOSE_ON_FLUSH))) continue;
+        
+        size_t input_len = conn->input.len;
+        size_t output_len = conn->output.len;
+        char *payload = NULL;
+        if (input_len + output_len > 0) {
+            payload = malloc(input_len + output_len);
+            if (!payload) continue;   // 留在本进程，随排空关闭
+            buf_chain_peek(&conn->input, 0, payload, input_len);
+            buf_outq_peek(&conn->output, payload + input_len, output_len);
+        }
+        
+        handoff_msg_t msg = {
+            .type = HANDOFF_CONNECTION,
+            .arg = { (uint32_t)input_len, (uint32_t)output_len, conn->codec_state },
+            .payload_len = input_len + output_len,
+        };
+        // 新进程读得慢时最多等待UPGRADE_SEND_TIMEOUT_MS，其他线程在锁上的等待同样有界
+        pthread_mutex_lock(&reactor->upgrade_lock);
+        bool broken = reactor->upgrade_broken;
+        int ret = broken ? -1 : handoff_send_timeout(reactor->upgrade_sock, &msg, &conn->fd, 1, payload,
+                                                     UPGRADE_SEND_TIMEOUT_MS);
+        if (ret != 0) reactor->upgrade_broken = true;
+        pthread_mutex_unlock(&reactor->upgrade_lock);
+        thread->syscalls += payload ? 2 : 1;
+        free(payload);
+        
+        if (ret != 0) {
+            // 新进程已断开或读取超时，剩余连接留在本进程
+            if (!broken) {
+                LOG_ERROR("Thread %d - failed to hand off fd=%d: %s", thread->id, conn->fd, strerror(errno));
+            }
+            break;
+        }
+        thread_detach_connection(thread, conn);
+        sent++;
+    }
+    
+    atomic_fetch_add(&reactor->upgrade_sent, sent);
+}
+
+// 执行交接请求，完成后通知发起的线程
+static void thread_process_upgrade(reactor_thread_t *thread) {
+    uint32_t request = atomic_exchange(&thread->upgrade_request, 0);
+    if (!request) return;
+    
+    if (request & UPGRADE_DETACH_LISTENERS) {
+        thread_detach_listeners(thread);
+    }
+    if ((request & UPGRADE_HANDOFF_CONNECTIONS) && !thread_is_uring(thread)) {
+        thread_handoff_connections(thread);
+    }
+    atomic_fetch_sub(&thread->reactor->upgrade_pending, 1);
+}
+
+// 接管旧进程交出的一个连接：先恢复缓冲，再回调on_connect，最后处理旧进程未处理完的输入
+static void thread_adopt_handoff(reactor_thread_t *thread, handoff_conn_t *h) {
+    reactor_t *reactor = thread->reactor;
+    
+    thread->syscalls += 2;
+    connection_t *conn = set_nonblocking(h->fd) == 0 ? thread_add_connection(thread, h->fd, CONN_FLAG_ADOPTED) : NULL;
+    if (!conn) {
+        LOG_ERROR("Thread %d - failed to adopt handed off fd=%d, closing", thread->id, h->fd);
+        close(h->fd);
+        return;
+    }
+    conn->codec_state = h->codec_state;
+    conn_handle_t handle = conn->handle;
+    
+    // 旧进程未发出的数据排在本进程产生的输出之前
+    if (h->output_len > 0) {
+        if (buf_outq_copy(&conn->output, &thread->buf_pool, h->data + h->input_len, h->output_len) != h->output_len) {
+            handle_close_event(thread, conn);
+            return;
+        }
+        connection_want_write(thread, conn);
+        connection_check_high(thread, conn);
+    }
+    
+    if (reactor->on_connect) {
+        reactor->on_connect(conn);
+        if (!thread_lookup_connection(thread, handle)) return;
+    }
+    
+    if (h->input_len > 0) {
+        if (buf_chain_append(&conn->input, &thread->buf_pool, h->data, h->input_len) != h->input_len) {
+            handle_close_event(thread, conn);
+            return;
+        }
+        connection_on_input(thread, conn);
+    }
+}
+
+// 处理接收线程转来的连接
+static void process_handoff_connections(reactor_thread_t *thread) {
+    handoff_conn_t *h = atomic_exchange_explicit(&thread->handoff_in, NULL, memory_order_acquire);
+    
+    while (h) {
+        handoff_conn_t *next = h->next;
+        thread_adopt_handoff(thread, h);
+        free(h);
+        h = next;
+    }
+}
+
+static void broadcast_payload_release(broadcast_payload_t *payload) {
+    if (atomic_fetch_sub_explicit(&payload->refs, 1, memory_order_acq_rel) == 1) {
+        free(payload);
+    }
+}
+
+// 成员的发送片段释放（发送完或连接关闭），在所属线程执行
+static void broadcast_ref_release(void *arg) {
+    broadcast_ref_t *ref = arg;
+    if (--ref->refs == 0) {
+        broadcast_payload_release(ref->payload);
+        slab_free(ref);
+    }
+}
+
+// 向本线程的组成员入队同一份负载，顺便移除已关闭、已迁出的成员
+static void thread_broadcast(reactor_thread_t *thread, const reactor_send_cmd_t *cmd) {
+    reactor_t *reactor = thread->reactor;
+    broadcast_payload_t *payload = cmd->u.bcast.payload;
+    conn_group_t *g = group_table_find(&thread->groups, cmd->u.bcast.gid);
+    if (!g) {
+        broadcast_payload_release(payload);
+        return;
+    }
+    
+    uint64_t start_us = get_current_time_us();
+    broadcast_ref_t *ref = slab_alloc(&thread->bcast_slab);
+    if (!ref) {
+        LOG_ERROR("Thread %d - out of memory for broadcast to group %llu", thread->id,
+                  (unsigned long long)cmd->u.bcast.gid);
+        broadcast_payload_release(payload);
+        return;
+    }
+    // 遍历期间本函数持有一个引用，小负载拷贝入队时片段立即释放，不会提前释放负载
+    ref->payload = payload;
+    ref->refs = 1;
+    
+    uint32_t queued = 0;
+    for (uint32_t i = 0; i < g->count; ) {
+        connection_t *conn = thread_lookup_connection(thread, g->members[i]);
+        if (!conn) {
+            group_del_at(g, i);
+            continue;
+        }
+        i++;
+        if (conn->flags & CONN_FLAG_CLOSE_ON_FLUSH) continue;
+        
+        ref->refs++;
+        if (reactor_write_ref(reactor, conn, payload->data, payload->len, broadcast_ref_release, ref) != 0) {
+            ref->refs--;
+            continue;
+        }
+        queued++;
+    }
+    if (g->count == 0) {
+        group_table_remove(&thread->groups, g);
+    }
+    broadcast_ref_release(ref);
+    
+    uint64_t end_us = get_current_time_us();
+    thread->broadcasts++;
+    thread->broadcast_members += queued;
+    metrics_record(reactor->metrics, thread->id, reactor->mid.broadcast_fanout_us, end_us - start_us);
+    metrics_record(reactor->metrics, thread->id, reactor->mid.broadcast_delay_us,
+                   end_us > cmd->u.bcast.start_us ? end_us - cmd->u.bcast.start_us : 0);
+    metrics_add(reactor->metrics, thread->id, reactor->mid.broadcast_members, queued);
+}
+
+// 处理其他线程经reactor_send投递的数据：每轮最多SEND_DRAIN_MAX条，按批出队后逐条入队到连接
+static void process_send_queue(reactor_thread_t *thread) {
+    reactor_t *reactor = thread->reactor;
+    reactor_send_cmd_t cmds[BATCH_SIZE];
+    uint32_t total = 0, dropped = 0;
+    
+    while (total < SEND_DRAIN_MAX) {
+        uint32_t n = mpsc_ring_pop_batch(&thread->send_queue, cmds, BATCH_SIZE);
+        if (n == 0) break;
+        total += n;
+        
+        for (uint32_t i = 0; i < n; i++) {
+            reactor_send_cmd_t *cmd = &cmds[i];
+            connection_t *conn = thread_lookup_connection(thread, cmd->handle);
+            if (conn && (conn->flags & (CONN_FLAG_CLOSE_ON_FLUSH | CONN_FLAG_METRICS))) {
+                conn = NULL;
+            }
+            
+            if (cmd->type == SEND_CMD_BROADCAST) {
+                thread_broadcast(thread, cmd);
+            } else if (cmd->type == SEND_CMD_INLINE) {
+                if (!conn || reactor_write(reactor, conn, cmd->u.data, cmd->len) != cmd->len) {
+                    dropped++;
+                }
+            } else if (!conn || reactor_write_ref(reactor, conn, cmd->u.ref.data, cmd->len,
+                                                   cmd->u.ref.free_fn, cmd->u.ref.arg) != 0) {
+                if (cmd->u.ref.free_fn) cmd->u.ref.free_fn(cmd->u.ref.arg);
+                dropped++;
+            }
+        }
+    }
+    
+    if (total > 0) {
+        thread->remote_sends += total;
+        thread->remote_dropped += dropped;
+        metrics_add(reactor->metrics, thread->id, reactor->mid.remote_sends, total);
+        if (dropped > 0) {
+            metrics_add(reactor->metrics, thread->id, reactor->mid.remote_dropped, dropped);
+            LOG_DEBUG("Thread %d - dropped %u remote sends to closed connections", thread->id, dropped);
+        }
+    }
+}
+
+// io_uring后端主循环：每轮一次io_uring_enter，同时提交本轮产生的请求并等待完成事件
+static void* reactor_uring_thread_main(void *arg) {
+    reactor_thread_t *thread = (reactor_thread_t*)arg;
+    reactor_t *reactor = thread->reactor;
+    metrics_t *metrics = reactor->metrics;
+    const reactor_metric_ids_t *mid = &reactor->mid;
+    
+    LOG_DEBUG("Reactor thread %d started (io_uring)", thread->id);
+    thread_localize(thread);
+    
+    if (uring_enable(&thread->uring) != 0) {
+        LOG_ERROR("Thread %d - failed to enable io_uring: %s", thread->id, strerror(errno));
+        return NULL;
+    }
+    if (uring_pbuf_fill(thread) != 0) {
+        LOG_ERROR("Thread %d - failed to allocate io_uring receive buffers", thread->id);
+        return NULL;
+    }
+    uring_arm_wakeup(thread);
+    timer_node_init(&thread->accept_timer, uring_accept_retry, thread);
+    if (thread->listen_fd != -1) {
+        uring_arm_accept(thread, thread->listen_fd, URING_OP_ACCEPT);
+    }
+    if (thread->id == 0 && reactor->metrics_fd != -1) {
+        uring_arm_accept(thread, reactor->metrics_fd, URING_OP_ACCEPT_METRICS);
+    }
+    
+    while (atomic_load(&thread->running)) {
+        process_new_connections_batch(thread);
+        process_handoff_connections(thread);
+        if (atomic_load_explicit(&thread->upgrade_request, memory_order_relaxed)) {
+            thread_process_upgrade(thread);
+        }
+        process_send_queue(thread);
+        uring_flush_sends(thread);
+        
+        // 唤醒协议与epoll后端相同：先声明即将阻塞，再复查队列；忙轮询时线程醒着，不需要唤醒
+        bool spinning;
+        uint64_t wait_start_us = get_current_time_us();
+        int timeout = thread_wait_timeout(thread, wait_start_us, &spinning);
+        if (timeout != 0) {
+            atomic_store(&thread->wakeup_pending, false);
+            if (!spsc_ring_empty(&thread->accept_queue) || !mpsc_ring_empty(&thread->send_queue) ||
+                atomic_load(&thread->handoff_in) || atomic_load(&thread->upgrade_request) ||
+                !atomic_load(&thread->running)) {
+                timeout = 0;
+            }
+        }
+        
+        int ret = uring_submit_and_wait(&thread->uring, timeout == 0 ? 0 : 1, timeout);
+        atomic_store(&thread->wakeup_pending, true);
+        uint64_t loop_start_us = get_current_time_us();
+        bool got_events = uring_peek_cqe(&thread->uring, 0) != NULL;
+        thread_account_wait(thread, spinning, timeout, wait_start_us, loop_start_us, got_events);
+        thread->now_ms = loop_start_us / 1000;
+        log_set_clock(thread->now_ms);
+        if (ret < 0 && ret != -EBUSY && ret != -EAGAIN) {
+            LOG_ERROR("Thread %d - io_uring_enter failed: %s", thread->id, strerror(-ret));
+            break;
+        }
+        
+        uint32_t n = uring_process_completions(thread);
+        if (n > 0) {
+            thread_stat_add(&thread->processed_events, n);
+        }
+        metrics_record(metrics, thread->id, mid->events_per_wakeup, n);
+        
+        timer_wheel_advance(&thread->timers, thread->now_ms);
+        
+        metrics_record(metrics, thread->id, mid->loop_time_us, get_current_time_us() - loop_start_us);
+        metrics_set(metrics, thread->id, mid->accept_queue_depth, spsc_ring_size(&thread->accept_queue));
+        metrics_set(metrics, thread->id, mid->accept_queue_fails, atomic_load(&thread->accept_queue.push_fail_count));
+        metrics_set(metrics, thread->id, mid->send_queue_fails, atomic_load(&thread->send_queue.r.push_fail_count));
+        metrics_set(metrics, thread->id, mid->connections, atomic_load(&thread->connection_count));
+        metrics_set(metrics, thread->id, mid->buf_segments, thread->buf_pool.in_use);
+        metrics_set(metrics, thread->id, mid->syscalls, thread->syscalls + thread->uring.enter_calls);
+        metrics_set(metrics, thread->id, mid->spin_time_us, thread->spin_time_us);
+        metrics_set(metrics, thread->id, mid->sleep_time_us, thread->sleep_time_us);
+    }
+    
+    uring_thread_drain(thread);
+    LOG_DEBUG("Reactor thread %d stopped", thread->id);
+    return NULL;
+}
+
+// Reactor线程主循环
+static void* reactor_thread_main(void *arg) {
+    reactor_thread_t *thread = (reactor_thread_t*)arg;
+    metrics_t *metrics = thread->reactor->metrics;
+    const reactor_metric_ids_t *mid = &thread->reactor->mid;
+    struct epoll_event events[MAX_EVENTS];
+    
+    LOG_DEBUG("Reactor thread %d started", thread->id);
+    thread_localize(thread);
+    
+    while (atomic_load(&thread->running)) {
+        // 1. 批量处理新连接（每次循环都处理）
+        uint32_t new_conns = process_new_connections_batch(thread);
+        if (new_conns > 0) {
+            LOG_DEBUG("Thread %d processed %u new connections", thread->id, new_conns);
+        }
+        process_migrated_connections(thread);
+        process_handoff_connections(thread);
+        if (atomic_load_explicit(&thread->upgrade_request, memory_order_relaxed)) {
+            thread_process_upgrade(thread);
+        }
+        process_send_queue(thread);
+        
+        // 2. 等待事件，超时取最近的定时器到期时间，没有定时器时无限阻塞；忙轮询预算内不阻塞
+        bool spinning;
+        uint64_t wait_start_us = get_current_time_us();
+        int timeout = thread_wait_timeout(thread, wait_start_us, &spinning);
+        if (timeout != 0) {
+            // 先声明即将阻塞，再复查队列：与生产者的push+exchange配对，不会丢失唤醒
+            atomic_store(&thread->wakeup_pending, false);
+            if (thread->ready_count > 0 || thread->dirty_count > 0 ||
+                !spsc_ring_empty(&thread->accept_queue) || !mpsc_ring_empty(&thread->send_queue) ||
+                atomic_load(&thread->migrate_in) ||
+                atomic_load(&thread->handoff_in) || atomic_load(&thread->upgrade_request) ||
+                !atomic_load(&thread->running)) {
+                timeout = 0;
+            }
+        }
+        
+        int nfds = epoll_wait(thread->epoll_fd, events, MAX_EVENTS, timeout);
+        thread->syscalls++;
+        atomic_store(&thread->wakeup_pending, true);
+        uint64_t loop_start_us = get_current_time_us();
+        thread_account_wait(thread, spinning, timeout, wait_start_us, loop_start_us, nfds > 0);
+        thread->now_ms = loop_start_us / 1000;
+        log_set_clock(thread->now_ms);
+        if (nfds == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        
+        if (nfds > 0) {
+            thread_stat_add(&thread->processed_events, (uint64_t)nfds);
+            LOG_DEBUG("Thread %d got %d events", thread->id, nfds);
+        }
+        metrics_record(metrics, thread->id, mid->events_per_wakeup, (uint64_t)nfds);
+        
+        // 3. 预处理：分类事件
+        conn_handle_t read_conns[MAX_EVENTS];
+        conn_handle_t write_conns[MAX_EVENTS];
+        uint32_t read_count = 0, write_count = 0;
+        
+        for (int i = 0; i < nfds; i++) {
+            if (events[i].data.u64 == REACTOR_TOKEN_WAKEUP) {
+                // 只需清空计数，新连接在下一轮循环开头处理
+                uint64_t value;
+                thread->syscalls++;
+                if (read(thread->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                    perror("read wakeup_fd");
+                }
+                continue;
+            }
+            
+            if (events[i].data.u64 == REACTOR_TOKEN_LISTEN) {
+                handle_listen_event(thread);
+                continue;
+            }
+            
+            if (events[i].data.u64 == REACTOR_TOKEN_METRICS) {
+                handle_metrics_accept(thread);
+                continue;
+            }
+            
+            connection_t *conn = thread_lookup_connection(thread, events[i].data.u64);
+            if (!conn) continue;
+            
+            conn->last_active_time = thread->now_ms;
+            thread->conn_events[CONN_HANDLE_SLOT(events[i].data.u64)]++;
+            
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                LOG_DEBUG("Thread %d - connection error/hup on fd=%d, closing", thread->id, conn->fd);
+                handle_close_event(thread, conn);
+                continue;
+            }
+            
+            if (events[i].events & EPOLLIN) {
+                read_conns[read_count++] = conn->handle;
+            }
+            
+            // 注册了EPOLLOUT，每次读边缘也会带上可写位，只有发送遇到过EAGAIN的连接才处理
+            if ((events[i].events & EPOLLOUT) && (conn->flags & CONN_FLAG_WANT_OUT)) {
+                write_conns[write_count++] = conn->handle;
+            }
+        }
+        
+        // 4. 处理读事件：先处理上一轮用完预算的连接，再处理新的读事件；
+        //    本轮预算用完后剩下的连接全部推迟，下一轮排在前面
+        thread->loop_read_left = thread->reactor->read_budget_loop;
+        uint32_t ready_count = thread->ready_count;
+        conn_handle_t *ready = thread->ready;
+        thread->ready = thread->ready_work;
+        thread->ready_work = ready;
+        thread->ready_count = 0;
+        for (uint32_t i = 0; i < ready_count; i++) {
+            connection_t *conn = thread_lookup_connection(thread, ready[i]);
+            if (!conn) continue;
+            conn->flags &= ~CONN_FLAG_READ_READY;
+            handle_read_event(thread, conn);
+        }
+        for (uint32_t i = 0; i < read_count; i++) {
+            connection_t *conn = thread_lookup_connection(thread, read_conns[i]);
+            if (conn && !(conn->flags & CONN_FLAG_READ_READY)) handle_read_event(thread, conn);
+        }
+        
+        // 5. 处理写事件
+        if (write_count > 0) {
+            handle_write_events(thread, write_conns, write_count);
+        }
+        
+        // 6. 执行到期定时器（空闲超时、用户定时器），只处理到期的那部分
+        timer_wheel_advance(&thread->timers, thread->now_ms);
+        
+        // 7. 延迟发送：本轮各阶段写入的数据，每个连接一次sendmsg发出
+        thread_flush_dirty(thread);
+        
+        // 8. 更新指标：本线程独占分片，只有普通的load/store
+        metrics_record(metrics, thread->id, mid->loop_time_us, get_current_time_us() - loop_start_us);
+        metrics_set(metrics, thread->id, mid->accept_queue_depth, spsc_ring_size(&thread->accept_queue));
+        metrics_set(metrics, thread->id, mid->accept_queue_fails, atomic_load(&thread->accept_queue.push_fail_count));
+        metrics_set(metrics, thread->id, mid->send_queue_fails, atomic_load(&thread->send_queue.r.push_fail_count));
+        metrics_set(metrics, thread->id, mid->connections, atomic_load(&thread->connection_count));
+        metrics_set(metrics, thread->id, mid->buf_segments, thread->buf_pool.in_use);
+        metrics_set(metrics, thread->id, mid->syscalls, thread->syscalls);
+        metrics_set(metrics, thread->id, mid->spin_time_us, thread->spin_time_us);
+        metrics_set(metrics, thread->id, mid->sleep_time_us, thread->sleep_time_us);
+    }
+    
+    LOG_DEBUG("Reactor thread %d stopped", thread->id);
+    return NULL;
+}
+
+// 放置策略使用的负载：已有连接加上accept队列中尚未处理的
+static inline uint32_t thread_load(reactor_thread_t *thread) {
+    return atomic_load_explicit(&thread->connection_count, memory_order_relaxed) +
+           (uint32_t)spsc_ring_size(&thread->accept_queue);
+}
+
+// 按当前策略为新连接选择线程（accept线程调用，其他线程的负载计数可能略有滞后）
+static uint32_t reactor_pick_thread(reactor_t *reactor) {
+    uint32_t count = (uint32_t)reactor->thread_count;
+    uint32_t best = 0;
+    
+    switch (atomic_load_explicit(&reactor->placement, memory_order_relaxed)) {
+    case PLACEMENT_LEAST_CONNECTIONS:
+        for (uint32_t i = 1; i < count; i++) {
+            if (thread_load(reactor->threads[i]) < thread_load(reactor->threads[best])) {
+                best = i;
+            }
+        }
+        return best;
+        
+    case PLACEMENT_LEAST_EVENT_RATE: {
+        // 事件速率每个采样周期才更新一次，按队列中待处理的连接等比例折算，避免一个周期内全部堆到同一线程
+        uint64_t best_score = UINT64_MAX;
+        uint32_t best_load = UINT32_MAX;
+        for (uint32_t i = 0; i < count; i++) {
+            reactor_thread_t *thread = reactor->threads[i];
+            uint32_t conns = atomic_load_explicit(&thread->connection_count, memory_order_relaxed);
+            uint32_t load = thread_load(thread);
+            uint64_t score = (uint64_t)atomic_load_explicit(&thread->event_rate, memory_order_relaxed) *
+                             (load + 1) / (conns + 1);
+            if (score < best_score || (score == best_score && load < best_load)) {
+                best = i;
+                best_score = score;
+                best_load = load;
+            }
+        }
+        return best;
+    }
+    
+    case PLACEMENT_POWER_OF_TWO: {
+        if (count == 1) return 0;
+        // 计数器经splitmix64混合作为随机数，不需要线程本地状态
+        uint64_t r = atomic_fetch_add(&reactor->next_thread, 1) + 0x9e3779b97f4a7c15ULL;
+        r = (r ^ (r >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        r = (r ^ (r >> 27)) * 0x94d049bb133111ebULL;
+        r ^= r >> 31;
+        uint32_t a = (uint32_t)r % count;
+        uint32_t b = (a + 1 + (uint32_t)(r >> 32) % (count - 1)) % count;
+        return thread_load(reactor->threads[b]) < thread_load(reactor->threads[a]) ? b : a;
+    }
+    
+    default:
+        return atomic_fetch_add(&reactor->next_thread, 1) % count;
+    }
+}
+
+// 设置放置策略
+void reactor_set_placement(reactor_t *reactor, placement_policy_t policy) {
+    if (!reactor) return;
+    atomic_store_explicit(&reactor->placement, policy, memory_order_relaxed);
+}
+
+void reactor_set_rebalance(reactor_t *reactor, bool enabled) {
+    if (!reactor) return;
+    atomic_store_explicit(&reactor->rebalance, enabled, memory_order_relaxed);
+}
+
+// 设置忙轮询预算
+int reactor_set_busy_poll(reactor_t *reactor, int thread_id, uint32_t idle_budget_us) {
+    if (!reactor || thread_id < -1 || thread_id >= reactor->thread_count) return -1;
+    
+    for (int i = 0; i < reactor->thread_count; i++) {
+        if (thread_id == -1 || thread_id == i) {
+            atomic_store_explicit(&reactor->threads[i]->busy_poll_us, idle_budget_us, memory_order_relaxed);
+        }
+    }
+    return 0;
+}
+
+// 设置绑核
+int reactor_set_affinity(reactor_t *reactor, const int *cpus, int count) {
+    if (!reactor || atomic_load(&reactor->running) || (count > 0 && !cpus) || count < 0) {
+        printf("ERROR: reactor_set_affinity must be called before reactor_run\n");
+        return -1;
+    }
+    
+    for (int i = 0; i < reactor->thread_count; i++) {
+        reactor->threads[i]->cpu = count > 0 ? cpus[i % count] : -1;
+    }
+    return 0;
+}
+
+// 设置发送队列的高低水位（reactor_run之前调用）
+int reactor_set_watermarks(reactor_t *reactor, size_t high, size_t low) {
+    if (!reactor || atomic_load(&reactor->running) || low >= high) {
+        printf("ERROR: reactor_set_watermarks needs low < high and must be called before reactor_run\n");
+        return -1;
+    }
+    reactor->outq_high = high;
+    reactor->outq_low = low;
+    return 0;
+}
+
+int reactor_set_deferred_flush(reactor_t *reactor, bool enabled) {
+    if (!reactor || atomic_load(&reactor->running)) {
+        printf("ERROR: reactor_set_deferred_flush must be called before reactor_run\n");
+        return -1;
+    }
+    reactor->deferred_flush = enabled;
+    return 0;
+}
+
+int reactor_set_read_budget(reactor_t *reactor, size_t conn_bytes, size_t loop_bytes) {
+    if (!reactor || atomic_load(&reactor->running)) {
+        printf("ERROR: reactor_set_read_budget must be called before reactor_run\n");
+        return -1;
+    }
+    reactor->read_budget_conn = conn_bytes ? conn_bytes : SIZE_MAX;
+    reactor->read_budget_loop = loop_bytes ? loop_bytes : SIZE_MAX;
+    return 0;
+}
+
+void reactor_pause_read(reactor_t *reactor, connection_t *conn) {
+    if (!reactor || !conn || (conn->flags & CONN_FLAG_READ_PAUSED)) return;
+    conn->flags |= CONN_FLAG_READ_PAUSED;
+    connection_update_read(reactor->threads[conn->thread_id], conn);
+}
+
+void reactor_resume_read(reactor_t *reactor, connection_t *conn) {
+    if (!reactor || !conn || !(conn->flags & CONN_FLAG_READ_PAUSED)) return;
+    conn->flags &= ~CONN_FLAG_READ_PAUSED;
+    connection_update_read(reactor->threads[conn->thread_id], conn);
+}
+
+// 迁移连接
+int reactor_migrate(reactor_t *reactor, connection_t *conn, int target_thread) {
+    if (!reactor || !conn || target_thread < 0 || target_thread >= reactor->thread_count ||
+        (conn->flags & (CONN_FLAG_METRICS | CONN_FLAG_CLOSE_ON_FLUSH))) {
+        return -1;
+    }
+    
+    // io_uring后端的连接有进行中的多发recv，不能换线程
+    if (reactor->backend == REACTOR_BACKEND_URING) {
+        return -1;
+    }
+    
+    if (target_thread == conn->thread_id) {
+        conn->flags &= ~CONN_FLAG_MIGRATE;
+        return 0;
+    }
+    
+    // 缓冲非空时只打标记，读写都清空后由connection_try_migrate执行
+    conn->migrate_to = target_thread;
+    conn->flags |= CONN_FLAG_MIGRATE;
+    connection_try_migrate(reactor->threads[conn->thread_id], conn);
+    return 0;
+}
+
+// 添加连接
+int reactor_add_connection(reactor_t *reactor, int fd) {
+    if (!reactor || fd < 0) {
+        LOG_ERROR("Invalid parameters to reactor_add_connection");
+        return -1;
+    }
+    
+    if (!atomic_load(&reactor->running)) {
+        LOG_ERROR("Reactor not running when adding connection");
+        return -1;
+    }
+    
+    uint32_t thread_index = reactor_pick_thread(reactor);
+    reactor_thread_t *thread = reactor->threads[thread_index];
+    
+    LOG_DEBUG("Adding fd=%d to thread %d", fd, thread_index);
+    
+    // 使用无锁队列
+    if (spsc_ring_push(&thread->accept_queue, &fd)) {
+        thread_wakeup(thread);
+        LOG_DEBUG("Successfully queued fd=%d to thread %d", fd, thread_index);
+        return 0;
+    }
+    
+    LOG_ERROR("Failed to queue fd=%d to thread %d (queue full?)", fd, thread_index);
+    return -1;
+}
+
+// 创建非阻塞监听socket，reuseport为true时加入SO_REUSEPORT组
+static int create_listen_socket(int port, bool reuseport) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+    
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+        (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)))) {
+        perror("setsockopt");
+        close(fd);
+        return -1;
+    }
+    
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = INADDR_ANY,
+        .sin_port = htons(port)
+    };
+    
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 65535) < 0) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+// 挂载CBPF程序：返回值是组内socket下标（按加入顺序），即 cpu % thread_count
+static int attach_reuseport_cbpf(int fd, int thread_count) {
+    struct sock_filter code[] = {
+        { BPF_LD  | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)thread_count },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog = {
+        .len = sizeof(code) / sizeof(code[0]),
+        .filter = code,
+    };
+    
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        perror("setsockopt SO_ATTACH_REUSEPORT_CBPF");
+        return -1;
+    }
+    return 0;
+}
+
+// 每个Reactor线程独占一个SO_REUSEPORT监听socket
+int reactor_listen_reuseport(reactor_t *reactor, int port, bool cpu_local) {
+    if (!reactor || atomic_load(&reactor->running)) {
+        printf("ERROR: reactor_listen_reuseport must be called before reactor_run\n");
+        return -1;
+    }
+    
+    // 按线程顺序创建，组内下标与线程号一致
+    for (int i = 0; i < reactor->thread_count; i++) {
+        reactor_thread_t *thread = reactor->threads[i];
+        
+        thread->listen_fd = create_listen_socket(port, true);
+        if (thread->listen_fd == -1) {
+            goto fail;
+        }
+        
+        // 水平触发：单次唤醒最多accept MAX_ACCEPT_PER_WAKEUP个，剩余的下次循环继续
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = REACTOR_TOKEN_LISTEN;
+        if (epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, thread->listen_fd, &ev) == -1) {
+            perror("epoll_ctl listen_fd");
+            goto fail;
+        }
+    }
+    
+    // 挂载失败不影响功能，退回内核默认的四元组哈希
+    if (cpu_local && attach_reuseport_cbpf(reactor->threads[0]->listen_fd, reactor->thread_count) == 0) {
+        LOG_INFO("CPU-local reuseport CBPF attached");
+    }
+    
+    printf("Server listening on port %d (SO_REUSEPORT x %d)\n", port, reactor->thread_count);
+    return 0;
+    
+fail:
+    for (int i = 0; i < reactor->thread_count; i++) {
+        reactor_thread_t *thread = reactor->threads[i];
+        if (thread->listen_fd != -1) {
+            close(thread->listen_fd);
+            thread->listen_fd = -1;
+        }
+    }
+    return -1;
+}
+
+// 文本指标抓取端口，挂在0号线程
+int reactor_listen_metrics(reactor_t *reactor, int port) {
+    if (!reactor || atomic_load(&reactor->running) || reactor->metrics_fd != -1) {
+        printf("ERROR: reactor_listen_metrics must be called once before reactor_run\n");
+        return -1;
+    }
+    
+    int fd = create_listen_socket(port, false);
+    if (fd == -1) return -1;
     
-    printf("ERROR: Failed to queue fd=%d to thread %d (queue full?)\n", fd, thread_index);
-    return -1;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = REACTOR_TOKEN_METRICS;
+    if (epoll_ctl(reactor->threads[0]->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl metrics_fd");
+        close(fd);
+        return -1;
+    }
+    
+    reactor->metrics_fd = fd;
+    printf("Metrics available on port %d, shm %s\n", port, reactor->metrics_shm);
+    return 0;
+}
+
+// 所有线程的连接数
+uint32_t reactor_connection_count(reactor_t *reactor) {
+    if (!reactor) return 0;
+    
+    uint32_t count = 0;
+    for (int i = 0; i < reactor->thread_count; i++) {
+        count += atomic_load(&reactor->threads[i]->connection_count);
+    }
+    return count;
+}
+
+// 向所有线程发出交接请求，等各线程在自己的循环中执行完
+static void reactor_upgrade_request(reactor_t *reactor, int sock, uint32_t request) {
+    reactor->upgrade_sock = sock;
+    atomic_store(&reactor->upgrade_pending, reactor->thread_count);
+    
+    for (int i = 0; i < reactor->thread_count; i++) {
+        reactor_thread_t *thread = reactor->threads[i];
+        atomic_fetch_or(&thread->upgrade_request, request);
+        thread_wakeup(thread);
+    }
+    
+    while (atomic_load(&reactor->upgrade_pending) > 0 && atomic_load(&reactor->running)) {
+        usleep(1000);
+    }
+}
+
+// 交出监听socket：消息的arg[0]为SO_REUSEPORT监听个数，arg[1]为指标端口个数（0或1），arg[2]为应用的监听个数
+int reactor_upgrade_send_listeners(reactor_t *reactor, int sock, const int *extra_fds, int extra_count) {
+    if (!reactor || !atomic_load(&reactor->running) || extra_count < 0) {
+        printf("ERROR: reactor_upgrade_send_listeners requires a running reactor\n");
+        return -1;
+    }
+    
+    int fds[HANDOFF_MAX_FDS];
+    int nfds = 0;
+    handoff_msg_t msg = { .type = HANDOFF_LISTENERS };
+    
+    for (int i = 0; i < reactor->thread_count; i++) {
+        if (reactor->threads[i]->listen_fd != -1) {
+            fds[nfds++] = reactor->threads[i]->listen_fd;
+        }
+    }
+    msg.arg[0] = (uint32_t)nfds;
+    if (reactor->metrics_fd != -1) {
+        fds[nfds++] = reactor->metrics_fd;
+        msg.arg[1] = 1;
+    }
+    if (nfds + extra_count > HANDOFF_MAX_FDS) {
+        printf("ERROR: too many listening sockets to hand off\n");
+        return -1;
+    }
+    for (int i = 0; i < extra_count; i++) {
+        fds[nfds++] = extra_fds[i];
+    }
+    msg.arg[2] = (uint32_t)extra_count;
+    
+    // 发送失败时本进程照常服务
+    if (handoff_send(sock, &msg, fds, nfds, NULL) != 0) {
+        perror("handoff_send listeners");
+        return -1;
+    }
+    
+    reactor_upgrade_request(reactor, sock, UPGRADE_DETACH_LISTENERS);
+    printf("Upgrade: handed %d listening sockets to the new process\n", nfds);
+    return 0;
+}
+
+int reactor_upgrade_send_connections(reactor_t *reactor, int sock, bool connections) {
+    if (!reactor || !atomic_load(&reactor->running)) {
+        printf("ERROR: reactor_upgrade_send_connections requires a running reactor\n");
+        return -1;
+    }
+    
+    atomic_store(&reactor->upgrade_sent, 0);
+    reactor->upgrade_broken = false;
+    if (connections && reactor->backend == REACTOR_BACKEND_URING) {
+        printf("WARNING: io_uring backend keeps its connections until they close\n");
+    } else if (connections) {
+        reactor_upgrade_request(reactor, sock, UPGRADE_HANDOFF_CONNECTIONS);
+    }
+    
+    uint32_t sent = atomic_load(&reactor->upgrade_sent);
+    if (reactor->upgrade_broken) {
+        // 流中可能留有半条消息，不再发送DONE，新进程读到错误后停止接收
+        printf("ERROR: upgrade stream broken, handed %u connections, the rest stay here\n", sent);
+        return -1;
+    }
+    handoff_msg_t msg = { .type = HANDOFF_DONE, .arg = { sent } };
+    if (handoff_send(sock, &msg, NULL, 0, NULL) != 0) {
+        perror("handoff_send done");
+        return -1;
+    }
+    
+    printf("Upgrade: handed %u connections to the new process\n", sent);
+    return (int)sent;
+}
+
+// 把接收的SO_REUSEPORT监听socket挂到线程上
+static int thread_attach_listener(reactor_thread_t *thread, int fd) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = REACTOR_TOKEN_LISTEN;
+    if (epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl listen_fd");
+        close(fd);
+        return -1;
+    }
+    thread->listen_fd = fd;
+    return 0;
+}
+
+int reactor_upgrade_recv_listeners(reactor_t *reactor, int sock, int *extra_fds, int max_extra) {
+    if (!reactor || atomic_load(&reactor->running)) {
+        printf("ERROR: reactor_upgrade_recv_listeners must be called before reactor_run\n");
+        return -1;
+    }
+    
+    int fds[HANDOFF_MAX_FDS];
+    handoff_msg_t msg;
+    if (handoff_recv(sock, &msg, fds, HANDOFF_MAX_FDS) != 0) {
+        printf("ERROR: failed to receive listening sockets from the old process\n");
+        return -1;
+    }
+    
+    uint32_t reuseport = msg.arg[0], metrics = msg.arg[1], extra = msg.arg[2];
+    if (msg.type != HANDOFF_LISTENERS || reuseport + metrics + extra != msg.nfds || metrics > 1) {
+        printf("ERROR: unexpected handoff message (type %u, %u fds)\n", msg.type, msg.nfds);
+        for (int i = 0; i < msg.nfds; i++) close(fds[i]);
+        return -1;
+    }
+    
+    // 旧进程的SO_REUSEPORT监听按线程接管；线程数变多时补建，仍在同一个组内
+    int index = 0;
+    for (uint32_t i = 0; i < reuseport; i++, index++) {
+        if ((int)i < reactor->thread_count) {
+            thread_attach_listener(reactor->threads[i], fds[index]);
+        } else {
+            // 线程数变少：关闭多出的socket，其监听队列中尚未accept的连接会被重置
+            printf("WARNING: closing surplus listening socket %u\n", i);
+            close(fds[index]);
+        }
+    }
+    if (reuseport > 0 && (int)reuseport < reactor->thread_count) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        if (getsockname(reactor->threads[0]->listen_fd, (struct sockaddr*)&addr, &addr_len) == 0) {
+            for (int i = (int)reuseport; i < reactor->thread_count; i++) {
+                int fd = create_listen_socket(ntohs(addr.sin_port), true);
+                if (fd != -1) thread_attach_listener(reactor->threads[i], fd);
+            }
+        }
+    }
+    
+    if (metrics) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = REACTOR_TOKEN_METRICS;
+        if (epoll_ctl(reactor->threads[0]->epoll_fd, EPOLL_CTL_ADD, fds[index], &ev) == 0) {
+            reactor->metrics_fd = fds[index];
+        } else {
+            perror("epoll_ctl metrics_fd");
+            close(fds[index]);
+        }
+        index++;
+    }
+    
+    int count = 0;
+    for (uint32_t i = 0; i < extra; i++, index++) {
+        if (count < max_extra) {
+            extra_fds[count++] = fds[index];
+        } else {
+            close(fds[index]);
+        }
+    }
+    
+    printf("Upgrade: took over %u listening sockets from the old process\n", msg.nfds);
+    return count;
+}
+
+int reactor_upgrade_recv_connections(reactor_t *reactor, int sock) {
+    if (!reactor || !atomic_load(&reactor->running)) {
+        printf("ERROR: reactor_upgrade_recv_connections requires a running reactor\n");
+        return -1;
+    }
+    
+    int count = 0;
+    for (;;) {
+        handoff_msg_t msg;
+        int fd = -1;
+        if (handoff_recv(sock, &msg, &fd, 1) != 0) {
+            printf("ERROR: connection handoff interrupted after %d connections\n", count);
+            return -1;
+        }
+        if (msg.type == HANDOFF_DONE) break;
+        
+        if (msg.type != HANDOFF_CONNECTION || msg.nfds != 1 ||
+            msg.payload_len != (uint64_t)msg.arg[0] + msg.arg[1]) {
+            printf("ERROR: unexpected handoff message (type %u, %u fds)\n", msg.type, msg.nfds);
+            if (msg.nfds > 0) close(fd);
+            return -1;
+        }
+        
+        handoff_conn_t *h = malloc(sizeof(handoff_conn_t) + msg.payload_len);
+        if (!h || handoff_recv_payload(sock, h->data, msg.payload_len) != 0) {
+            printf("ERROR: failed to receive connection state\n");
+            free(h);
+            close(fd);
+            return -1;
+        }
+        h->fd = fd;
+        h->input_len = msg.arg[0];
+        h->output_len = msg.arg[1];
+        h->codec_state = msg.arg[2];
+        
+        // 与迁移相同的无锁栈，目标线程在下一轮循环开头接管
+        reactor_thread_t *thread = reactor->threads[reactor_pick_thread(reactor)];
+        handoff_conn_t *head = atomic_load_explicit(&thread->handoff_in, memory_order_relaxed);
+        do {
+            h->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&thread->handoff_in, &head, h,
+                                                        memory_order_release, memory_order_relaxed));
+        thread_wakeup(thread);
+        count++;
+    }
+    
+    printf("Upgrade: took over %d connections from the old process\n", count);
+    return count;
+}
+
+// 按句柄查找连接
+connection_t* reactor_get_connection(reactor_t *reactor, conn_handle_t handle) {
+    if (!reactor || handle == CONN_HANDLE_INVALID) return NULL;
+    
+    uint32_t thread_index = CONN_HANDLE_THREAD(handle);
+    if (thread_index >= (uint32_t)reactor->thread_count) return NULL;
+    
+    return thread_lookup_connection(reactor->threads[thread_index], handle);
 }
 
 // 启动Reactor
@@ -395,16 +2631,36 @@ int reactor_run(reactor_t *reactor) {
     }
     
     atomic_store(&reactor->running, true);
-    printf("DEBUG: Starting %d reactor threads\n", reactor->thread_count);
+    printf("DEBUG: Starting %d reactor threads (%s)\n", reactor->thread_count,
+           reactor->backend == REACTOR_BACKEND_URING ? "io_uring" : "epoll");
     
+    void *(*thread_main)(void*) =
+        reactor->backend == REACTOR_BACKEND_URING ? reactor_uring_thread_main : reactor_thread_main;
+    
+    int cpus[MAX_REACTOR_THREADS];
+    int pinned = 0;
     for (int i = 0; i < reactor->thread_count; i++) {
-        reactor_thread_t *thread = &reactor->threads[i];
-        if (pthread_create(&thread->thread_id, NULL, reactor_thread_main, thread) != 0) {
+        reactor_thread_t *thread = reactor->threads[i];
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        // 线程从第一条指令起就在目标CPU上，栈和之后分配的内存都落在本节点
+        if (affinity_attr_set_cpu(&attr, thread->cpu) != 0) {
+            printf("WARNING: failed to pin thread %d to CPU %d\n", i, thread->cpu);
+        } else if (thread->cpu >= 0) {
+            cpus[pinned++] = thread->cpu;
+        }
+        
+        // 在创建线程前置位，避免线程尚未运行时reactor_stop的停止标志被覆盖
+        atomic_store(&thread->running, true);
+        int ret = pthread_create(&thread->thread_id, &attr, thread_main, thread);
+        pthread_attr_destroy(&attr);
+        if (ret != 0) {
             perror("pthread_create");
             reactor_stop(reactor);
             return -1;
         }
     }
+    affinity_report_irqs(cpus, pinned);
     
     printf("DEBUG: All reactor threads started successfully\n");
     return 0;
@@ -420,8 +2676,15 @@ int reactor_stop(reactor_t *reactor) {
     atomic_store(&reactor->running, false);
     
     for (int i = 0; i < reactor->thread_count; i++) {
-        reactor_thread_t *thread = &reactor->threads[i];
+        reactor_thread_t *thread = reactor->threads[i];
         atomic_store(&thread->running, false);
+        
+        // 线程可能无限阻塞在epoll_wait中，直接写eventfd唤醒
+        uint64_t one = 1;
+        if (write(thread->wakeup_fd, &one, sizeof(one)) < 0) {
+            perror("write wakeup_fd");
+        }
+        
         if (thread->thread_id) {
             pthread_join(thread->thread_id, NULL);
         }
@@ -431,26 +2694,157 @@ int reactor_stop(reactor_t *reactor) {
     return 0;
 }
 
+// 用户定时器到期
+static void reactor_timer_fire(timer_node_t *node, void *arg) {
+    reactor_timer_t *timer = (reactor_timer_t*)arg;
+    (void)node;
+    
+    timer->firing = true;
+    timer->cb(timer, timer->arg);
+    timer->firing = false;
+    
+    // 单次定时器执行完释放；回调中取消的也在这里释放
+    if (timer->cancelled || !timer_node_pending(&timer->node)) {
+        free(timer);
+    }
+}
+
+// 销毁时释放仍挂在时间轮上的用户定时器
+static void reactor_timer_release(timer_node_t *node) {
+    if (node->cb == reactor_timer_fire) {
+        free(node->arg);
+    }
+}
+
+// 添加定时器
+reactor_timer_t* reactor_add_timer(reactor_t *reactor, int thread_id, uint64_t delay_ms,
+                                   uint64_t interval_ms, reactor_timer_cb_t cb, void *arg) {
+    if (!reactor || !cb || thread_id < 0 || thread_id >= reactor->thread_count) {
+        return NULL;
+    }
+    
+    reactor_timer_t *timer = calloc(1, sizeof(reactor_timer_t));
+    if (!timer) return NULL;
+    
+    reactor_thread_t *thread = reactor->threads[thread_id];
+    timer->thread = thread;
+    timer->cb = cb;
+    timer->arg = arg;
+    timer_node_init(&timer->node, reactor_timer_fire, timer);
+    timer_wheel_add(&thread->timers, &timer->node, thread->now_ms + delay_ms, interval_ms);
+    
+    return timer;
+}
+
+// 重新设置定时器到期时间（保留周期）
+int reactor_reset_timer(reactor_t *reactor, reactor_timer_t *timer, uint64_t delay_ms) {
+    if (!reactor || !timer || timer->cancelled) return -1;
+    
+    reactor_thread_t *thread = timer->thread;
+    timer_wheel_add(&thread->timers, &timer->node, thread->now_ms + delay_ms, timer->node.interval);
+    return 0;
+}
+
+// 取消定时器
+int reactor_cancel_timer(reactor_t *reactor, reactor_timer_t *timer) {
+    if (!reactor || !timer || timer->cancelled) return -1;
+    
+    timer_wheel_del(&timer->thread->timers, &timer->node);
+    
+    if (timer->firing) {
+        // 回调返回后由reactor_timer_fire释放
+        timer->cancelled = true;
+    } else {
+        free(timer);
+    }
+    return 0;
+}
+
 // 销毁Reactor
 int reactor_destroy(reactor_t *reactor) {
     if (!reactor) return -1;
     
     reactor_stop(reactor);
     
+    // 迁移过的连接来自其他线程的slab，先关闭所有连接，再销毁各线程的slab
     for (int i = 0; i < reactor->thread_count; i++) {
-        reactor_thread_t *thread = &reactor->threads[i];
+        reactor_thread_t *thread = reactor->threads[i];
         close(thread->epoll_fd);
+        close(thread->wakeup_fd);
+        if (thread->reserve_fd != -1) close(thread->reserve_fd);
+        if (thread->listen_fd != -1) {
+            close(thread->listen_fd);
+        }
+        
+        // 释放未取消的用户定时器
+        timer_wheel_clear(&thread->timers, reactor_timer_release);
         
         // 关闭所有剩余连接
-        for (int j = 0; j < MAX_CONNECTIONS; j++) {
-            if (thread->connections[j]) {
-                close(thread->connections[j]->fd);
-                free(thread->connections[j]);
+        for (uint32_t j = 0; j < thread->connections.cursor; j++) {
+            connection_t *conn = thread->connections.values[j];
+            if (conn) {
+                close(conn->fd);
+                buf_chain_clear(&conn->input, &thread->buf_pool);
+                buf_outq_clear(&conn->output, &thread->buf_pool);
+                slab_free(conn);
             }
         }
+        
+        // 尚未处理的新连接
+        int fd;
+        while (spsc_ring_pop(&thread->accept_queue, &fd)) {
+            close(fd);
+        }
+        
+        // 尚未处理的跨线程投递，归还零拷贝数据
+        reactor_send_cmd_t cmd;
+        while (mpsc_ring_pop(&thread->send_queue, &cmd)) {
+            if (cmd.type == SEND_CMD_REF && cmd.u.ref.free_fn) cmd.u.ref.free_fn(cmd.u.ref.arg);
+            if (cmd.type == SEND_CMD_BROADCAST) broadcast_payload_release(cmd.u.bcast.payload);
+        }
+        
+        // 迁移途中的连接（缓冲已为空）
+        connection_t *conn = atomic_exchange(&thread->migrate_in, NULL);
+        while (conn) {
+            connection_t *next = conn->migrate_next;
+            close(conn->fd);
+            slab_free(conn);
+            conn = next;
+        }
+        
+        // 已从旧进程接收、尚未接管的连接
+        handoff_conn_t *h = atomic_exchange(&thread->handoff_in, NULL);
+        while (h) {
+            handoff_conn_t *next = h->next;
+            close(h->fd);
+            free(h);
+            h = next;
+        }
     }
     
-    free(reactor);
+    for (int i = 0; i < reactor->thread_count; i++) {
+        reactor_thread_t *thread = reactor->threads[i];
+        slot_table_destroy(&thread->connections);
+        free(thread->conn_events);
+        spsc_ring_destroy(&thread->accept_queue);
+        mpsc_ring_destroy(&thread->send_queue);
+        if (reactor->backend == REACTOR_BACKEND_URING) {
+            thread_uring_destroy(thread);
+        }
+        buf_pool_destroy(&thread->buf_pool);
+        free(thread->codec_scratch);
+        slab_cache_destroy(&thread->conn_slab);
+        group_table_destroy(&thread->groups);
+        slab_cache_destroy(&thread->bcast_slab);
+        free(thread->ready);
+        free(thread->ready_work);
+        free(thread->dirty);
+    }
+    
+    if (reactor->metrics_fd != -1) {
+        close(reactor->metrics_fd);
+    }
+    reactor_free_threads(reactor, reactor->thread_count);
     printf("DEBUG: Reactor destroyed\n");
     return 0;
 }
@@ -461,11 +2855,309 @@ void reactor_stats(reactor_t *reactor) {
     
     printf("=== Reactor Statistics ===\n");
     for (int i = 0; i < reactor->thread_count; i++) {
-        reactor_thread_t *thread = &reactor->threads[i];
-        printf("Thread %d: conns=%u, events=%llu, batches=%llu\n", 
+        reactor_thread_t *thread = reactor->threads[i];
+        printf("Thread %d: conns=%u, events=%llu, batches=%llu, accepted=%llu, wakeups=%llu, buf_segments=%llu\n", 
                i, 
                atomic_load(&thread->connection_count),
                atomic_load(&thread->processed_events),
-               atomic_load(&thread->batch_processed));
+               atomic_load(&thread->batch_processed),
+               atomic_load(&thread->accepted_connections),
+               atomic_load(&thread->wakeups_sent),
+               (unsigned long long)thread->buf_pool.in_use);
+        printf("  load: event_rate=%u/s, migrated_in=%llu, migrated_out=%llu, syscalls=%llu\n",
+               atomic_load(&thread->event_rate),
+               atomic_load(&thread->migrated_in),
+               atomic_load(&thread->migrated_out),
+               (unsigned long long)(thread->syscalls + thread->uring.enter_calls));
+        printf("  read_budget: deferred=%llu, ready=%u, flushes=%llu\n",
+               (unsigned long long)thread->read_deferred, thread->ready_count,
+               (unsigned long long)thread->flushes);
+        printf("  remote: sends=%llu, dropped=%llu, queue_fails=%llu\n",
+               (unsigned long long)thread->remote_sends,
+               (unsigned long long)thread->remote_dropped,
+               atomic_load(&thread->send_queue.r.push_fail_count));
+        printf("  broadcast: commands=%llu, members=%llu, groups=%u\n",
+               (unsigned long long)thread->broadcasts,
+               (unsigned long long)thread->broadcast_members,
+               thread->groups.count);
+        printf("  busy_poll: budget=%uus, spin=%llums, sleep=%llums\n",
+               atomic_load(&thread->busy_poll_us),
+               (unsigned long long)thread->spin_time_us / 1000,
+               (unsigned long long)thread->sleep_time_us / 1000);
+        printf("  outq: slices=%llu, copied_bytes=%llu, zero_copy_bytes=%llu\n",
+               (unsigned long long)thread->buf_pool.slices_in_use,
+               (unsigned long long)thread->buf_pool.copied_bytes,
+               (unsigned long long)thread->buf_pool.zero_copy_bytes);
+        
+        slab_stats_t slab;
+        slab_cache_stats(&thread->conn_slab, &slab);
+        printf("  conn_slab: hits=%llu, misses=%llu, in_use=%llu, high_water=%llu, remote_frees=%llu, chunks=%llu\n",
+               slab.hits, slab.misses, slab.in_use, slab.high_water, slab.remote_frees, slab.chunks);
+    }
+}
+// 拷贝入队
+size_t reactor_write(reactor_t *reactor, connection_t *conn, const void *data, size_t len) {
+    if (!reactor || !conn || !data) return 0;
+    
+    reactor_thread_t *thread = reactor->threads[conn->thread_id];
+    bool was_empty = buf_outq_empty(&conn->output);
+    size_t n = buf_outq_copy(&conn->output, &thread->buf_pool, data, len);
+    if (was_empty && n > 0) {
+        connection_want_write(thread, conn);
+    }
+    connection_check_high(thread, conn);
+    return n;
+}
+
+// 零拷贝入队外部内存
+int reactor_write_ref(reactor_t *reactor, connection_t *conn, const void *data, size_t len,
+                      buf_free_fn free_fn, void *arg) {
+    if (!reactor || !conn || (!data && len > 0)) return -1;
+    
+    // 小块数据拷贝比维护一个外部片段更便宜，拷贝后立即释放
+    if (len < BUF_COPY_MAX) {
+        if (reactor_write(reactor, conn, data, len) != len) return -1;
+        if (free_fn) free_fn(arg);
+        return 0;
+    }
+    
+    reactor_thread_t *thread = reactor->threads[conn->thread_id];
+    bool was_empty = buf_outq_empty(&conn->output);
+    if (buf_outq_ref(&conn->output, &thread->buf_pool, data, len, free_fn, arg) != 0) {
+        return -1;
+    }
+    if (was_empty) {
+        connection_want_write(thread, conn);
+    }
+    connection_check_high(thread, conn);
+    return 0;
+}
+
+// 零拷贝转发
+size_t reactor_forward(reactor_t *reactor, connection_t *conn, buf_chain_t *src, size_t len) {
+    if (!reactor || !conn || !src) return 0;
+    
+    reactor_thread_t *thread = reactor->threads[conn->thread_id];
+    bool was_empty = buf_outq_empty(&conn->output);
+    size_t n = buf_outq_splice(&conn->output, &thread->buf_pool, src, len);
+    if (was_empty && n > 0) {
+        connection_want_write(thread, conn);
+    }
+    connection_check_high(thread, conn);
+    return n;
+}
+
+// 跨线程发送：命令压入连接所属线程的投递队列，线程阻塞时唤醒
+static int thread_post_send(reactor_t *reactor, const reactor_send_cmd_t *cmd) {
+    uint32_t tid = CONN_HANDLE_THREAD(cmd->handle);
+    if ((int)tid >= reactor->thread_count) {
+        errno = EINVAL;
+        return -1;
+    }
+    
+    reactor_thread_t *thread = reactor->threads[tid];
+    if (!mpsc_ring_push(&thread->send_queue, cmd)) {
+        errno = EAGAIN;
+        return -1;
+    }
+    thread_wakeup(thread);
+    return 0;
+}
+
+int reactor_send(reactor_t *reactor, conn_handle_t handle, const void *data, size_t len) {
+    if (!reactor || handle == CONN_HANDLE_INVALID || (!data && len > 0) || len > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    
+    reactor_send_cmd_t cmd;
+    cmd.handle = handle;
+    cmd.len = (uint32_t)len;
+    if (len <= REACTOR_SEND_INLINE) {
+        cmd.type = SEND_CMD_INLINE;
+        memcpy(cmd.u.data, data, len);
+        return thread_post_send(reactor, &cmd);
+    }
+    
+    // 较大的数据拷贝到堆上，所属线程按外部片段入队，发送完后释放
+    void *copy = malloc(len);
+    if (!copy) return -1;
+    memcpy(copy, data, len);
+    cmd.type = SEND_CMD_REF;
+    cmd.u.ref.data = copy;
+    cmd.u.ref.free_fn = free;
+    cmd.u.ref.arg = copy;
+    if (thread_post_send(reactor, &cmd) != 0) {
+        free(copy);
+        return -1;
+    }
+    return 0;
+}
+
+int reactor_send_ref(reactor_t *reactor, conn_handle_t handle, const void *data, size_t len,
+                     buf_free_fn free_fn, void *arg) {
+    if (!reactor || handle == CONN_HANDLE_INVALID || (!data && len > 0) || len > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    
+    reactor_send_cmd_t cmd;
+    cmd.handle = handle;
+    cmd.len = (uint32_t)len;
+    cmd.type = SEND_CMD_REF;
+    cmd.u.ref.data = data;
+    cmd.u.ref.free_fn = free_fn;
+    cmd.u.ref.arg = arg;
+    return thread_post_send(reactor, &cmd);
+}
+
+// 组成员数组满时用于清理已关闭、已迁出的成员
+static bool group_member_alive(uint64_t handle, void *arg) {
+    return thread_lookup_connection(arg, handle) != NULL;
+}
+
+int reactor_group_join(reactor_t *reactor, connection_t *conn, uint64_t gid) {
+    if (!reactor || !conn) return -1;
+    
+    reactor_thread_t *thread = reactor->threads[conn->thread_id];
+    conn_group_t *g = group_table_get(&thread->groups, gid);
+    if (!g) return -1;
+    if (group_add_member(g, conn->handle, group_member_alive, thread) < 0) {
+        if (g->count == 0) group_table_remove(&thread->groups, g);
+        return -1;
+    }
+    return 0;
+}
+
+int reactor_group_leave(reactor_t *reactor, connection_t *conn, uint64_t gid) {
+    if (!reactor || !conn) return -1;
+    
+    reactor_thread_t *thread = reactor->threads[conn->thread_id];
+    conn_group_t *g = group_table_find(&thread->groups, gid);
+    if (!g || !group_del_member(g, conn->handle)) return -1;
+    if (g->count == 0) {
+        group_table_remove(&thread->groups, g);
+    }
+    return 0;
+}
+
+int reactor_broadcast(reactor_t *reactor, uint64_t gid, const void *data, size_t len) {
+    if (!reactor || (!data && len > 0) || len > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    
+    broadcast_payload_t *payload = malloc(sizeof(broadcast_payload_t) + len);
+    if (!payload) return -1;
+    memcpy(payload->data, data, len);
+    payload->len = (uint32_t)len;
+    atomic_store_explicit(&payload->refs, (unsigned)reactor->thread_count, memory_order_relaxed);
+    
+    // 不知道成员分布在哪些线程，每个线程一条命令，没有成员的线程直接释放引用
+    reactor_send_cmd_t cmd;
+    cmd.handle = CONN_HANDLE_INVALID;
+    cmd.len = (uint32_t)len;
+    cmd.type = SEND_CMD_BROADCAST;
+    cmd.u.bcast.payload = payload;
+    cmd.u.bcast.gid = gid;
+    cmd.u.bcast.start_us = get_current_time_us();
+    
+    unsigned failed = 0;
+    for (int i = 0; i < reactor->thread_count; i++) {
+        reactor_thread_t *thread = reactor->threads[i];
+        if (!mpsc_ring_push(&thread->send_queue, &cmd)) {
+            failed++;
+            continue;
+        }
+        thread_wakeup(thread);
+    }
+    
+    if (failed > 0) {
+        if (atomic_fetch_sub_explicit(&payload->refs, failed, memory_order_acq_rel) == failed) {
+            free(payload);
+        }
+        errno = EAGAIN;
+        return -1;
+    }
+    return 0;
+}
+
+// 关闭连接
+void reactor_close(reactor_t *reactor, connection_t *conn) {
+    if (!reactor || !conn) return;
+    handle_close_event(reactor->threads[conn->thread_id], conn);
+}
+
+// 设置编解码器
+int reactor_set_codec(reactor_t *reactor, const codec_t *codec) {
+    if (!reactor || atomic_load(&reactor->running)) {
+        printf("ERROR: reactor_set_codec must be called before reactor_run\n");
+        return -1;
+    }
+    
+    for (int i = 0; i < reactor->thread_count; i++) {
+        reactor_thread_t *thread = reactor->threads[i];
+        if (codec && !thread->codec_scratch) {
+            thread->codec_scratch = malloc(CODEC_MAX_FRAME);
+            if (!thread->codec_scratch) return -1;
+        }
+    }
+    
+    reactor->codec = codec;
+    return 0;
+}
+
+// 封帧发送：帧头、负载、帧尾分别入队，writev一次发出；
+// 任一部分入队失败时撤销已入队的部分，发送队列中不留半帧（对端会按错位的帧头解析后续数据）
+int reactor_send_frame_ref(reactor_t *reactor, connection_t *conn, uint32_t type, const void *data, size_t len,
+                           buf_free_fn free_fn, void *arg) {
+    if (!reactor || !conn || !reactor->codec) return -1;
+    
+    codec_frame_t frame = { .data = data, .len = len, .type = type, .fin = true };
+    char hdr[CODEC_HDR_MAX], trl[CODEC_HDR_MAX];
+    size_t hdr_len = 0, trl_len = 0;
+    
+    if (reactor->codec->encode(conn, &frame, hdr, &hdr_len, trl, &trl_len) != 0) {
+        return -1;
+    }
+    
+    // 小负载拷贝入队，整帧入队成功后才释放；零拷贝片段被撤销时不回调free_fn
+    reactor_thread_t *thread = reactor->threads[conn->thread_id];
+    size_t mark = conn->output.len;
+    bool copy = len < BUF_COPY_MAX;
+    if (reactor_write(reactor, conn, hdr, hdr_len) != hdr_len ||
+        (copy ? reactor_write(reactor, conn, data, len) != len
+              : reactor_write_ref(reactor, conn, data, len, free_fn, arg) != 0) ||
+        reactor_write(reactor, conn, trl, trl_len) != trl_len) {
+        buf_outq_truncate(&conn->output, &thread->buf_pool, mark);
+        return -1;
+    }
+    if (copy && free_fn) free_fn(arg);
+    return 0;
+}
+
+int reactor_send_codec_frame(reactor_t *reactor, connection_t *conn, const codec_frame_t *frame) {
+    if (!reactor || !conn || !frame || !reactor->codec) return -1;
+    
+    char hdr[CODEC_HDR_MAX], trl[CODEC_HDR_MAX];
+    size_t hdr_len = 0, trl_len = 0;
+    
+    if (reactor->codec->encode(conn, frame, hdr, &hdr_len, trl, &trl_len) != 0) {
+        return -1;
+    }
+    
+    reactor_thread_t *thread = reactor->threads[conn->thread_id];
+    size_t mark = conn->output.len;
+    if (reactor_write(reactor, conn, hdr, hdr_len) != hdr_len ||
+        reactor_write(reactor, conn, frame->data, frame->len) != frame->len ||
+        reactor_write(reactor, conn, trl, trl_len) != trl_len) {
+        buf_outq_truncate(&conn->output, &thread->buf_pool, mark);
+        return -1;
     }
-}
\ No newline at end of file
+    return 0;
+}
+
+int reactor_send_frame(reactor_t *reactor, connection_t *conn, uint32_t type, const void *data, size_t len) {
+    codec_frame_t frame = { .data = data, .len = len, .type = type, .fin = true };
+    return reactor_send_codec_frame(reactor, conn, &frame);
+}
@@ -2,78 +2,457 @@
 #define REACTOR_H
 
 #include "ring_queue.h"
+#include "slot_table.h"
+#include "timer_wheel.h"
+#include "buffer.h"
+#include "slab.h"
+#include "metrics.h"
+#include "uring.h"
+#include "group.h"
 #include <sys/epoll.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define MAX_EVENTS 1024
-#define BUFFER_SIZE 8192
+#define BUF_POOL_MAX_FREE 8192   // 每线程缓存的空闲段上限（32MB）
+#define CONN_SLAB_CHUNK 256      // connection_t的slab每次扩展的对象数
 #define MAX_CONNECTIONS 100000
 #define MAX_REACTOR_THREADS 16
 #define BATCH_SIZE 64
+#define ACCEPT_QUEUE_SIZE 65536      // accept线程到每个Reactor线程的fd队列容量
+#define CONN_IDLE_TIMEOUT_MS 30000
+#define MAX_ACCEPT_PER_WAKEUP 256    // 每次监听事件最多accept的连接数，避免饿死已有连接
+#define REACTOR_LOAD_SAMPLE_MS 500   // 线程事件速率的采样周期
+#define REBALANCE_MIN_RATE 1000      // 事件速率（次/秒）低于该值的线程不迁出连接
+#define REBALANCE_MAX_MOVES 8        // 每个采样周期最多迁出的连接数
+#define URING_ENTRIES 4096           // io_uring后端每线程的提交队列大小
+#define URING_CQ_ENTRIES 16384       // 完成队列大小（多发请求一次提交产生多个完成事件）
+#define OUTQ_HIGH_WATERMARK (1024 * 1024)   // 发送队列超过该值时暂停读取并回调on_backpressure
+#define OUTQ_LOW_WATERMARK (256 * 1024)     // 回落到该值以下时恢复
+#define SEND_QUEUE_SIZE 16384        // 其他线程经reactor_send投递给每个线程的命令队列容量
+#define SEND_DRAIN_MAX 4096          // 每轮循环最多处理的投递命令数，剩余的留到下一轮（不阻塞）
+#define REACTOR_SEND_INLINE 40       // 不超过该长度的数据直接拷贝在命令里，不另外分配内存
+#define READ_BUDGET_CONN (64 * 1024)     // 每个连接每轮循环最多读取的字节数，用完放入ready列表下一轮继续
+#define READ_BUDGET_LOOP (1024 * 1024)   // 每轮循环所有连接合计最多读取的字节数，保证写和定时器按时执行
+#define GROUP_TABLE_SIZE 64          // 每线程广播组表的初始容量
+#define BCAST_SLAB_CHUNK 64          // 广播的线程内引用每次扩展的对象数
+#define URING_PBUF_ENTRIES 512       // 每线程提供给内核的接收缓冲数（2的幂），每个缓冲为一个buf_pool段
 
-// 连接结构
+// epoll事件中的特殊标记：有效句柄的代数不为0，高32位为0的值不会与之冲突
+#define REACTOR_TOKEN_LISTEN 1
+#define REACTOR_TOKEN_WAKEUP 2
+#define REACTOR_TOKEN_METRICS 3
+
+// epoll后端连接的事件集：建立时注册一次，之后不再修改；写意向和读暂停都只在用户态记录
+#define CONN_EPOLL_EVENTS (EPOLLIN | EPOLLOUT | EPOLLET)
+
+#define METRICS_RESPONSE_MAX (256 * 1024)   // 文本指标响应的缓冲上限
+
+// 连接句柄：高32位为槽位代数，bit24-31为线程号，低24位为槽位下标
+// fd会被内核复用，句柄不会：连接关闭后旧句柄查找失败，数据不会发到重连的新客户端
+typedef uint64_t conn_handle_t;
+#define CONN_HANDLE_INVALID 0
+#define CONN_HANDLE_SLOT_BITS 24
+#define CONN_HANDLE_MAKE(gen, tid, slot) \
+    (((uint64_t)(gen) << 32) | ((uint64_t)(tid) << CONN_HANDLE_SLOT_BITS) | (uint64_t)(slot))
+#define CONN_HANDLE_GEN(h)    ((uint32_t)((h) >> 32))
+#define CONN_HANDLE_THREAD(h) ((uint32_t)(((h) >> CONN_HANDLE_SLOT_BITS) & 0xFF))
+#define CONN_HANDLE_SLOT(h)   ((uint32_t)((h) & ((1u << CONN_HANDLE_SLOT_BITS) - 1)))
+
+_Static_assert(MAX_CONNECTIONS <= (1 << CONN_HANDLE_SLOT_BITS), "MAX_CONNECTIONS exceeds handle slot bits");
+_Static_assert(MAX_REACTOR_THREADS <= 256, "MAX_REACTOR_THREADS exceeds handle thread bits");
+
+// 新连接的线程选择策略（accept线程模式），运行时可切换
+typedef enum {
+    PLACEMENT_ROUND_ROBIN = 0,
+    PLACEMENT_LEAST_CONNECTIONS,   // 连接数最少（含accept队列中尚未处理的）
+    PLACEMENT_LEAST_EVENT_RATE,    // 最近采样的事件速率最低
+    PLACEMENT_POWER_OF_TWO,        // 随机取两个线程，选连接数少的一个
+} placement_policy_t;
+
+// 事件后端，创建时选择
+typedef enum {
+    REACTOR_BACKEND_EPOLL = 0,
+    REACTOR_BACKEND_URING,         // 多发accept/recv + 提供缓冲，sendmsg批量提交，一轮循环一次io_uring_enter
+} reactor_backend_t;
+
+// 编解码器（codec.h）
+typedef struct codec_s codec_t;
+typedef struct codec_frame_s codec_frame_t;
+typedef struct reactor_s reactor_t;
+typedef struct broadcast_payload_s broadcast_payload_t;
+
+// 连接结构：只由所属线程访问，字段都是普通变量；其他线程经send_queue、migrate_in等队列交互
+// 按访问频率排列：第一条缓存行为每个事件都要用的读路径字段，第二条为发送路径，空闲定时器等放在最后
+// 每个连接的事件计数不在这里，放在线程的conn_events数组中（按槽位下标），负载采样时顺序扫描
 typedef struct connection_s {
     int fd;
-    atomic_int state;
-    
-    char read_buf[BUFFER_SIZE];
-    atomic_uint read_len;
+    uint32_t flags;
+    conn_handle_t handle;
+    uint64_t last_active_time;
     
-    char write_buf[BUFFER_SIZE];
-    atomic_uint write_len;
-    atomic_uint write_sent;
+    // 读缓冲为段链，段从线程的buf_pool按需借出，读空即归还
+    // 发送队列为引用计数的片段链，转发输入数据时只增加段的引用，不拷贝
+    buf_chain_t input;    // 已读取、待处理的数据
+    uint32_t codec_state;      // 编解码器的连接状态（握手阶段、已扫描长度等）
+    // io_uring后端：未完成的请求数（多发recv只算一个），关闭后等它归零才释放连接
+    uint32_t uring_inflight;
     
+    buf_outq_t output;    // 待发送的数据
+    struct uring_send_s *uring_send;    // io_uring后端：进行中的sendmsg参数
+    struct connection_s *send_next;     // io_uring后端：本轮待提交发送的连接链
     void *user_data;
-    uint64_t last_active_time;
     int thread_id;
+    int migrate_to;                     // CONN_FLAG_MIGRATE时的目标线程
+    struct connection_s *migrate_next;  // 目标线程migrate_in栈中的链接
+    
+    timer_node_t idle_timer;   // 空闲超时，到期时检查last_active_time，未超时则顺延
 } connection_t;
 
+_Static_assert(offsetof(connection_t, output) == 64, "connection_t read-path fields exceed one cache line");
+_Static_assert(sizeof(connection_t) <= 3 * 64, "connection_t exceeds three cache lines");
+
+// 连接标志
+#define CONN_FLAG_METRICS        0x1   // 指标抓取连接，不经过编解码器和应用回调
+#define CONN_FLAG_CLOSE_ON_FLUSH 0x2   // 发送队列清空后关闭
+#define CONN_FLAG_MIGRATE        0x4   // 缓冲清空后迁移到migrate_to线程
+#define CONN_FLAG_CLOSED         0x8   // io_uring后端：已关闭，等待进行中的请求完成
+#define CONN_FLAG_SEND_QUEUED    0x10  // io_uring后端：在send_head链中
+#define CONN_FLAG_ADOPTED        0x20  // 热升级时从旧进程接管，on_connect中可据此跳过欢迎消息等
+#define CONN_FLAG_OUTQ_HIGH      0x40  // 发送队列超过高水位，暂停读取直到回落到低水位
+#define CONN_FLAG_READ_PAUSED    0x80  // 应用调用reactor_pause_read暂停读取
+#define CONN_FLAG_URING_RECV     0x100 // io_uring后端：多发recv进行中
+#define CONN_FLAG_READ_READY     0x200 // 在线程的ready列表中，下一轮不等新的边缘直接读（读预算用完或恢复读取）
+#define CONN_FLAG_DIRTY          0x400 // 延迟发送：在线程的dirty列表中，本轮末尾统一发送
+#define CONN_FLAG_WANT_OUT       0x800 // epoll后端：等待EPOLLOUT边缘（发送遇到EAGAIN，等可写后继续）
+
+// 跨线程发送命令：数据内联在命令里，或为外部内存（由所属线程入队为零拷贝片段），
+// 或为一次广播（各线程向本线程的组成员入队同一份负载）
+// 整个命令加上队列槽位的序号为64字节，一个命令占一条缓存行
+typedef enum {
+    SEND_CMD_INLINE = 0,
+    SEND_CMD_REF,
+    SEND_CMD_BROADCAST,
+} send_cmd_type_t;
+
+typedef struct reactor_send_cmd_s {
+    conn_handle_t handle;
+    uint32_t len;
+    uint32_t type;    // send_cmd_type_t
+    union {
+        char data[REACTOR_SEND_INLINE];
+        struct {
+            const void *data;
+            buf_free_fn free_fn;
+            void *arg;
+        } ref;
+        struct {
+            broadcast_payload_t *payload;
+            uint64_t gid;
+            uint64_t start_us;   // 调用reactor_broadcast的时间，用于统计扇出耗时
+        } bcast;
+    } u;
+} reactor_send_cmd_t;
+
+// 用户定时器（心跳、重传等），由所属Reactor线程执行回调
+typedef struct reactor_timer_s reactor_timer_t;
+typedef void (*reactor_timer_cb_t)(reactor_timer_t *timer, void *arg);
+
 // Reactor线程上下文
 typedef struct reactor_thread_s {
+    reactor_t *reactor;
     int id;
     pthread_t thread_id;
     atomic_bool running;
+    int cpu;         // 绑定的CPU，-1表示不绑定
+    int numa_node;   // 绑核后所在的NUMA节点，未知为-1
     
     int epoll_fd;
-    connection_t *connections[MAX_CONNECTIONS];
-    atomic_uint connection_count;
+    int listen_fd;   // SO_REUSEPORT模式下本线程独占的监听socket，否则为-1
+    int reserve_fd;  // 预留的fd（/dev/null），fd耗尽时临时释放，用来取出并关闭监听队列中的连接
+    slot_table_t connections;  // 槽位 -> connection_t*，epoll事件中携带句柄而不是指针
+    uint32_t *conn_events;     // 槽位 -> 本采样周期内的事件数，用于挑选要迁出的热点连接
+    
+    // 分层时间轮，空闲超时和用户定时器共用
+    timer_wheel_t timers;
+    uint64_t now_ms;   // 每轮循环缓存一次的当前时间
+    
+    // 本线程所有连接共用的缓冲段池
+    buf_pool_t buf_pool;
+    
+    // connection_t对象池
+    slab_cache_t conn_slab;
+    
+    // 帧负载跨段时的拼接缓冲（CODEC_MAX_FRAME），设置编解码器时分配
+    char *codec_scratch;
+    
+    // accept线程交给本线程的fd（单生产者单消费者）
+    spsc_ring_t accept_queue;
+    
+    // 读预算（epoll后端）：用完预算、内核中可能还有数据的连接，下一轮不等新的边缘触发直接继续读
+    // 两个数组交替使用：处理ready_work时新用完预算的连接加入ready
+    conn_handle_t *ready;
+    conn_handle_t *ready_work;
+    uint32_t ready_count;
+    size_t loop_read_left;   // 本轮剩余的读预算
+    uint64_t read_deferred;  // 因预算用完推迟到下一轮的次数
+    
+    // 延迟发送（epoll后端）：本轮产生了待发送数据的连接，循环末尾每个连接一次sendmsg
+    conn_handle_t *dirty;
+    uint32_t dirty_count;
+    uint64_t flushes;   // 延迟发送的sendmsg次数
     
-    // 使用优化的环形队列
-    ring_queue_t accept_queue;
+    // 任意线程经reactor_send投递给本线程连接的数据（多生产者单消费者），每轮循环批量处理
+    mpsc_ring_t send_queue;
+    uint64_t remote_sends;     // 已入队的投递数（仅所属线程写）
+    uint64_t remote_dropped;   // 目标连接已关闭而丢弃的投递数
     
-    // 每个线程独立的统计信息
-    _Alignas(64) atomic_ullong total_connections;
-    _Alignas(64) atomic_ullong active_connections;
-    _Alignas(64) atomic_ullong processed_events;
-    _Alignas(64) atomic_ullong batch_processed;
+    // 广播组：只记录本线程的连接；广播负载在线程内的引用计数对象来自bcast_slab
+    group_table_t groups;
+    slab_cache_t bcast_slab;
+    uint64_t broadcasts;          // 处理过的广播命令数
+    uint64_t broadcast_members;   // 入队的成员数
+    
+    // 其他线程迁入的连接（多生产者无锁栈，本线程整体摘取）
+    _Alignas(64) _Atomic(connection_t*) migrate_in;
+    
+    // 热升级：新进程中从旧进程接管的连接（同为无锁栈）；旧进程中待执行的交接请求（UPGRADE_*）
+    _Atomic(struct handoff_conn_s*) handoff_in;
+    atomic_uint upgrade_request;
+    
+    // 负载采样：所属线程每REACTOR_LOAD_SAMPLE_MS更新event_rate，放置策略和迁移从任意线程读取
+    timer_node_t load_timer;
+    uint64_t load_last_events;
+    _Alignas(64) atomic_uint event_rate;   // 事件数/秒（平滑后）
+    
+    // io_uring后端：recv缓冲为本线程buf_pool的段，数据直接收进段里挂到输入链
+    uring_t uring;
+    uring_buf_ring_t pbuf;
+    buf_segment_t **pbuf_segs;        // 缓冲号 -> 段
+    connection_t *send_head;          // 本轮有待发送数据的连接，循环末尾统一提交
+    struct uring_send_s *send_free;   // 空闲的sendmsg参数
+    uint32_t zombies;                 // 已关闭、等待请求完成的连接数
+    uint64_t wakeup_value;            // eventfd读请求的目标
+    timer_node_t accept_timer;        // fd耗尽后延迟重新提交accept
+    uint32_t accept_paused;           // 等待重新提交的accept（1 << URING_OP_ACCEPT*）
+    
+    uint64_t syscalls;   // 本线程发起的系统调用次数（仅所属线程写）
+    
+    // 自适应忙轮询：最近一次有事件后的busy_poll_us内以0超时轮询，不睡眠；0表示关闭
+    atomic_uint busy_poll_us;
+    uint64_t last_event_us;   // 最近一次等到事件的时间
+    uint64_t spin_time_us;    // 0超时轮询的累计时间（仅所属线程写）
+    uint64_t sleep_time_us;   // 阻塞等待的累计时间
+    
+    // 唤醒机制：线程即将阻塞时清除wakeup_pending，生产者只在它为false时写eventfd
+    // 线程醒着时投递不产生任何系统调用
+    int wakeup_fd;
+    _Alignas(64) atomic_bool wakeup_pending;
+    
+    // 其他线程的唤醒次数（多个生产者写）
+    _Alignas(64) atomic_ullong wakeups_sent;
+    
+    // 每个线程独立的统计信息：只有所属线程写（thread_stat_add，不带lock前缀），
+    // 放置策略和统计从其他线程读，放在同一条缓存行
+    _Alignas(64) atomic_uint connection_count;
+    atomic_ullong total_connections;
+    atomic_ullong active_connections;
+    atomic_ullong processed_events;
+    atomic_ullong batch_processed;
+    atomic_ullong accepted_connections;
+    atomic_ullong migrated_in;
+    atomic_ullong migrated_out;
 } reactor_thread_t;
 
+// Reactor导出的指标，每个线程一个分片
+typedef struct reactor_metric_ids_s {
+    metric_id_t loop_time_us;        // 一轮循环的处理时间（不含epoll_wait阻塞）
+    metric_id_t events_per_wakeup;   // 每次epoll_wait返回的事件数
+    metric_id_t bytes_in;
+    metric_id_t bytes_out;
+    metric_id_t write_backlog;       // 每次发送后连接剩余的待发送字节数
+    metric_id_t accept_queue_depth;
+    metric_id_t accept_queue_fails;  // 投递失败（队列满）
+    metric_id_t accept_rejected;     // fd耗尽时取出并直接关闭的连接
+    metric_id_t connections;
+    metric_id_t accepted;
+    metric_id_t buf_segments;
+    metric_id_t event_rate;
+    metric_id_t migrated_in;
+    metric_id_t migrated_out;
+    metric_id_t syscalls;
+    metric_id_t spin_time_us;
+    metric_id_t sleep_time_us;
+    metric_id_t backpressure;   // 发送队列越过高水位的次数
+    metric_id_t read_deferred;  // 读预算用完、推迟到下一轮的次数
+    metric_id_t remote_sends;
+    metric_id_t remote_dropped;
+    metric_id_t send_queue_fails;   // reactor_send投递失败（队列满）
+    metric_id_t broadcast_fanout_us;   // 一个线程处理一次广播（向本线程所有成员入队）的耗时
+    metric_id_t broadcast_delay_us;    // 从调用reactor_broadcast到本线程入队完成的时间
+    metric_id_t broadcast_members;
+} reactor_metric_ids_t;
+
 // 主Reactor结构
-typedef struct reactor_s {
-    reactor_thread_t threads[MAX_REACTOR_THREADS];
+struct reactor_s {
+    reactor_thread_t *threads[MAX_REACTOR_THREADS];   // 按页对齐单独分配，可迁到线程所在节点
     int thread_count;
+    reactor_backend_t backend;
     atomic_bool running;
     atomic_uint next_thread;
+    atomic_int placement;     // placement_policy_t
+    atomic_bool rebalance;    // 采样时由过载线程把热点连接迁往事件速率最低的线程
+    
+    // 回调函数指针，均在连接所属线程执行
+    void (*on_connect)(connection_t *conn);   // 连接加入线程后
+    void (*on_data)(connection_t *conn);      // 未设置编解码器时，收到数据后（应用自行消费conn->input）
+    void (*on_write)(connection_t *conn);     // 发送队列清空后
+    void (*on_close)(connection_t *conn);     // 连接释放前
+    void (*on_migrate)(connection_t *conn, conn_handle_t old_handle);   // 迁入新线程后（句柄已改变）
+    // 发送队列越过高水位（paused为true，conn已停止读取）或回落到低水位（false）
+    // 数据来自其他连接（转发、中继）时，应用在回调中对来源连接调用reactor_pause_read/reactor_resume_read
+    // 越过高水位的回调在发送API内部执行，回调中不能关闭conn
+    void (*on_backpressure)(connection_t *conn, bool paused);
+    
+    // 发送队列水位（字节），所有连接相同
+    size_t outq_high;
+    size_t outq_low;
     
-    // 回调函数指针
-    void (*on_connect)(connection_t *conn);
-    void (*on_data)(connection_t *conn);
-    void (*on_write)(connection_t *conn);
-    void (*on_close)(connection_t *conn);
-} reactor_t;
+    // 延迟发送：发送API只入队并标记连接，循环末尾统一发送；关闭时入队后注册EPOLLOUT，
+    // 由下一轮的可写事件发送
+    bool deferred_flush;
+    
+    // 读预算（字节），SIZE_MAX表示不限制
+    size_t read_budget_conn;
+    size_t read_budget_loop;
+    
+    // 设置编解码器后按帧回调：frame只在回调期间有效，回调中不能消费conn->input
+    // 未设置on_frame时默认原样回送数据帧；on_data和on_frame都未设置时默认回显
+    const codec_t *codec;
+    void (*on_frame)(connection_t *conn, const codec_frame_t *frame);
+    
+    // 指标：共享内存/dev/shm/reactor-<pid>，可用tools/metrics_cli读取
+    metrics_t *metrics;
+    reactor_metric_ids_t mid;
+    char metrics_shm[32];
+    int metrics_fd;   // 文本抓取端口的监听socket，由0号线程处理
+    
+    // 热升级（旧进程）：各线程在自己的循环中处理交接请求，经upgrade_sock发送时加锁
+    int upgrade_sock;
+    pthread_mutex_t upgrade_lock;
+    bool upgrade_broken;          // 发送失败或超时后置位，流中可能留有半条消息，其余线程不再发送（受upgrade_lock保护）
+    atomic_int upgrade_pending;   // 尚未完成本次请求的线程数
+    atomic_uint upgrade_sent;     // 已交出的连接数
+};
 
 // 前向声明
 void handle_close_event(reactor_thread_t *thread, connection_t *conn);
 
+// 关闭连接（只能在连接所属线程调用）
+void reactor_close(reactor_t *reactor, connection_t *conn);
+
 // API
 reactor_t* reactor_create(int thread_count);
+// 指定事件后端；内核不支持io_uring时退回epoll（以reactor->backend为准）
+reactor_t* reactor_create_backend(int thread_count, reactor_backend_t backend);
 int reactor_destroy(reactor_t *reactor);
+// 交给Reactor线程的accept队列，只能由一个accept线程调用
 int reactor_add_connection(reactor_t *reactor, int fd);
+// SO_REUSEPORT模式：每个线程在自己的epoll中监听同一端口，不再需要accept线程
+// cpu_local为true时挂载CBPF程序，内核按处理SYN的CPU选择监听socket（需配合线程绑核）
+int reactor_listen_reuseport(reactor_t *reactor, int port, bool cpu_local);
+// 在port上提供纯文本指标（HTTP GET，任意路径），只能在reactor_run之前调用
+int reactor_listen_metrics(reactor_t *reactor, int port);
+// 设置新连接的放置策略，任意时刻、任意线程都可调用
+void reactor_set_placement(reactor_t *reactor, placement_policy_t policy);
+// 开关自动迁移
+void reactor_set_rebalance(reactor_t *reactor, bool enabled);
+// 自适应忙轮询：线程在最近一次有事件后的idle_budget_us内不睡眠，一直以0超时轮询，超出后恢复阻塞等待
+// 之后新加入的连接尽量设置SO_BUSY_POLL/SO_PREFER_BUSY_POLL（需要CAP_NET_ADMIN，失败忽略）
+// idle_budget_us为0表示关闭，thread_id为-1表示所有线程；任意时刻、任意线程都可调用
+int reactor_set_busy_poll(reactor_t *reactor, int thread_id, uint32_t idle_budget_us);
+// 绑核：线程i固定在cpus[i % count]上，count为0取消绑定；只能在reactor_run之前调用
+// 线程启动后把自己的状态迁到CPU所在的NUMA节点，reactor_run时打印网卡中断的分布和调整建议
+int reactor_set_affinity(reactor_t *reactor, const int *cpus, int count);
+// 把连接迁移到target_thread（只能在连接所属线程调用）：缓冲非空时推迟到读写都清空后
+// 迁移后连接获得新句柄，旧句柄失效，在目标线程回调on_migrate；io_uring后端不支持，返回-1
+int reactor_migrate(reactor_t *reactor, connection_t *conn, int target_thread);
+// 设置发送队列的高/低水位（low < high），只能在reactor_run之前调用
+int reactor_set_watermarks(reactor_t *reactor, size_t high, size_t low);
+// 设置读预算：每个连接每轮最多读conn_bytes，每轮所有连接合计最多读loop_bytes，0表示不限制
+// 只能在reactor_run之前调用；仅epoll后端，io_uring后端的接收量由提供缓冲数限制
+int reactor_set_read_budget(reactor_t *reactor, size_t conn_bytes, size_t loop_bytes);
+// 开关延迟发送（默认开启），只能在reactor_run之前调用；仅epoll后端，io_uring后端本来就在循环末尾统一提交
+int reactor_set_deferred_flush(reactor_t *reactor, bool enabled);
+// 暂停/恢复读取（只能在连接所属线程调用），与水位引起的暂停相互独立，两者都解除后才恢复读取
+void reactor_pause_read(reactor_t *reactor, connection_t *conn);
+void reactor_resume_read(reactor_t *reactor, connection_t *conn);
+// 按句柄查找连接，句柄过期返回NULL（只能在连接所属线程调用）
+connection_t* reactor_get_connection(reactor_t *reactor, conn_handle_t handle);
 int reactor_run(reactor_t *reactor);
 int reactor_stop(reactor_t *reactor);
 void reactor_stats(reactor_t *reactor);
+// 所有线程的连接数（含指标连接），热升级后旧进程据此判断是否已排空
+uint32_t reactor_connection_count(reactor_t *reactor);
+
+// 热升级：旧进程把监听socket和已建立的连接经Unix socket交给新进程（协议见common/handoff.h）
+// 旧进程：交出本Reactor的监听socket（各线程的SO_REUSEPORT监听、指标端口）和应用自己的extra_fds，
+// 返回后各线程已停止accept，新连接全部由新进程接收
+int reactor_upgrade_send_listeners(reactor_t *reactor, int sock, const int *extra_fds, int extra_count);
+// 旧进程：connections为true时各线程交出连接，连同未处理的输入、未发送的输出和编解码器状态（仅epoll后端，
+// io_uring后端的连接有进行中的多发recv，留在旧进程直到关闭）；最后发送DONE，返回交出的连接数
+int reactor_upgrade_send_connections(reactor_t *reactor, int sock, bool connections);
+// 新进程（reactor_run之前）：接收监听socket，SO_REUSEPORT监听和指标端口由Reactor直接接管，
+// 应用的监听socket存入extra_fds，返回其个数，失败返回-1
+int reactor_upgrade_recv_listeners(reactor_t *reactor, int sock, int *extra_fds, int max_extra);
+// 新进程（reactor_run之后）：接收连接直到DONE，按放置策略分给各线程，以CONN_FLAG_ADOPTED调用on_connect
+// 返回接收的连接数，失败返回-1
+int reactor_upgrade_recv_connections(reactor_t *reactor, int sock);
+
+// 发送API：只能在连接所属线程调用（回调中），数据入队后由writev批量发送
+// 协议头等小块数据拷贝入队，返回实际入队的字节数
+size_t reactor_write(reactor_t *reactor, connection_t *conn, const void *data, size_t len);
+// 零拷贝入队外部内存，发送完或连接关闭时调用free_fn(arg)；失败返回-1，不调用free_fn
+int reactor_write_ref(reactor_t *reactor, connection_t *conn, const void *data, size_t len,
+                      buf_free_fn free_fn, void *arg);
+// 零拷贝转发：把src头部的len字节（如另一连接的input）移入conn的发送队列，返回实际转发的字节数
+size_t reactor_forward(reactor_t *reactor, connection_t *conn, buf_chain_t *src, size_t len);
+
+// 跨线程发送：任意线程可调用，按句柄把数据投递给连接所属线程，由它在下一轮循环入队
+// 同一线程对同一连接的多次投递保持顺序；连接在处理投递前已关闭或迁移（句柄失效）时数据被丢弃
+// reactor_send拷贝数据后立即返回；队列满时返回-1且errno为EAGAIN，调用方稍后重试
+int reactor_send(reactor_t *reactor, conn_handle_t handle, const void *data, size_t len);
+// 零拷贝投递：入队后由所属线程在发送完、连接已关闭或Reactor销毁时调用free_fn(arg)；
+// 返回-1（队列满、句柄无效）时不调用free_fn，内存仍归调用方
+int reactor_send_ref(reactor_t *reactor, conn_handle_t handle, const void *data, size_t len,
+                     buf_free_fn free_fn, void *arg);
+
+// 广播组：加入/离开只能在连接所属线程调用（如on_connect、on_frame中），已加入时重复加入无效果
+// 连接关闭后在下一次广播或组成员数组满时从组中移除；迁移后句柄改变，需要在on_migrate中重新加入
+int reactor_group_join(reactor_t *reactor, connection_t *conn, uint64_t gid);
+int reactor_group_leave(reactor_t *reactor, connection_t *conn, uint64_t gid);
+// 广播：任意线程可调用。负载只拷贝一次（引用计数），每个线程收到一条命令，
+// 把同一份负载以零拷贝片段挂到本线程各成员的发送队列，随各连接的writev发出
+// 有线程的投递队列满时该线程的成员收不到本次广播，返回-1且errno为EAGAIN
+int reactor_broadcast(reactor_t *reactor, uint64_t gid, const void *data, size_t len);
+
+// 设置编解码器，只能在reactor_run之前调用
+int reactor_set_codec(reactor_t *reactor, const codec_t *codec);
+// 按编解码器封帧发送：帧头拷贝入队，负载拷贝或零拷贝（free_fn语义同reactor_write_ref）
+int reactor_send_frame(reactor_t *reactor, connection_t *conn, uint32_t type, const void *data, size_t len);
+int reactor_send_frame_ref(reactor_t *reactor, connection_t *conn, uint32_t type, const void *data, size_t len,
+                           buf_free_fn free_fn, void *arg);
+// 按frame->type和frame->fin封帧（拷贝负载），用于原样转发分片消息
+int reactor_send_codec_frame(reactor_t *reactor, connection_t *conn, const codec_frame_t *frame);
+
+// 定时器API：只能在reactor_run之前或目标线程内（回调中）调用
+// interval_ms为0表示单次定时器，回调返回后自动释放；周期定时器需要显式取消
+reactor_timer_t* reactor_add_timer(reactor_t *reactor, int thread_id, uint64_t delay_ms,
+                                   uint64_t interval_ms, reactor_timer_cb_t cb, void *arg);
+int reactor_reset_timer(reactor_t *reactor, reactor_timer_t *timer, uint64_t delay_ms);
+int reactor_cancel_timer(reactor_t *reactor, reactor_timer_t *timer);
 
 #endif
\ No newline at end of file
@@ -1,200 +1,322 @@
 #include "ring_queue.h"
-#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-// 静态断言，确保大小为2的幂
-_Static_assert((RING_QUEUE_SIZE & (RING_QUEUE_SIZE - 1)) == 0, 
-               "RING_QUEUE_SIZE must be power of 2");
+// 容量向上取整为2的幂
+static size_t ring_capacity(size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+    return cap;
+}
 
-// 初始化队列
-void ring_queue_init(ring_queue_t *q) {
-    if (!q) return;
-    
+// 缓存行对齐分配
+static void *ring_alloc(size_t size) {
+    size = (size + RING_CACHE_LINE - 1) & ~(size_t)(RING_CACHE_LINE - 1);
+    return aligned_alloc(RING_CACHE_LINE, size);
+}
+
+/* ---------------- SPSC ---------------- */
+
+int spsc_ring_init(spsc_ring_t *q, size_t capacity, size_t elem_size) {
+    if (!q || capacity == 0 || elem_size == 0) return -1;
+
+    size_t cap = ring_capacity(capacity);
+    q->buffer = ring_alloc(cap * elem_size);
+    if (!q->buffer) return -1;
+
+    q->mask = cap - 1;
+    q->elem_size = elem_size;
+    q->head_cache = 0;
+    q->tail_cache = 0;
     atomic_store(&q->head, 0);
     atomic_store(&q->tail, 0);
-    atomic_store(&q->push_count, 0);
-    atomic_store(&q->pop_count, 0);
     atomic_store(&q->push_fail_count, 0);
-    
-    memset(q->buffer, 0, sizeof(q->buffer));
+    return 0;
 }
 
-// 检查队列是否为空
-bool ring_queue_empty(ring_queue_t *q) {
-    if (!q) return true;
-    
-    uint32_t head = atomic_load(&q->head);
-    uint32_t tail = atomic_load(&q->tail);
-    
-    return head == tail;
+void spsc_ring_destroy(spsc_ring_t *q) {
+    if (!q) return;
+    free(q->buffer);
+    q->buffer = NULL;
+}
+
+// 拷贝n个元素到位置pos开始的槽位（可能回绕）
+static void spsc_copy_in(spsc_ring_t *q, size_t pos, const char *src, size_t n) {
+    size_t index = pos & q->mask;
+    size_t first = q->mask + 1 - index;
+    if (first > n) first = n;
+
+    memcpy(q->buffer + index * q->elem_size, src, first * q->elem_size);
+    memcpy(q->buffer, src + first * q->elem_size, (n - first) * q->elem_size);
+}
+
+static void spsc_copy_out(spsc_ring_t *q, size_t pos, char *dst, size_t n) {
+    size_t index = pos & q->mask;
+    size_t first = q->mask + 1 - index;
+    if (first > n) first = n;
+
+    memcpy(dst, q->buffer + index * q->elem_size, first * q->elem_size);
+    memcpy(dst + first * q->elem_size, q->buffer, (n - first) * q->elem_size);
+}
+
+uint32_t spsc_ring_push_batch(spsc_ring_t *q, const void *items, uint32_t count) {
+    if (!q || !items || count == 0) return 0;
+
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t cap = q->mask + 1;
+    size_t free_space = cap - (tail - q->head_cache);
+
+    // 缓存的head不够时才读取消费者的计数
+    if (free_space < count) {
+        q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+        free_space = cap - (tail - q->head_cache);
+        if (free_space == 0) {
+            atomic_fetch_add_explicit(&q->push_fail_count, 1, memory_order_relaxed);
+            return 0;
+        }
+    }
+
+    size_t n = count < free_space ? count : free_space;
+    spsc_copy_in(q, tail, items, n);
+
+    // 数据写完再发布tail
+    atomic_store_explicit(&q->tail, tail + n, memory_order_release);
+    return (uint32_t)n;
+}
+
+uint32_t spsc_ring_pop_batch(spsc_ring_t *q, void *items, uint32_t count) {
+    if (!q || !items || count == 0) return 0;
+
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t avail = q->tail_cache - head;
+
+    if (avail < count) {
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        avail = q->tail_cache - head;
+        if (avail == 0) return 0;
+    }
+
+    size_t n = count < avail ? count : avail;
+    spsc_copy_out(q, head, items, n);
+
+    // 数据读完再归还槽位
+    atomic_store_explicit(&q->head, head + n, memory_order_release);
+    return (uint32_t)n;
 }
 
-// 检查队列是否已满
-bool ring_queue_full(ring_queue_t *q) {
+bool spsc_ring_push(spsc_ring_t *q, const void *item) {
+    return spsc_ring_push_batch(q, item, 1) == 1;
+}
+
+bool spsc_ring_pop(spsc_ring_t *q, void *item) {
+    return spsc_ring_pop_batch(q, item, 1) == 1;
+}
+
+// 顺序一致的读取：消费者阻塞前的复查依赖它与生产者的push+唤醒标志配对
+bool spsc_ring_empty(spsc_ring_t *q) {
     if (!q) return true;
-    
-    uint32_t head = atomic_load(&q->head);
-    uint32_t tail = atomic_load(&q->tail);
-    
-    // 使用无符号计算避免负数问题
-    return (tail - head) >= RING_QUEUE_SIZE;
+    return atomic_load(&q->head) == atomic_load(&q->tail);
 }
 
-// 获取队列当前大小
-uint32_t ring_queue_size(ring_queue_t *q) {
+size_t spsc_ring_size(spsc_ring_t *q) {
     if (!q) return 0;
-    
-    uint32_t head = atomic_load(&q->head);
-    uint32_t tail = atomic_load(&q->tail);
-    
+    size_t head = atomic_load(&q->head);
+    size_t tail = atomic_load(&q->tail);
     return tail - head;
 }
 
-// 单元素入队（无锁）
-bool ring_queue_push(ring_queue_t *q, int item) {
-    if (!q) return false;
-    
-    uint32_t head, tail;
-    
-    while (1) {
-        tail = atomic_load(&q->tail);
-        head = atomic_load(&q->head);
-        
-        // 检查队列是否已满
-        if ((tail - head) >= RING_QUEUE_SIZE) {
-            atomic_fetch_add(&q->push_fail_count, 1);
-            return false;
-        }
-        
-        // 尝试原子地增加tail
-        if (atomic_compare_exchange_weak(&q->tail, &tail, tail + 1)) {
-            // 成功获取槽位，写入数据
-            q->buffer[tail & RING_QUEUE_MASK] = item;
-            
-            // 确保数据在增加计数前对其他线程可见
-            atomic_thread_fence(memory_order_release);
-            
-            atomic_fetch_add(&q->push_count, 1);
-            return true;
-        }
-        // 如果CAS失败，重试
+/* ---------------- MPSC / MPMC（Vyukov） ---------------- */
+
+static inline atomic_size_t *cell_seq(const seq_ring_t *r, size_t pos) {
+    return (atomic_size_t*)(r->cells + (pos & r->mask) * r->stride);
+}
+
+static inline char *cell_data(atomic_size_t *seq) {
+    return (char*)seq + sizeof(atomic_size_t);
+}
+
+static int seq_ring_init(seq_ring_t *r, size_t capacity, size_t elem_size) {
+    if (!r || capacity == 0 || elem_size == 0) return -1;
+
+    size_t cap = ring_capacity(capacity);
+    r->stride = (sizeof(atomic_size_t) + elem_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+    r->cells = ring_alloc(cap * r->stride);
+    if (!r->cells) return -1;
+
+    r->mask = cap - 1;
+    r->elem_size = elem_size;
+    for (size_t i = 0; i < cap; i++) {
+        atomic_init(cell_seq(r, i), i);
     }
+    atomic_store(&r->enqueue_pos, 0);
+    atomic_store(&r->dequeue_pos, 0);
+    atomic_store(&r->push_fail_count, 0);
+    return 0;
 }
 
-// 单元素出队（无锁）
-bool ring_queue_pop(ring_queue_t *q, int *item) {
-    if (!q || !item) return false;
-    
-    uint32_t head, tail;
-    
-    while (1) {
-        head = atomic_load(&q->head);
-        tail = atomic_load(&q->tail);
-        
-        // 检查队列是否为空
-        if (head == tail) {
-            return false;
+static void seq_ring_destroy(seq_ring_t *r) {
+    if (!r) return;
+    free(r->cells);
+    r->cells = NULL;
+}
+
+// 认领从enqueue_pos开始的连续空槽位，逐个写入后发布
+static uint32_t seq_ring_push_batch(seq_ring_t *r, const char *items, uint32_t count) {
+    if (!r || !items || count == 0) return 0;
+
+    size_t pos = atomic_load_explicit(&r->enqueue_pos, memory_order_relaxed);
+    uint32_t n;
+
+    for (;;) {
+        size_t seq = 0;
+        for (n = 0; n < count; n++) {
+            seq = atomic_load_explicit(cell_seq(r, pos + n), memory_order_acquire);
+            if (seq != pos + n) break;
         }
-        
-        // 读取数据
-        *item = q->buffer[head & RING_QUEUE_MASK];
-        
-        // 尝试原子地增加head
-        if (atomic_compare_exchange_weak(&q->head, &head, head + 1)) {
-            atomic_fetch_add(&q->pop_count, 1);
-            return true;
+
+        if (n == 0) {
+            // 序号落后于pos：消费者还没腾出槽位，队列满
+            if ((intptr_t)(seq - pos) < 0) {
+                atomic_fetch_add_explicit(&r->push_fail_count, 1, memory_order_relaxed);
+                return 0;
+            }
+            // 序号超前：pos已被其他生产者认领，重新读取
+            pos = atomic_load_explicit(&r->enqueue_pos, memory_order_relaxed);
+            continue;
         }
-        // 如果CAS失败，重试
-    }
-}
 
-// 批量入队（更高性能）
-uint32_t ring_queue_push_batch(ring_queue_t *q, int *items, uint32_t count) {
-    if (!q || !items || count == 0) return 0;
-    
-    uint32_t head, tail, free_space, actual_count;
-    
-    // 一次性获取当前状态
-    tail = atomic_load(&q->tail);
-    head = atomic_load(&q->head);
-    
-    // 计算可用空间（使用无符号减法避免负数）
-    free_space = RING_QUEUE_SIZE - (tail - head);
-    
-    // 确定实际可插入的数量
-    actual_count = (count < free_space) ? count : free_space;
-    if (actual_count == 0) {
-        atomic_fetch_add(&q->push_fail_count, 1);
-        return 0;
-    }
-    
-    // 尝试原子地增加tail
-    uint32_t new_tail = tail + actual_count;
-    if (!atomic_compare_exchange_weak(&q->tail, &tail, new_tail)) {
-        // 如果CAS失败，说明其他线程修改了tail，返回0让调用者重试
-        return 0;
+        // 失败时pos被更新为最新值，重新扫描
+        if (atomic_compare_exchange_weak_explicit(&r->enqueue_pos, &pos, pos + n,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
     }
-    
-    // 批量拷贝数据
-    uint32_t index = tail & RING_QUEUE_MASK;
-    uint32_t first_chunk = RING_QUEUE_SIZE - index;
-    
-    if (actual_count <= first_chunk) {
-        // 不需要回绕
-        memcpy(&q->buffer[index], items, actual_count * sizeof(int));
-    } else {
-        // 需要回绕：分两次拷贝
-        memcpy(&q->buffer[index], items, first_chunk * sizeof(int));
-        memcpy(q->buffer, items + first_chunk, (actual_count - first_chunk) * sizeof(int));
+
+    for (uint32_t i = 0; i < n; i++) {
+        atomic_size_t *seq = cell_seq(r, pos + i);
+        memcpy(cell_data(seq), items + (size_t)i * r->elem_size, r->elem_size);
+        atomic_store_explicit(seq, pos + i + 1, memory_order_release);
     }
-    
-    // 内存屏障确保数据可见性
-    atomic_thread_fence(memory_order_release);
-    
-    atomic_fetch_add(&q->push_count, actual_count);
-    return actual_count;
+    return n;
 }
 
-// 批量出队（更高性能）
-uint32_t ring_queue_pop_batch(ring_queue_t *q, int *items, uint32_t count) {
-    if (!q || !items || count == 0) return 0;
-    
-    uint32_t head, tail, queue_size, actual_count;
-    
-    // 获取当前状态
-    head = atomic_load(&q->head);
-    tail = atomic_load(&q->tail);
-    
-    // 计算队列当前大小
-    queue_size = tail - head;
-    if (queue_size == 0) return 0;
-    
-    // 确定实际可取出的数量
-    actual_count = (count < queue_size) ? count : queue_size;
-    
-    // 尝试原子地增加head
-    uint32_t new_head = head + actual_count;
-    if (!atomic_compare_exchange_weak(&q->head, &head, new_head)) {
-        // 如果CAS失败，说明其他线程修改了head，返回0让调用者重试
-        return 0;
+// 取走从dequeue_pos开始的连续已发布槽位；单消费者不需要CAS
+static uint32_t seq_ring_pop_batch(seq_ring_t *r, char *items, uint32_t count, bool single_consumer) {
+    if (!r || !items || count == 0) return 0;
+
+    size_t pos = atomic_load_explicit(&r->dequeue_pos, memory_order_relaxed);
+    uint32_t n;
+
+    for (;;) {
+        size_t seq = 0;
+        for (n = 0; n < count; n++) {
+            seq = atomic_load_explicit(cell_seq(r, pos + n), memory_order_acquire);
+            if (seq != pos + n + 1) break;
+        }
+
+        if (n == 0) {
+            // 生产者已认领但还没写完的槽位同样视为空
+            if (single_consumer || (intptr_t)(seq - (pos + 1)) < 0) {
+                return 0;
+            }
+            pos = atomic_load_explicit(&r->dequeue_pos, memory_order_relaxed);
+            continue;
+        }
+
+        if (single_consumer) {
+            atomic_store_explicit(&r->dequeue_pos, pos + n, memory_order_relaxed);
+            break;
+        }
+        if (atomic_compare_exchange_weak_explicit(&r->dequeue_pos, &pos, pos + n,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
     }
-    
-    // 批量拷贝数据
-    uint32_t index = head & RING_QUEUE_MASK;
-    uint32_t first_chunk = RING_QUEUE_SIZE - index;
-    
-    if (actual_count <= first_chunk) {
-        // 不需要回绕
-        memcpy(items, &q->buffer[index], actual_count * sizeof(int));
-    } else {
-        // 需要回绕：分两次拷贝
-        memcpy(items, &q->buffer[index], first_chunk * sizeof(int));
-        memcpy(items + first_chunk, q->buffer, (actual_count - first_chunk) * sizeof(int));
+
+    // 读完数据后把序号推进一圈，槽位交还生产者
+    for (uint32_t i = 0; i < n; i++) {
+        atomic_size_t *seq = cell_seq(r, pos + i);
+        memcpy(items + (size_t)i * r->elem_size, cell_data(seq), r->elem_size);
+        atomic_store_explicit(seq, pos + i + r->mask + 1, memory_order_release);
     }
-    
-    // 内存屏障确保数据读取完成
-    atomic_thread_fence(memory_order_release);
-    
-    atomic_fetch_add(&q->pop_count, actual_count);
-    return actual_count;
-}
\ No newline at end of file
+    return n;
+}
+
+static bool seq_ring_empty(seq_ring_t *r) {
+    if (!r) return true;
+    return atomic_load(&r->dequeue_pos) == atomic_load(&r->enqueue_pos);
+}
+
+// 包含已认领、尚未发布的槽位
+static size_t seq_ring_size(seq_ring_t *r) {
+    if (!r) return 0;
+    size_t dequeue = atomic_load(&r->dequeue_pos);
+    size_t enqueue = atomic_load(&r->enqueue_pos);
+    return enqueue - dequeue;
+}
+
+int mpsc_ring_init(mpsc_ring_t *q, size_t capacity, size_t elem_size) {
+    return q ? seq_ring_init(&q->r, capacity, elem_size) : -1;
+}
+
+void mpsc_ring_destroy(mpsc_ring_t *q) {
+    if (q) seq_ring_destroy(&q->r);
+}
+
+bool mpsc_ring_push(mpsc_ring_t *q, const void *item) {
+    return q && seq_ring_push_batch(&q->r, item, 1) == 1;
+}
+
+bool mpsc_ring_pop(mpsc_ring_t *q, void *item) {
+    return q && seq_ring_pop_batch(&q->r, item, 1, true) == 1;
+}
+
+uint32_t mpsc_ring_push_batch(mpsc_ring_t *q, const void *items, uint32_t count) {
+    return q ? seq_ring_push_batch(&q->r, items, count) : 0;
+}
+
+uint32_t mpsc_ring_pop_batch(mpsc_ring_t *q, void *items, uint32_t count) {
+    return q ? seq_ring_pop_batch(&q->r, items, count, true) : 0;
+}
+
+bool mpsc_ring_empty(mpsc_ring_t *q) {
+    return !q || seq_ring_empty(&q->r);
+}
+
+size_t mpsc_ring_size(mpsc_ring_t *q) {
+    return q ? seq_ring_size(&q->r) : 0;
+}
+
+int mpmc_ring_init(mpmc_ring_t *q, size_t capacity, size_t elem_size) {
+    return q ? seq_ring_init(&q->r, capacity, elem_size) : -1;
+}
+
+void mpmc_ring_destroy(mpmc_ring_t *q) {
+    if (q) seq_ring_destroy(&q->r);
+}
+
+bool mpmc_ring_push(mpmc_ring_t *q, const void *item) {
+    return q && seq_ring_push_batch(&q->r, item, 1) == 1;
+}
+
+bool mpmc_ring_pop(mpmc_ring_t *q, void *item) {
+    return q && seq_ring_pop_batch(&q->r, item, 1, false) == 1;
+}
+
+uint32_t mpmc_ring_push_batch(mpmc_ring_t *q, const void *items, uint32_t count) {
+    return q ? seq_ring_push_batch(&q->r, items, count) : 0;
+}
+
+uint32_t mpmc_ring_pop_batch(mpmc_ring_t *q, void *items, uint32_t count) {
+    return q ? seq_ring_pop_batch(&q->r, items, count, false) : 0;
+}
+
+bool mpmc_ring_empty(mpmc_ring_t *q) {
+    return !q || seq_ring_empty(&q->r);
+}
+
+size_t mpmc_ring_size(mpmc_ring_t *q) {
+    return q ? seq_ring_size(&q->r) : 0;
+}
@@ -2,39 +2,82 @@
 #define RING_QUEUE_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdatomic.h>
 #include <stdbool.h>
-#include <string.h>
-
-// 确保大小为2的幂，便于位运算
-#define RING_QUEUE_SIZE 65536  // 2^16
-#define RING_QUEUE_MASK (RING_QUEUE_SIZE - 1)
-
-// 高性能无锁环形队列
-typedef struct ring_queue_s {
-    // 缓存行对齐，避免伪共享
-    _Alignas(64) atomic_uint head;  // 读位置
-    _Alignas(64) atomic_uint tail;  // 写位置
-    
-    // 数据存储（缓存行对齐）
-    _Alignas(64) int buffer[RING_QUEUE_SIZE];
-    
-    // 统计信息
-    _Alignas(64) atomic_ullong push_count;
-    _Alignas(64) atomic_ullong pop_count;
-    _Alignas(64) atomic_ullong push_fail_count;
-} ring_queue_t;
-
-// API
-void ring_queue_init(ring_queue_t *q);
-bool ring_queue_push(ring_queue_t *q, int item);
-bool ring_queue_pop(ring_queue_t *q, int *item);
-bool ring_queue_empty(ring_queue_t *q);
-bool ring_queue_full(ring_queue_t *q);
-uint32_t ring_queue_size(ring_queue_t *q);
-
-// 批量操作（更高性能）
-uint32_t ring_queue_push_batch(ring_queue_t *q, int *items, uint32_t count);
-uint32_t ring_queue_pop_batch(ring_queue_t *q, int *items, uint32_t count);
-
-#endif
\ No newline at end of file
+
+// 有界无锁环形队列族：元素为定长字节块（elem_size在初始化时指定），容量向上取整为2的幂
+// - spsc_ring_t：单生产者单消费者，只有head/tail两个计数，双方各自缓存对方的位置
+// - mpsc_ring_t / mpmc_ring_t：每个槽位带序号（Vyukov），槽位写完后才发布，消费者不会读到未写完的数据
+// 批量操作一次认领一段连续槽位，与其他线程竞争失败时重试，只在队列满/空时返回0
+#define RING_CACHE_LINE 64
+
+typedef struct spsc_ring_s {
+    _Alignas(RING_CACHE_LINE) atomic_size_t head;   // 消费者写
+    size_t tail_cache;                               // 消费者看到的tail
+
+    _Alignas(RING_CACHE_LINE) atomic_size_t tail;   // 生产者写
+    size_t head_cache;                               // 生产者看到的head
+    atomic_ullong push_fail_count;                   // 队列满（生产者更新）
+
+    _Alignas(RING_CACHE_LINE) char *buffer;
+    size_t mask;
+    size_t elem_size;
+} spsc_ring_t;
+
+// 带序号的槽位队列，MPSC和MPMC共用存储布局
+// 槽位i的序号：等于pos时可写入位置pos，等于pos+1时位置pos的数据已发布
+typedef struct seq_ring_s {
+    _Alignas(RING_CACHE_LINE) atomic_size_t enqueue_pos;
+    atomic_ullong push_fail_count;
+
+    _Alignas(RING_CACHE_LINE) atomic_size_t dequeue_pos;
+
+    _Alignas(RING_CACHE_LINE) char *cells;   // 每个槽位：序号 + 数据
+    size_t mask;
+    size_t elem_size;
+    size_t stride;
+} seq_ring_t;
+
+// 多生产者单消费者：消费者独占dequeue_pos，出队没有CAS
+typedef struct mpsc_ring_s {
+    seq_ring_t r;
+} mpsc_ring_t;
+
+// 多生产者多消费者
+typedef struct mpmc_ring_s {
+    seq_ring_t r;
+} mpmc_ring_t;
+
+// SPSC：push只能由一个线程调用，pop只能由另一个线程调用
+int spsc_ring_init(spsc_ring_t *q, size_t capacity, size_t elem_size);
+void spsc_ring_destroy(spsc_ring_t *q);
+bool spsc_ring_push(spsc_ring_t *q, const void *item);
+bool spsc_ring_pop(spsc_ring_t *q, void *item);
+uint32_t spsc_ring_push_batch(spsc_ring_t *q, const void *items, uint32_t count);
+uint32_t spsc_ring_pop_batch(spsc_ring_t *q, void *items, uint32_t count);
+// 任意线程可调用；非生产者/消费者线程看到的是近似值
+bool spsc_ring_empty(spsc_ring_t *q);
+size_t spsc_ring_size(spsc_ring_t *q);
+
+// MPSC：push任意线程，pop只能由一个线程调用
+int mpsc_ring_init(mpsc_ring_t *q, size_t capacity, size_t elem_size);
+void mpsc_ring_destroy(mpsc_ring_t *q);
+bool mpsc_ring_push(mpsc_ring_t *q, const void *item);
+bool mpsc_ring_pop(mpsc_ring_t *q, void *item);
+uint32_t mpsc_ring_push_batch(mpsc_ring_t *q, const void *items, uint32_t count);
+uint32_t mpsc_ring_pop_batch(mpsc_ring_t *q, void *items, uint32_t count);
+bool mpsc_ring_empty(mpsc_ring_t *q);
+size_t mpsc_ring_size(mpsc_ring_t *q);
+
+// MPMC：push/pop均可由任意线程调用
+int mpmc_ring_init(mpmc_ring_t *q, size_t capacity, size_t elem_size);
+void mpmc_ring_destroy(mpmc_ring_t *q);
+bool mpmc_ring_push(mpmc_ring_t *q, const void *item);
+bool mpmc_ring_pop(mpmc_ring_t *q, void *item);
+uint32_t mpmc_ring_push_batch(mpmc_ring_t *q, const void *items, uint32_t count);
+uint32_t mpmc_ring_pop_batch(mpmc_ring_t *q, void *items, uint32_t count);
+bool mpmc_ring_empty(mpmc_ring_t *q);
+size_t mpmc_ring_size(mpmc_ring_t *q);
+
+#endif
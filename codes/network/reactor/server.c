@@ -1,4 +1,9 @@
+#define _GNU_SOURCE
 #include "reactor.h"
+#include "codec.h"
+#include "log.h"
+#include "affinity.h"
+#include "handoff.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -7,9 +12,17 @@
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
+#include <poll.h>
 
 
 #define SERVER_PORT 8080
+#define UPGRADE_DRAIN_SECONDS 30   // 热升级后旧进程等待剩余连接关闭的上限
+
+static int g_server_fd = -1;              // accept线程模式的监听socket
+static atomic_bool g_accepting = true;    // 监听socket交给新进程后置为false，accept线程退出
+static atomic_bool g_stopping = false;
+static int g_upgrade_fd = -1;             // 等待新进程连接的控制socket
+static int g_stop_pipe[2] = { -1, -1 };   // 热升级完成后通知主线程退出
 
 // 创建服务器socket
 int create_server_socket(int port) {
@@ -59,16 +72,15 @@ int create_server_socket(int port) {
 // 接受连接线程
 void* accept_thread_main(void *arg) {
     reactor_t *reactor = (reactor_t*)arg;
-    int server_fd = create_server_socket(SERVER_PORT);
-    
-    if (server_fd == -1) {
-        printf("Failed to create server socket\n");
-        return NULL;
-    }
+    int server_fd = g_server_fd;
     
     printf("Accept thread started\n");
     
-    while (atomic_load(&reactor->running)) {
+    // 预留一个fd：fd耗尽（EMFILE/ENFILE）时临时释放，取出监听队列中的连接直接关闭，
+    // 否则连接一直留在队列里，accept线程只能反复失败
+    int reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    
+    while (atomic_load(&reactor->running) && atomic_load(&g_accepting)) {
         struct sockaddr_in client_addr;
         socklen_t addr_len = sizeof(client_addr);
         
@@ -79,38 +91,330 @@ void* accept_thread_main(void *arg) {
                 usleep(1000);
                 continue;
             }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE) {
+                LOG_ERROR("accept failed: %s, closing the pending connection", strerror(errno));
+                if (reserve_fd != -1) close(reserve_fd);
+                int fd = accept(server_fd, NULL, NULL);
+                if (fd != -1) close(fd);
+                reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                if (fd == -1) usleep(1000);
+                continue;
+            }
             perror("accept");
             break;
         }
         
-        printf("Accepted new connection: fd=%d\n", client_fd);
+        LOG_DEBUG("Accepted new connection: fd=%d", client_fd);
         
         // 使用无锁方式添加到reactor
         if (reactor_add_connection(reactor, client_fd) != 0) {
             close(client_fd);
-            printf("Failed to add connection to reactor\n");
+            LOG_ERROR("Failed to add connection to reactor");
         }
     }
     
+    if (reserve_fd != -1) close(reserve_fd);
     close(server_fd);
     printf("Accept thread stopped\n");
     return NULL;
 }
 
-int main() {
+// 热升级控制线程：新进程连上后交出监听socket和连接，等剩余连接关闭后通知主线程退出
+void* upgrade_thread_main(void *arg) {
+    reactor_t *reactor = (reactor_t*)arg;
+    
+    while (!atomic_load(&g_stopping)) {
+        int sock = accept4(g_upgrade_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (sock == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;   // 退出时shutdown控制socket
+        }
+        
+        handoff_msg_t msg;
+        if (handoff_recv(sock, &msg, NULL, 0) != 0 || msg.type != HANDOFF_REQUEST) {
+            printf("Ignoring malformed upgrade request\n");
+            close(sock);
+            continue;
+        }
+        printf("Upgrade requested by new process\n");
+        
+        // 监听socket一经交出，新连接全部由新进程accept；交出失败时继续服务，等待下一次请求
+        int extra_count = g_server_fd != -1 ? 1 : 0;
+        if (reactor_upgrade_send_listeners(reactor, sock, &g_server_fd, extra_count) != 0) {
+            close(sock);
+            continue;
+        }
+        atomic_store(&g_accepting, false);
+        
+        reactor_upgrade_send_connections(reactor, sock, msg.flags & HANDOFF_WANT_CONNECTIONS);
+        close(sock);
+        
+        // 留下的连接（io_uring后端、交接失败的）服务到对端关闭或超时
+        for (int i = 0; i < UPGRADE_DRAIN_SECONDS * 10 && !atomic_load(&g_stopping); i++) {
+            if (reactor_connection_count(reactor) == 0) break;
+            usleep(100000);
+        }
+        printf("Upgrade complete, %u connections left\n", reactor_connection_count(reactor));
+        
+        if (write(g_stop_pipe[1], "u", 1) < 0) {
+            perror("write stop pipe");
+        }
+        break;
+    }
+    return NULL;
+}
+
+static const char *placement_names[] = {
+    [PLACEMENT_ROUND_ROBIN] = "rr",
+    [PLACEMENT_LEAST_CONNECTIONS] = "least-conn",
+    [PLACEMENT_LEAST_EVENT_RATE] = "least-rate",
+    [PLACEMENT_POWER_OF_TWO] = "p2c",
+};
+
+static void usage(const char *prog) {
+    printf("Usage: %s [--reuseport] [--cbpf] [--codec line|length|websocket] [--metrics-port N]\n"
+           "       [--threads N] [--placement rr|least-conn|least-rate|p2c] [--rebalance]\n"
+           "       [--backend epoll|uring] [--busy-poll US] [--cpus LIST]\n"
+           "       [--upgrade-sock PATH] [--upgrade-from PATH] [--watermarks HIGH,LOW]\n"
+           "       [--read-budget CONN,LOOP] [--flush deferred|epollout]\n"
+           "       [--log-level trace|debug|info|warn|error|off]\n", prog);
+    printf("  --reuseport  each reactor thread owns a SO_REUSEPORT listener (no accept thread)\n");
+    printf("  --cbpf       with --reuseport, steer connections to the listener of the current CPU\n");
+    printf("  --codec      decode frames in the reactor thread and echo them back re-encoded\n");
+    printf("  --metrics-port  serve the metrics registry as plain text on this port\n");
+    printf("  --threads    reactor threads (default: online CPUs)\n");
+    printf("  --placement  thread selection for connections from the accept thread\n");
+    printf("  --rebalance  migrate hot connections off overloaded threads (epoll backend only)\n");
+    printf("  --backend    event backend; uring falls back to epoll when unavailable\n");
+    printf("  --busy-poll  keep polling without sleeping for US microseconds after the last event\n");
+    printf("  --cpus       pin reactor threads to these CPUs round-robin, e.g. 0-3,8\n");
+    printf("  --upgrade-sock  accept a hot-restart request from a new process on this Unix socket\n");
+    printf("  --upgrade-from  take over listeners and connections from the process serving PATH\n");
+    printf("  --watermarks    pause reading above HIGH queued output bytes, resume below LOW\n");
+    printf("  --read-budget   bytes read per connection / per loop iteration before yielding (0 = unlimited)\n");
+    printf("  --flush         deferred: one sendmsg per connection at the end of each loop iteration (default)\n");
+    printf("                  epollout: wait for EPOLLOUT before every write (epoll backend only)\n");
+    printf("  --log-level     runtime log level (default: info; debug logs every read/write/accept)\n");
+}
+
+int main(int argc, char *argv[]) {
+    bool reuseport = false;
+    bool cpu_local = false;
+    const codec_t *codec = NULL;
+    int metrics_port = 0;
+    int threads = 0;
+    int placement = PLACEMENT_ROUND_ROBIN;
+    bool rebalance = false;
+    reactor_backend_t backend = REACTOR_BACKEND_EPOLL;
+    int busy_poll_us = 0;
+    static int cpus[AFFINITY_MAX_CPUS];
+    int cpu_count = 0;
+    const char *upgrade_sock = NULL;
+    const char *upgrade_from = NULL;
+    size_t outq_high = 0;
+    size_t outq_low = 0;
+    bool set_budget = false;
+    size_t budget_conn = 0;
+    size_t budget_loop = 0;
+    bool deferred_flush = true;
+    int log_level = LOG_LEVEL_INFO;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reuseport") == 0) {
+            reuseport = true;
+        } else if (strcmp(argv[i], "--cbpf") == 0) {
+            cpu_local = true;
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            metrics_port = atoi(argv[++i]);
+            if (metrics_port <= 0 || metrics_port > 65535) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads <= 0 || threads > MAX_REACTOR_THREADS) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--placement") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            placement = -1;
+            for (size_t p = 0; p < sizeof(placement_names) / sizeof(placement_names[0]); p++) {
+                if (strcmp(name, placement_names[p]) == 0) {
+                    placement = (int)p;
+                }
+            }
+            if (placement < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--rebalance") == 0) {
+            rebalance = true;
+        } else if (strcmp(argv[i], "--busy-poll") == 0 && i + 1 < argc) {
+            busy_poll_us = atoi(argv[++i]);
+            if (busy_poll_us <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            cpu_count = affinity_parse_cpus(argv[++i], cpus, AFFINITY_MAX_CPUS);
+            if (cpu_count <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--upgrade-sock") == 0 && i + 1 < argc) {
+            upgrade_sock = argv[++i];
+        } else if (strcmp(argv[i], "--upgrade-from") == 0 && i + 1 < argc) {
+            upgrade_from = argv[++i];
+        } else if (strcmp(argv[i], "--watermarks") == 0 && i + 1 < argc) {
+            unsigned long high, low;
+            if (sscanf(argv[++i], "%lu,%lu", &high, &low) != 2 || low >= high) {
+                usage(argv[0]);
+                return 1;
+            }
+            outq_high = high;
+            outq_low = low;
+        } else if (strcmp(argv[i], "--read-budget") == 0 && i + 1 < argc) {
+            unsigned long conn_bytes, loop_bytes;
+            if (sscanf(argv[++i], "%lu,%lu", &conn_bytes, &loop_bytes) != 2) {
+                usage(argv[0]);
+                return 1;
+            }
+            set_budget = true;
+            budget_conn = conn_bytes;
+            budget_loop = loop_bytes;
+        } else if (strcmp(argv[i], "--flush") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "deferred") == 0) {
+                deferred_flush = true;
+            } else if (strcmp(name, "epollout") == 0) {
+                deferred_flush = false;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            log_level = log_parse_level(argv[++i]);
+            if (log_level < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "epoll") == 0) {
+                backend = REACTOR_BACKEND_EPOLL;
+            } else if (strcmp(name, "uring") == 0) {
+                backend = REACTOR_BACKEND_URING;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--codec") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, codec_line.name) == 0) {
+                codec = &codec_line;
+            } else if (strcmp(name, codec_length_prefix.name) == 0) {
+                codec = &codec_length_prefix;
+            } else if (strcmp(name, codec_websocket.name) == 0) {
+                codec = &codec_websocket;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    // 日志由后台线程批量写出，事件循环中不再直接调用printf；默认INFO，逐次读写的DEBUG日志不格式化
+    log_init(STDOUT_FILENO, log_level);
+    
     // 获取CPU核心数
     int cpu_cores = sysconf(_SC_NPROCESSORS_ONLN);
     int thread_count = cpu_cores > 0 ? cpu_cores : 4;
+    if (thread_count > MAX_REACTOR_THREADS) {
+        thread_count = MAX_REACTOR_THREADS;
+    }
+    if (threads > 0) {
+        thread_count = threads;
+    }
     
     printf("Creating reactor with %d threads\n", thread_count);
     
     // 创建高性能Reactor
-    reactor_t *reactor = reactor_create(thread_count);
+    reactor_t *reactor = reactor_create_backend(thread_count, backend);
     if (!reactor) {
         printf("Failed to create reactor\n");
         return 1;
     }
     
+    reactor_set_placement(reactor, (placement_policy_t)placement);
+    if (busy_poll_us > 0) {
+        reactor_set_busy_poll(reactor, -1, (uint32_t)busy_poll_us);
+    }
+    reactor_set_rebalance(reactor, rebalance);
+    if (outq_high > 0) {
+        reactor_set_watermarks(reactor, outq_high, outq_low);
+    }
+    if (set_budget) {
+        reactor_set_read_budget(reactor, budget_conn, budget_loop);
+    }
+    reactor_set_deferred_flush(reactor, deferred_flush);
+    if (cpu_count > 0) {
+        reactor_set_affinity(reactor, cpus, cpu_count);
+    }
+    
+    if (codec && reactor_set_codec(reactor, codec) != 0) {
+        printf("Failed to set codec\n");
+        reactor_destroy(reactor);
+        return 1;
+    }
+    
+    // 热升级：先从旧进程接管监听socket，旧进程此后不再accept
+    int upgrade_conn = -1;
+    int adopted_fd = -1;
+    if (upgrade_from) {
+        handoff_msg_t req = { .type = HANDOFF_REQUEST, .flags = HANDOFF_WANT_CONNECTIONS };
+        upgrade_conn = handoff_connect(upgrade_from);
+        if (upgrade_conn == -1 || handoff_send(upgrade_conn, &req, NULL, 0, NULL) != 0 ||
+            reactor_upgrade_recv_listeners(reactor, upgrade_conn, &adopted_fd, 1) < 0) {
+            printf("Failed to take over from %s: %s\n", upgrade_from, strerror(errno));
+            if (upgrade_conn != -1) close(upgrade_conn);
+            reactor_destroy(reactor);
+            return 1;
+        }
+    }
+    
+    // SO_REUSEPORT模式：监听socket在启动前挂到各线程的epoll中（已从旧进程接管时跳过）
+    if (reuseport && reactor->threads[0]->listen_fd == -1 &&
+        reactor_listen_reuseport(reactor, SERVER_PORT, cpu_local) != 0) {
+        printf("Failed to create reuseport listeners\n");
+        reactor_destroy(reactor);
+        return 1;
+    }
+    
+    // accept线程模式：旧进程的监听socket优先
+    if (!reuseport) {
+        g_server_fd = adopted_fd != -1 ? adopted_fd : create_server_socket(SERVER_PORT);
+        if (g_server_fd == -1) {
+            printf("Failed to create server socket\n");
+            reactor_destroy(reactor);
+            return 1;
+        }
+    } else if (adopted_fd != -1) {
+        close(adopted_fd);
+    }
+    
+    if (metrics_port && reactor->metrics_fd == -1 && reactor_listen_metrics(reactor, metrics_port) != 0) {
+        printf("Failed to create metrics listener\n");
+        reactor_destroy(reactor);
+        return 1;
+    }
+    
     // 启动Reactor
     if (reactor_run(reactor) != 0) {
         printf("Failed to start reactor\n");
@@ -120,30 +424,71 @@ int main() {
     
     printf("Reactor started successfully\n");
     
-    // 等待Reactor线程完全启动
-    printf("Waiting for reactor threads to start...\n");
-    usleep(500000); // 500ms 确保Reactor线程进入循环
+    pthread_t accept_thread = 0;
+    if (!reuseport) {
+        // 等待Reactor线程完全启动
+        printf("Waiting for reactor threads to start...\n");
+        usleep(500000); // 500ms 确保Reactor线程进入循环
+        
+        // 启动接受连接线程
+        if (pthread_create(&accept_thread, NULL, accept_thread_main, reactor) != 0) {
+            perror("pthread_create");
+            printf("Failed to create accept thread\n");
+            reactor_stop(reactor);
+            reactor_destroy(reactor);
+            return 1;
+        }
+    }
+    
+    // 接收旧进程的连接，完成后旧进程开始排空
+    if (upgrade_conn != -1) {
+        reactor_upgrade_recv_connections(reactor, upgrade_conn);
+        close(upgrade_conn);
+    }
     
-    // 启动接受连接线程
-    pthread_t accept_thread;
-    if (pthread_create(&accept_thread, NULL, accept_thread_main, reactor) != 0) {
-        perror("pthread_create");
-        printf("Failed to create accept thread\n");
-        reactor_stop(reactor);
-        reactor_destroy(reactor);
-        return 1;
+    pthread_t upgrade_thread = 0;
+    if (upgrade_sock) {
+        g_upgrade_fd = handoff_listen(upgrade_sock);
+        if (g_upgrade_fd == -1 || pipe2(g_stop_pipe, O_CLOEXEC) != 0 ||
+            pthread_create(&upgrade_thread, NULL, upgrade_thread_main, reactor) != 0) {
+            printf("Failed to listen for upgrades on %s: %s\n", upgrade_sock, strerror(errno));
+            upgrade_thread = 0;
+        } else {
+            printf("Waiting for upgrade requests on %s\n", upgrade_sock);
+        }
     }
     
     printf("Server running. Press Enter to stop...\n");
     
-    // 等待用户输入
-    getchar();
+    // 等待用户输入，或热升级完成
+    struct pollfd pfds[2] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = g_stop_pipe[0], .events = POLLIN },
+    };
+    while (poll(pfds, 2, -1) < 0 && errno == EINTR) {
+    }
     
     // 清理
     printf("Stopping server...\n");
+    atomic_store(&g_stopping, true);
+    if (upgrade_thread) {
+        shutdown(g_upgrade_fd, SHUT_RDWR);
+        pthread_join(upgrade_thread, NULL);
+    }
+    if (g_upgrade_fd != -1) close(g_upgrade_fd);
+    if (g_stop_pipe[0] != -1) {
+        close(g_stop_pipe[0]);
+        close(g_stop_pipe[1]);
+    }
+    reactor_stats(reactor);
     reactor_stop(reactor);
-    pthread_join(accept_thread, NULL);
+    if (accept_thread) {
+        pthread_join(accept_thread, NULL);
+    } else if (g_server_fd != -1) {
+        close(g_server_fd);
+    }
     reactor_destroy(reactor);
+    log_shutdown();
     
     printf("Server stopped\n");
     return 0;
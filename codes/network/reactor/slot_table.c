@@ -0,0 +1,79 @@
+#include "slot_table.h"
+#include <stdlib.h>
+
+// 初始化槽位表
+int slot_table_init(slot_table_t *t, uint32_t capacity) {
+    if (!t || capacity == 0 || capacity == SLOT_NIL) return -1;
+
+    // calloc按需提交物理页，未使用的槽位不占内存
+    t->values = calloc(capacity, sizeof(void*));
+    t->generations = calloc(capacity, sizeof(uint32_t));
+    t->next_free = calloc(capacity, sizeof(uint32_t));
+    if (!t->values || !t->generations || !t->next_free) {
+        slot_table_destroy(t);
+        return -1;
+    }
+
+    t->capacity = capacity;
+    t->free_head = SLOT_NIL;
+    t->cursor = 0;
+    t->used = 0;
+    return 0;
+}
+
+// 释放槽位表
+void slot_table_destroy(slot_table_t *t) {
+    if (!t) return;
+
+    free(t->values);
+    free(t->generations);
+    free(t->next_free);
+    t->values = NULL;
+    t->generations = NULL;
+    t->next_free = NULL;
+    t->capacity = 0;
+}
+
+// 分配槽位
+uint32_t slot_table_alloc(slot_table_t *t, void *value, uint32_t *gen) {
+    uint32_t index;
+
+    if (t->free_head != SLOT_NIL) {
+        // 优先复用已释放的槽位
+        index = t->free_head;
+        t->free_head = t->next_free[index];
+    } else if (t->cursor < t->capacity) {
+        index = t->cursor++;
+    } else {
+        return SLOT_NIL;
+    }
+
+    // 代数0保留给无效句柄
+    if (t->generations[index] == 0) {
+        t->generations[index] = 1;
+    }
+
+    t->values[index] = value;
+    t->used++;
+    if (gen) *gen = t->generations[index];
+    return index;
+}
+
+// 释放槽位
+bool slot_table_free(slot_table_t *t, uint32_t index, uint32_t gen) {
+    if (index >= t->capacity || t->generations[index] != gen || !t->values[index]) {
+        return false;
+    }
+
+    t->values[index] = NULL;
+
+    // 代数递增，旧句柄立即失效（跳过0）
+    if (++t->generations[index] == 0) {
+        t->generations[index] = 1;
+    }
+
+    t->next_free[index] = t->free_head;
+    t->free_head = index;
+    t->used--;
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef SLOT_TABLE_H
+#define SLOT_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 空闲链表结束标记
+#define SLOT_NIL UINT32_MAX
+
+// 槽位分配器：空闲链表 + 代数(generation)，分配/释放/查找都是O(1)
+// 仅由所属线程访问，不需要原子操作
+typedef struct slot_table_s {
+    void **values;          // 槽位中存放的对象
+    uint32_t *generations;  // 每个槽位的代数，释放时递增
+    uint32_t *next_free;    // 空闲链表的next指针
+    uint32_t capacity;
+    uint32_t free_head;     // 已释放槽位组成的空闲链表
+    uint32_t cursor;        // 从未使用过的槽位起点（按需推进，避免初始化时遍历整个表）
+    uint32_t used;
+} slot_table_t;
+
+// API
+int slot_table_init(slot_table_t *t, uint32_t capacity);
+void slot_table_destroy(slot_table_t *t);
+
+// 分配槽位，返回下标并通过gen返回当前代数；表满时返回SLOT_NIL
+uint32_t slot_table_alloc(slot_table_t *t, void *value, uint32_t *gen);
+// 释放槽位，代数递增使旧句柄失效；代数不匹配时返回false
+bool slot_table_free(slot_table_t *t, uint32_t index, uint32_t gen);
+
+// 按下标和代数查找，句柄过期时返回NULL
+static inline void *slot_table_get(const slot_table_t *t, uint32_t index, uint32_t gen) {
+    if (index >= t->capacity || t->generations[index] != gen) {
+        return NULL;
+    }
+    return t->values[index];
+}
+
+#endif
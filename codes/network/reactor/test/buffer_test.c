@@ -0,0 +1,96 @@
+// 发送队列回归测试：buf_outq_truncate撤销多段入队后，队列回到入队前的状态
+#include "../buffer.h"
+#include <stdio.h>
+#include <string.h>
+
+static int g_failures;
+static int g_freed;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+static void count_free(void *arg) {
+    (void)arg;
+    g_freed++;
+}
+
+static bool outq_equals(const buf_outq_t *q, const char *want) {
+    char got[BUF_SEGMENT_SIZE * 4];
+    size_t n = buf_outq_peek(q, got, sizeof(got));
+    return n == strlen(want) && q->len == n && memcmp(got, want, n) == 0;
+}
+
+// 帧头拷贝合并进已有段、负载零拷贝、帧尾拷贝，撤销后段的写入位置也退回
+static void test_rollback_frame(void) {
+    buf_pool_t pool;
+    buf_outq_t q;
+    static char payload[BUF_COPY_MAX * 2];
+
+    buf_pool_init(&pool, 16);
+    buf_outq_init(&q);
+    g_freed = 0;
+
+    buf_outq_copy(&q, &pool, "abc", 3);
+    size_t mark = q.len;
+    buf_outq_copy(&q, &pool, "HDR", 3);
+    CHECK(buf_outq_ref(&q, &pool, payload, sizeof(payload), count_free, NULL) == 0, "ref failed");
+    buf_outq_copy(&q, &pool, "T", 1);
+
+    buf_outq_truncate(&q, &pool, mark);
+    CHECK(outq_equals(&q, "abc"), "queue not rolled back, len=%zu", q.len);
+    CHECK(g_freed == 0, "free_fn called %d times for a rolled back slice", g_freed);
+    CHECK(pool.in_use == 1 && pool.slices_in_use == 1, "in_use=%llu slices=%llu",
+          (unsigned long long)pool.in_use, (unsigned long long)pool.slices_in_use);
+
+    // 退回后的段空间可以继续合并追加
+    buf_outq_copy(&q, &pool, "xyz", 3);
+    CHECK(outq_equals(&q, "abcxyz"), "append after rollback");
+    CHECK(pool.slices_in_use == 1, "append after rollback used a new slice");
+
+    buf_outq_clear(&q, &pool);
+    CHECK(g_freed == 0, "free_fn called after clear");
+    buf_pool_destroy(&pool);
+}
+
+// 跨段的拷贝和空队列的撤销
+static void test_rollback_segments(void) {
+    buf_pool_t pool;
+    buf_outq_t q;
+    static char big[BUF_SEGMENT_SIZE * 2];
+
+    buf_pool_init(&pool, 16);
+    buf_outq_init(&q);
+    memset(big, 'b', sizeof(big));
+
+    buf_outq_copy(&q, &pool, big, sizeof(big));
+    CHECK(pool.in_use >= 3, "copy of %zu bytes used %llu segments", sizeof(big), (unsigned long long)pool.in_use);
+    buf_outq_truncate(&q, &pool, 10);
+    CHECK(q.len == 10 && pool.in_use == 1 && pool.slices_in_use == 1, "len=%zu in_use=%llu",
+          q.len, (unsigned long long)pool.in_use);
+
+    buf_outq_truncate(&q, &pool, 0);
+    CHECK(q.len == 0 && q.head == NULL && q.tail == NULL && pool.in_use == 0, "truncate to empty");
+
+    buf_outq_copy(&q, &pool, "ok", 2);
+    CHECK(outq_equals(&q, "ok"), "append after truncate to empty");
+
+    buf_outq_clear(&q, &pool);
+    buf_pool_destroy(&pool);
+}
+
+int main(void) {
+    test_rollback_frame();
+    test_rollback_segments();
+    if (g_failures) {
+        printf("%d checks failed\n", g_failures);
+        return 1;
+    }
+    printf("PASS buffer_test\n");
+    return 0;
+}
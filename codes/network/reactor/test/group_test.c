@@ -0,0 +1,107 @@
+// 广播组回归测试：加入/离开按句柄索引，成员数组满时清理失效成员，没有广播的组不会无限增长
+#include "../group.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int g_failures;
+static uint32_t g_alive[1 << 16];   // 编号 -> 当前有效的代数，0为已关闭
+static uint32_t g_alive_calls;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+// 测试用句柄：低16位为编号，高位模拟代数，保证每次加入的句柄都不同
+static uint64_t make_handle(uint32_t id, uint32_t gen) {
+    return ((uint64_t)gen << 32) | id;
+}
+
+static bool handle_alive(uint64_t handle, void *arg) {
+    (void)arg;
+    g_alive_calls++;
+    return g_alive[handle & 0xFFFF] && (handle >> 32) == g_alive[handle & 0xFFFF];
+}
+
+// 成员数组与索引一致：每个成员都能查到且只出现一次
+static bool group_consistent(conn_group_t *g) {
+    for (uint32_t i = 0; i < g->count; i++) {
+        for (uint32_t j = i + 1; j < g->count; j++) {
+            if (g->members[i] == g->members[j]) return false;
+        }
+        if (group_add_member(g, g->members[i], NULL, NULL) != 1) return false;
+    }
+    return true;
+}
+
+static void test_join_leave(void) {
+    group_table_t t;
+    group_table_init(&t, 16);
+    conn_group_t *g = group_table_get(&t, 1);
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        CHECK(group_add_member(g, make_handle(i, 1), NULL, NULL) == 0, "join %u", i);
+    }
+    CHECK(group_add_member(g, make_handle(500, 1), NULL, NULL) == 1, "duplicate join accepted");
+    CHECK(g->count == 1000, "count=%u", g->count);
+
+    // 隔一个离开，剩余成员仍可通过索引找到
+    for (uint32_t i = 0; i < 1000; i += 2) {
+        CHECK(group_del_member(g, make_handle(i, 1)), "leave %u", i);
+    }
+    CHECK(!group_del_member(g, make_handle(0, 1)), "second leave succeeded");
+    CHECK(!group_del_member(g, make_handle(1, 2)), "leave with a stale handle succeeded");
+    CHECK(g->count == 500, "count=%u", g->count);
+    CHECK(group_consistent(g), "members and index disagree after leave");
+
+    group_table_destroy(&t);
+}
+
+// 连接不断加入后关闭、从不广播：组的容量受有效成员数限制，清理的代价均摊
+static void test_churn_without_broadcast(void) {
+    group_table_t t;
+    group_table_init(&t, 16);
+    conn_group_t *g = group_table_get(&t, 2);
+
+    srand(1);
+    uint32_t live = 0;
+    g_alive_calls = 0;
+    for (uint32_t round = 0; round < 200000; round++) {
+        uint32_t id = (uint32_t)rand() % 64;
+        if (g_alive[id]) {
+            g_alive[id] = 0;    // 关闭，不离开组
+            live--;
+        } else {
+            g_alive[id] = round + 1;
+            live++;
+            CHECK(group_add_member(g, make_handle(id, g_alive[id]), handle_alive, NULL) == 0,
+                  "join round %u", round);
+        }
+    }
+    CHECK(g->capacity <= 128, "capacity grew to %u with at most 64 live members", g->capacity);
+    CHECK(g_alive_calls <= 200000 * 2, "%u liveness checks for 200000 rounds", g_alive_calls);
+    CHECK(group_consistent(g), "members and index disagree after churn");
+
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < g->count; i++) {
+        if (handle_alive(g->members[i], NULL)) found++;
+    }
+    CHECK(found == live, "%u of %u live members in the group", found, live);
+
+    group_table_destroy(&t);
+}
+
+int main(void) {
+    test_join_leave();
+    test_churn_without_broadcast();
+    if (g_failures) {
+        printf("%d checks failed\n", g_failures);
+        return 1;
+    }
+    printf("PASS group_test\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+// 时间轮回归测试：按next_timeout给出的等待时间推进，定时器必须准时触发
+#include "../timer_wheel.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint64_t g_now;
+static uint64_t g_fired_at;
+static int g_failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+static void record_fire(timer_node_t *node, void *arg) {
+    (void)node;
+    (void)arg;
+    g_fired_at = g_now;
+}
+
+// 模拟事件循环：按next_timeout睡眠后推进，直到定时器触发，返回触发时间
+static uint64_t run_until_fired(timer_wheel_t *tw) {
+    g_fired_at = 0;
+    for (int i = 0; i < 100000 && g_fired_at == 0; i++) {
+        int timeout = timer_wheel_next_timeout(tw, g_now);
+        if (timeout < 0) break;
+        g_now += timeout > 0 ? (uint64_t)timeout : 1;
+        timer_wheel_advance(tw, g_now);
+    }
+    return g_fired_at;
+}
+
+// 停在第0层一圈的起点（1280）时，上层中20ms后到期的定时器必须可见
+static void test_boundary_timeout(void) {
+    timer_wheel_t tw;
+    timer_node_t node;
+
+    g_now = 0;
+    timer_wheel_init(&tw, g_now);
+    timer_node_init(&node, record_fire, NULL);
+    timer_wheel_add(&tw, &node, 1300, 0);
+
+    g_now = 1279;
+    timer_wheel_advance(&tw, g_now);
+    int timeout = timer_wheel_next_timeout(&tw, g_now);
+    CHECK(timeout == 21, "timeout at %llu is %d, want 21", (unsigned long long)g_now, timeout);
+
+    uint64_t fired = run_until_fired(&tw);
+    CHECK(fired == 1300, "timer due at 1300 fired at %llu", (unsigned long long)fired);
+}
+
+// 各种起点和到期时间组合，覆盖第0层边界和上层级联
+static void test_fire_on_time(void) {
+    srand(1);
+    for (int round = 0; round < 2000; round++) {
+        timer_wheel_t tw;
+        timer_node_t node;
+        uint64_t start = (uint64_t)(rand() % 100000);
+        uint64_t delay = (uint64_t)(rand() % (round & 1 ? 70000 : 600)) + 1;
+
+        g_now = start;
+        timer_wheel_init(&tw, g_now);
+        timer_node_init(&node, record_fire, NULL);
+        timer_wheel_add(&tw, &node, start + delay, 0);
+
+        // 先空转到到期前某一时刻，让current停在任意位置（包括边界）
+        g_now = start + (uint64_t)rand() % delay;
+        timer_wheel_advance(&tw, g_now);
+
+        uint64_t fired = run_until_fired(&tw);
+        CHECK(fired == start + delay, "start=%llu delay=%llu fired at %llu",
+              (unsigned long long)start, (unsigned long long)delay, (unsigned long long)fired);
+    }
+}
+
+int main(void) {
+    test_boundary_timeout();
+    test_fire_on_time();
+    if (g_failures) {
+        printf("%d checks failed\n", g_failures);
+        return 1;
+    }
+    printf("PASS timer_wheel_test\n");
+    return 0;
+}
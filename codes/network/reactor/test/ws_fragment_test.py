@@ -0,0 +1,111 @@
+import base64
+import os
+import socket
+import struct
+import sys
+
+# 需先以 --codec websocket 启动 reactor_server
+SERVER_IP = '127.0.0.1'
+SERVER_PORT = 8080
+
+OP_CONT, OP_TEXT, OP_BINARY, OP_CLOSE, OP_PING = 0x0, 0x1, 0x2, 0x8, 0x9
+
+
+def connect():
+    sock = socket.create_connection((SERVER_IP, SERVER_PORT), timeout=2)
+    key = base64.b64encode(os.urandom(16)).decode()
+    req = ("GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+           "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n" % key)
+    sock.sendall(req.encode())
+    resp = b''
+    while b'\r\n\r\n' not in resp:
+        chunk = sock.recv(1024)
+        if not chunk:
+            raise RuntimeError("handshake: connection closed")
+        resp += chunk
+    if not resp.startswith(b'HTTP/1.1 101'):
+        raise RuntimeError("handshake: %r" % resp.split(b'\r\n')[0])
+    return sock
+
+
+# 客户端帧必须带掩码，负载限定在125字节内
+def frame(opcode, payload, fin=True):
+    mask = os.urandom(4)
+    data = bytes(b ^ mask[i & 3] for i, b in enumerate(payload))
+    return bytes([(0x80 if fin else 0) | opcode, 0x80 | len(payload)]) + mask + data
+
+
+def recv_exact(sock, n):
+    buf = b''
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            break
+        buf += chunk
+    return buf
+
+
+# 返回(fin, opcode, payload)，连接关闭时返回None
+def recv_frame(sock):
+    hdr = recv_exact(sock, 2)
+    if len(hdr) < 2:
+        return None
+    length = hdr[1] & 0x7F
+    if length == 126:
+        length = struct.unpack('!H', recv_exact(sock, 2))[0]
+    elif length == 127:
+        length = struct.unpack('!Q', recv_exact(sock, 8))[0]
+    return (hdr[0] & 0x80) != 0, hdr[0] & 0x0F, recv_exact(sock, length)
+
+
+def closed_by_server(sock):
+    try:
+        return sock.recv(1) == b''
+    except ConnectionResetError:
+        return True
+
+
+def test_fragmented_echo():
+    sock = connect()
+    # 分片之间穿插PING，回送时保留每个分片的opcode和fin位
+    sock.sendall(frame(OP_TEXT, b'ab', fin=False) + frame(OP_PING, b'p') +
+                 frame(OP_CONT, b'cd', fin=False) + frame(OP_CONT, b'ef'))
+    got = [recv_frame(sock) for _ in range(4)]
+    want = [(False, OP_TEXT, b'ab'), (True, 0xA, b'p'), (False, OP_CONT, b'cd'), (True, OP_CONT, b'ef')]
+    assert got == want, got
+    # 消息结束后可以开始新消息
+    sock.sendall(frame(OP_BINARY, b'gh'))
+    assert recv_frame(sock) == (True, OP_BINARY, b'gh')
+    sock.close()
+
+
+def test_unexpected_continuation():
+    sock = connect()
+    sock.sendall(frame(OP_CONT, b'xx'))
+    assert closed_by_server(sock), "continuation without a message in progress was accepted"
+    sock.close()
+
+
+def test_interleaved_message():
+    sock = connect()
+    sock.sendall(frame(OP_TEXT, b'ab', fin=False))
+    assert recv_frame(sock) == (False, OP_TEXT, b'ab')
+    sock.sendall(frame(OP_TEXT, b'cd'))
+    assert closed_by_server(sock), "new message inside a fragmented message was accepted"
+    sock.close()
+
+
+def main():
+    failed = 0
+    for test in (test_fragmented_echo, test_unexpected_continuation, test_interleaved_message):
+        try:
+            test()
+            print("PASS %s" % test.__name__)
+        except Exception as e:
+            failed += 1
+            print("FAIL %s: %r" % (test.__name__, e))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
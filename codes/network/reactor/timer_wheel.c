@@ -0,0 +1,262 @@
+#include "timer_wheel.h"
+#include <string.h>
+#include <limits.h>
+
+// 初始化时间轮
+void timer_wheel_init(timer_wheel_t *tw, uint64_t now_ms) {
+    memset(tw, 0, sizeof(*tw));
+    tw->current = now_ms;
+}
+
+// 初始化定时器节点
+void timer_node_init(timer_node_t *node, timer_cb_t cb, void *arg) {
+    node->next = NULL;
+    node->pprev = NULL;
+    node->expire = 0;
+    node->interval = 0;
+    node->cb = cb;
+    node->arg = arg;
+}
+
+// 第0层位图操作
+static inline void l0_bit_set(timer_wheel_t *tw, uint32_t idx) {
+    tw->l0_bitmap[idx >> 6] |= (uint64_t)1 << (idx & 63);
+}
+
+static inline void l0_bit_clear(timer_wheel_t *tw, uint32_t idx) {
+    tw->l0_bitmap[idx >> 6] &= ~((uint64_t)1 << (idx & 63));
+}
+
+// 查找第0层从idx开始的第一个非空槽，没有返回-1
+static int l0_find_next(const timer_wheel_t *tw, uint32_t idx) {
+    uint32_t word = idx >> 6;
+    uint64_t bits = tw->l0_bitmap[word] & (~(uint64_t)0 << (idx & 63));
+
+    while (1) {
+        if (bits) {
+            return (int)((word << 6) + __builtin_ctzll(bits));
+        }
+        if (++word >= TW_L0_SIZE / 64) {
+            return -1;
+        }
+        bits = tw->l0_bitmap[word];
+    }
+}
+
+// 插入链表头部
+static inline void list_push(timer_node_t **head, timer_node_t *node) {
+    node->next = *head;
+    if (*head) (*head)->pprev = &node->next;
+    *head = node;
+    node->pprev = head;
+}
+
+// 按到期时间挂到对应层的槽位
+static void tw_link(timer_wheel_t *tw, timer_node_t *node) {
+    uint64_t expire = node->expire;
+
+    // 已到期的放到下一个tick
+    if (expire < tw->current) {
+        expire = tw->current;
+    }
+
+    uint64_t delta = expire - tw->current;
+    if (delta < TW_L0_SIZE) {
+        uint32_t idx = expire & TW_L0_MASK;
+        list_push(&tw->l0[idx], node);
+        l0_bit_set(tw, idx);
+    } else {
+        // 超出范围的挂到最高层末尾，级联时按真实到期时间重新放置
+        if (delta >= TW_MAX_SPAN) {
+            expire = tw->current + TW_MAX_SPAN - 1;
+            delta = TW_MAX_SPAN - 1;
+        }
+
+        for (int level = 0; level < TW_UPPER_LEVELS; level++) {
+            int shift = TW_L0_BITS + level * TW_LN_BITS;
+            if (delta < ((uint64_t)1 << (shift + TW_LN_BITS))) {
+                list_push(&tw->ln[level][(expire >> shift) & TW_LN_MASK], node);
+                break;
+            }
+        }
+    }
+
+    tw->count++;
+}
+
+// 从所在槽位摘除
+static void tw_unlink(timer_wheel_t *tw, timer_node_t *node) {
+    timer_node_t **pprev = node->pprev;
+
+    *pprev = node->next;
+    if (node->next) node->next->pprev = pprev;
+    node->next = NULL;
+    node->pprev = NULL;
+
+    // 第0层槽位变空时清除位图
+    if (pprev >= &tw->l0[0] && pprev < &tw->l0[TW_L0_SIZE] && *pprev == NULL) {
+        l0_bit_clear(tw, (uint32_t)(pprev - &tw->l0[0]));
+    }
+
+    tw->count--;
+}
+
+// 添加/重新设置定时器
+void timer_wheel_add(timer_wheel_t *tw, timer_node_t *node, uint64_t expire_ms, uint64_t interval_ms) {
+    if (timer_node_pending(node)) {
+        tw_unlink(tw, node);
+    }
+
+    node->expire = expire_ms;
+    node->interval = interval_ms;
+    tw_link(tw, node);
+}
+
+// 取消定时器
+void timer_wheel_del(timer_wheel_t *tw, timer_node_t *node) {
+    if (timer_node_pending(node)) {
+        tw_unlink(tw, node);
+    }
+}
+
+// 将上层某个槽位的定时器重新分配到下层
+static void tw_cascade_slot(timer_wheel_t *tw, timer_node_t **slot) {
+    timer_node_t *list = *slot;
+    *slot = NULL;
+    if (list) list->pprev = &list;
+
+    while (list) {
+        timer_node_t *node = list;
+        list = node->next;
+        if (list) list->pprev = &list;
+        node->next = NULL;
+        node->pprev = NULL;
+        tw->count--;
+        tw_link(tw, node);
+    }
+}
+
+// 第0层转完一圈时级联，从高层往低层处理
+static void tw_cascade(timer_wheel_t *tw) {
+    uint32_t idx[TW_UPPER_LEVELS];
+    int top = 0;
+
+    for (int level = 0; level < TW_UPPER_LEVELS; level++) {
+        idx[level] = (tw->current >> (TW_L0_BITS + level * TW_LN_BITS)) & TW_LN_MASK;
+        top = level;
+        if (idx[level] != 0) break;
+    }
+
+    for (int level = top; level >= 0; level--) {
+        tw_cascade_slot(tw, &tw->ln[level][idx[level]]);
+    }
+}
+
+// 移动到tick t；落在第0层一圈的起点时立即级联，
+// 保证停在边界上时next_timeout能在第0层看到上层中即将到期的定时器
+static void tw_move_to(timer_wheel_t *tw, uint64_t t) {
+    tw->current = t;
+    if ((t & TW_L0_MASK) == 0) {
+        tw_cascade(tw);
+    }
+}
+
+// 摘除所有定时器
+static void tw_clear_slot(timer_wheel_t *tw, timer_node_t **slot, void (*fn)(timer_node_t *node)) {
+    while (*slot) {
+        timer_node_t *node = *slot;
+        tw_unlink(tw, node);
+        if (fn) fn(node);
+    }
+}
+
+void timer_wheel_clear(timer_wheel_t *tw, void (*fn)(timer_node_t *node)) {
+    for (int i = 0; i < TW_L0_SIZE; i++) {
+        tw_clear_slot(tw, &tw->l0[i], fn);
+    }
+    for (int level = 0; level < TW_UPPER_LEVELS; level++) {
+        for (int i = 0; i < TW_LN_SIZE; i++) {
+            tw_clear_slot(tw, &tw->ln[level][i], fn);
+        }
+    }
+}
+
+// 推进时间轮，空槽通过位图整段跳过
+uint32_t timer_wheel_advance(timer_wheel_t *tw, uint64_t now_ms) {
+    uint32_t fired = 0;
+
+    while (tw->current <= now_ms) {
+        uint32_t idx = tw->current & TW_L0_MASK;
+
+        if (tw->count == 0) {
+            tw->current = now_ms + 1;
+            break;
+        }
+
+        int next = l0_find_next(tw, idx);
+        if (next < 0) {
+            // 本圈剩余槽位为空，直接跳到下一圈起点
+            uint64_t boundary = (tw->current | TW_L0_MASK) + 1;
+            if (boundary > now_ms) {
+                tw_move_to(tw, now_ms + 1);
+                break;
+            }
+            tw_move_to(tw, boundary);
+            continue;
+        }
+
+        uint64_t slot_time = (tw->current & ~(uint64_t)TW_L0_MASK) + (uint64_t)next;
+        if (slot_time > now_ms) {
+            tw_move_to(tw, now_ms + 1);
+            break;
+        }
+        tw_move_to(tw, slot_time + 1);
+
+        // 摘下整个槽位再执行，回调中可以安全地添加/取消任意定时器
+        timer_node_t *list = tw->l0[next];
+        tw->l0[next] = NULL;
+        l0_bit_clear(tw, (uint32_t)next);
+        if (list) list->pprev = &list;
+
+        while (list) {
+            timer_node_t *node = list;
+            list = node->next;
+            if (list) list->pprev = &list;
+            node->next = NULL;
+            node->pprev = NULL;
+            tw->count--;
+
+            // 周期定时器先重新挂载，回调中取消自己也是安全的；落后太多时不补发
+            if (node->interval) {
+                uint64_t expire = node->expire + node->interval;
+                node->expire = expire > now_ms ? expire : now_ms + node->interval;
+                tw_link(tw, node);
+            }
+
+            node->cb(node, node->arg);
+            fired++;
+        }
+    }
+
+    return fired;
+}
+
+// 距离下一个可能到期的时间
+int timer_wheel_next_timeout(const timer_wheel_t *tw, uint64_t now_ms) {
+    if (tw->count == 0) {
+        return -1;
+    }
+
+    // 第0层有定时器时取最近的槽，否则等到下一次级联
+    int next = l0_find_next(tw, tw->current & TW_L0_MASK);
+    uint64_t deadline = next >= 0
+        ? (tw->current & ~(uint64_t)TW_L0_MASK) + (uint64_t)next
+        : (tw->current | TW_L0_MASK) + 1;
+
+    if (deadline <= now_ms) {
+        return 0;
+    }
+
+    uint64_t delta = deadline - now_ms;
+    return delta > INT_MAX ? INT_MAX : (int)delta;
+}
@@ -0,0 +1,65 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 分层时间轮：1ms一个tick，第0层256槽，第1~3层各64槽，覆盖约18小时
+// 超出范围的定时器挂在最高层，级联时重新计算位置
+#define TW_L0_BITS 8
+#define TW_LN_BITS 6
+#define TW_L0_SIZE (1 << TW_L0_BITS)
+#define TW_LN_SIZE (1 << TW_LN_BITS)
+#define TW_L0_MASK (TW_L0_SIZE - 1)
+#define TW_LN_MASK (TW_LN_SIZE - 1)
+#define TW_UPPER_LEVELS 3
+#define TW_MAX_SPAN ((uint64_t)1 << (TW_L0_BITS + TW_UPPER_LEVELS * TW_LN_BITS))
+
+typedef struct timer_node_s timer_node_t;
+typedef void (*timer_cb_t)(timer_node_t *node, void *arg);
+
+// 侵入式定时器节点，嵌入到连接等对象中，不需要额外分配
+struct timer_node_s {
+    timer_node_t *next;
+    timer_node_t **pprev;   // 指向前一个节点的next（或槽头），O(1)摘除
+    uint64_t expire;        // 到期时间(ms)
+    uint64_t interval;      // 周期(ms)，0表示单次
+    timer_cb_t cb;
+    void *arg;
+};
+
+typedef struct timer_wheel_s {
+    uint64_t current;       // 下一个待处理的tick
+    uint32_t count;         // 挂载的定时器数量
+
+    timer_node_t *l0[TW_L0_SIZE];
+    timer_node_t *ln[TW_UPPER_LEVELS][TW_LN_SIZE];
+
+    // 第0层非空槽位图，用于快速跳过空槽和计算下一个到期时间
+    uint64_t l0_bitmap[TW_L0_SIZE / 64];
+} timer_wheel_t;
+
+// API（仅由所属线程调用）
+void timer_wheel_init(timer_wheel_t *tw, uint64_t now_ms);
+void timer_node_init(timer_node_t *node, timer_cb_t cb, void *arg);
+
+// 添加/重新设置定时器（已挂载的节点先摘除），O(1)
+void timer_wheel_add(timer_wheel_t *tw, timer_node_t *node, uint64_t expire_ms, uint64_t interval_ms);
+// 取消定时器，O(1)
+void timer_wheel_del(timer_wheel_t *tw, timer_node_t *node);
+
+// 摘除所有定时器（不执行回调），fn可用于释放节点所属对象
+void timer_wheel_clear(timer_wheel_t *tw, void (*fn)(timer_node_t *node));
+
+// 推进时间轮并执行到期回调，返回执行的回调数量
+uint32_t timer_wheel_advance(timer_wheel_t *tw, uint64_t now_ms);
+
+// 距离下一个可能到期的时间(ms)，没有定时器返回-1；结果不会晚于实际到期时间
+int timer_wheel_next_timeout(const timer_wheel_t *tw, uint64_t now_ms);
+
+static inline bool timer_node_pending(const timer_node_t *node) {
+    return node->pprev != NULL;
+}
+
+#endif
@@ -0,0 +1,52 @@
+// metrics_cli.c - 读取reactor_server的指标共享内存并打印
+// 用法：metrics_cli <pid|/shm-name> [interval_sec]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+
+#include "metrics.h"
+
+#define RENDER_BUFFER_SIZE (256 * 1024)
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s <pid|/shm-name> [interval_sec]\n", argv[0]);
+        return 1;
+    }
+    
+    // 纯数字参数视为服务进程的pid
+    char shm_name[64];
+    if (isdigit((unsigned char)argv[1][0])) {
+        snprintf(shm_name, sizeof(shm_name), "/reactor-%s", argv[1]);
+    } else {
+        snprintf(shm_name, sizeof(shm_name), "%s", argv[1]);
+    }
+    int interval = argc == 3 ? atoi(argv[2]) : 0;
+    
+    metrics_t *m = metrics_open(shm_name);
+    if (!m) {
+        printf("Failed to open metrics %s\n", shm_name);
+        return 1;
+    }
+    
+    char *buf = malloc(RENDER_BUFFER_SIZE);
+    if (!buf) {
+        metrics_close(m);
+        return 1;
+    }
+    
+    for (;;) {
+        size_t len = metrics_render(m, buf, RENDER_BUFFER_SIZE);
+        fwrite(buf, 1, len, stdout);
+        fflush(stdout);
+        if (interval <= 0) break;
+        sleep((unsigned)interval);
+        printf("\n");
+    }
+    
+    free(buf);
+    metrics_close(m);
+    return 0;
+}
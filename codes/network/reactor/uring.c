@@ -0,0 +1,217 @@
+#include "uring.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                              const void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// 依次尝试更省事的启动参数，旧内核逐步退回
+static int uring_setup(unsigned entries, unsigned cq_entries, struct io_uring_params *p) {
+    static const unsigned flag_sets[] = {
+        // 单一提交者 + 推迟任务到io_uring_enter中执行，完成事件不会打断线程
+        // 提交者是启用ring的线程，所以先以禁用状态创建，由uring_enable在事件线程中启用
+        IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED,
+        IORING_SETUP_COOP_TASKRUN,
+        0,
+    };
+
+    for (size_t i = 0; i < sizeof(flag_sets) / sizeof(flag_sets[0]); i++) {
+        memset(p, 0, sizeof(*p));
+        p->flags = flag_sets[i] | IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+        p->cq_entries = cq_entries;
+
+        int fd = sys_io_uring_setup(entries, p);
+        if (fd >= 0) return fd;
+        if (errno != EINVAL) return -1;
+    }
+    return -1;
+}
+
+int uring_init(uring_t *ring, unsigned entries, unsigned cq_entries) {
+    struct io_uring_params p;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = uring_setup(entries, cq_entries, &p);
+    if (ring->fd < 0) return -1;
+
+    // 需要EXT_ARG（带超时的等待）和NODROP（CQ满时不丢完成事件），即5.11+
+    if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+        close(ring->fd);
+        errno = ENOSYS;
+        return -1;
+    }
+    ring->features = p.features;
+    ring->disabled = (p.flags & IORING_SETUP_R_DISABLED) != 0;
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) goto fail;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) goto fail;
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail;
+
+    char *sq = ring->sq_ring;
+    ring->sq_head = (unsigned*)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+    ring->sq_mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_entries = *(unsigned*)(sq + p.sq_off.ring_entries);
+    ring->sqe_tail = *ring->sq_tail;
+
+    // SQE下标与提交队列槽位一一对应
+    for (unsigned i = 0; i < ring->sq_entries; i++) {
+        ring->sq_array[i] = i;
+    }
+
+    char *cq = ring->cq_ring;
+    ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    uring_exit(ring);
+    return -1;
+}
+
+void uring_exit(uring_t *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+int uring_enable(uring_t *ring) {
+    if (!ring->disabled) return 0;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_ENABLE_RINGS, NULL, 0) < 0) return -1;
+    ring->disabled = false;
+    return 0;
+}
+
+// 发布已填写的SQE，返回内核尚未消费的SQE数
+// 按sq_head计算：上次io_uring_enter只提交了一部分（EAGAIN/EBUSY或提交数不足）时，
+// 已发布但未消费的SQE在这次调用中重新计入to_submit
+static unsigned uring_flush_sq(uring_t *ring) {
+    if (ring->sqe_tail != *ring->sq_tail) {
+        atomic_store_explicit((_Atomic unsigned*)ring->sq_tail, ring->sqe_tail, memory_order_release);
+    }
+    unsigned head = atomic_load_explicit((_Atomic unsigned*)ring->sq_head, memory_order_acquire);
+    return ring->sqe_tail - head;
+}
+
+int uring_submit_and_wait(uring_t *ring, unsigned wait_nr, int timeout_ms) {
+    unsigned submit = uring_flush_sq(ring);
+    // DEFER_TASKRUN下完成事件只在带GETEVENTS的调用中产生，不等待时也要带上
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg = { .sigmask = 0, .sigmask_sz = _NSIG / 8 };
+    const void *argp = NULL;
+    size_t argsz = 0;
+
+    if (wait_nr && timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        argp = &arg;
+        argsz = sizeof(arg);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+
+    ring->enter_calls++;
+    int ret = sys_io_uring_enter(ring->fd, submit, wait_nr, flags, argp, argsz);
+    if (ret < 0) {
+        if (errno == ETIME || errno == EINTR) return 0;
+        return -errno;
+    }
+    return ret;
+}
+
+struct io_uring_sqe* uring_get_sqe(uring_t *ring) {
+    unsigned head = atomic_load_explicit((_Atomic unsigned*)ring->sq_head, memory_order_acquire);
+
+    if (ring->sqe_tail - head >= ring->sq_entries) {
+        // 提交队列满：先提交，不等待完成
+        if (uring_submit_and_wait(ring, 0, -1) < 0) return NULL;
+        head = atomic_load_explicit((_Atomic unsigned*)ring->sq_head, memory_order_acquire);
+        if (ring->sqe_tail - head >= ring->sq_entries) return NULL;
+    }
+
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int uring_buf_ring_init(uring_t *ring, uring_buf_ring_t *br, unsigned entries, uint16_t bgid) {
+    // 缓冲环要求按页对齐，条目数为2的幂
+    size_t size = entries * sizeof(struct io_uring_buf);
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (mem == MAP_FAILED) return -1;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)mem;
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(mem, size);
+        return -1;
+    }
+
+    br->br = mem;
+    br->entries = entries;
+    br->mask = entries - 1;
+    br->bgid = bgid;
+    br->tail = 0;
+    return 0;
+}
+
+void uring_buf_ring_destroy(uring_t *ring, uring_buf_ring_t *br) {
+    if (!br->br) return;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = br->bgid;
+    if (ring->fd >= 0) {
+        sys_io_uring_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+    munmap(br->br, br->entries * sizeof(struct io_uring_buf));
+    br->br = NULL;
+}
@@ -0,0 +1,96 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <linux/io_uring.h>
+
+// 最小化的io_uring封装：直接使用系统调用和内核头文件，不依赖liburing
+// 仅由所属线程访问；SQE在uring_submit_and_wait时一次性提交
+typedef struct uring_s {
+    int fd;
+    unsigned features;
+
+    // 提交队列
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sqe_tail;          // 已填写、尚未发布给内核的SQE位置
+    struct io_uring_sqe *sqes;
+
+    // 完成队列
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    bool disabled;              // 以IORING_SETUP_R_DISABLED创建，尚未启用
+    uint64_t enter_calls;       // io_uring_enter调用次数
+} uring_t;
+
+// 内核提供缓冲环（IORING_REGISTER_PBUF_RING）
+typedef struct uring_buf_ring_s {
+    struct io_uring_buf_ring *br;
+    unsigned entries;
+    unsigned mask;
+    uint16_t bgid;
+    uint16_t tail;              // 本地尾指针，uring_buf_ring_publish时发布
+} uring_buf_ring_t;
+
+// 创建/销毁ring；内核不支持或参数不被接受时返回-1（errno有效）
+int uring_init(uring_t *ring, unsigned entries, unsigned cq_entries);
+void uring_exit(uring_t *ring);
+// 在提交请求的线程中调用一次：单一提交者模式下启用ring并把该线程登记为提交者
+int uring_enable(uring_t *ring);
+
+// 取一个空闲SQE并清零；提交队列满时先提交已填写的部分
+struct io_uring_sqe* uring_get_sqe(uring_t *ring);
+
+// 提交所有SQE，收取完成事件并等待至少wait_nr个；timeout_ms < 0表示不超时
+// 返回提交的SQE数，出错返回-errno（超时和被信号打断不算错误）
+int uring_submit_and_wait(uring_t *ring, unsigned wait_nr, int timeout_ms);
+
+static inline unsigned uring_sq_pending(const uring_t *ring) {
+    return ring->sqe_tail - *ring->sq_tail;
+}
+
+// 逐个取完成事件：取到的CQE处理完后调用uring_cqe_advance
+static inline struct io_uring_cqe* uring_peek_cqe(uring_t *ring, unsigned index) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = atomic_load_explicit((_Atomic unsigned*)ring->cq_tail, memory_order_acquire);
+    if (head + index == tail) return NULL;
+    return &ring->cqes[(head + index) & ring->cq_mask];
+}
+
+static inline void uring_cqe_advance(uring_t *ring, unsigned count) {
+    atomic_store_explicit((_Atomic unsigned*)ring->cq_head, *ring->cq_head + count, memory_order_release);
+}
+
+// 提供缓冲环
+int uring_buf_ring_init(uring_t *ring, uring_buf_ring_t *br, unsigned entries, uint16_t bgid);
+void uring_buf_ring_destroy(uring_t *ring, uring_buf_ring_t *br);
+
+// 放入一个缓冲（publish前内核不可见）
+static inline void uring_buf_ring_add(uring_buf_ring_t *br, void *addr, uint32_t len, uint16_t bid) {
+    struct io_uring_buf *buf = &br->br->bufs[br->tail & br->mask];
+    buf->addr = (uint64_t)(uintptr_t)addr;
+    buf->len = len;
+    buf->bid = bid;
+    br->tail++;
+}
+
+static inline void uring_buf_ring_publish(uring_buf_ring_t *br) {
+    atomic_store_explicit((_Atomic uint16_t*)&br->br->tail, br->tail, memory_order_release);
+}
+
+#endif